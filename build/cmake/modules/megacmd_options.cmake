@@ -59,6 +59,8 @@ if(UNIX AND NOT APPLE)
         message(STATUS "Configuring with FUSE support")
         option(WITH_FUSE "Build with FUSE support." ON)
     endif()
+
+    option(INSTALL_CLIENT_SYMLINKS "Install mega-* commands as symlinks to mega-exec instead of wrapper scripts" ON)
 endif()
 
 if(WITH_FUSE)
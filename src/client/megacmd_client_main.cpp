@@ -24,5 +24,6 @@ int main(int argc, char* argv[])
     megacmd::Instance<megacmd::WindowsConsoleController> windowsConsoleController;
 #endif
 
-    return megacmd::executeClient(argc, argv, COUT, CERR);
+    // mega-exec can also be invoked as mega-<command> (e.g: through symlinks), saving the wrapper scripts startup
+    return megacmd::executeMultiCallClient(argc, argv, COUT, CERR);
 }
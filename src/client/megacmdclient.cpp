@@ -846,6 +846,94 @@ void statechangehandle(string statestring, MegaCmdShellCommunications & comsMana
     }
 }
 
+// Executes the commands read from stdin (one per line) through a single connection to the server
+int executeBatch(int argc, char* argv[], MegaCmdShellCommunications &comms, OUTSTREAMTYPE &outstream, OUTSTREAMTYPE &errorOutput)
+{
+    int maxInFlight = 1;
+    for (int i = 2; i < argc; ++i)
+    {
+        string arg = argv[i];
+        if (arg.compare(0, 11, "--parallel=") == 0)
+        {
+            maxInFlight = std::max(1, atoi(arg.substr(11).c_str()));
+        }
+        else
+        {
+            cerr << "Unexpected argument for batch mode: " << arg << endl;
+            comms.shutdown();
+            return -1;
+        }
+    }
+
+    comms.waitForServerReadyOrRegistrationFailed();
+
+    auto prepareCommand = [&comms](const string &line)
+    {
+        vector<string> words = getlistOfWords(line.c_str(), false, true);
+        vector<char*> commandArgv;
+        commandArgv.push_back(const_cast<char*>("mega-exec"));
+        for (auto &word : words)
+        {
+            commandArgv.push_back(const_cast<char*>(word.c_str()));
+        }
+        commandArgv.push_back(nullptr);
+        return parseArgs(static_cast<int>(words.size() + 1), commandArgv.data(), comms);
+    };
+
+    int outcode = comms.executeBatch(std::cin, prepareCommand, maxInFlight, outstream, errorOutput);
+
+    // do always return positive error codes (POSIX compliant)
+    if (outcode < 0)
+    {
+        outcode = - outcode;
+    }
+
+    comms.shutdown();
+    return outcode;
+}
+
+std::optional<std::string> getMultiCallCommand(std::string_view programPath)
+{
+    auto separator = programPath.find_last_of("/\\");
+    std::string_view name = separator == std::string_view::npos ? programPath : programPath.substr(separator + 1);
+
+    constexpr std::string_view prefix = "mega-";
+    if (!startsWith(name, prefix))
+    {
+        return std::nullopt;
+    }
+
+    std::string_view command = name.substr(prefix.size());
+    if (command.empty() || command == "exec" || command == "cmd" || command == "cmd-server" || command == "cmd-updater")
+    {
+        return std::nullopt;
+    }
+    return std::string(command);
+}
+
+int executeMultiCallClient(int argc, char* argv[], OUTSTREAMTYPE &outstream, OUTSTREAMTYPE &errorOutput)
+{
+#ifdef _WIN32
+    // executeClient takes the arguments from the (wide) command line there: the command could not be injected
+    std::optional<std::string> command;
+#else
+    auto command = argc > 0 ? getMultiCallCommand(argv[0]) : std::nullopt;
+#endif
+    if (!command)
+    {
+        return executeClient(argc, argv, outstream, errorOutput);
+    }
+
+    // argv as if invoked through mega-exec: the rest is parsed exactly the same way
+    vector<char*> execArgv;
+    execArgv.reserve(static_cast<size_t>(argc) + 2);
+    execArgv.push_back(argv[0]);
+    execArgv.push_back(command->data());
+    execArgv.insert(execArgv.end(), argv + 1, argv + argc);
+    execArgv.push_back(nullptr);
+    return executeClient(argc + 1, execArgv.data(), outstream, errorOutput);
+}
+
 int executeClient(int argc, char* argv[], OUTSTREAMTYPE & outstream, OUTSTREAMTYPE &errorOutput)
 {
 #ifdef _WIN32
@@ -891,6 +979,11 @@ int executeClient(int argc, char* argv[], OUTSTREAMTYPE & outstream, OUTSTREAMTY
         return -2;
     }
 
+    if (command == "--batch")
+    {
+        return executeBatch(argc, argv, *comms, outstream, errorOutput);
+    }
+
 #if defined _WIN32 && !defined MEGACMD_TESTING_CODE
     int wargc;
 
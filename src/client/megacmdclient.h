@@ -20,6 +20,22 @@
 
 #include "../megacmdcommonutils.h"
 
+#include <optional>
+#include <string>
+#include <string_view>
+
 namespace megacmd {
     int executeClient(int argc, char* argv[], OUTSTREAMTYPE &outstream, OUTSTREAMTYPE &errorOutput = CERR);
+
+    /**
+     * @brief Gets the command a multi-call invocation refers to, given the program path (argv[0]).
+     * e.g: "/usr/bin/mega-ls" -> "ls". Returns nullopt for "mega-exec" and names of other MEGAcmd binaries.
+     */
+    std::optional<std::string> getMultiCallCommand(std::string_view programPath);
+
+    /**
+     * @brief Same as executeClient, but when invoked as mega-<command> (e.g: through a symlink to mega-exec)
+     * the command is taken from the program name, as the wrapper scripts do: "mega-ls -l" == "mega-exec ls -l"
+     */
+    int executeMultiCallClient(int argc, char* argv[], OUTSTREAMTYPE &outstream, OUTSTREAMTYPE &errorOutput = CERR);
 } // end namespace
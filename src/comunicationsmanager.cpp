@@ -46,8 +46,8 @@ CmdPetition* ComunicationsManager::registerStateListener(std::unique_ptr<CmdPeti
         return nullptr;
     }
 
-    stateListenersPetitions.emplace_back(std::move(inf));
-    return stateListenersPetitions.back().get();
+    stateListenersPetitions.push_back(StateListener{std::move(inf), StateListenerQueue()});
+    return stateListenersPetitions.back().mPetition.get();
 }
 
 int ComunicationsManager::waitForPetition()
@@ -71,40 +71,116 @@ int ComunicationsManager::getMaxStateListeners() const
 
 void ComunicationsManager::ackStateListenersAndRemoveClosed()
 {
+    std::lock_guard<std::recursive_mutex> g(mStateListenersMutex);
     informStateListeners("ack");
+    flushStateListeners(); // closed connections are detected when writing
+}
+
+bool ComunicationsManager::queueStateMessage(StateListener &listener, const string &s)
+{
+    if (!listener.mQueue.push(s + (char) 0x1F))
+    {
+        LOG_warn << "Unregistering state listener not consuming messages (" << listener.mQueue.size()
+                 << " pending). Original petition: " << listener.mPetition->getRedactedLine();
+        return false;
+    }
+    return true;
 }
 
 bool ComunicationsManager::informStateListeners(const string &s)
 {
+    if (!isValidUtf8(s))
+    {
+        LOG_err << "Attempt to inform listeners of an invalid utf-8 string of size " << s.size();
+        ASSERT_UTF8_BREAK("Attempt to inform listeners of an invalid utf-8 string");
+        return true;
+    }
+
     std::lock_guard<std::recursive_mutex> g(mStateListenersMutex);
     for (auto it = stateListenersPetitions.begin(); it != stateListenersPetitions.end();)
     {
-        if (informStateListener(it->get(), s + (char) 0x1F) < 0)
+        if (!queueStateMessage(*it, s))
         {
             it = stateListenersPetitions.erase(it);
             continue;
         }
         ++it;
     }
+
+    stateListenersQueued();
     return !stateListenersPetitions.empty();
 }
 
 void ComunicationsManager::informStateListenerByClientId(const string &s, int clientID)
 {
+    if (!isValidUtf8(s))
+    {
+        LOG_err << "Attempt to inform listener of an invalid utf-8 string of size " << s.size();
+        ASSERT_UTF8_BREAK("Attempt to inform listener of an invalid utf-8 string");
+        return;
+    }
+
     std::lock_guard<std::recursive_mutex> g(mStateListenersMutex);
     for (auto it = stateListenersPetitions.begin(); it != stateListenersPetitions.end(); ++it)
     {
-        if (clientID == (*it)->clientID)
+        if (clientID == it->mPetition->clientID)
         {
-            if (informStateListener(it->get(), s + (char) 0x1F) < 0)
+            if (!queueStateMessage(*it, s))
             {
                 stateListenersPetitions.erase(it);
+                return;
             }
+            stateListenersQueued();
             return;
         }
     }
 }
 
+void ComunicationsManager::stateListenersQueued()
+{
+    flushStateListeners();
+}
+
+void ComunicationsManager::flushStateListeners()
+{
+    std::lock_guard<std::recursive_mutex> g(mStateListenersMutex);
+    for (auto it = stateListenersPetitions.begin(); it != stateListenersPetitions.end();)
+    {
+        bool closed = false;
+        auto &queue = it->mQueue;
+        while (!queue.empty())
+        {
+            auto sent = sendToStateListener(it->mPetition.get(), queue.front());
+            if (sent < 0)
+            {
+                closed = true;
+                break;
+            }
+            if (sent == 0)
+            {
+                break; // would block: to be continued
+            }
+            queue.consume(static_cast<size_t>(sent));
+        }
+
+        if (closed)
+        {
+            it = stateListenersPetitions.erase(it);
+            continue;
+        }
+        ++it;
+    }
+}
+
+long long ComunicationsManager::sendToStateListener(CmdPetition *inf, std::string_view data)
+{
+    if (informStateListener(inf, std::string(data)) < 0)
+    {
+        return -1;
+    }
+    return static_cast<long long>(data.size());
+}
+
 int ComunicationsManager::informStateListener(CmdPetition *inf, const string &s)
 {
     return 0;
@@ -134,6 +210,13 @@ std::string ComunicationsManager::getUserResponse(CmdPetition *inf, string messa
     return string();
 }
 
+void ComunicationsManager::startBatchSession(std::unique_ptr<CmdPetition> inf, int, PetitionDispatcher)
+{
+    OUTSTRINGSTREAM os;
+    os << "Batch sessions are not supported in this platform" << std::endl;
+    returnAndClosePetition(std::move(inf), &os, MCMD_NOTPERMITTED);
+}
+
 void CmdPetition::setLine(std::string_view line)
 {
     mLine = line;
@@ -186,14 +269,4 @@ bool CmdPetition::isFromCmdShell() const
 {
     return startsWith(mLine, "X");
 }
-
-MegaThread *CmdPetition::getPetitionThread() const
-{
-    return petitionThread;
-}
-
-void CmdPetition::setPetitionThread(MegaThread *value)
-{
-    petitionThread = value;
-}
 }//end namespace
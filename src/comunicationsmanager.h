@@ -21,6 +21,10 @@
 
 #include "megacmd.h"
 #include "megacmdcommonutils.h"
+#include "megacmd_state_listener_queue.h"
+#include "megacmd_cancellation.h"
+
+#include <functional>
 
 namespace megacmd {
 class CmdPetition
@@ -28,10 +32,12 @@ class CmdPetition
     std::string mLine;
 
 public:
-    mega::MegaThread *petitionThread = nullptr;
     int clientID = -27;
     bool clientDisconnected = false;
 
+    // Cancelled when the client is detected to have gone away while the petition is being processed
+    CancellationToken mCancellationToken;
+
     virtual ~CmdPetition() = default;
 
     void setLine(std::string_view line);
@@ -45,18 +51,48 @@ public:
 
     bool isFromCmdShell() const;
 
-    mega::MegaThread *getPetitionThread() const;
-    void setPetitionThread(mega::MegaThread *value);
     virtual std::string getPetitionDetails() const { return {}; }
 };
 
 class ComunicationsManager
 {
+public:
+    using PetitionDispatcher = std::function<void(std::unique_ptr<CmdPetition>)>;
+
 private:
     fd_set fds;
 
+    struct StateListener
+    {
+        std::unique_ptr<CmdPetition> mPetition;
+        StateListenerQueue mQueue;
+    };
+
     std::recursive_mutex mStateListenersMutex;
-    std::vector<std::unique_ptr<CmdPetition>> stateListenersPetitions;
+    std::vector<StateListener> stateListenersPetitions;
+
+    // Queues the message for a listener. Returns false if the listener is to be removed (not consuming messages)
+    bool queueStateMessage(StateListener &listener, const std::string &s);
+
+protected:
+    /**
+     * @brief Called after messages have been queued for state listeners.
+     * Messages are sent right away by default (flushStateListeners): implementations with an event loop
+     * should just wake it up, and get the queues flushed from there.
+     */
+    virtual void stateListenersQueued();
+
+    /**
+     * @brief Sends as much as possible of the pending messages of every state listener, without blocking
+     * (unless sendToStateListener does). Listeners whose connection was closed are removed.
+     */
+    void flushStateListeners();
+
+    /**
+     * @brief Sends (part of) data to a state listener
+     * @returns the number of bytes sent (0 if that would block), or -1 if connection closed by listener (removal required)
+     */
+    virtual long long sendToStateListener(CmdPetition *inf, std::string_view data);
 
 public:
     ComunicationsManager();
@@ -91,6 +127,7 @@ public:
 
     /**
      * @brief Sends an status message (e.g. prompt:who@/new/prompt:) to all registered listeners
+     * Messages are queued per listener (see StateListenerQueue) and, where there is an event loop, sent from there.
      * @param s
      * @returns if state listeners left
      */
@@ -116,6 +153,21 @@ public:
 
     virtual int getConfirmation(CmdPetition *inf, std::string message);
     virtual std::string getUserResponse(CmdPetition *inf, std::string message);
+
+    /**
+     * @brief Takes over the connection of a petition to receive many framed commands through it (see megacmd_framing.h)
+     * Each command received is handed to dispatch as a new petition, whose outputs are framed with its id.
+     * The connection is closed once the client has finished sending commands and all of them have been responded.
+     * @param maxInFlight Max number of commands of the session being processed at the same time
+     */
+    virtual void startBatchSession(std::unique_ptr<CmdPetition> inf, int maxInFlight, PetitionDispatcher dispatch);
+
+    /**
+     * @brief Watches the client of a petition about to be processed: if it goes away, the cancellation token
+     * of the petition is cancelled. The watch ends when the petition is returned (see returnAndClosePetition).
+     * Does nothing where hang ups cannot be detected by the event loop.
+     */
+    virtual void watchForCancellation(CmdPetition* /*inf*/) {}
 };
 
 } //end namespace
@@ -23,6 +23,11 @@
 #include <sys/ioctl.h>
 #include <sys/resource.h>
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
 #ifdef __MACH__
 #define MSG_NOSIGNAL 0
 #endif
@@ -35,6 +40,19 @@ using namespace mega;
 
 namespace megacmd {
 
+namespace {
+// Commands of batch sessions have no socket of their own: they are answered with frames through their session
+CmdPetitionPosixSockets* getSocketPetition(CmdPetition *inf, const char *action)
+{
+    auto petition = dynamic_cast<CmdPetitionPosixSockets *>(inf);
+    if (!petition)
+    {
+        LOG_err << action << ": " << inf->getPetitionDetails() << " has no socket of its own";
+    }
+    return petition;
+}
+}
+
 ComunicationsManagerFileSockets::ComunicationsManagerFileSockets()
 {
     count = 0;
@@ -99,9 +117,380 @@ int ComunicationsManagerFileSockets::initialize()
             return errno;
         }
     }
+
+#ifdef __linux__
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (mEpollFd < 0)
+    {
+        LOG_fatal << "ERROR creating epoll instance: " << strerror(errno);
+        return errno;
+    }
+
+    mWakeUpFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (mWakeUpFd < 0)
+    {
+        LOG_fatal << "ERROR creating wake up eventfd: " << strerror(errno);
+        return errno;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = mWakeUpFd;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mWakeUpFd, &ev) == -1)
+    {
+        LOG_fatal << "ERROR adding wake up eventfd to epoll: " << strerror(errno);
+        return errno;
+    }
+
+    if (sockfd >= 0)
+    {
+        if (fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL, 0) | O_NONBLOCK) == -1)
+        {
+            LOG_err << "ERROR setting listening socket as non blocking: " << errno;
+        }
+
+        ev.events = EPOLLIN | EPOLLET;
+        ev.data.fd = sockfd;
+        if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, sockfd, &ev) == -1)
+        {
+            LOG_fatal << "ERROR adding listening socket to epoll: " << strerror(errno);
+            return errno;
+        }
+    }
+#endif
     return 0;
 }
 
+#ifdef __linux__
+void ComunicationsManagerFileSockets::acceptPendingConnections()
+{
+    // edge-triggered: we need to drain the backlog until accept would block
+    mAcceptPending = false;
+    for (;;)
+    {
+        int newsockfd = accept4(sockfd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if (newsockfd >= 0)
+        {
+            struct epoll_event ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN | EPOLLRDHUP;
+            ev.data.u64 = sIncomingPetitionTag | static_cast<uint64_t>(newsockfd);
+            if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, newsockfd, &ev) == -1)
+            {
+                LOG_err << "ERROR watching accepted socket with epoll: " << errno;
+                close(newsockfd);
+                continue;
+            }
+            mIncomingPetitions.emplace(newsockfd, PetitionAssembler());
+            continue;
+        }
+
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            return;
+        }
+
+        if (errno == EMFILE || errno == ENFILE)
+        {
+            LOG_fatal << "ERROR on accept at waitForPetition: TOO many open files.";
+            ackStateListenersAndRemoveClosed();
+        }
+        else
+        {
+            LOG_err << "ERROR on accept at waitForPetition: " << errno;
+        }
+        // no new edge will come for the connections still in the backlog: retry them later
+        mAcceptPending = true;
+        return;
+    }
+}
+
+void ComunicationsManagerFileSockets::readIncomingPetition(int socket)
+{
+    auto it = mIncomingPetitions.find(socket);
+    if (it == mIncomingPetitions.end())
+    {
+        return;
+    }
+
+    PetitionAssembler &assembler = it->second;
+    auto status = PetitionAssembler::Status::INCOMPLETE;
+    while (status == PetitionAssembler::Status::INCOMPLETE)
+    {
+        auto n = recv(socket, buffer, sizeof(buffer), 0);
+        if (n > 0)
+        {
+            status = assembler.append(buffer, static_cast<size_t>(n));
+        }
+        else if (!n)
+        {
+            status = assembler.onClosed();
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            return; // more may come: legacy petitions are completed once quiet (see expireIncomingPetitions)
+        }
+        else if (errno != EINTR)
+        {
+            LOG_err << "ERROR reading petition from socket " << socket << ": " << errno;
+            status = PetitionAssembler::Status::INVALID;
+        }
+    }
+
+    finishIncomingPetition(it, status);
+}
+
+void ComunicationsManagerFileSockets::expireIncomingPetitions()
+{
+    const auto now = PetitionAssembler::Clock::now();
+    for (auto it = mIncomingPetitions.begin(); it != mIncomingPetitions.end();)
+    {
+        auto current = it++;
+        auto status = current->second.onIdle(now);
+        if (status != PetitionAssembler::Status::INCOMPLETE)
+        {
+            finishIncomingPetition(current, status);
+        }
+    }
+}
+
+int ComunicationsManagerFileSockets::getIncomingPetitionsTimeoutMs() const
+{
+    if (mIncomingPetitions.empty())
+    {
+        return -1;
+    }
+
+    auto deadline = PetitionAssembler::Clock::time_point::max();
+    for (const auto &incoming : mIncomingPetitions)
+    {
+        deadline = std::min(deadline, incoming.second.getDeadline());
+    }
+    const auto now = PetitionAssembler::Clock::now();
+    if (deadline <= now)
+    {
+        return 0;
+    }
+    // rounded up, not to wake up right before the deadline
+    return static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(deadline - now).count());
+}
+
+void ComunicationsManagerFileSockets::finishIncomingPetition(std::map<int, PetitionAssembler>::iterator it, PetitionAssembler::Status status)
+{
+    const int socket = it->first;
+    PetitionAssembler &assembler = it->second;
+
+    epoll_ctl(mEpollFd, EPOLL_CTL_DEL, socket, nullptr);
+    if (status == PetitionAssembler::Status::INVALID)
+    {
+        if (assembler.hasTimedOut())
+        {
+            LOG_err << "Petition not received in time from socket " << socket << ". Dropping its connection";
+        }
+        else
+        {
+            LOG_err << "Invalid petition received" << (assembler.isFramed() ? ". Frame type: " + std::to_string(static_cast<int>(assembler.getHeader().mType)) : "");
+        }
+        mIncomingPetitions.erase(it);
+        close(socket);
+        return;
+    }
+
+    // Responses (and user confirmations) are written and read from the petition's thread, blocking
+    if (fcntl(socket, F_SETFL, fcntl(socket, F_GETFL, 0) & ~O_NONBLOCK) == -1)
+    {
+        LOG_err << "ERROR setting petition socket as blocking: " << errno;
+    }
+
+    auto inf = std::make_unique<CmdPetitionPosixSockets>();
+    inf->outSocket = socket;
+    inf->mFramed = assembler.isFramed();
+    inf->mPetitionId = inf->mFramed ? assembler.getHeader().mPetitionId : 0;
+    inf->setLine(assembler.takeLine());
+    mIncomingPetitions.erase(it);
+    mReceivedPetitions.push_back(std::move(inf));
+}
+
+void ComunicationsManagerFileSockets::watchForHangUps(int socket, bool alsoWritable)
+{
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLRDHUP | EPOLLET | (alsoWritable ? EPOLLOUT : 0);
+    ev.data.fd = socket;
+    if (epoll_ctl(mEpollFd, alsoWritable ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, socket, &ev) == -1
+            && errno != ENOENT) // already removed after a hang up
+    {
+        LOG_err << "ERROR watching state listener socket with epoll: " << errno;
+    }
+}
+
+void ComunicationsManagerFileSockets::watchForCancellation(CmdPetition *inf)
+{
+    auto petition = dynamic_cast<CmdPetitionPosixSockets *>(inf);
+    if (!petition || petition->outSocket == -1)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> g(mCancellationWatchesMutex);
+    const uint64_t watchId = ++mLastCancellationWatchId;
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLRDHUP | EPOLLET; // an already hung up client triggers the event right away
+    ev.data.u64 = sCancellationWatchTag | watchId;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, petition->outSocket, &ev) == -1)
+    {
+        LOG_err << "ERROR watching petition socket with epoll: " << errno;
+        return;
+    }
+
+    mCancellationWatches.emplace(watchId, CancellationWatch{petition->outSocket, inf->mCancellationToken});
+    petition->mCancellationWatchId = watchId;
+}
+
+void ComunicationsManagerFileSockets::cancelWatchedPetition(uint64_t watchId)
+{
+    std::lock_guard<std::mutex> g(mCancellationWatchesMutex);
+    auto it = mCancellationWatches.find(watchId);
+    if (it == mCancellationWatches.end())
+    {
+        return; // already returned: the event is stale
+    }
+
+    LOG_debug << "Client of petition with socket " << it->second.mSocket << " hung up. Cancelling it";
+    it->second.mToken.cancel();
+    epoll_ctl(mEpollFd, EPOLL_CTL_DEL, it->second.mSocket, nullptr);
+    mCancellationWatches.erase(it);
+}
+
+void ComunicationsManagerFileSockets::stopWatchingForCancellation(CmdPetition *inf)
+{
+    auto petition = dynamic_cast<CmdPetitionPosixSockets *>(inf);
+    if (!petition || !petition->mCancellationWatchId)
+    {
+        return;
+    }
+
+    // Before the socket is closed, so that it is never reused while being watched
+    std::lock_guard<std::mutex> g(mCancellationWatchesMutex);
+    if (mCancellationWatches.erase(petition->mCancellationWatchId))
+    {
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, petition->outSocket, nullptr);
+    }
+    petition->mCancellationWatchId = 0;
+}
+
+void ComunicationsManagerFileSockets::stateListenersQueued()
+{
+    // never block the producer: messages will be sent from the event loop
+    if (!mStateListenersPending.exchange(true))
+    {
+        stopWaiting();
+    }
+}
+
+bool ComunicationsManagerFileSockets::receivedPetition()
+{
+    return !mReceivedPetitions.empty();
+}
+
+int ComunicationsManagerFileSockets::waitForPetition()
+{
+    constexpr int maxEvents = 64;
+    struct epoll_event events[maxEvents];
+
+    // do not block if there are petitions already received or connections pending to be accepted,
+    // nor past the deadline of any incoming petition
+    int timeoutMs = getIncomingPetitionsTimeoutMs();
+    if (!mReceivedPetitions.empty())
+    {
+        timeoutMs = 0;
+    }
+    else if (mAcceptPending && (timeoutMs < 0 || timeoutMs > 1000))
+    {
+        timeoutMs = 1000;
+    }
+
+    int rc = epoll_wait(mEpollFd, events, maxEvents, timeoutMs);
+    if (rc < 0)
+    {
+        if (errno != EINTR)  //syscall
+        {
+            LOG_fatal << "Error at epoll_wait: " << errno;
+            return errno;
+        }
+        return 0;
+    }
+
+    bool hangUpDetected = false;
+    bool flushRequired = false;
+    for (int i = 0; i < rc; i++)
+    {
+        if (events[i].data.u64 & sCancellationWatchTag)
+        {
+            cancelWatchedPetition(events[i].data.u64 & ~sCancellationWatchTag);
+            continue;
+        }
+        if (events[i].data.u64 & sIncomingPetitionTag)
+        {
+            readIncomingPetition(static_cast<int>(events[i].data.u64 & ~sIncomingPetitionTag));
+            continue;
+        }
+
+        const int fd = events[i].data.fd;
+        if (fd == sockfd)
+        {
+            acceptPendingConnections();
+        }
+        else if (fd == mWakeUpFd)
+        {
+            uint64_t value;
+            while (read(mWakeUpFd, &value, sizeof(value)) > 0);
+        }
+        else if (events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+        {
+            // a state listener went away. Closing its socket will remove it from the epoll set.
+            epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, nullptr);
+            hangUpDetected = true;
+        }
+        else if (events[i].events & EPOLLOUT)
+        {
+            // a slow state listener can take more messages: stop watching until it falls behind again
+            struct epoll_event ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLRDHUP | EPOLLET;
+            ev.data.fd = fd;
+            epoll_ctl(mEpollFd, EPOLL_CTL_MOD, fd, &ev);
+            flushRequired = true;
+        }
+    }
+
+    if (flushRequired || mStateListenersPending.exchange(false))
+    {
+        flushStateListeners();
+    }
+
+    if (rc == 0 && mAcceptPending)
+    {
+        acceptPendingConnections();
+    }
+
+    expireIncomingPetitions();
+
+    if (hangUpDetected)
+    {
+        ackStateListenersAndRemoveClosed();
+    }
+
+    return 0;
+}
+#else
 bool ComunicationsManagerFileSockets::receivedPetition()
 {
     return FD_ISSET(sockfd, &fds);
@@ -125,12 +514,25 @@ int ComunicationsManagerFileSockets::waitForPetition()
     }
     return 0;
 }
+#endif
 
 void ComunicationsManagerFileSockets::stopWaiting()
 {
 #ifdef _WIN32
     shutdown(sockfd,SD_BOTH);
 #else
+#ifdef __linux__
+    if (mWakeUpFd >= 0)
+    {
+        LOG_verbose << "Waking up main event loop";
+        uint64_t value = 1;
+        if (write(mWakeUpFd, &value, sizeof(value)) == sizeof(value))
+        {
+            return;
+        }
+        LOG_err << "ERROR writing to wake up eventfd: " << errno << ". Shutting down main socket instead";
+    }
+#endif
     LOG_verbose << "Shutting down main socket ";
 
     if (shutdown(sockfd,SHUT_RDWR) == -1)
@@ -185,7 +587,12 @@ void ComunicationsManagerFileSockets::stopWaiting()
 
 CmdPetition* ComunicationsManagerFileSockets::registerStateListener(std::unique_ptr<CmdPetition> &&inf)
 {
-    const int socket = ((CmdPetitionPosixSockets*) inf.get())->outSocket;
+    auto petition = getSocketPetition(inf.get(), "Registering state listener");
+    if (!petition)
+    {
+        return nullptr;
+    }
+    const int socket = petition->outSocket;
     LOG_debug << "Registering state listener petition with socket: " << socket;
 
 #ifndef NDEBUG
@@ -196,7 +603,15 @@ CmdPetition* ComunicationsManagerFileSockets::registerStateListener(std::unique_
         LOG_err << "ERROR setting state listener socket timeout: " << errno;
     }
 #endif
-    return ComunicationsManager::registerStateListener(std::move(inf));
+
+    CmdPetition *registered = ComunicationsManager::registerStateListener(std::move(inf));
+#ifdef __linux__
+    if (registered)
+    {
+        watchForHangUps(socket);
+    }
+#endif
+    return registered;
 }
 
 int ComunicationsManagerFileSockets::getMaxStateListeners() const
@@ -210,7 +625,9 @@ int ComunicationsManagerFileSockets::getMaxStateListeners() const
         }
         int systemNumFilesLimit = static_cast<int>(limit.rlim_cur);
         int maxListeners = systemNumFilesLimit - std::max(100, static_cast<int>(systemNumFilesLimit * 0.20)); // leave 20% or 100 file descriptors for libraries and other fds:
+#ifndef __linux__
         maxListeners = std::min(maxListeners, static_cast<int>(FD_SETSIZE * 0.4)); // we don't want to use fd with numbers > 1024: select will not digest them well: lets play a safe 60% margin.
+#endif
 
         return std::max(2/*minimum requirement*/, maxListeners); // maxListeners may be negative based on above calculations (unexpected). Let's play our chances of survival despite that.
     }();
@@ -224,7 +641,27 @@ int ComunicationsManagerFileSockets::getMaxStateListeners() const
  */
 void ComunicationsManagerFileSockets::returnAndClosePetition(std::unique_ptr<CmdPetition> inf, OUTSTRINGSTREAM *s, int outCode)
 {
-    const int socket = ((CmdPetitionPosixSockets *) inf.get())->outSocket;
+#ifdef __linux__
+    stopWatchingForCancellation(inf.get());
+#endif
+
+    if (isFramed(inf.get()))
+    {
+        int32_t code = outCode;
+        string sout = s->str();
+        if (!sendResponseFrame(inf.get(), FrameType::FINAL, std::string_view(reinterpret_cast<const char*>(&code), sizeof(code)), sout))
+        {
+            LOG_err << "ERROR writing final response of " << inf->getPetitionDetails() << ": " << errno;
+        }
+        return;
+    }
+
+    auto petition = getSocketPetition(inf.get(), "Return and close");
+    if (!petition)
+    {
+        return;
+    }
+    const int socket = petition->outSocket;
     assert(socket != -1);
 
     LOG_verbose << "Output to write in socket " << socket;
@@ -281,51 +718,153 @@ void ComunicationsManagerFileSockets::sendPartialOutputImpl(CmdPetition *inf, ch
         return;
     }
 
-    int connectedsocket = ((CmdPetitionPosixSockets *)inf)->outSocket;
-    assert(connectedsocket != -1);
-    if (connectedsocket == -1)
+    if (!binaryContents && !isValidUtf8(s, size))
     {
-        std::cerr << "Return and close: no valid outsocket " << ((CmdPetitionPosixSockets *)inf)->outSocket << endl;
+        std::cerr << "Attempt to sendPartialOutput of invalid utf8 of size " << size << std::endl;
+        ASSERT_UTF8_BREAK("Attempt to sendPartialOutput of invalid utf8");
         return;
     }
 
-    if (!binaryContents && !isValidUtf8(s, size))
+    if (!size)
     {
-        std::cerr << "Attempt to sendPartialOutput of invalid utf8 of size " << size << std::endl;
-        ASSERT_UTF8_BREAK("Attempt to sendPartialOutput of invalid utf8");
+        return; // nothing to tell the client
+    }
+
+    if (auto batchItem = dynamic_cast<CmdPetitionBatchItem *>(inf))
+    {
+        FrameHeader header;
+        header.mType = sendAsError ? FrameType::PARTIAL_ERR : FrameType::PARTIAL_OUT;
+        header.mFlags = binaryContents ? FRAME_FLAG_BINARY : 0;
+        header.mPetitionId = batchItem->mPetitionId;
+        if (!batchItem->mSession->sendFrame(header, std::string_view(s, size)))
+        {
+            std::cerr << "WARNING: Client disconnected, the rest of the output will be discarded" << endl;
+            inf->clientDisconnected = true;
+            inf->mCancellationToken.cancel();
+        }
         return;
     }
 
-    if (size)
+    auto petition = getSocketPetition(inf, "Sending partial output");
+    if (!petition)
     {
-        int outCode = sendAsError ? MCMD_PARTIALERR : MCMD_PARTIALOUT;
-        auto n = send(connectedsocket, (void*)&outCode, sizeof( outCode ), MSG_NOSIGNAL);
-        if (n < 0)
+        return;
+    }
+
+    if (petition->mFramed)
+    {
+        if (binaryContents && !petition->mStreaming)
         {
-            std::cerr << "ERROR writing MCMD_PARTIALOUT/MCMD_PARTIALERR to socket: " << errno << endl;
-            if (errno == EPIPE)
-            {
-                std::cerr << "WARNING: Client disconnected, the rest of the output will be discarded" << endl;
-                inf->clientDisconnected = true;
-            }
-            return;
+            // Large buffers let the SDK keep streaming while the client is writing
+            framing::enlargeSocketBuffer(petition->outSocket, SO_SNDBUF);
+            petition->mStreaming = true;
         }
-        n = send(connectedsocket, (void*)&size, sizeof( size ), MSG_NOSIGNAL);
-        if (n < 0)
+
+        // The payload is sent straight from the given buffer, along with the header (writev-style)
+        if (!sendResponseFrame(inf, sendAsError ? FrameType::PARTIAL_ERR : FrameType::PARTIAL_OUT, std::string_view(s, size), {},
+                               binaryContents ? FRAME_FLAG_BINARY : 0))
         {
-            std::cerr << "ERROR writing size of partial output to socket: " << errno << endl;
-            return;
+            std::cerr << "WARNING: Client disconnected, the rest of the output will be discarded" << endl;
+            inf->clientDisconnected = true;
+            inf->mCancellationToken.cancel();
+        }
+        return;
+    }
+
+    int connectedsocket = petition->outSocket;
+    assert(connectedsocket != -1);
+    if (connectedsocket == -1)
+    {
+        std::cerr << "Return and close: no valid outsocket " << connectedsocket << endl;
+        return;
+    }
+
+    int outCode = sendAsError ? MCMD_PARTIALERR : MCMD_PARTIALOUT;
+    auto n = send(connectedsocket, (void*)&outCode, sizeof( outCode ), MSG_NOSIGNAL);
+    if (n < 0)
+    {
+        std::cerr << "ERROR writing MCMD_PARTIALOUT/MCMD_PARTIALERR to socket: " << errno << endl;
+        if (errno == EPIPE)
+        {
+            std::cerr << "WARNING: Client disconnected, the rest of the output will be discarded" << endl;
+            inf->clientDisconnected = true;
+            inf->mCancellationToken.cancel();
         }
+        return;
+    }
+    n = send(connectedsocket, (void*)&size, sizeof( size ), MSG_NOSIGNAL);
+    if (n < 0)
+    {
+        std::cerr << "ERROR writing size of partial output to socket: " << errno << endl;
+        return;
+    }
 
 
-        n = send(connectedsocket, s, size, MSG_NOSIGNAL); // for some reason without the max recv never quits in the client for empty responses
+    n = send(connectedsocket, s, size, MSG_NOSIGNAL); // for some reason without the max recv never quits in the client for empty responses
 
-        if (n < 0)
+    if (n < 0)
+    {
+        std::cerr << "ERROR writing to socket partial output: " << errno << endl;
+        return;
+    }
+}
+
+long long ComunicationsManagerFileSockets::sendToStateListener(CmdPetition *inf, std::string_view data)
+{
+    auto petition = getSocketPetition(inf, "Informing state listener");
+    if (!petition)
+    {
+        return -1;
+    }
+    int connectedsocket = petition->outSocket;
+    assert(connectedsocket != -1);
+    if (connectedsocket == -1)
+    {
+        LOG_err << "Informing state listener: Not valid on outsocket " << connectedsocket;
+        return static_cast<long long>(data.size()); // discard
+    }
+
+#ifdef __linux__
+    auto n = send(connectedsocket, data.data(), data.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+#else
+    // no event loop to tell when the socket is writable again
+    auto n = send(connectedsocket, data.data(), data.size(), MSG_NOSIGNAL);
+#endif
+    if (n < 0)
+    {
+        if (errno == EINTR)
         {
-            std::cerr << "ERROR writing to socket partial output: " << errno << endl;
-            return;
+            return 0;
         }
+#ifdef __linux__
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            watchForHangUps(connectedsocket, true); // the event loop will resume once writable
+            return 0;
+        }
+#endif
+        if (errno == EPIPE) //socket closed
+        {
+            LOG_verbose << "Unregistering no longer listening client. Original petition: " << inf->getRedactedLine();
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK) // timed out
+        {
+            LOG_warn << "Unregistering timed out listening client. Original petition: " << inf->getRedactedLine();
+        }
+        else
+        {
+            LOG_err << "ERROR writing to state listener socket: " << errno << ". Original petition: " << inf->getRedactedLine();
+        }
+        return -1;
     }
+
+#ifdef __linux__
+    if (static_cast<size_t>(n) < data.size())
+    {
+        watchForHangUps(connectedsocket, true);
+    }
+#endif
+    return n;
 }
 
 int ComunicationsManagerFileSockets::informStateListener(CmdPetition *inf, const std::string &s)
@@ -337,15 +876,21 @@ int ComunicationsManagerFileSockets::informStateListener(CmdPetition *inf, const
         return 0;
     }
 
+    auto petition = getSocketPetition(inf, "Informing state listener");
+    if (!petition)
+    {
+        return -1;
+    }
+
     std::lock_guard<std::mutex> g(informerMutex);
-    LOG_verbose << "Inform State Listener: Output to write in socket " << ((CmdPetitionPosixSockets *)inf)->outSocket << ": <<" << s << ">>";
+    LOG_verbose << "Inform State Listener: Output to write in socket " << petition->outSocket << ": <<" << s << ">>";
 
-    int connectedsocket = ((CmdPetitionPosixSockets *)inf)->outSocket;
+    int connectedsocket = petition->outSocket;
     assert(connectedsocket != -1);
 
     if (connectedsocket == -1)
     {
-        LOG_err << "Informing state listener: Not valid on outsocket " << ((CmdPetitionPosixSockets *)inf)->outSocket;
+        LOG_err << "Informing state listener: Not valid on outsocket " << connectedsocket;
         return 0;
     }
 
@@ -381,6 +926,19 @@ int ComunicationsManagerFileSockets::informStateListener(CmdPetition *inf, const
  */
 std::unique_ptr<CmdPetition> ComunicationsManagerFileSockets::getPetition()
 {
+#ifdef __linux__
+    if (mReceivedPetitions.empty())
+    {
+        LOG_err << "ERROR at getPetition: no petition received";
+        auto inf = std::make_unique<CmdPetitionPosixSockets>();
+        inf->setLine("ERROR");
+        return inf;
+    }
+
+    auto inf = std::move(mReceivedPetitions.front());
+    mReceivedPetitions.pop_front();
+    return inf;
+#else
     auto inf = std::make_unique<CmdPetitionPosixSockets>();
     static socklen_t clilen = sizeof(cli_addr);
 
@@ -408,56 +966,156 @@ std::unique_ptr<CmdPetition> ComunicationsManagerFileSockets::getPetition()
         LOG_err << "ERROR setting CLOEXEC to socket: " << errno;
     }
 
-    string wholepetition;
+    if (!readPetition(newsockfd, *inf))
+    {
+        inf->setLine("ERROR");
+        close(newsockfd);
+        return inf;
+    }
 
-    int n = read(newsockfd, buffer, 1023);
-    while(n == 1023)
+    inf->outSocket = newsockfd;
+    return inf;
+#endif
+}
+
+#ifndef __linux__
+bool ComunicationsManagerFileSockets::readPetition(int socket, CmdPetitionPosixSockets &inf)
+{
+    PetitionAssembler assembler;
+    auto status = PetitionAssembler::Status::INCOMPLETE;
+    while (status == PetitionAssembler::Status::INCOMPLETE)
     {
-        unsigned long int total_available_bytes;
-        if (-1 == ioctl(newsockfd, FIONREAD, &total_available_bytes))
+        auto n = read(socket, buffer, sizeof(buffer));
+        if (n < 0)
         {
-            LOG_err << "Failed to PeekNamedPipe. errno: " << errno;
-            break;
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            LOG_fatal << "ERROR reading from socket at getPetition: " << errno;
+            return false;
         }
 
-        if (total_available_bytes == 0)
+        status = n ? assembler.append(buffer, static_cast<size_t>(n)) : assembler.onClosed();
+        // more bytes may come late: legacy petitions are only complete once quiet
+        while (status == PetitionAssembler::Status::INCOMPLETE && !framing::bytesAvailable(socket))
         {
-            break;
+            auto timeout = assembler.getDeadline() - PetitionAssembler::Clock::now();
+            if (framing::waitForBytes(socket, std::chrono::ceil<std::chrono::milliseconds>(timeout)))
+            {
+                break;
+            }
+            status = assembler.onIdle();
         }
+    }
 
-        buffer[n] = '\0';
-        wholepetition.append(buffer);
-        n = read(newsockfd, buffer, 1023);
+    if (status == PetitionAssembler::Status::INVALID)
+    {
+        if (assembler.hasTimedOut())
+        {
+            LOG_err << "Petition not received in time from socket " << socket;
+        }
+        else
+        {
+            LOG_err << "Invalid petition received" << (assembler.isFramed() ? ". Frame type: " + std::to_string(static_cast<int>(assembler.getHeader().mType)) : "");
+        }
+        return false;
     }
-    if (n >=0 )
+
+    inf.mFramed = assembler.isFramed();
+    inf.mPetitionId = inf.mFramed ? assembler.getHeader().mPetitionId : 0;
+    inf.setLine(assembler.takeLine());
+    return true;
+}
+#endif
+
+bool ComunicationsManagerFileSockets::isFramed(CmdPetition *inf)
+{
+    if (dynamic_cast<CmdPetitionBatchItem *>(inf))
     {
-        buffer[n] = '\0';
-        wholepetition.append(buffer);
+        return true;
     }
-    if (n < 0)
+    auto petition = dynamic_cast<CmdPetitionPosixSockets *>(inf);
+    return petition && petition->mFramed;
+}
+
+bool ComunicationsManagerFileSockets::sendResponseFrame(CmdPetition *inf, FrameType type, std::string_view payload, std::string_view payload2, uint16_t flags)
+{
+    FrameHeader header;
+    header.mType = type;
+    header.mFlags = flags;
+
+    if (auto batchItem = dynamic_cast<CmdPetitionBatchItem *>(inf))
     {
-        LOG_fatal << "ERROR reading from socket at getPetition: " << errno;
-        inf->setLine("ERROR");
-        close(newsockfd);
-        return inf;
+        header.mPetitionId = batchItem->mPetitionId;
+        return batchItem->mSession->sendFrame(header, payload, payload2);
     }
 
-    inf->outSocket = newsockfd;
-    inf->setLine(wholepetition);
+    auto petition = getSocketPetition(inf, "Sending response frame");
+    if (!petition)
+    {
+        return false;
+    }
+    header.mPetitionId = petition->mPetitionId;
+    return framing::sendFrame(petition->outSocket, header, payload, payload2);
+}
 
-    return inf;
+std::optional<string> ComunicationsManagerFileSockets::receiveUserResponse(CmdPetition *inf)
+{
+    auto petition = getSocketPetition(inf, "Receiving user response");
+    if (!petition)
+    {
+        return std::nullopt;
+    }
+
+    auto frame = framing::recvFrame(petition->outSocket, FRAME_MAX_COMMAND_SIZE);
+    if (!frame || frame->first.mType != FrameType::USER_RESPONSE)
+    {
+        LOG_err << "ERROR receiving user response for " << inf->getPetitionDetails() << ": " << errno;
+        return std::nullopt;
+    }
+    return std::move(frame->second);
 }
 
 int ComunicationsManagerFileSockets::getConfirmation(CmdPetition *inf, string message)
 {
-    int connectedsocket = ((CmdPetitionPosixSockets *)inf)->outSocket;
+    if (dynamic_cast<CmdPetitionBatchItem *>(inf))
+    {
+        // the client's input is the list of commands: no way to ask the user
+        return ComunicationsManager::getConfirmation(inf, message);
+    }
+
+    auto petition = getSocketPetition(inf, "Getting confirmation");
+    if (!petition)
+    {
+        return MCMDCONFIRM_NO;
+    }
+
+    int connectedsocket = petition->outSocket;
     assert(connectedsocket != -1);
     if (connectedsocket == -1)
     {
-        LOG_fatal << "Getting Confirmation: invalid outsocket " << ((CmdPetitionPosixSockets *)inf)->outSocket;
+        LOG_fatal << "Getting Confirmation: invalid outsocket " << connectedsocket;
         return false;
     }
 
+    if (isFramed(inf))
+    {
+        int32_t response = MCMDCONFIRM_NO;
+        if (!sendResponseFrame(inf, FrameType::REQ_CONFIRM, message))
+        {
+            LOG_err << "ERROR writing confirmation request to socket: " << errno;
+            return response;
+        }
+
+        auto responseStr = receiveUserResponse(inf);
+        if (responseStr && responseStr->size() == sizeof(response))
+        {
+            memcpy(&response, responseStr->data(), sizeof(response));
+        }
+        return response;
+    }
+
     int outCode = MCMD_REQCONFIRM;
     auto n = send(connectedsocket, (void*)&outCode, sizeof( outCode ), MSG_NOSIGNAL);
     if (n < 0)
@@ -478,14 +1136,35 @@ int ComunicationsManagerFileSockets::getConfirmation(CmdPetition *inf, string me
 
 string ComunicationsManagerFileSockets::getUserResponse(CmdPetition *inf, string message)
 {
-    int connectedsocket = ((CmdPetitionPosixSockets *)inf)->outSocket;
+    if (dynamic_cast<CmdPetitionBatchItem *>(inf))
+    {
+        return ComunicationsManager::getUserResponse(inf, message);
+    }
+
+    auto petition = getSocketPetition(inf, "Getting user response");
+    if (!petition)
+    {
+        return "FAILED";
+    }
+
+    int connectedsocket = petition->outSocket;
     assert(connectedsocket != -1);
     if (connectedsocket == -1)
     {
-        LOG_fatal << "Getting Confirmation: Invalid outsocket " << ((CmdPetitionPosixSockets *)inf)->outSocket;
+        LOG_fatal << "Getting Confirmation: Invalid outsocket " << connectedsocket;
         return "FAILED";
     }
 
+    if (isFramed(inf))
+    {
+        if (!sendResponseFrame(inf, FrameType::REQ_STRING, message))
+        {
+            LOG_err << "ERROR writing string request to socket: " << errno;
+            return "FAILED";
+        }
+        return receiveUserResponse(inf).value_or("FAILED");
+    }
+
     int outCode = MCMD_REQSTRING;
     auto n = send(connectedsocket, (void*)&outCode, sizeof( outCode ), MSG_NOSIGNAL);
     if (n < 0)
@@ -513,8 +1192,176 @@ string ComunicationsManagerFileSockets::getUserResponse(CmdPetition *inf, string
     return response;
 }
 
+BatchSession::BatchSession(int socket, int maxInFlight)
+    : mSocket(socket)
+    , mMaxInFlight(std::max(1, maxInFlight))
+{
+}
+
+BatchSession::~BatchSession()
+{
+    LOG_debug << "Closing batch session with socket " << mSocket;
+    shutdown(mSocket, SHUT_RDWR);
+    close(mSocket);
+}
+
+void BatchSession::stopReceiving()
+{
+    {
+        std::lock_guard<std::mutex> g(mInFlightMutex);
+        mStopping = true;
+    }
+    mInFlightCV.notify_all();
+    shutdown(mSocket, SHUT_RD);
+}
+
+bool BatchSession::sendFrame(const FrameHeader &header, std::string_view payload, std::string_view payload2)
+{
+    std::lock_guard<std::mutex> g(mSendMutex);
+    return framing::sendFrame(mSocket, header, payload, payload2);
+}
+
+bool BatchSession::acquireSlot()
+{
+    std::unique_lock<std::mutex> lock(mInFlightMutex);
+    mInFlightCV.wait(lock, [this]() { return mStopping || mInFlight < mMaxInFlight; });
+    if (mStopping)
+    {
+        return false;
+    }
+    ++mInFlight;
+    return true;
+}
+
+void BatchSession::releaseSlot()
+{
+    {
+        std::lock_guard<std::mutex> g(mInFlightMutex);
+        --mInFlight;
+    }
+    mInFlightCV.notify_one();
+}
+
+void ComunicationsManagerFileSockets::startBatchSession(std::unique_ptr<CmdPetition> inf, int maxInFlight, PetitionDispatcher dispatch)
+{
+    auto petition = getSocketPetition(inf.get(), "Starting batch session");
+    if (!petition)
+    {
+        return;
+    }
+    auto session = std::make_shared<BatchSession>(petition->outSocket, maxInFlight);
+    petition->outSocket = -1; // owned by the session now
+
+    LOG_debug << "Starting batch session with socket " << session->getSocket() << ". Max commands in flight: " << maxInFlight;
+
+    joinFinishedBatchSessionReceivers();
+
+    std::lock_guard<std::mutex> g(mBatchSessionReceiversMutex);
+    std::weak_ptr<BatchSession> weakSession = session;
+    mBatchSessionReceivers.push_back(BatchSessionReceiver{std::move(weakSession), std::thread(receiveBatchCommands, std::move(session), std::move(dispatch))});
+}
+
+void ComunicationsManagerFileSockets::joinFinishedBatchSessionReceivers()
+{
+    std::lock_guard<std::mutex> g(mBatchSessionReceiversMutex);
+    for (auto it = mBatchSessionReceivers.begin(); it != mBatchSessionReceivers.end();)
+    {
+        auto session = it->mSession.lock();
+        if (session && session->isReceiving())
+        {
+            ++it;
+            continue;
+        }
+
+        it->mThread.join(); // done, or about to return
+        it = mBatchSessionReceivers.erase(it);
+    }
+}
+
+void ComunicationsManagerFileSockets::stopBatchSessionReceivers()
+{
+    std::vector<BatchSessionReceiver> receivers;
+    {
+        std::lock_guard<std::mutex> g(mBatchSessionReceiversMutex);
+        receivers.swap(mBatchSessionReceivers);
+    }
+
+    for (auto &receiver : receivers)
+    {
+        if (auto session = receiver.mSession.lock())
+        {
+            session->stopReceiving();
+        }
+        receiver.mThread.join();
+    }
+}
+
+void ComunicationsManagerFileSockets::receiveBatchCommands(std::shared_ptr<BatchSession> session, PetitionDispatcher dispatch)
+{
+    FrameHeader ready;
+    ready.mType = FrameType::SESSION_READY;
+    if (!session->sendFrame(ready, {}))
+    {
+        LOG_err << "ERROR starting batch session: " << errno;
+        session->setReceiving(false);
+        return;
+    }
+
+    for (;;)
+    {
+        auto header = framing::recvFrameHeader(session->getSocket());
+        if (!header)
+        {
+            break; // client finished sending commands (or went away)
+        }
+
+        if (header->mType != FrameType::COMMAND || header->mLength > FRAME_MAX_COMMAND_SIZE)
+        {
+            LOG_err << "Unexpected frame received in batch session. Type: " << static_cast<int>(header->mType) << ", length: " << header->mLength;
+            break;
+        }
+
+        std::string line(header->mLength, '\0');
+        if (!framing::recvAll(session->getSocket(), line.data(), line.size()))
+        {
+            LOG_err << "ERROR reading batch command " << header->mPetitionId << ": " << errno;
+            break;
+        }
+
+        if (!session->acquireSlot())
+        {
+            break;
+        }
+
+        auto item = std::make_unique<CmdPetitionBatchItem>();
+        item->mSession = session;
+        item->mPetitionId = header->mPetitionId;
+        item->setLine(line);
+        dispatch(std::move(item));
+    }
+
+    LOG_debug << "No more commands to receive in batch session with socket " << session->getSocket();
+    session->setReceiving(false);
+}
+
 ComunicationsManagerFileSockets::~ComunicationsManagerFileSockets()
 {
+    stopBatchSessionReceivers();
+
+#ifdef __linux__
+    for (const auto &incoming : mIncomingPetitions)
+    {
+        close(incoming.first);
+    }
+    if (mWakeUpFd >= 0)
+    {
+        close(mWakeUpFd);
+    }
+    if (mEpollFd >= 0)
+    {
+        close(mEpollFd);
+    }
+#endif
 }
 }//end namespace
 
@@ -21,19 +21,39 @@
 #ifndef WIN32
 
 #include "comunicationsmanager.h"
+#include "megacmd_framing.h"
 
 #include <sys/types.h>
 #include <sys/socket.h>
 
+#include <atomic>
+#include <deque>
+#include <map>
+#include <thread>
+#include <vector>
+
 namespace megacmd {
 struct CmdPetitionPosixSockets: public CmdPetition
 {
     int outSocket = -1;
 
+    // Whether the petition came framed (see megacmd_framing.h): responses will be framed too
+    bool mFramed = false;
+    uint32_t mPetitionId = 0;
+
+    // Whether socket buffers have been enlarged to stream binary contents
+    bool mStreaming = false;
+
+    // Identifies the petition in the event loop while its client is watched for hang ups (0: not watched)
+    uint64_t mCancellationWatchId = 0;
+
     virtual ~CmdPetitionPosixSockets()
     {
-        shutdown(outSocket, SHUT_RDWR);
-        close(outSocket);
+        if (outSocket != -1)
+        {
+            shutdown(outSocket, SHUT_RDWR);
+            close(outSocket);
+        }
     }
 
     std::string getPetitionDetails() const override
@@ -42,12 +62,102 @@ struct CmdPetitionPosixSockets: public CmdPetition
     }
 };
 
+// A connection carrying many framed commands and their framed responses
+class BatchSession
+{
+public:
+    BatchSession(int socket, int maxInFlight);
+    ~BatchSession();
+
+    bool sendFrame(const FrameHeader &header, std::string_view payload, std::string_view payload2 = {});
+
+    // Blocks until less than maxInFlight commands are being processed. false if stopped receiving meanwhile
+    bool acquireSlot();
+    void releaseSlot();
+
+    int getSocket() const { return mSocket; }
+
+    // Whether commands are still being received from the client
+    bool isReceiving() const { return mReceiving; }
+    void setReceiving(bool receiving) { mReceiving = receiving; }
+
+    // Wakes up the reception of commands (also if waiting for a slot), as if the client had finished sending them
+    void stopReceiving();
+
+private:
+    const int mSocket;
+    const int mMaxInFlight;
+    std::atomic<bool> mReceiving{true};
+
+    std::mutex mSendMutex;
+
+    std::mutex mInFlightMutex;
+    std::condition_variable mInFlightCV;
+    int mInFlight = 0;
+    bool mStopping = false;
+};
+
+struct CmdPetitionBatchItem : public CmdPetition
+{
+    std::shared_ptr<BatchSession> mSession;
+    uint32_t mPetitionId = 0;
+
+    virtual ~CmdPetitionBatchItem()
+    {
+        mSession->releaseSlot();
+    }
+
+    std::string getPetitionDetails() const override
+    {
+        return "batch socket: " + std::to_string(mSession->getSocket()) + ", petition id: " + std::to_string(mPetitionId);
+    }
+};
+
 OUTSTREAMTYPE &operator<<(OUTSTREAMTYPE &os, CmdPetitionPosixSockets &p);
 
 class ComunicationsManagerFileSockets : public ComunicationsManager
 {
 private:
+#ifdef __linux__
+    // epoll based event loop: the listening socket is edge-triggered and non-blocking,
+    // an eventfd is used to wake up the loop, and state listeners are watched for hang ups
+    int mEpollFd = -1;
+    int mWakeUpFd = -1;
+    bool mAcceptPending = false;
+
+    // Accepted connections are non-blocking and watched for input until their petition is complete,
+    // so that a slow client never holds the event loop. epoll events carry their socket (tagged).
+    // Those idle past their assembler's deadline are completed (legacy) or dropped by the loop
+    static constexpr uint64_t sIncomingPetitionTag = 1ull << 62;
+    std::map<int, PetitionAssembler> mIncomingPetitions;
+    std::deque<std::unique_ptr<CmdPetitionPosixSockets>> mReceivedPetitions;
+
+    // State listener messages are queued by producers and sent from the event loop
+    std::atomic<bool> mStateListenersPending{false};
+
+    // Petitions being processed whose clients are watched for hang ups, by watch id.
+    // epoll events carry the watch id (tagged) instead of the socket: sockets may be reused once closed.
+    static constexpr uint64_t sCancellationWatchTag = 1ull << 63;
+    struct CancellationWatch
+    {
+        int mSocket;
+        CancellationToken mToken;
+    };
+    std::mutex mCancellationWatchesMutex;
+    std::map<uint64_t, CancellationWatch> mCancellationWatches;
+    uint64_t mLastCancellationWatchId = 0;
+
+    void acceptPendingConnections();
+    void readIncomingPetition(int socket);
+    void expireIncomingPetitions();
+    void finishIncomingPetition(std::map<int, PetitionAssembler>::iterator it, PetitionAssembler::Status status);
+    int getIncomingPetitionsTimeoutMs() const;
+    void watchForHangUps(int socket, bool alsoWritable = false);
+    void cancelWatchedPetition(uint64_t watchId);
+    void stopWatchingForCancellation(CmdPetition *inf);
+#else
     fd_set fds;
+#endif
 
     // sockets and asociated variables
     int sockfd;
@@ -60,6 +170,35 @@ private:
     std::mutex informerMutex;
 
     void sendPartialOutputImpl(CmdPetition *inf, char *s, size_t size, bool binaryContents, bool sendAsError);
+
+#ifndef __linux__
+    // Reads the petition from the socket, either framed or raw (legacy clients)
+    bool readPetition(int socket, CmdPetitionPosixSockets &inf);
+#endif
+
+    static bool isFramed(CmdPetition *inf);
+    static bool sendResponseFrame(CmdPetition *inf, FrameType type, std::string_view payload, std::string_view payload2 = {}, uint16_t flags = 0);
+    static std::optional<std::string> receiveUserResponse(CmdPetition *inf);
+
+    static void receiveBatchCommands(std::shared_ptr<BatchSession> session, PetitionDispatcher dispatch);
+
+    // Threads receiving the commands of batch sessions: joined once they are done, or at destruction
+    struct BatchSessionReceiver
+    {
+        std::weak_ptr<BatchSession> mSession;
+        std::thread mThread;
+    };
+    std::mutex mBatchSessionReceiversMutex;
+    std::vector<BatchSessionReceiver> mBatchSessionReceivers;
+
+    void joinFinishedBatchSessionReceivers();
+    void stopBatchSessionReceivers();
+
+protected:
+#ifdef __linux__
+    void stateListenersQueued() override;
+#endif
+    long long sendToStateListener(CmdPetition *inf, std::string_view data) override;
 public:
     ComunicationsManagerFileSockets();
 
@@ -99,6 +238,12 @@ public:
 
     virtual std::string getUserResponse(CmdPetition *inf, std::string message);
 
+    void startBatchSession(std::unique_ptr<CmdPetition> inf, int maxInFlight, PetitionDispatcher dispatch) override;
+
+#ifdef __linux__
+    void watchForCancellation(CmdPetition *inf) override;
+#endif
+
     ~ComunicationsManagerFileSockets();
 };
 
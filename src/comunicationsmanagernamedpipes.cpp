@@ -343,6 +343,7 @@ void ComunicationsManagerNamedPipes::sendPartialOutputImpl(CmdPetition *inf, cha
         {
             std::cerr << "WARNING: Client disconnected, the rest of the output will be discarded" << endl;
             inf->clientDisconnected = true;
+            inf->mCancellationToken.cancel();
         }
         return;
     }
@@ -356,6 +357,7 @@ void ComunicationsManagerNamedPipes::sendPartialOutputImpl(CmdPetition *inf, cha
         {
             std::cerr << "WARNING: Client disconnected, the rest of the output will be discarded" << std::endl;
             inf->clientDisconnected = true;
+            inf->mCancellationToken.cancel();
         }
         return;
     }
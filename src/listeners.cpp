@@ -78,6 +78,11 @@ MegaCmdGlobalListener::MegaCmdGlobalListener(MegaCmdLogger *logger, MegaCmdSandb
 
 void MegaCmdGlobalListener::onNodesUpdate(MegaApi *api, MegaNodeList *nodes)
 {
+    if (sandboxCMD->cmdexecuter)
+    {
+        sandboxCMD->cmdexecuter->onNodesUpdate(nodes);
+    }
+
     long long nfolders = 0;
     long long nfiles = 0;
     long long rfolders = 0;
@@ -28,6 +28,8 @@
 #include "comunicationsmanager.h"
 #include "listeners.h"
 #include "megacmd_fuse.h"
+#include "megacmd_petition_scheduler.h"
+#include "megacmd_progress_aggregator.h"
 #include "sync_command.h"
 
 #include "megacmdplatform.h"
@@ -106,7 +108,10 @@ typedef char *completionfunction_t PARAMS((const char *, int));
 MegaCmdExecuter *cmdexecuter;
 MegaCmdSandbox *sandboxCMD;
 
-MegaSemaphore semaphoreClients; //to limit max parallel petitions
+std::unique_ptr<PetitionScheduler> petitionsScheduler; //runs petitions, limiting max parallel ones per class
+std::unique_ptr<ProgressAggregator> progressAggregator; //limits the rate of progress updates sent to clients
+int batchSessionMaxParallel = 32; //max commands of a batch session processed at the same time, whatever its client asks for
+static_assert(ProgressAggregator::sCompleteMark == PROGRESS_COMPLETE);
 
 MegaApi *api = nullptr;
 
@@ -118,9 +123,6 @@ std::mutex mutexapiFolders;
 
 MegaCmdLogger *loggerCMD;
 
-std::mutex mutexEndedPetitionThreads;
-std::vector<std::unique_ptr<MegaThread>> petitionThreads;
-std::vector<MegaThread *> endedPetitionThreads;
 MegaThread *threadRetryConnections;
 
 std::mutex greetingsmsgsMutex;
@@ -176,7 +178,7 @@ int mcmdMainArgc;
 
 void printWelcomeMsg();
 
-void delete_finished_threads();
+size_t getNumOngoingPetitions();
 
 void appendGreetingStatusFirstListener(const std::string &msj)
 {
@@ -419,18 +421,13 @@ void informStateListenerByClientId(int clientID, string s)
 
 void informProgressUpdate(long long transferred, long long total, int clientID, string title)
 {
-    string s = "progress:";
-    s+=SSTR(transferred);
-    s+=":";
-    s+=SSTR(total);
-
-    if (title.size())
+    if (progressAggregator)
     {
-        s+=":";
-        s+=title;
+        progressAggregator->update(transferred, total, clientID, title);
+        return;
     }
 
-    informStateListenerByClientId(clientID, s);
+    informStateListenerByClientId(clientID, ProgressAggregator::formatMessage(transferred, total, title));
 }
 
 void insertValidParamsPerCommand(set<string> *validParams, string thecommand, set<string> *validOptValues = nullptr, bool skipDeprecated = false)
@@ -454,6 +451,12 @@ void insertValidParamsPerCommand(set<string> *validParams, string thecommand, se
         validParams->insert("show-creation-time");
         validOptValues->insert("time-format");
         validParams->insert("tree");
+        validOptValues->insert("sort");
+        validParams->insert("reverse");
+        validOptValues->insert("limit");
+        validOptValues->insert("offset");
+        validOptValues->insert("cursor");
+        validOptValues->insert("format");
 #ifdef USE_PCRE
         validParams->insert("use-pcre");
 #endif
@@ -684,6 +687,12 @@ void insertValidParamsPerCommand(set<string> *validParams, string thecommand, se
         validOptValues->insert("size");
         validOptValues->insert("time-format");
         validOptValues->insert("type");
+        validOptValues->insert("mindepth");
+        validOptValues->insert("maxdepth");
+        validOptValues->insert("format");
+        validOptValues->insert("sort");
+        validParams->insert("reverse");
+        validOptValues->insert("limit");
     }
     else if ("mkdir" == thecommand)
     {
@@ -1623,11 +1632,11 @@ const char * getUsageStr(const char *command, const HelpFlags& flags)
     {
         if (flags.usePcre || flags.showAll)
         {
-            return "ls [-halRr] [--show-handles] [--tree] [--versions] [remotepath] [--use-pcre] [--show-creation-time] [--time-format=FORMAT]";
+            return "ls [-halRr] [--show-handles] [--tree] [--versions] [remotepath] [--use-pcre] [--show-creation-time] [--time-format=FORMAT] [--sort=name|size|mtime] [--reverse] [--limit=N] [--offset=N|--cursor=CURSOR] [--format=ndjson|binary]";
         }
         else
         {
-            return "ls [-halRr] [--show-handles] [--tree] [--versions] [remotepath] [--show-creation-time] [--time-format=FORMAT]";
+            return "ls [-halRr] [--show-handles] [--tree] [--versions] [remotepath] [--show-creation-time] [--time-format=FORMAT] [--sort=name|size|mtime] [--reverse] [--limit=N] [--offset=N|--cursor=CURSOR] [--format=ndjson|binary]";
         }
     }
     if (!strcmp(command, "tree"))
@@ -1975,11 +1984,11 @@ const char * getUsageStr(const char *command, const HelpFlags& flags)
     {
         if (flags.usePcre || flags.showAll)
         {
-            return "find [remotepath] [-l] [--pattern=PATTERN] [--type=d|f] [--mtime=TIMECONSTRAIN] [--size=SIZECONSTRAIN] [--use-pcre] [--time-format=FORMAT] [--show-handles|--print-only-handles]";
+            return "find [remotepath] [-l] [--pattern=PATTERN] [--type=d|f] [--mtime=TIMECONSTRAIN] [--size=SIZECONSTRAIN] [--mindepth=N] [--maxdepth=N] [--use-pcre] [--time-format=FORMAT] [--show-handles|--print-only-handles] [--sort=name|size|mtime] [--reverse] [--limit=N] [--format=ndjson|binary]";
         }
         else
         {
-            return "find [remotepath] [-l] [--pattern=PATTERN] [--type=d|f] [--mtime=TIMECONSTRAIN] [--size=SIZECONSTRAIN] [--time-format=FORMAT] [--show-handles|--print-only-handles]";
+            return "find [remotepath] [-l] [--pattern=PATTERN] [--type=d|f] [--mtime=TIMECONSTRAIN] [--size=SIZECONSTRAIN] [--mindepth=N] [--maxdepth=N] [--time-format=FORMAT] [--show-handles|--print-only-handles] [--sort=name|size|mtime] [--reverse] [--limit=N] [--format=ndjson|binary]";
         }
     }
     if (!strcmp(command, "help"))
@@ -2062,6 +2071,35 @@ void printTimeFormatHelp(ostringstream &os)
     os << "                 You can use any strftime compliant format: http://www.cplusplus.com/reference/ctime/strftime/" << endl;
 }
 
+void printListingOrderHelp(ostringstream &os)
+{
+    os << " --sort=name|size|mtime" << "\t" << "Sorts the results: by name, largest first or most recently modified first" << endl;
+    os << "                      " << "\t" << " Folders have no size, and are sorted by their creation time" << endl;
+    os << " --reverse" << "\t" << "Reverses the order of the results" << endl;
+    os << " --limit=N" << "\t" << "Shows only the first N results" << endl;
+    os << "          " << "\t" << " Sorted or limited results are listed without nesting (paths are relative to the listed folder)" << endl;
+}
+
+void printListingPagesHelp(ostringstream &os)
+{
+    os << " --offset=N" << "\t" << "Skips the first N results (e.g: to show page N/limit)" << endl;
+    os << " --cursor=CURSOR" << "\t" << "Shows the results following the ones of a previous page, listed with the same options" << endl;
+    os << "                " << "\t" << " Full pages end with a line \"Next page: --cursor=CURSOR\" (the last page may be empty)" << endl;
+    os << "                " << "\t" << " Unlike large offsets, cursors take the server no more memory than a page" << endl;
+    os << "                " << "\t" << " Without --sort, the folder is to be listed again from its first page if it changed meanwhile" << endl;
+}
+
+void printNodeExportFormatHelp(ostringstream &os)
+{
+    os << " --format=ndjson|binary" << "\t" << "Writes the nodes in a machine-readable format instead, as they are found:" << endl;
+    os << "                       " << "\t" << " handle, parent, name, type, size, mtime, fingerprint and number of versions" << endl;
+    os << "                       " << "\t" << " ndjson: one JSON object per line (handles in base64, null parent/fingerprint when missing)" << endl;
+    os << "                       " << "\t" << " binary: \"MCNX\" and a version byte (1), then per node: type (1 byte), handle and parent" << endl;
+    os << "                       " << "\t" << "  (6 bytes each, little endian), size, zigzag mtime and versions (LEB128 varints)," << endl;
+    os << "                       " << "\t" << "  name and fingerprint (varint length and bytes)" << endl;
+    os << "                       " << "\t" << " Folders have size 0 and their creation time as mtime. Other output options are ignored" << endl;
+}
+
 void printColumnDisplayerHelp(ostringstream &os)
 {
     os << " --col-separator=X" << "\t" << "Uses the string \"X\" as column separator. Otherwise, spaces will be added between columns to align them." << endl;
@@ -2241,6 +2279,9 @@ string getHelpStr(const char *command, const HelpFlags& flags = {})
         os << "   " << "\t" << "You can delete all versions of a file with \"deleteversions\"" << endl;
         os << " --show-creation-time" << "\t" << "show creation time instead of modification time for files" << endl;
         printTimeFormatHelp(os);
+        printListingOrderHelp(os);
+        printListingPagesHelp(os);
+        printNodeExportFormatHelp(os);
 
         if (flags.usePcre || flags.showAll)
         {
@@ -3093,6 +3134,8 @@ string getHelpStr(const char *command, const HelpFlags& flags = {})
         os << "                      " << "\t" << "   \"+1m12k3B\" shows files bigger than 1 Mega, 12 Kbytes and 3Bytes" << endl;
         os << "                      " << "\t" << "   \"-3M\" shows files smaller than 3 Megabytes" << endl;
         os << "                      " << "\t" << "   \"-4M+100K\" shows files smaller than 4 Mbytes and bigger than 100 Kbytes" << endl;
+        os << " --mindepth=N" << "\t" << "Skips nodes less than N levels below remotepath (which is at level 0)" << endl;
+        os << " --maxdepth=N" << "\t" << "Descends at most N levels below remotepath" << endl;
         os << " --show-handles" << "\t" << "Prints files/folders handles (H:XXXXXXXX). You can address a file/folder by its handle" << endl;
         os << " --print-only-handles" << "\t" << "Prints only files/folders handles (H:XXXXXXXX). You can address a file/folder by its handle" << endl;
 
@@ -3103,6 +3146,8 @@ string getHelpStr(const char *command, const HelpFlags& flags = {})
 
         os << " -l" << "\t" << "Prints file info" << endl;
         printTimeFormatHelp(os);
+        printListingOrderHelp(os);
+        printNodeExportFormatHelp(os);
     }
     else if(!strcmp(command,"debug") )
     {
@@ -4112,13 +4157,11 @@ static bool process_line(const std::string_view line)
                 if (strstr(l,"--wait-for-ongoing-petitions"))
                 {
                     int attempts=20; //give a while for ongoing petitions to end before killing the server
-                    delete_finished_threads();
 
-                    while(petitionThreads.size() > 1 && attempts--)
+                    while(getNumOngoingPetitions() > 1 && attempts--)
                     {
-                        LOG_debug << "giving a little longer for ongoing petitions: " << petitionThreads.size();
+                        LOG_debug << "giving a little longer for ongoing petitions: " << getNumOngoingPetitions();
                         sleepSeconds(20-attempts);
-                        delete_finished_threads();
                     }
                 }
 
@@ -4156,7 +4199,7 @@ static bool process_line(const std::string_view line)
                     OUTSTREAM << " " << endl;
 
                     int attempts=20; //give a while for ongoing petitions to end before killing the server
-                    while(petitionThreads.size() > 1 && attempts--)
+                    while(getNumOngoingPetitions() > 1 && attempts--)
                     {
                         sleepSeconds(20-attempts);
                     }
@@ -4176,54 +4219,58 @@ static bool process_line(const std::string_view line)
     return false; //Do not exit
 }
 
-void* doProcessLine(void* infRaw)
+void doProcessLine(std::unique_ptr<CmdPetition> inf)
 {
-    auto inf = std::unique_ptr<CmdPetition>((CmdPetition*) infRaw);
-
     OUTSTRINGSTREAM s;
+    int outCode = MCMD_OK;
+    bool stopWaiting = false;
 
-    setCurrentThreadLogLevel(MegaApi::LOG_LEVEL_ERROR);
-    setCurrentThreadOutCode(MCMD_OK);
-    setCurrentThreadCmdPetition(inf.get());
-    LoggedStreamPartialOutputs ls(cm, inf.get());
-    LoggedStreamPartialErrors lserr(cm, inf.get());
-    setCurrentThreadOutStreams(ls, lserr);
+    {
+        setCurrentThreadLogLevel(MegaApi::LOG_LEVEL_ERROR);
+        setCurrentThreadOutCode(MCMD_OK);
+        setCurrentThreadCmdPetition(inf.get());
+        PartialOutputsBuffer outputsBuffer(cm, inf.get()); // flushed upon destruction, before closing the petition
+        LoggedStreamPartialOutputs ls(outputsBuffer);
+        LoggedStreamPartialErrors lserr(outputsBuffer);
+        setCurrentThreadOutStreams(ls, lserr);
 
 
-    setCurrentThreadIsCmdShell(inf->isFromCmdShell());
+        setCurrentThreadIsCmdShell(inf->isFromCmdShell());
+        setCurrentThreadCancellationToken(inf->mCancellationToken);
 
 
-    LOG_verbose << " Processing " << inf->getRedactedLine() << " in thread: " << MegaThread::currentThreadId() << " " << inf->getPetitionDetails();
+        LOG_verbose << " Processing " << inf->getRedactedLine() << " in thread: " << MegaThread::currentThreadId() << " " << inf->getPetitionDetails();
 
-    doExit = process_line(inf->getUniformLine());
+        doExit = process_line(inf->getUniformLine());
 
-    if (doExit)
-    {
-        stopCheckingforUpdaters = true;
-        LOG_verbose << " Exit registered upon process_line: " ;
-    }
+        if (doExit)
+        {
+            stopCheckingforUpdaters = true;
+            LOG_verbose << " Exit registered upon process_line: " ;
+        }
+
+        LOG_verbose << " Procesed " << inf->getRedactedLine() << " in thread: " << MegaThread::currentThreadId() << " " << inf->getPetitionDetails();
+        if (isCurrentThreadCancelled())
+        {
+            LOG_debug << "Petition " << inf->getRedactedLine() << " was cancelled: its client went away";
+        }
 
-    LOG_verbose << " Procesed " << inf->getRedactedLine() << " in thread: " << MegaThread::currentThreadId() << " " << inf->getPetitionDetails();
+        outCode = getCurrentThreadOutCode();
+        stopWaiting = doExit && (!isCurrentThreadInteractive() || isCurrentThreadCmdShell());
 
-    MegaThread * petitionThread = inf->getPetitionThread();
+        // worker threads are reused: do not leave references to this petition's streams behind
+        resetCurrentThreadData();
+    }
 
     if (inf->clientID != -3) // -3 is self client (no actual client)
     {
-        cm->returnAndClosePetition(std::move(inf), &s, getCurrentThreadOutCode());
+        cm->returnAndClosePetition(std::move(inf), &s, outCode);
     }
 
-    semaphoreClients.release();
-
-    if (doExit && (!isCurrentThreadInteractive() || isCurrentThreadCmdShell() ))
+    if (stopWaiting)
     {
         cm->stopWaiting();
     }
-
-    mutexEndedPetitionThreads.lock();
-    endedPetitionThreads.push_back(petitionThread);
-    mutexEndedPetitionThreads.unlock();
-
-    return nullptr;
 }
 
 int askforConfirmation(string message)
@@ -4231,6 +4278,7 @@ int askforConfirmation(string message)
     CmdPetition *inf = getCurrentThreadCmdPetition();
     if (inf)
     {
+        OUTSTREAM.flush(); // pending outputs shall reach the client before the question
         return cm->getConfirmation(inf,message);
     }
     else
@@ -4253,6 +4301,7 @@ string askforUserResponse(string message)
     CmdPetition *inf = getCurrentThreadCmdPetition();
     if (inf)
     {
+        OUTSTREAM.flush(); // pending outputs shall reach the client before the question
         return cm->getUserResponse(inf,message);
     }
     else
@@ -4265,26 +4314,9 @@ string askforUserResponse(string message)
 
 
 
-void delete_finished_threads()
+size_t getNumOngoingPetitions()
 {
-    std::unique_lock<std::mutex> lock(mutexEndedPetitionThreads);
-
-    for (MegaThread *mt : endedPetitionThreads)
-    {
-        for (auto it = petitionThreads.begin(); it != petitionThreads.end(); )
-        {
-            if (mt == it->get())
-            {
-                (*it)->join();
-                it = petitionThreads.erase(it);
-            }
-            else
-            {
-                ++it;
-            }
-        }
-    }
-    endedPetitionThreads.clear();
+    return petitionsScheduler ? petitionsScheduler->getNumOngoingTasks() : 0;
 }
 
 void processCommandInPetitionQueues(CmdPetition *inf);
@@ -4326,7 +4358,15 @@ void finalize(bool waitForRestartSignal_param)
     alreadyfinalized = true;
     LOG_info << "closing application ...";
 
-    delete_finished_threads();
+    if (petitionsScheduler)
+    {
+        // running petitions are cancelled: they are expected to finish soon
+        if (auto numRunning = petitionsScheduler->stop())
+        {
+            LOG_warn << numRunning << " petitions did not finish in time after being cancelled. Closing anyway";
+        }
+    }
+    progressAggregator.reset();
     if (!consoleFailed)
     {
         delete console;
@@ -4466,11 +4506,10 @@ void* checkForUpdates(void *param)
             sleepSeconds(1);
             if (stopCheckingforUpdaters) break;
 
-            while(petitionThreads.size() && !stopCheckingforUpdaters)
+            while(getNumOngoingPetitions() && !stopCheckingforUpdaters)
             {
-                LOG_fatal << " waiting for petitions to end to initiate upload " << petitionThreads.size() << petitionThreads.at(0).get();
+                LOG_fatal << " waiting for petitions to end to initiate upload " << getNumOngoingPetitions();
                 sleepSeconds(2);
-                delete_finished_threads();
             }
 
             if (stopCheckingforUpdaters) break;
@@ -4490,10 +4529,9 @@ void* checkForUpdates(void *param)
         if (restartRequired && restartServer())
         {
             int attempts = 20; //give a while for ingoin petitions to end before killing the server
-            while(petitionThreads.size() && --attempts)
+            while(getNumOngoingPetitions() && --attempts)
             {
                 sleepSeconds(20 - attempts);
-                delete_finished_threads();
             }
 
             doExit = true;
@@ -4517,16 +4555,35 @@ void* checkForUpdates(void *param)
 
 void processCommandInPetitionQueues(std::unique_ptr<CmdPetition> inf)
 {
-    semaphoreClients.wait();
+    auto petitionClass = PetitionScheduler::classify(inf->getUniformLine());
+    LOG_verbose << "queueing processing: <" << inf->getRedactedLine() << "> as " << getPetitionClassName(petitionClass);
 
-    //append new one
-    auto petitionThread = new MegaThread();
+    // Cancelled if the server stops while the petition runs
+    auto token = inf->mCancellationToken;
 
-    petitionThreads.emplace_back(petitionThread);
-    inf->setPetitionThread(petitionThread);
+    // std::function requires copyable callables: share the ownership with the task
+    auto sharedInf = std::make_shared<std::unique_ptr<CmdPetition>>(std::move(inf));
+    PetitionScheduler::Task task = [sharedInf, petitionClass](std::chrono::milliseconds queueWaitTime)
+    {
+        constexpr std::chrono::milliseconds slowQueueWaitTime(1000);
+        if (queueWaitTime >= slowQueueWaitTime)
+        {
+            LOG_warn << "Petition <" << (*sharedInf)->getRedactedLine() << "> waited " << queueWaitTime.count()
+                     << " ms in the " << getPetitionClassName(petitionClass) << " queue";
+        }
+        else
+        {
+            LOG_verbose << "Petition waited " << queueWaitTime.count() << " ms in the " << getPetitionClassName(petitionClass) << " queue";
+        }
+        doProcessLine(std::move(*sharedInf));
+    };
 
-    LOG_verbose << "starting processing: <" << inf->getRedactedLine() << ">";
-    petitionThread->start(doProcessLine, (void*) inf.release());
+    // When its class is full, the petition waits for room without holding the thread reading petitions:
+    // its client simply gets the response later (the time waited is logged as above)
+    if (!petitionsScheduler->submitOrDefer(petitionClass, std::move(task), std::move(token)))
+    {
+        LOG_warn << "Petition discarded: no longer processing petitions";
+    }
 }
 
 void processCommandLinePetitionQueues(std::string what)
@@ -4576,7 +4633,6 @@ void megacmd()
             CmdPetition* inf = infOwned.get();
 
             LOG_verbose << "petition registered: " << inf->getRedactedLine();
-            delete_finished_threads();
 
             if (inf->getUniformLine() == "ERROR")
             {
@@ -4765,8 +4821,26 @@ void megacmd()
 
                 cm->informStateListener(inf, s);
             }
+            else if (startsWith(inf->getUniformLine(), "batchsession"))
+            {
+                // the connection will carry many framed commands
+                int maxInFlight = 1;
+                auto line = inf->getUniformLine();
+                auto pos = line.find("--parallel=");
+                if (pos != std::string_view::npos)
+                {
+                    long parallel = strtol(std::string(line.substr(pos + strlen("--parallel="))).c_str(), nullptr, 10);
+                    if (parallel > batchSessionMaxParallel)
+                    {
+                        LOG_warn << "Batch session asked for " << parallel << " commands in parallel. Limited to " << batchSessionMaxParallel;
+                    }
+                    maxInFlight = static_cast<int>(std::clamp<long>(parallel, 1, batchSessionMaxParallel));
+                }
+                cm->startBatchSession(std::move(infOwned), maxInFlight, processCommandInPetitionQueues);
+            }
             else
             { // normal petition
+                cm->watchForCancellation(inf); // before it can be processed (and returned)
                 processCommandInPetitionQueues(std::move(infOwned));
             }
         }
@@ -5423,9 +5497,97 @@ int executeServer(int argc, char* argv[],
         semaphoreapiFolders.release();
     }
 
-    for (int i = 0; i < 100; i++)
     {
-        semaphoreClients.release();
+        // Quick commands get a budget of their own, so that they are not delayed by heavy ones
+        constexpr int defaultMaxWorkers[] = {20, 40, 40};
+        constexpr const char* sizeKeys[] = {"PetitionsWorkerPool:InteractiveSize", "PetitionsWorkerPool:TraversalSize", "PetitionsWorkerPool:TransferSize"};
+        static_assert(std::size(defaultMaxWorkers) == static_cast<size_t>(PetitionClass::NUM_CLASSES));
+
+        constexpr int defaultMaxQueueDepth = 100;
+        int maxQueueDepth = ConfigurationManager::getConfigurationValue("PetitionsWorkerPool:MaxQueueDepth", defaultMaxQueueDepth);
+        if (maxQueueDepth <= 0)
+        {
+            maxQueueDepth = defaultMaxQueueDepth;
+        }
+
+        PetitionScheduler::Limits limits;
+        for (size_t i = 0; i < limits.size(); ++i)
+        {
+            int maxWorkers = ConfigurationManager::getConfigurationValue(sizeKeys[i], defaultMaxWorkers[i]);
+            if (maxWorkers <= 0)
+            {
+                maxWorkers = defaultMaxWorkers[i];
+            }
+            limits[i] = {static_cast<size_t>(maxWorkers), static_cast<size_t>(maxQueueDepth)};
+
+            LOG_debug << "Petitions worker pool for " << getPetitionClassName(static_cast<PetitionClass>(i)) << " commands: size "
+                      << maxWorkers << ", max queue depth: " << maxQueueDepth;
+        }
+        petitionsScheduler = std::make_unique<PetitionScheduler>(limits);
+    }
+
+    {
+        constexpr int defaultIntervalMs = 100;
+        int intervalMs = ConfigurationManager::getConfigurationValue("ProgressUpdates:IntervalMs", defaultIntervalMs);
+        if (intervalMs < 0)
+        {
+            intervalMs = defaultIntervalMs;
+        }
+
+        LOG_debug << "Progress updates interval: " << intervalMs << " ms";
+        progressAggregator = std::make_unique<ProgressAggregator>(std::chrono::milliseconds(intervalMs), [](int clientID, const string &message)
+        {
+            informStateListenerByClientId(clientID, message);
+        });
+    }
+
+    if (ConfigurationManager::getConfigurationValue("NameIndex:Enabled", false))
+    {
+        LOG_debug << "Name index enabled";
+        cmdexecuter->enableNameIndex();
+    }
+
+    if (ConfigurationManager::getConfigurationValue("SizeCache:Enabled", true))
+    {
+        cmdexecuter->enableSizeCache();
+    }
+
+    {
+        constexpr int defaultPathCacheSize = 100000;
+        int pathCacheSize = ConfigurationManager::getConfigurationValue("PathCache:Size", defaultPathCacheSize);
+        if (pathCacheSize > 0)
+        {
+            LOG_debug << "Path cache size: " << pathCacheSize << " folders";
+            cmdexecuter->enablePathCache(static_cast<size_t>(pathCacheSize));
+        }
+    }
+
+    {
+        constexpr int defaultCompletionCacheSize = 1000000;
+        int completionCacheSize = ConfigurationManager::getConfigurationValue("CompletionCache:Size", defaultCompletionCacheSize);
+        if (completionCacheSize > 0)
+        {
+            LOG_debug << "Completion cache size: " << completionCacheSize << " names";
+            cmdexecuter->enableCompletionCache(static_cast<size_t>(completionCacheSize));
+        }
+    }
+
+    {
+        int maxParallel = ConfigurationManager::getConfigurationValue("BatchSessions:MaxParallel", batchSessionMaxParallel);
+        if (maxParallel > 0)
+        {
+            batchSessionMaxParallel = maxParallel;
+        }
+    }
+
+    {
+        constexpr int defaultMaxBulkRequestsInFlight = 64;
+        int maxBulkRequestsInFlight = ConfigurationManager::getConfigurationValue("BulkRequests:MaxInFlight", defaultMaxBulkRequestsInFlight);
+        if (maxBulkRequestsInFlight > 0)
+        {
+            LOG_debug << "Bulk requests in flight: " << maxBulkRequestsInFlight;
+            cmdexecuter->setMaxBulkRequestsInFlight(static_cast<size_t>(maxBulkRequestsInFlight));
+        }
     }
 
     if (const char* fuseLogLevelStr = getenv("MEGACMD_FUSE_LOG_LEVEL"); fuseLogLevelStr)
@@ -0,0 +1,106 @@
+/**
+ * @file src/megacmd_bulk_requests.cpp
+ * @brief MEGAcmd: Many independent requests kept in flight at once
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "megacmd_bulk_requests.h"
+
+#include <algorithm>
+
+namespace megacmd {
+
+BulkRequests::BulkRequests(size_t maxInFlight)
+    : mMaxInFlight(std::max<size_t>(maxInFlight, 1)),
+      mTracker(std::make_shared<Tracker>())
+{
+}
+
+BulkRequests::~BulkRequests()
+{
+    waitAll();
+}
+
+void BulkRequests::submit(Start start, Finish finish)
+{
+    while (mPending.size() >= mMaxInFlight)
+    {
+        finishNext(true);
+    }
+
+    const size_t item = mNumSubmitted++;
+    mPending.push_back(std::move(finish));
+    start([tracker = mTracker, item](int errorCode)
+    {
+        std::lock_guard<std::mutex> guard(tracker->mMutex);
+        tracker->mCompleted.emplace(item, errorCode);
+        tracker->mCV.notify_all();
+    });
+
+    // Report as soon as possible what is done (e.g: items completing right away)
+    while (finishNext(false));
+}
+
+void BulkRequests::waitAll()
+{
+    while (!mPending.empty())
+    {
+        finishNext(true);
+    }
+}
+
+bool BulkRequests::finishNext(bool wait)
+{
+    if (mPending.empty())
+    {
+        return false;
+    }
+
+    const size_t item = getNumFinished();
+    int errorCode = 0;
+    {
+        std::unique_lock<std::mutex> lock(mTracker->mMutex);
+        auto completed = mTracker->mCompleted.find(item);
+        if (completed == mTracker->mCompleted.end())
+        {
+            if (!wait)
+            {
+                return false;
+            }
+
+            mTracker->mCV.wait(lock, [this, item, &completed]()
+            {
+                completed = mTracker->mCompleted.find(item);
+                return completed != mTracker->mCompleted.end();
+            });
+        }
+        errorCode = completed->second;
+        mTracker->mCompleted.erase(completed);
+    }
+
+    Finish finish = std::move(mPending.front());
+    mPending.pop_front();
+    if (errorCode)
+    {
+        mErrors.push_back(ItemError{item, errorCode});
+    }
+    if (finish)
+    {
+        finish(errorCode);
+    }
+    return true;
+}
+
+}
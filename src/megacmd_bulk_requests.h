@@ -0,0 +1,96 @@
+/**
+ * @file src/megacmd_bulk_requests.h
+ * @brief MEGAcmd: Many independent requests kept in flight at once
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace megacmd {
+
+/**
+ * @brief Runs the items of a bulk operation (e.g: removing every node matched) keeping up to a number of them
+ * in flight, instead of waiting for each one before requesting the next.
+ *
+ * Each item is started with a completion, to be called once (from any thread) with its error code (0 if it succeeded).
+ * Items are then finished in the order they were submitted, always from the thread submitting them, so that
+ * their results are reported as if each one had been waited for. The window slides over the items not finished yet:
+ * an item taking long holds the ones after it (up to the limit) until it completes.
+ *
+ * Not thread-safe, but for the completions. Finishing an item is not to submit others to the same BulkRequests.
+ */
+class BulkRequests final
+{
+public:
+    using Completion = std::function<void(int errorCode)>;
+    using Start = std::function<void(Completion completion)>;
+    using Finish = std::function<void(int errorCode)>;
+
+    struct ItemError
+    {
+        size_t mItem = 0; // in the order submitted
+        int mErrorCode = 0;
+    };
+
+    // A limit of 1 waits for every item before starting the next one
+    explicit BulkRequests(size_t maxInFlight);
+    // Waits for (and finishes) every item submitted
+    ~BulkRequests();
+
+    BulkRequests(const BulkRequests&) = delete;
+    BulkRequests& operator=(const BulkRequests&) = delete;
+
+    // Starts the item, once fewer than the limit are unfinished. Finishes the items completed meanwhile
+    void submit(Start start, Finish finish);
+
+    // Waits for every item submitted, finishing them
+    void waitAll();
+
+    size_t getMaxInFlight() const { return mMaxInFlight; }
+    size_t getNumSubmitted() const { return mNumSubmitted; }
+    size_t getNumFinished() const { return mNumSubmitted - mPending.size(); }
+
+    // The items finished so far that failed, in order
+    const std::vector<ItemError>& getErrors() const { return mErrors; }
+
+private:
+    // Shared with the completions, to be safe to signal even as the items are being waited for
+    struct Tracker
+    {
+        std::mutex mMutex;
+        std::condition_variable mCV;
+        std::map<size_t, int> mCompleted; // error codes of the items completed but not finished yet
+    };
+
+    // Finishes the oldest item, if completed (or once it is, if waiting). Whether it was
+    bool finishNext(bool wait);
+
+    size_t mMaxInFlight;
+    size_t mNumSubmitted = 0;
+    std::shared_ptr<Tracker> mTracker;
+    std::deque<Finish> mPending; // unfinished items, from the one numbered getNumFinished()
+    std::vector<ItemError> mErrors;
+};
+
+}
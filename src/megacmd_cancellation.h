@@ -0,0 +1,44 @@
+/**
+ * @file src/megacmd_cancellation.h
+ * @brief MEGAcmd: Cooperative cancellation of petitions
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+namespace megacmd {
+
+/**
+ * @brief Flag shared between a petition and whoever can cancel it (e.g: the loop detecting client hang ups).
+ *
+ * Copies refer to the same flag. Long running loops are expected to check isCancelled
+ * regularly and bail out: cancellation is cooperative.
+ */
+class CancellationToken
+{
+public:
+    CancellationToken() : mCancelled(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void cancel() { mCancelled->store(true, std::memory_order_relaxed); }
+    bool isCancelled() const { return mCancelled->load(std::memory_order_relaxed); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> mCancelled;
+};
+
+}
@@ -0,0 +1,170 @@
+/**
+ * @file src/megacmd_completion_cache.cpp
+ * @brief MEGAcmd: Cache of folder listings for path completion
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "megacmd_completion_cache.h"
+
+#include <algorithm>
+
+namespace megacmd {
+
+CompletionCache::CompletionCache(size_t capacity)
+    : mCapacity(std::max<size_t>(capacity, 1))
+{
+}
+
+uint64_t CompletionCache::getGeneration() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mGeneration;
+}
+
+std::optional<std::vector<CompletionCache::Child>> CompletionCache::find(Handle folder, const std::string &prefix)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mByFolder.find(folder);
+    if (it == mByFolder.end())
+    {
+        ++mMisses;
+        return std::nullopt;
+    }
+
+    ++mHits;
+    mListings.splice(mListings.begin(), mListings, it->second);
+
+    const auto &children = it->second->mChildren;
+    auto first = std::lower_bound(children.begin(), children.end(), prefix, [](const Child &child, const std::string &value)
+    {
+        return child.mName < value;
+    });
+    auto last = first;
+    while (last != children.end() && !last->mName.compare(0, prefix.size(), prefix))
+    {
+        ++last;
+    }
+    return std::vector<Child>(first, last);
+}
+
+void CompletionCache::put(Handle folder, std::vector<Child> children, uint64_t generation)
+{
+    if (children.size() > mCapacity)
+    {
+        return;
+    }
+
+    std::sort(children.begin(), children.end(), [](const Child &a, const Child &b) { return a.mName < b.mName; });
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (generation != mGeneration)
+    {
+        return;
+    }
+
+    auto existing = mByFolder.find(folder);
+    if (existing != mByFolder.end())
+    {
+        eraseLocked(existing->second);
+    }
+
+    for (const auto &child : children)
+    {
+        mFolderOf[child.mHandle] = folder;
+    }
+    mNumNames += children.size();
+    mListings.push_front(Listing{folder, std::move(children)});
+    mByFolder.emplace(folder, mListings.begin());
+    evictIfNeededLocked();
+}
+
+void CompletionCache::onNodeUpdated(Handle node, Handle parent, bool removed)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    ++mGeneration;
+
+    if (removed)
+    {
+        auto it = mByFolder.find(node);
+        if (it != mByFolder.end())
+        {
+            eraseLocked(it->second);
+        }
+    }
+
+    // The folder it was listed in (it may have been moved from there), and the one it is in now
+    auto formerFolder = mFolderOf.find(node);
+    if (formerFolder != mFolderOf.end())
+    {
+        auto it = mByFolder.find(formerFolder->second);
+        if (it != mByFolder.end())
+        {
+            eraseLocked(it->second);
+        }
+    }
+
+    auto it = mByFolder.find(parent);
+    if (it != mByFolder.end())
+    {
+        eraseLocked(it->second);
+    }
+}
+
+void CompletionCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    ++mGeneration;
+    mFolderOf.clear();
+    mByFolder.clear();
+    mListings.clear();
+    mNumNames = 0;
+}
+
+CompletionCache::Stats CompletionCache::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    Stats stats;
+    stats.mNumFolders = mListings.size();
+    stats.mNumNames = mNumNames;
+    stats.mCapacity = mCapacity;
+    stats.mHits = mHits;
+    stats.mMisses = mMisses;
+    return stats;
+}
+
+void CompletionCache::eraseLocked(Listings::iterator it)
+{
+    for (const auto &child : it->mChildren)
+    {
+        auto folderOf = mFolderOf.find(child.mHandle);
+        if (folderOf != mFolderOf.end() && folderOf->second == it->mFolder)
+        {
+            mFolderOf.erase(folderOf);
+        }
+    }
+    mNumNames -= it->mChildren.size();
+    mByFolder.erase(it->mFolder);
+    mListings.erase(it);
+}
+
+void CompletionCache::evictIfNeededLocked()
+{
+    while (mNumNames > mCapacity)
+    {
+        eraseLocked(std::prev(mListings.end()));
+    }
+}
+
+}
@@ -0,0 +1,106 @@
+/**
+ * @file src/megacmd_completion_cache.h
+ * @brief MEGAcmd: Cache of folder listings for path completion
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace megacmd {
+
+/**
+ * @brief The children of the most recently completed folders, sorted by name to be searched by prefix.
+ *
+ * Each folder's names are kept in a sorted array: the children starting with a prefix are a contiguous
+ * range found by binary search, without going through the rest of them.
+ *
+ * A listing is discarded when a node is added to, renamed within, moved from/to or removed from its folder.
+ * Listings got before that are discarded when put afterwards: generations are to be taken before reading them.
+ * Up to capacity names are kept, evicting least recently used folders. Thread safe.
+ */
+class CompletionCache final
+{
+public:
+    using Handle = uint64_t;
+
+    struct Child
+    {
+        std::string mName;
+        Handle mHandle = 0;
+        bool mIsFile = false;
+    };
+
+    struct Stats
+    {
+        size_t mNumFolders = 0;
+        size_t mNumNames = 0;
+        size_t mCapacity = 0;
+        uint64_t mHits = 0;
+        uint64_t mMisses = 0;
+    };
+
+    explicit CompletionCache(size_t capacity);
+
+    CompletionCache(const CompletionCache&) = delete;
+    CompletionCache& operator=(const CompletionCache&) = delete;
+
+    uint64_t getGeneration() const;
+
+    // Children of the folder whose names start with prefix, sorted by name. Nothing if the folder is not cached
+    std::optional<std::vector<Child>> find(Handle folder, const std::string &prefix);
+
+    // Folders with more children than the capacity are not kept
+    void put(Handle folder, std::vector<Child> children, uint64_t generation);
+
+    // A node was added, renamed, moved or removed: parent is the folder it is (or was, if removed) in
+    void onNodeUpdated(Handle node, Handle parent, bool removed);
+
+    void clear();
+
+    Stats getStats() const;
+
+private:
+    struct Listing
+    {
+        Handle mFolder;
+        std::vector<Child> mChildren; // sorted by name
+    };
+
+    using Listings = std::list<Listing>;
+
+    void eraseLocked(Listings::iterator it);
+    void evictIfNeededLocked();
+
+    const size_t mCapacity;
+
+    mutable std::mutex mMutex;
+    uint64_t mGeneration = 0;
+    Listings mListings; // most recently used first
+    std::unordered_map<Handle, Listings::iterator> mByFolder;
+    std::unordered_map<Handle, Handle> mFolderOf; // children listed -> their folder
+    size_t mNumNames = 0;
+    uint64_t mHits = 0;
+    uint64_t mMisses = 0;
+};
+
+}
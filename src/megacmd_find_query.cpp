@@ -0,0 +1,176 @@
+/**
+ * @file src/megacmd_find_query.cpp
+ * @brief MEGAcmd: Evaluation plan of find criteria
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "megacmd_find_query.h"
+
+#include <algorithm>
+
+namespace megacmd {
+
+FindQuery::FindQuery(const FindCriteria &criteria)
+    : mCriteria(criteria)
+{
+    const bool sized = mCriteria.mMinSize != -1 || mCriteria.mMaxSize != -1;
+
+    if ((sized && mCriteria.mType == FindNodeType::FOLDERS)
+            || (mCriteria.mMinSize != -1 && mCriteria.mMaxSize != -1 && mCriteria.mMinSize > mCriteria.mMaxSize)
+            || (mCriteria.mMinTime != -1 && mCriteria.mMaxTime != -1 && mCriteria.mMaxTime - mCriteria.mMinTime <= 1)
+            || (mCriteria.mMaxDepth >= 0 && mCriteria.mMinDepth > mCriteria.mMaxDepth)
+            || (mCriteria.mMatcher && !mCriteria.mMatcher->isValid()))
+    {
+        mSatisfiable = false;
+        return;
+    }
+
+    if (usesDepth())
+    {
+        mPredicates.push_back(Predicate::DEPTH);
+    }
+    if (mCriteria.mType != FindNodeType::ANY && !sized) // sizes already imply files
+    {
+        mPredicates.push_back(Predicate::TYPE);
+    }
+    if (sized)
+    {
+        mPredicates.push_back(Predicate::SIZE);
+    }
+    if (mCriteria.mMinTime != -1 || mCriteria.mMaxTime != -1)
+    {
+        mPredicates.push_back(Predicate::TIME);
+    }
+    if (mCriteria.mMatcher)
+    {
+        mPredicates.push_back(mCriteria.mMatcher->matchesAnyName() ? Predicate::NAMED : Predicate::NAME);
+    }
+
+    const PatternMatcher *matcher = mCriteria.mMatcher;
+    std::stable_sort(mPredicates.begin(), mPredicates.end(), [matcher](Predicate a, Predicate b)
+    {
+        return getCost(a, matcher) < getCost(b, matcher);
+    });
+}
+
+bool FindQuery::matches(const FindCandidate &candidate) const
+{
+    if (!mSatisfiable)
+    {
+        return false;
+    }
+
+    for (Predicate predicate : mPredicates)
+    {
+        if (!check(predicate, candidate))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string FindQuery::describe() const
+{
+    if (!mSatisfiable)
+    {
+        return "nothing can match";
+    }
+    if (mPredicates.empty())
+    {
+        return "everything matches";
+    }
+
+    std::string description;
+    for (Predicate predicate : mPredicates)
+    {
+        if (description.size())
+        {
+            description += ", ";
+        }
+
+        switch (predicate)
+        {
+            case Predicate::DEPTH: description += "depth"; break;
+            case Predicate::TYPE:  description += "type"; break;
+            case Predicate::NAMED: description += "any name"; break;
+            case Predicate::SIZE:  description += "size"; break;
+            case Predicate::TIME:  description += "mtime"; break;
+            case Predicate::NAME:
+                description += "name (";
+                description += PatternMatcher::getBackendName(mCriteria.mMatcher->getBackend());
+                description += ")";
+                break;
+        }
+    }
+    return description;
+}
+
+int FindQuery::getCost(Predicate predicate, const PatternMatcher *matcher)
+{
+    switch (predicate)
+    {
+        case Predicate::DEPTH:
+        case Predicate::TYPE:
+        case Predicate::NAMED:
+            return 0;
+        case Predicate::SIZE:
+        case Predicate::TIME:
+            return 1;
+        case Predicate::NAME:
+            break;
+    }
+
+    switch (matcher->getBackend())
+    {
+        case PatternMatcher::Backend::LITERAL: return 2;
+        case PatternMatcher::Backend::PREFIX:
+        case PatternMatcher::Backend::SUFFIX:  return 3;
+        case PatternMatcher::Backend::GLOB:    return 4;
+        case PatternMatcher::Backend::REGEX:
+        case PatternMatcher::Backend::INVALID: return 5;
+    }
+    return 5;
+}
+
+bool FindQuery::check(Predicate predicate, const FindCandidate &candidate) const
+{
+    switch (predicate)
+    {
+        case Predicate::DEPTH:
+            return candidate.mDepth >= mCriteria.mMinDepth && (mCriteria.mMaxDepth < 0 || candidate.mDepth <= mCriteria.mMaxDepth);
+
+        case Predicate::TYPE:
+            return mCriteria.mType == FindNodeType::FILES ? candidate.mIsFile : candidate.mIsFolder;
+
+        case Predicate::NAMED:
+            return candidate.mName != nullptr;
+
+        case Predicate::SIZE:
+            return candidate.mIsFile
+                    && (mCriteria.mMinSize == -1 || candidate.mSize >= mCriteria.mMinSize)
+                    && (mCriteria.mMaxSize == -1 || candidate.mSize <= mCriteria.mMaxSize);
+
+        case Predicate::TIME:
+            return (mCriteria.mMinTime == -1 || candidate.mTime > mCriteria.mMinTime)
+                    && (mCriteria.mMaxTime == -1 || candidate.mTime < mCriteria.mMaxTime);
+
+        case Predicate::NAME:
+            return mCriteria.mMatcher->matches(candidate.mName);
+    }
+    return false;
+}
+
+}
@@ -0,0 +1,112 @@
+/**
+ * @file src/megacmd_find_query.h
+ * @brief MEGAcmd: Evaluation plan of find criteria
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "megacmd_pattern_matcher.h"
+
+namespace megacmd {
+
+enum class FindNodeType
+{
+    ANY,
+    FILES,
+    FOLDERS,
+};
+
+struct FindCriteria
+{
+    const PatternMatcher *mMatcher = nullptr; // nullptr: any name
+    FindNodeType mType = FindNodeType::ANY;
+
+    // Exclusive bounds of the modification time. -1: none
+    int64_t mMinTime = -1;
+    int64_t mMaxTime = -1;
+
+    // Inclusive bounds of the size, only met by files. -1: none
+    int64_t mMinSize = -1;
+    int64_t mMaxSize = -1;
+
+    // Depth relative to the node searched from, which has depth 0. -1: no max
+    int mMinDepth = 0;
+    int mMaxDepth = -1;
+};
+
+// What the criteria are checked against (only valid during the check)
+struct FindCandidate
+{
+    bool mIsFile = false;
+    bool mIsFolder = false;
+    const char *mName = nullptr;
+    int64_t mTime = 0;
+    int64_t mSize = 0;
+    int mDepth = 0;
+};
+
+/**
+ * @brief The criteria of a find, planned once to be checked against every node found.
+ *
+ * Predicates always true are dropped, and the rest are checked cheapest first (the name pattern last,
+ * ranked by its backend), so that most nodes are discarded before matching their names.
+ * Criteria no node can meet (e.g: folders of some size) are detected upfront: nothing needs traversing then.
+ *
+ * Subtrees are only pruned by depth: time and size bounds of a folder say nothing about its descendants,
+ * and names are best looked up in the name index.
+ */
+class FindQuery final
+{
+public:
+    explicit FindQuery(const FindCriteria &criteria);
+
+    bool isSatisfiable() const { return mSatisfiable; }
+
+    // Max depth worth traversing. -1: the whole tree
+    int getMaxDepth() const { return mCriteria.mMaxDepth; }
+
+    // Whether matching needs the depth of nodes (e.g: those from the name index have none)
+    bool usesDepth() const { return mCriteria.mMinDepth > 0 || mCriteria.mMaxDepth >= 0; }
+
+    bool matches(const FindCandidate &candidate) const;
+
+    // The predicates in the order they are checked, e.g: "type, mtime, name (glob)"
+    std::string describe() const;
+
+private:
+    enum class Predicate
+    {
+        DEPTH,
+        TYPE,
+        NAMED, // any name: a pattern matching everything
+        SIZE,
+        TIME,
+        NAME,
+    };
+
+    static int getCost(Predicate predicate, const PatternMatcher *matcher);
+    bool check(Predicate predicate, const FindCandidate &candidate) const;
+
+    FindCriteria mCriteria;
+    std::vector<Predicate> mPredicates; // cheapest first
+    bool mSatisfiable = true;
+};
+
+}
@@ -0,0 +1,396 @@
+/**
+ * @file src/megacmd_framing.h
+ * @brief MEGAcmd: framed messages exchanged between clients and server
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace megacmd {
+
+/**
+ * Every framed message starts with a fixed size header:
+ *
+ *   magic (4 bytes) | version (1) | type (1) | flags (2) | petition id (4) | payload length (8)
+ *
+ * followed by `payload length` bytes. Integers are in host byte order: both ends
+ * live in the same machine.
+ *
+ * A petition is a COMMAND frame sent by the client. The server responds with any number of
+ * PARTIAL_OUT/PARTIAL_ERR/REQ_CONFIRM/REQ_STRING frames (the latter two are answered by the
+ * client with a USER_RESPONSE frame) and a FINAL frame.
+ * The server still accepts unframed petitions (the raw command line) from older clients:
+ * those are told apart by the magic number, and responded with the legacy protocol.
+ */
+constexpr uint32_t FRAME_MAGIC = 0x464D434D; // "MCMF" in little endian
+constexpr uint8_t FRAME_PROTOCOL_VERSION = 1;
+constexpr size_t FRAME_HEADER_SIZE = 20;
+constexpr uint64_t FRAME_MAX_COMMAND_SIZE = 64 * 1024 * 1024; // larger commands are rejected
+
+// Flags
+constexpr uint16_t FRAME_FLAG_BINARY = 0x1; ///< PARTIAL_OUT carrying binary contents (e.g: cat), to be written as is
+
+// Legacy petitions carry no length: they are taken as complete once no more bytes arrived for this long
+constexpr std::chrono::milliseconds LEGACY_PETITION_QUIET_TIME{50};
+// Connections whose petition is still incomplete this long after their last bytes are dropped
+constexpr std::chrono::seconds INCOMING_PETITION_TIMEOUT{30};
+
+// Socket buffers are enlarged to this size when streaming binary contents
+constexpr int STREAMING_SOCKET_BUFFER_SIZE = 4 * 1024 * 1024;
+
+enum class FrameType : uint8_t
+{
+    SESSION_READY = 1,  ///< Server -> client: the session accepts command frames
+    COMMAND = 2,        ///< Client -> server: payload is the command line
+    PARTIAL_OUT = 3,    ///< Server -> client: payload is partial output
+    PARTIAL_ERR = 4,    ///< Server -> client: payload is partial error output
+    FINAL = 5,          ///< Server -> client: payload is the out code (int32) followed by the remaining output
+    REQ_CONFIRM = 6,    ///< Server -> client: payload is the question to confirm
+    REQ_STRING = 7,     ///< Server -> client: payload is the prompt to request a string
+    USER_RESPONSE = 8,  ///< Client -> server: payload is the confirmation (int32) or the string requested
+};
+
+struct FrameHeader
+{
+    uint8_t mVersion = FRAME_PROTOCOL_VERSION;
+    FrameType mType = FrameType::COMMAND;
+    uint16_t mFlags = 0;
+    uint32_t mPetitionId = 0;
+    uint64_t mLength = 0;
+
+    std::array<char, FRAME_HEADER_SIZE> encode() const
+    {
+        std::array<char, FRAME_HEADER_SIZE> bytes;
+        char *p = bytes.data();
+        std::memcpy(p, &FRAME_MAGIC, 4);
+        std::memcpy(p + 4, &mVersion, 1);
+        std::memcpy(p + 5, &mType, 1);
+        std::memcpy(p + 6, &mFlags, 2);
+        std::memcpy(p + 8, &mPetitionId, 4);
+        std::memcpy(p + 12, &mLength, 8);
+        return bytes;
+    }
+
+    // Returns nullopt if the bytes are not a frame header of a supported version
+    static std::optional<FrameHeader> decode(const char *bytes)
+    {
+        uint32_t magic;
+        std::memcpy(&magic, bytes, 4);
+        if (magic != FRAME_MAGIC)
+        {
+            return std::nullopt;
+        }
+
+        FrameHeader header;
+        std::memcpy(&header.mVersion, bytes + 4, 1);
+        std::memcpy(&header.mType, bytes + 5, 1);
+        std::memcpy(&header.mFlags, bytes + 6, 2);
+        std::memcpy(&header.mPetitionId, bytes + 8, 4);
+        std::memcpy(&header.mLength, bytes + 12, 8);
+        if (header.mVersion > FRAME_PROTOCOL_VERSION)
+        {
+            return std::nullopt;
+        }
+        return header;
+    }
+};
+
+/**
+ * @brief Assembles a petition from the bytes received on its connection, as they arrive.
+ *
+ * It is told to be framed or legacy once the 4 bytes of the magic number have been received, or as soon as
+ * the ones received differ from it. A framed petition is complete once its whole COMMAND frame has been received.
+ * A legacy one has no delimiter: it is complete once the client has nothing more to send (it then waits for the response).
+ */
+class PetitionAssembler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Status
+    {
+        INCOMPLETE,
+        COMPLETE,
+        INVALID,
+    };
+
+    explicit PetitionAssembler(Clock::time_point now = Clock::now()) : mLastReceived(now) {}
+
+    // Appends the bytes received
+    Status append(const char *data, size_t size, Clock::time_point now = Clock::now())
+    {
+        if (mStatus != Status::INCOMPLETE)
+        {
+            return mStatus;
+        }
+        mData.append(data, size);
+        mLastReceived = now;
+
+        if (!mLegacy && !mHeader)
+        {
+            const size_t magicBytes = std::min(sizeof(FRAME_MAGIC), mData.size());
+            if (std::memcmp(mData.data(), &FRAME_MAGIC, magicBytes))
+            {
+                mLegacy = true;
+            }
+            else if (mData.size() >= FRAME_HEADER_SIZE)
+            {
+                mHeader = FrameHeader::decode(mData.data());
+                if (!mHeader || mHeader->mType != FrameType::COMMAND || mHeader->mLength > FRAME_MAX_COMMAND_SIZE)
+                {
+                    return mStatus = Status::INVALID;
+                }
+            }
+        }
+
+        if (mLegacy && mData.size() > FRAME_MAX_COMMAND_SIZE)
+        {
+            return mStatus = Status::INVALID;
+        }
+        if (mHeader && mData.size() >= FRAME_HEADER_SIZE + mHeader->mLength)
+        {
+            mStatus = Status::COMPLETE;
+        }
+        return mStatus;
+    }
+
+    // Until then, the status only changes if more bytes arrive (or the connection is closed)
+    Clock::time_point getDeadline() const
+    {
+        return mLastReceived + (mLegacy ? Clock::duration(LEGACY_PETITION_QUIET_TIME) : Clock::duration(INCOMING_PETITION_TIMEOUT));
+    }
+
+    // To be called when no bytes are available: once the deadline passed, a legacy petition
+    // is complete (its client sent it all and awaits the response) and any other is dropped
+    Status onIdle(Clock::time_point now = Clock::now())
+    {
+        if (mStatus == Status::INCOMPLETE && now >= getDeadline())
+        {
+            mTimedOut = !mLegacy;
+            mStatus = mLegacy ? Status::COMPLETE : Status::INVALID;
+        }
+        return mStatus;
+    }
+
+    // To be called once the client shut down its side of the connection (or went away)
+    Status onClosed()
+    {
+        if (mStatus == Status::INCOMPLETE)
+        {
+            // A legacy petition shorter than the magic number, and a prefix of it
+            mLegacy = mLegacy || (!mHeader && !mData.empty());
+            mStatus = mLegacy ? Status::COMPLETE : Status::INVALID;
+        }
+        return mStatus;
+    }
+
+    Status getStatus() const { return mStatus; }
+
+    bool isFramed() const { return mHeader.has_value(); }
+
+    bool hasTimedOut() const { return mTimedOut; }
+
+    // Complete framed petitions only
+    const FrameHeader& getHeader() const { return *mHeader; }
+
+    // Complete petitions only: the command line
+    std::string takeLine()
+    {
+        if (mHeader)
+        {
+            return mData.substr(FRAME_HEADER_SIZE, static_cast<size_t>(mHeader->mLength));
+        }
+        return std::move(mData);
+    }
+
+private:
+    std::string mData;
+    bool mLegacy = false;
+    bool mTimedOut = false;
+    Clock::time_point mLastReceived;
+    std::optional<FrameHeader> mHeader;
+    Status mStatus = Status::INCOMPLETE;
+};
+
+#ifndef _WIN32
+namespace framing {
+
+#if defined(__MACH__) && !defined(MSG_NOSIGNAL)
+constexpr int SEND_FLAGS = 0;
+#else
+constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#endif
+
+// Sends all the buffers described by iov, in as few syscalls as possible
+inline bool sendAll(int socket, struct iovec *iov, int iovcnt)
+{
+    while (iovcnt > 0)
+    {
+        struct msghdr msg;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = iovcnt;
+
+        auto n = sendmsg(socket, &msg, SEND_FLAGS);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+
+        size_t sent = static_cast<size_t>(n);
+        while (iovcnt > 0 && sent >= iov->iov_len)
+        {
+            sent -= iov->iov_len;
+            ++iov;
+            --iovcnt;
+        }
+        if (iovcnt > 0)
+        {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + sent;
+            iov->iov_len -= sent;
+        }
+    }
+    return true;
+}
+
+inline bool recvAll(int socket, char *data, size_t size)
+{
+    while (size)
+    {
+        auto n = recv(socket, data, size, MSG_WAITALL);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Header and payload are sent within the same syscall (unless the socket buffer is full)
+inline bool sendFrame(int socket, const FrameHeader &header, std::string_view payload, std::string_view payload2 = {})
+{
+    FrameHeader h = header;
+    h.mLength = payload.size() + payload2.size();
+    auto headerBytes = h.encode();
+
+    struct iovec iov[3];
+    iov[0].iov_base = headerBytes.data();
+    iov[0].iov_len = headerBytes.size();
+    iov[1].iov_base = const_cast<char*>(payload.data());
+    iov[1].iov_len = payload.size();
+    iov[2].iov_base = const_cast<char*>(payload2.data());
+    iov[2].iov_len = payload2.size();
+    return sendAll(socket, iov, payload2.empty() ? 2 : 3);
+}
+
+// Returns nullopt on EOF, error or invalid header
+inline std::optional<FrameHeader> recvFrameHeader(int socket)
+{
+    char bytes[FRAME_HEADER_SIZE];
+    if (!recvAll(socket, bytes, sizeof(bytes)))
+    {
+        return std::nullopt;
+    }
+    return FrameHeader::decode(bytes);
+}
+
+// Bytes that can be received without blocking
+inline size_t bytesAvailable(int socket)
+{
+    int available = 0;
+    if (ioctl(socket, FIONREAD, &available) == -1 || available < 0)
+    {
+        return 0;
+    }
+    return static_cast<size_t>(available);
+}
+
+// Waits for bytes to receive (or the connection to be closed) for up to `timeout`
+inline bool waitForBytes(int socket, std::chrono::milliseconds timeout)
+{
+    struct pollfd pfd;
+    pfd.fd = socket;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    int rc;
+    do
+    {
+        rc = poll(&pfd, 1, static_cast<int>(std::max<std::chrono::milliseconds::rep>(timeout.count(), 0)));
+    } while (rc < 0 && errno == EINTR);
+    return rc != 0;
+}
+
+// option: SO_SNDBUF or SO_RCVBUF. The size is only a hint: the kernel may cap it
+inline void enlargeSocketBuffer(int socket, int option, int size = STREAMING_SOCKET_BUFFER_SIZE)
+{
+    int current = 0;
+    socklen_t len = sizeof(current);
+    if (getsockopt(socket, SOL_SOCKET, option, &current, &len) == 0 && current >= size)
+    {
+        return;
+    }
+    setsockopt(socket, SOL_SOCKET, option, &size, sizeof(size));
+}
+
+// Receives a whole frame. Returns nullopt on EOF, error, invalid header or payload larger than maxPayloadSize
+inline std::optional<std::pair<FrameHeader, std::string>> recvFrame(int socket, uint64_t maxPayloadSize)
+{
+    auto header = recvFrameHeader(socket);
+    if (!header || header->mLength > maxPayloadSize)
+    {
+        return std::nullopt;
+    }
+
+    std::string payload(static_cast<size_t>(header->mLength), '\0');
+    if (!recvAll(socket, payload.data(), payload.size()))
+    {
+        return std::nullopt;
+    }
+    return std::make_pair(*header, std::move(payload));
+}
+
+}
+#endif
+
+}
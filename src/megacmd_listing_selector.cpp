@@ -0,0 +1,359 @@
+/**
+ * @file src/megacmd_listing_selector.cpp
+ * @brief MEGAcmd: Sorted and limited listings
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "megacmd_listing_selector.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace megacmd {
+
+std::optional<ListingSortKey> parseListingSortKey(const std::string &key)
+{
+    if (key == "name")
+    {
+        return ListingSortKey::NAME;
+    }
+    if (key == "size")
+    {
+        return ListingSortKey::SIZE;
+    }
+    if (key == "mtime")
+    {
+        return ListingSortKey::TIME;
+    }
+    return std::nullopt;
+}
+
+namespace {
+const char sBase64Chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+constexpr uint8_t sCursorVersion = 1;
+
+void appendFixed(std::string &out, uint64_t value, int size)
+{
+    for (int i = 0; i < size; ++i)
+    {
+        out += static_cast<char>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+bool readFixed(const std::string &in, size_t &pos, int size, uint64_t &value)
+{
+    if (in.size() - pos < static_cast<size_t>(size))
+    {
+        return false;
+    }
+
+    value = 0;
+    for (int i = 0; i < size; ++i)
+    {
+        value |= static_cast<uint64_t>(static_cast<uint8_t>(in[pos++])) << (8 * i);
+    }
+    return true;
+}
+
+std::string toBase64(const std::string &bytes)
+{
+    std::string out;
+    uint32_t bits = 0;
+    int numBits = 0;
+    for (char c : bytes)
+    {
+        bits = (bits << 8) | static_cast<uint8_t>(c);
+        numBits += 8;
+        while (numBits >= 6)
+        {
+            numBits -= 6;
+            out += sBase64Chars[(bits >> numBits) & 63];
+        }
+    }
+    if (numBits)
+    {
+        out += sBase64Chars[(bits << (6 - numBits)) & 63];
+    }
+    return out;
+}
+
+bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// Case-insensitive, digit runs compared by their value: "file2" < "File10"
+int compareNatural(const std::string &a, const std::string &b)
+{
+    size_t i = 0, j = 0;
+    while (i < a.size() && j < b.size())
+    {
+        if (isDigit(a[i]) && isDigit(b[j]))
+        {
+            while (i < a.size() && a[i] == '0') ++i;
+            while (j < b.size() && b[j] == '0') ++j;
+            size_t endA = i, endB = j;
+            while (endA < a.size() && isDigit(a[endA])) ++endA;
+            while (endB < b.size() && isDigit(b[endB])) ++endB;
+            if (endA - i != endB - j)
+            {
+                return endA - i < endB - j ? -1 : 1;
+            }
+            int compared = a.compare(i, endA - i, b, j, endB - j);
+            if (compared)
+            {
+                return compared;
+            }
+            i = endA;
+            j = endB;
+            continue;
+        }
+
+        const int ca = std::tolower(static_cast<unsigned char>(a[i]));
+        const int cb = std::tolower(static_cast<unsigned char>(b[j]));
+        if (ca != cb)
+        {
+            return ca < cb ? -1 : 1;
+        }
+        ++i;
+        ++j;
+    }
+    if (i < a.size() || j < b.size())
+    {
+        return i < a.size() ? 1 : -1;
+    }
+    return 0; // differing in case or leading zeros at most: told apart by handle
+}
+
+int compareKeys(const ListingKey &a, const ListingKey &b)
+{
+    if (a.mIsFolder != b.mIsFolder)
+    {
+        return a.mIsFolder ? -1 : 1;
+    }
+    if (int compared = compareNatural(a.mName, b.mName))
+    {
+        return compared;
+    }
+    if (a.mHandle != b.mHandle)
+    {
+        return a.mHandle < b.mHandle ? -1 : 1;
+    }
+    return 0;
+}
+
+std::optional<std::string> fromBase64(const std::string &text)
+{
+    std::string out;
+    uint32_t bits = 0;
+    int numBits = 0;
+    for (char c : text)
+    {
+        const char *found = std::strchr(sBase64Chars, c);
+        if (!c || !found)
+        {
+            return std::nullopt;
+        }
+
+        bits = (bits << 6) | static_cast<uint32_t>(found - sBase64Chars);
+        numBits += 6;
+        if (numBits >= 8)
+        {
+            numBits -= 8;
+            out += static_cast<char>((bits >> numBits) & 0xFF);
+        }
+    }
+    return out;
+}
+}
+
+std::string ListingCursor::encode() const
+{
+    std::string bytes;
+    bytes += static_cast<char>(sCursorVersion);
+    bytes += static_cast<char>(mKey);
+    bytes += static_cast<char>((mReverse ? 1 : 0) | (mRecursive ? 2 : 0));
+    appendFixed(bytes, mFolder, 8);
+    appendFixed(bytes, mLast.mHandle, 8);
+    appendFixed(bytes, static_cast<uint64_t>(mLast.mSize), 8);
+    appendFixed(bytes, static_cast<uint64_t>(mLast.mTime), 8);
+    appendFixed(bytes, mLast.mSequence, 8);
+    appendFixed(bytes, mLast.mName.size(), 4);
+    bytes += mLast.mName;
+    return toBase64(bytes);
+}
+
+std::optional<ListingCursor> ListingCursor::decode(const std::string &token)
+{
+    auto bytes = fromBase64(token);
+    if (!bytes || bytes->size() < 3 || static_cast<uint8_t>((*bytes)[0]) != sCursorVersion
+            || static_cast<uint8_t>((*bytes)[1]) > static_cast<uint8_t>(ListingSortKey::TIME))
+    {
+        return std::nullopt;
+    }
+
+    ListingCursor cursor;
+    cursor.mKey = static_cast<ListingSortKey>((*bytes)[1]);
+    cursor.mReverse = (*bytes)[2] & 1;
+    cursor.mRecursive = (*bytes)[2] & 2;
+
+    size_t pos = 3;
+    uint64_t size, time, nameSize;
+    if (!readFixed(*bytes, pos, 8, cursor.mFolder)
+            || !readFixed(*bytes, pos, 8, cursor.mLast.mHandle)
+            || !readFixed(*bytes, pos, 8, size)
+            || !readFixed(*bytes, pos, 8, time)
+            || !readFixed(*bytes, pos, 8, cursor.mLast.mSequence)
+            || !readFixed(*bytes, pos, 4, nameSize)
+            || bytes->size() - pos != nameSize)
+    {
+        return std::nullopt;
+    }
+    cursor.mLast.mSize = static_cast<int64_t>(size);
+    cursor.mLast.mTime = static_cast<int64_t>(time);
+    cursor.mLast.mName = bytes->substr(pos);
+    return cursor;
+}
+
+int compareFindOrder(const ListingEntry &a, const ListingEntry &b)
+{
+    // Compared by their chains of keys: the first folders differing tell, else descendants go first
+    const ListingKey keyA{a.mIsFolder, a.mName, a.mHandle};
+    const ListingKey keyB{b.mIsFolder, b.mName, b.mHandle};
+    const size_t sizeA = a.mAncestors.size() + 1;
+    const size_t sizeB = b.mAncestors.size() + 1;
+    for (size_t i = 0; i < std::min(sizeA, sizeB); ++i)
+    {
+        const ListingKey &componentA = i < a.mAncestors.size() ? a.mAncestors[i] : keyA;
+        const ListingKey &componentB = i < b.mAncestors.size() ? b.mAncestors[i] : keyB;
+        if (int compared = compareKeys(componentA, componentB))
+        {
+            return compared;
+        }
+    }
+    if (sizeA != sizeB)
+    {
+        return sizeA < sizeB ? 1 : -1;
+    }
+    return 0;
+}
+
+ListingSelector::ListingSelector(const ListingOrder &order)
+    : mOrder(order)
+{
+}
+
+void ListingSelector::startAfter(const ListingEntry &last)
+{
+    mStartAfter = last;
+}
+
+void ListingSelector::add(ListingEntry entry)
+{
+    entry.mSequence = mNextSequence++;
+    if (mStartAfter && mOrder.mKey == ListingSortKey::NONE && entry.mSequence == mStartAfter->mSequence)
+    {
+        mStartFound = entry.mHandle == mStartAfter->mHandle;
+    }
+    if (mStartAfter && !precedes(*mStartAfter, entry)) // within a previous page
+    {
+        return;
+    }
+
+    auto comparator = [this](const ListingEntry &a, const ListingEntry &b) { return precedes(a, b); };
+    if (!mOrder.mLimit)
+    {
+        mEntries.push_back(std::move(entry));
+    }
+    else if (mEntries.size() < mOrder.mOffset + mOrder.mLimit)
+    {
+        mEntries.push_back(std::move(entry));
+        std::push_heap(mEntries.begin(), mEntries.end(), comparator);
+    }
+    else if (precedes(entry, mEntries.front()))
+    {
+        std::pop_heap(mEntries.begin(), mEntries.end(), comparator);
+        mEntries.back() = std::move(entry);
+        std::push_heap(mEntries.begin(), mEntries.end(), comparator);
+    }
+}
+
+bool ListingSelector::isComplete() const
+{
+    // Later entries come after the ones selected
+    return mOrder.mKey == ListingSortKey::NONE && !mOrder.mReverse && mOrder.mLimit && mEntries.size() >= mOrder.mOffset + mOrder.mLimit;
+}
+
+bool ListingSelector::isStartLost() const
+{
+    // Positions are only meaningful while the listing stays the same
+    return mStartAfter && mOrder.mKey == ListingSortKey::NONE && !mStartFound;
+}
+
+std::vector<ListingEntry> ListingSelector::take()
+{
+    auto comparator = [this](const ListingEntry &a, const ListingEntry &b) { return precedes(a, b); };
+    if (mOrder.mLimit)
+    {
+        std::sort_heap(mEntries.begin(), mEntries.end(), comparator);
+    }
+    else
+    {
+        std::sort(mEntries.begin(), mEntries.end(), comparator);
+    }
+    mEntries.erase(mEntries.begin(), mEntries.begin() + static_cast<std::ptrdiff_t>(std::min(mOrder.mOffset, mEntries.size())));
+    return std::move(mEntries);
+}
+
+bool ListingSelector::precedes(const ListingEntry &a, const ListingEntry &b) const
+{
+    const bool reverse = mOrder.mReverse;
+    switch (mOrder.mKey)
+    {
+        case ListingSortKey::NAME:
+        {
+            int compared = a.mName.compare(b.mName);
+            if (compared)
+            {
+                return reverse ? compared > 0 : compared < 0;
+            }
+            break;
+        }
+        case ListingSortKey::SIZE:
+            if (a.mSize != b.mSize)
+            {
+                return reverse ? a.mSize < b.mSize : a.mSize > b.mSize;
+            }
+            break;
+        case ListingSortKey::TIME:
+            if (a.mTime != b.mTime)
+            {
+                return reverse ? a.mTime < b.mTime : a.mTime > b.mTime;
+            }
+            break;
+        case ListingSortKey::NONE:
+            return reverse ? a.mSequence > b.mSequence : a.mSequence < b.mSequence;
+    }
+
+    // Handles are stable across listings, for pages to follow each other
+    if (a.mHandle != b.mHandle)
+    {
+        return reverse ? a.mHandle > b.mHandle : a.mHandle < b.mHandle;
+    }
+    return reverse ? a.mSequence > b.mSequence : a.mSequence < b.mSequence;
+}
+
+}
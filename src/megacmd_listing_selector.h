@@ -0,0 +1,138 @@
+/**
+ * @file src/megacmd_listing_selector.h
+ * @brief MEGAcmd: Sorted and limited listings
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace megacmd {
+
+enum class ListingSortKey
+{
+    NONE,  ///< The order nodes are found in
+    NAME,  ///< Ascending
+    SIZE,  ///< Largest first
+    TIME,  ///< Most recent first
+};
+
+// "name", "size" or "mtime"
+std::optional<ListingSortKey> parseListingSortKey(const std::string &key);
+
+struct ListingOrder
+{
+    ListingSortKey mKey = ListingSortKey::NONE;
+    bool mReverse = false;
+    size_t mLimit = 0; // 0: no limit
+    size_t mOffset = 0; // entries skipped before the ones selected
+
+    bool isDefault() const { return mKey == ListingSortKey::NONE && !mReverse && !mLimit && !mOffset; }
+};
+
+struct ListingKey
+{
+    bool mIsFolder = false;
+    std::string mName;
+    uint64_t mHandle = 0;
+};
+
+struct ListingEntry
+{
+    uint64_t mHandle = 0;
+    std::string mName; // only needed to sort by name
+    int64_t mSize = 0;
+    int64_t mTime = 0;
+    uint64_t mSequence = 0; // set when added: the position in the order found
+    bool mIsFolder = false;
+    std::vector<ListingKey> mAncestors; // only needed to sort find results: the folders from the one searched down to the entry's parent
+};
+
+/**
+ * @brief Compares results of find close to the order its traversal lists them in: each folder after its
+ * descendants, and siblings close to the SDK's default order (folders first, then names compared
+ * case-insensitively, with digit runs by their value), ties broken by handle.
+ *
+ * Only ASCII letters are compared case-insensitively, and leading zeros are ignored: siblings whose names differ
+ * there may come in another order than the traversal's.
+ *
+ * @return < 0 if a comes first, > 0 if b does, 0 if they are the same entry
+ */
+int compareFindOrder(const ListingEntry &a, const ListingEntry &b);
+
+/**
+ * @brief Where a page of a listing ended, for the next one to start right after it.
+ *
+ * Encoded as an opaque token (base64), to be given back as it is. Unsorted listings resume at the position
+ * after the last entry, which is to be found still at its own position: otherwise the listing changed, and
+ * the next page would skip or repeat entries.
+ */
+struct ListingCursor
+{
+    uint64_t mFolder = 0;
+    ListingSortKey mKey = ListingSortKey::NONE;
+    bool mReverse = false;
+    bool mRecursive = false;
+    ListingEntry mLast;
+
+    std::string encode() const;
+    static std::optional<ListingCursor> decode(const std::string &token);
+};
+
+/**
+ * @brief Selects the first entries of a listing in the order requested, as they are found.
+ *
+ * With a limit, only that many entries (plus the offset) are kept, in a heap whose top is the last one selected
+ * so far: memory is O(offset + limit) and time O(n log (offset + limit)). Without limit, every entry is kept
+ * and sorted at the end. Ties are broken by handle (by the order entries were added in, when not sorted by
+ * any key); reversing flips the whole order.
+ *
+ * Starting after the last entry of a previous page (see ListingCursor) discards everything up to it as found,
+ * so that any page takes O(limit) memory.
+ */
+class ListingSelector final
+{
+public:
+    explicit ListingSelector(const ListingOrder &order);
+
+    // Only entries coming after last are to be selected
+    void startAfter(const ListingEntry &last);
+
+    void add(ListingEntry entry);
+
+    // Whether no further entry could be selected: the listing can stop
+    bool isComplete() const;
+
+    // Whether, not sorted by any key, the last entry of the previous page was not added at its position
+    bool isStartLost() const;
+
+    // The entries selected, in order
+    std::vector<ListingEntry> take();
+
+private:
+    bool precedes(const ListingEntry &a, const ListingEntry &b) const;
+
+    ListingOrder mOrder;
+    std::optional<ListingEntry> mStartAfter;
+    bool mStartFound = false;
+    std::vector<ListingEntry> mEntries; // a heap if limited
+    uint64_t mNextSequence = 0;
+};
+
+}
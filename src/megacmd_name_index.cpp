@@ -0,0 +1,370 @@
+/**
+ * @file src/megacmd_name_index.cpp
+ * @brief MEGAcmd: In-memory index of node names
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "megacmd_name_index.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace megacmd {
+
+namespace {
+// Dead slots are purged once they are this many, and more than the live ones
+constexpr size_t sMinDeadSlotsToCompact = 4096;
+}
+
+std::vector<NodeNameIndex::Trigram> NodeNameIndex::getTrigrams(const std::string &s)
+{
+    std::vector<Trigram> trigrams;
+    if (s.size() < 3)
+    {
+        return trigrams;
+    }
+
+    trigrams.reserve(s.size() - 2);
+    for (size_t i = 0; i + 2 < s.size(); ++i)
+    {
+        trigrams.push_back(static_cast<Trigram>(static_cast<unsigned char>(s[i])) << 16
+                         | static_cast<Trigram>(static_cast<unsigned char>(s[i + 1])) << 8
+                         | static_cast<Trigram>(static_cast<unsigned char>(s[i + 2])));
+    }
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+    return trigrams;
+}
+
+void NodeNameIndex::clear()
+{
+    std::unique_lock<std::shared_mutex> lock(mMutex);
+    clearLocked();
+}
+
+void NodeNameIndex::beginBuild()
+{
+    std::unique_lock<std::shared_mutex> lock(mMutex);
+    clearLocked();
+    mBuilding = true;
+}
+
+void NodeNameIndex::add(Handle handle, Handle parent, const std::string &name, bool isFile)
+{
+    std::unique_lock<std::shared_mutex> lock(mMutex);
+    if (mBuilding) // otherwise, the build was aborted by clear()
+    {
+        addLocked(handle, parent, name, isFile);
+    }
+}
+
+void NodeNameIndex::endBuild(std::chrono::milliseconds buildTime)
+{
+    std::unique_lock<std::shared_mutex> lock(mMutex);
+    if (!mBuilding)
+    {
+        return;
+    }
+
+    for (const auto &update : mHeldUpdates)
+    {
+        applyLocked(update);
+    }
+    mHeldUpdates.clear();
+    mHeldUpdates.shrink_to_fit();
+
+    mBuilding = false;
+    mReady = true;
+    mBuildTime = buildTime;
+}
+
+void NodeNameIndex::applyUpdates(const std::vector<Update> &updates)
+{
+    std::unique_lock<std::shared_mutex> lock(mMutex);
+    if (mBuilding)
+    {
+        mHeldUpdates.insert(mHeldUpdates.end(), updates.begin(), updates.end());
+    }
+    else if (mReady)
+    {
+        for (const auto &update : updates)
+        {
+            applyLocked(update);
+        }
+    }
+}
+
+bool NodeNameIndex::isReady() const
+{
+    std::shared_lock<std::shared_mutex> lock(mMutex);
+    return mReady;
+}
+
+void NodeNameIndex::clearLocked()
+{
+    mSlots = std::vector<Slot>();
+    mSlotByHandle = std::unordered_map<Handle, uint32_t>();
+    mPostings = std::unordered_map<Trigram, std::vector<uint32_t>>();
+    mNumDeadSlots = 0;
+    mReady = false;
+    mBuilding = false;
+    mHeldUpdates.clear();
+}
+
+void NodeNameIndex::addLocked(Handle handle, Handle parent, const std::string &name, bool isFile)
+{
+    auto it = mSlotByHandle.find(handle);
+    if (it != mSlotByHandle.end())
+    {
+        Slot &slot = mSlots[it->second];
+        if (slot.mName == name) // moved (or updated otherwise): postings are still valid
+        {
+            slot.mParent = parent;
+            slot.mIsFile = isFile;
+            return;
+        }
+
+        // renamed: the old postings become stale
+        slot.mLive = false;
+        ++mNumDeadSlots;
+    }
+
+    const auto index = static_cast<uint32_t>(mSlots.size());
+    mSlots.push_back(Slot{handle, parent, name, isFile, true});
+    mSlotByHandle[handle] = index;
+    for (Trigram trigram : getTrigrams(name))
+    {
+        mPostings[trigram].push_back(index); // slots are appended: lists remain sorted
+    }
+
+    compactIfNeededLocked();
+}
+
+void NodeNameIndex::applyLocked(const Update &update)
+{
+    if (update.mRemoved)
+    {
+        removeLocked(update.mHandle);
+    }
+    else
+    {
+        addLocked(update.mHandle, update.mParent, update.mName, update.mIsFile);
+    }
+}
+
+void NodeNameIndex::removeLocked(Handle handle)
+{
+    auto it = mSlotByHandle.find(handle);
+    if (it == mSlotByHandle.end())
+    {
+        return;
+    }
+
+    // Descendants are notified as removed too. Should any be left behind, it would be unreachable from any root
+    mSlots[it->second].mLive = false;
+    ++mNumDeadSlots;
+    mSlotByHandle.erase(it);
+
+    compactIfNeededLocked();
+}
+
+void NodeNameIndex::compactIfNeededLocked()
+{
+    if (mNumDeadSlots < sMinDeadSlotsToCompact || mNumDeadSlots * 2 < mSlots.size())
+    {
+        return;
+    }
+
+    std::vector<Slot> slots;
+    slots.reserve(mSlots.size() - mNumDeadSlots);
+    mPostings.clear();
+    for (auto &slot : mSlots)
+    {
+        if (!slot.mLive)
+        {
+            continue;
+        }
+
+        const auto index = static_cast<uint32_t>(slots.size());
+        mSlotByHandle[slot.mHandle] = index;
+        for (Trigram trigram : getTrigrams(slot.mName))
+        {
+            mPostings[trigram].push_back(index);
+        }
+        slots.push_back(std::move(slot));
+    }
+    mSlots = std::move(slots);
+    mNumDeadSlots = 0;
+}
+
+bool NodeNameIndex::isInSubtreeLocked(const Slot &slot, Handle root) const
+{
+    if (slot.mHandle == root)
+    {
+        return true;
+    }
+
+    // Bounded: the links could be momentarily inconsistent (e.g: a cycle while moves are being notified)
+    Handle current = slot.mParent;
+    for (size_t steps = 0; steps < mSlotByHandle.size(); ++steps)
+    {
+        auto it = mSlotByHandle.find(current);
+        if (it == mSlotByHandle.end())
+        {
+            return false;
+        }
+
+        const Slot &ancestor = mSlots[it->second];
+        if (ancestor.mIsFile) // a version of a file
+        {
+            return false;
+        }
+        if (current == root)
+        {
+            return true;
+        }
+        current = ancestor.mParent;
+    }
+    return false;
+}
+
+std::optional<std::vector<NodeNameIndex::Handle>> NodeNameIndex::find(Handle root, const PatternMatcher &matcher) const
+{
+    std::shared_lock<std::shared_mutex> lock(mMutex);
+    if (!mReady || mSlotByHandle.find(root) == mSlotByHandle.end())
+    {
+        return std::nullopt;
+    }
+
+    std::vector<Handle> found;
+    if (!matcher.isValid())
+    {
+        return found;
+    }
+
+    auto consider = [this, root, &matcher, &found](uint32_t index)
+    {
+        const Slot &slot = mSlots[index];
+        if (slot.mLive && matcher.matches(slot.mName) && isInSubtreeLocked(slot, root))
+        {
+            found.push_back(slot.mHandle);
+        }
+    };
+
+    std::vector<Trigram> trigrams;
+    for (const auto &substring : matcher.getRequiredSubstrings())
+    {
+        auto substringTrigrams = getTrigrams(substring);
+        trigrams.insert(trigrams.end(), substringTrigrams.begin(), substringTrigrams.end());
+    }
+
+    if (trigrams.empty())
+    {
+        for (uint32_t i = 0; i < mSlots.size(); ++i)
+        {
+            consider(i);
+        }
+        return found;
+    }
+
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+    std::vector<const std::vector<uint32_t>*> lists;
+    for (Trigram trigram : trigrams)
+    {
+        auto it = mPostings.find(trigram);
+        if (it == mPostings.end())
+        {
+            return found; // no name contains it
+        }
+        lists.push_back(&it->second);
+    }
+
+    // Candidates are the slots in every list: walk the shortest one
+    std::sort(lists.begin(), lists.end(), [](auto a, auto b) { return a->size() < b->size(); });
+    for (uint32_t index : *lists.front())
+    {
+        bool inAll = std::all_of(lists.begin() + 1, lists.end(), [index](auto list) {
+            return std::binary_search(list->begin(), list->end(), index);
+        });
+        if (inAll)
+        {
+            consider(index);
+        }
+    }
+    return found;
+}
+
+std::optional<std::vector<NodeNameIndex::Node>> NodeNameIndex::getLineage(Handle handle, Handle root) const
+{
+    std::shared_lock<std::shared_mutex> lock(mMutex);
+    std::vector<Node> lineage;
+
+    // Bounded as isInSubtreeLocked is
+    Handle current = handle;
+    for (size_t steps = 0; steps < mSlotByHandle.size(); ++steps)
+    {
+        auto it = mSlotByHandle.find(current);
+        if (it == mSlotByHandle.end())
+        {
+            return std::nullopt;
+        }
+
+        const Slot &slot = mSlots[it->second];
+        if (slot.mIsFile && !lineage.empty()) // a version of a file
+        {
+            return std::nullopt;
+        }
+        lineage.push_back(Node{slot.mHandle, slot.mName, slot.mIsFile});
+        if (current == root)
+        {
+            std::reverse(lineage.begin(), lineage.end());
+            return lineage;
+        }
+        current = slot.mParent;
+    }
+    return std::nullopt;
+}
+
+NodeNameIndex::Stats NodeNameIndex::getStats() const
+{
+    std::shared_lock<std::shared_mutex> lock(mMutex);
+    constexpr size_t nodeOverhead = 2 * sizeof(void*); // per hash map element: next pointer and cached hash
+
+    Stats stats;
+    stats.mNumNodes = mSlotByHandle.size();
+    stats.mNumTrigrams = mPostings.size();
+    stats.mBuildTime = mBuildTime;
+
+    size_t bytes = mSlots.capacity() * sizeof(Slot);
+    for (const auto &slot : mSlots)
+    {
+        if (slot.mName.capacity() > 15) // beyond the small string buffer
+        {
+            bytes += slot.mName.capacity() + 1;
+        }
+    }
+    bytes += mSlotByHandle.size() * (sizeof(std::pair<const Handle, uint32_t>) + nodeOverhead) + mSlotByHandle.bucket_count() * sizeof(void*);
+    for (const auto &posting : mPostings)
+    {
+        bytes += sizeof(posting) + nodeOverhead + posting.second.capacity() * sizeof(uint32_t);
+    }
+    bytes += mPostings.bucket_count() * sizeof(void*);
+    stats.mMemoryBytes = bytes;
+    return stats;
+}
+
+}
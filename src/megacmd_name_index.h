@@ -0,0 +1,145 @@
+/**
+ * @file src/megacmd_name_index.h
+ * @brief MEGAcmd: In-memory index of node names
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "megacmd_pattern_matcher.h"
+
+namespace megacmd {
+
+/**
+ * @brief Index of the names of the nodes of an account, along with their parent links,
+ * to find nodes by name without traversing the tree.
+ *
+ * Names are indexed by their trigrams: a query intersects the posting lists of the trigrams
+ * of the substrings its pattern requires, and then matches the remaining candidates.
+ * Patterns without such substrings are matched against every name (still without any tree traversal).
+ *
+ * The index is built once (beginBuild, add, endBuild) and kept current with applyUpdates.
+ * Updates received while building are held and applied on endBuild, so that no change is lost
+ * regardless of whether the builder saw the node before or after it.
+ *
+ * Thread safe: queries share a lock, updates take it exclusively.
+ */
+class NodeNameIndex final
+{
+public:
+    using Handle = uint64_t;
+
+    struct Update
+    {
+        Handle mHandle;
+        Handle mParent;
+        std::string mName;
+        bool mIsFile = false;
+        bool mRemoved = false;
+    };
+
+    struct Node
+    {
+        Handle mHandle;
+        std::string mName;
+        bool mIsFile = false;
+    };
+
+    struct Stats
+    {
+        size_t mNumNodes = 0;
+        size_t mNumTrigrams = 0;
+        size_t mMemoryBytes = 0; // approximate
+        std::chrono::milliseconds mBuildTime{0};
+    };
+
+    NodeNameIndex() = default;
+
+    NodeNameIndex(const NodeNameIndex&) = delete;
+    NodeNameIndex& operator=(const NodeNameIndex&) = delete;
+
+    // Discards the contents: the index will not be ready until a build ends
+    void clear();
+
+    void beginBuild();
+    void add(Handle handle, Handle parent, const std::string &name, bool isFile);
+    void endBuild(std::chrono::milliseconds buildTime);
+
+    void applyUpdates(const std::vector<Update> &updates);
+
+    bool isReady() const;
+
+    /**
+     * @brief Finds the nodes whose names match within the subtree of root (root included).
+     * Nodes under files (i.e: previous versions) are not considered part of the tree.
+     * @returns the handles found (in no particular order), or nothing if the index is not ready
+     */
+    std::optional<std::vector<Handle>> find(Handle root, const PatternMatcher &matcher) const;
+
+    /**
+     * @brief The nodes from root down to the one given (both included), e.g: to sort the results of find
+     * by the folders they are in, without getting each of those from the SDK.
+     * @returns nothing if the node is not indexed within the subtree of root
+     */
+    std::optional<std::vector<Node>> getLineage(Handle handle, Handle root) const;
+
+    Stats getStats() const;
+
+private:
+    struct Slot
+    {
+        Handle mHandle;
+        Handle mParent;
+        std::string mName;
+        bool mIsFile = false;
+        bool mLive = true;
+    };
+
+    using Trigram = uint32_t;
+
+    static std::vector<Trigram> getTrigrams(const std::string &s);
+
+    // These expect the mutex to be held exclusively
+    void clearLocked();
+    void addLocked(Handle handle, Handle parent, const std::string &name, bool isFile);
+    void applyLocked(const Update &update);
+    void removeLocked(Handle handle);
+    void compactIfNeededLocked();
+
+    bool isInSubtreeLocked(const Slot &slot, Handle root) const;
+
+    mutable std::shared_mutex mMutex;
+
+    std::vector<Slot> mSlots;
+    std::unordered_map<Handle, uint32_t> mSlotByHandle;
+    // Sorted slot indexes of the names containing each trigram. Stale entries (dead slots) are purged on compaction
+    std::unordered_map<Trigram, std::vector<uint32_t>> mPostings;
+    size_t mNumDeadSlots = 0;
+
+    bool mReady = false;
+    bool mBuilding = false;
+    std::vector<Update> mHeldUpdates;
+    std::chrono::milliseconds mBuildTime{0};
+};
+
+}
@@ -0,0 +1,233 @@
+/**
+ * @file src/megacmd_node_export.cpp
+ * @brief MEGAcmd: Machine-readable export of nodes
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "megacmd_node_export.h"
+
+#include <charconv>
+#include <cstring>
+
+namespace megacmd {
+
+namespace {
+const char *getTypeName(ExportedNodeType type)
+{
+    switch (type)
+    {
+        case ExportedNodeType::FILE:    return "file";
+        case ExportedNodeType::FOLDER:  return "folder";
+        case ExportedNodeType::ROOT:    return "root";
+        case ExportedNodeType::VAULT:   return "vault";
+        case ExportedNodeType::RUBBISH: return "rubbish";
+        case ExportedNodeType::UNKNOWN: break;
+    }
+    return "unknown";
+}
+
+// Node handles take 6 bytes
+constexpr int sHandleSize = 6;
+}
+
+std::optional<NodeExportFormat> parseNodeExportFormat(const std::string &format)
+{
+    if (format == "ndjson")
+    {
+        return NodeExportFormat::NDJSON;
+    }
+    if (format == "binary")
+    {
+        return NodeExportFormat::BINARY;
+    }
+    return std::nullopt;
+}
+
+NodeExporter::NodeExporter(NodeExportFormat format, Sink sink, size_t bufferSize)
+    : mFormat(format)
+    , mSink(std::move(sink))
+    , mBufferSize(bufferSize)
+{
+    mBuffer.reserve(mBufferSize + 1024);
+    if (mFormat == NodeExportFormat::BINARY)
+    {
+        mBuffer.append("MCNX\x01", 5);
+    }
+}
+
+NodeExporter::~NodeExporter()
+{
+    flush();
+}
+
+void NodeExporter::write(const ExportedNode &node)
+{
+    if (mFormat == NodeExportFormat::NDJSON)
+    {
+        writeJson(node);
+    }
+    else
+    {
+        writeBinary(node);
+    }
+
+    ++mNumNodes;
+    if (mBuffer.size() >= mBufferSize)
+    {
+        flush();
+    }
+}
+
+void NodeExporter::flush()
+{
+    if (mBuffer.size())
+    {
+        mSink(mBuffer.data(), mBuffer.size());
+        mBuffer.clear();
+    }
+}
+
+void NodeExporter::appendHandle(std::string &out, uint64_t handle)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+    // The bytes of the handle as stored in memory (little endian), 3 at a time
+    for (int i = 0; i < sHandleSize; i += 3)
+    {
+        uint32_t group = static_cast<uint32_t>((handle >> (8 * i)) & 0xFF) << 16
+                       | static_cast<uint32_t>((handle >> (8 * (i + 1))) & 0xFF) << 8
+                       | static_cast<uint32_t>((handle >> (8 * (i + 2))) & 0xFF);
+        out += alphabet[(group >> 18) & 63];
+        out += alphabet[(group >> 12) & 63];
+        out += alphabet[(group >> 6) & 63];
+        out += alphabet[group & 63];
+    }
+}
+
+void NodeExporter::writeJson(const ExportedNode &node)
+{
+    mBuffer += "{\"handle\":\"";
+    appendHandle(mBuffer, node.mHandle);
+    mBuffer += "\",\"parent\":";
+    if (node.mParentHandle)
+    {
+        mBuffer += '"';
+        appendHandle(mBuffer, *node.mParentHandle);
+        mBuffer += '"';
+    }
+    else
+    {
+        mBuffer += "null";
+    }
+    mBuffer += ",\"name\":";
+    appendJsonString(node.mName ? node.mName : "");
+    mBuffer += ",\"type\":\"";
+    mBuffer += getTypeName(node.mType);
+    mBuffer += "\",\"size\":";
+    appendInteger(node.mSize);
+    mBuffer += ",\"mtime\":";
+    appendInteger(node.mTime);
+    mBuffer += ",\"fingerprint\":";
+    if (node.mFingerprint)
+    {
+        appendJsonString(node.mFingerprint);
+    }
+    else
+    {
+        mBuffer += "null";
+    }
+    mBuffer += ",\"versions\":";
+    appendInteger(node.mNumVersions);
+    mBuffer += "}\n";
+}
+
+void NodeExporter::writeBinary(const ExportedNode &node)
+{
+    mBuffer += static_cast<char>(node.mType);
+    appendHandleBytes(node.mHandle);
+    appendHandleBytes(node.mParentHandle.value_or(~uint64_t(0)));
+    appendVarint(static_cast<uint64_t>(node.mSize));
+    appendVarint((static_cast<uint64_t>(node.mTime) << 1) ^ static_cast<uint64_t>(node.mTime >> 63));
+    appendVarint(static_cast<uint64_t>(node.mNumVersions));
+    appendBytes(node.mName);
+    appendBytes(node.mFingerprint);
+}
+
+void NodeExporter::appendJsonString(const char *value)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    mBuffer += '"';
+    const char *run = value; // chars not needing escaping are appended at once
+    for (const char *c = value; *c; ++c)
+    {
+        const unsigned char uc = static_cast<unsigned char>(*c);
+        if (uc >= 0x20 && uc != '"' && uc != '\\')
+        {
+            continue;
+        }
+
+        mBuffer.append(run, static_cast<size_t>(c - run));
+        run = c + 1;
+        switch (uc)
+        {
+            case '"':  mBuffer += "\\\""; break;
+            case '\\': mBuffer += "\\\\"; break;
+            case '\n': mBuffer += "\\n"; break;
+            case '\r': mBuffer += "\\r"; break;
+            case '\t': mBuffer += "\\t"; break;
+            default:
+                mBuffer += "\\u00";
+                mBuffer += hex[uc >> 4];
+                mBuffer += hex[uc & 15];
+        }
+    }
+    mBuffer += run;
+    mBuffer += '"';
+}
+
+void NodeExporter::appendInteger(int64_t value)
+{
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    mBuffer.append(digits, static_cast<size_t>(result.ptr - digits));
+}
+
+void NodeExporter::appendVarint(uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        mBuffer += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    mBuffer += static_cast<char>(value);
+}
+
+void NodeExporter::appendBytes(const char *value)
+{
+    const size_t size = value ? std::strlen(value) : 0;
+    appendVarint(size);
+    mBuffer.append(value ? value : "", size);
+}
+
+void NodeExporter::appendHandleBytes(uint64_t handle)
+{
+    for (int i = 0; i < sHandleSize; ++i)
+    {
+        mBuffer += static_cast<char>((handle >> (8 * i)) & 0xFF);
+    }
+}
+
+}
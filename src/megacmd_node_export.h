@@ -0,0 +1,110 @@
+/**
+ * @file src/megacmd_node_export.h
+ * @brief MEGAcmd: Machine-readable export of nodes
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+
+namespace megacmd {
+
+enum class NodeExportFormat
+{
+    NDJSON, ///< One JSON object per line
+    BINARY, ///< Compact records (see NodeExporter)
+};
+
+// "ndjson" or "binary"
+std::optional<NodeExportFormat> parseNodeExportFormat(const std::string &format);
+
+enum class ExportedNodeType : uint8_t
+{
+    FILE = 0,
+    FOLDER = 1,
+    ROOT = 2,
+    VAULT = 3,
+    RUBBISH = 4,
+    UNKNOWN = 255,
+};
+
+// What is exported of a node (only valid while being written)
+struct ExportedNode
+{
+    uint64_t mHandle = 0;
+    std::optional<uint64_t> mParentHandle;
+    const char *mName = nullptr;
+    ExportedNodeType mType = ExportedNodeType::UNKNOWN;
+    int64_t mSize = 0;
+    int64_t mTime = 0;
+    const char *mFingerprint = nullptr;
+    int64_t mNumVersions = 0;
+};
+
+/**
+ * @brief Writes nodes as they are found, into a buffer handed to the sink whenever it fills up (and when flushed).
+ *
+ * Fields are appended straight to the buffer, without formatting strings for each of them.
+ *
+ * NDJSON: one object per node and line, e.g:
+ *   {"handle":"AbCdEfGh","parent":"XyZ01234","name":"a.txt","type":"file","size":10,"mtime":1700000000,"fingerprint":"...","versions":1}
+ * Handles are in base64, as shown by MEGAcmd. parent and fingerprint are null when missing.
+ *
+ * BINARY: the magic "MCNX" and a version byte (1), then one record per node:
+ *   type (1 byte), handle and parent (6 bytes each, little endian; the parent all 0xFF when missing),
+ *   size, mtime and versions (LEB128 varints, the mtime zigzag-encoded),
+ *   name and fingerprint (varint length followed by the bytes).
+ */
+class NodeExporter final
+{
+public:
+    using Sink = std::function<void(const char *data, size_t size)>;
+
+    NodeExporter(NodeExportFormat format, Sink sink, size_t bufferSize = 64 * 1024);
+    ~NodeExporter(); // flushes
+
+    NodeExporter(const NodeExporter&) = delete;
+    NodeExporter& operator=(const NodeExporter&) = delete;
+
+    void write(const ExportedNode &node);
+    void flush();
+
+    uint64_t getNumNodes() const { return mNumNodes; }
+
+    // Appends the 8 base64 characters of a node handle
+    static void appendHandle(std::string &out, uint64_t handle);
+
+private:
+    void writeJson(const ExportedNode &node);
+    void writeBinary(const ExportedNode &node);
+
+    void appendJsonString(const char *value);
+    void appendInteger(int64_t value);
+    void appendVarint(uint64_t value);
+    void appendBytes(const char *value);
+    void appendHandleBytes(uint64_t handle);
+
+    NodeExportFormat mFormat;
+    Sink mSink;
+    size_t mBufferSize;
+    std::string mBuffer;
+    uint64_t mNumNodes = 0;
+};
+
+}
@@ -0,0 +1,180 @@
+/**
+ * @file src/megacmd_path_cache.cpp
+ * @brief MEGAcmd: Cache of the paths of folders
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "megacmd_path_cache.h"
+
+#include <algorithm>
+
+namespace megacmd {
+
+NodePathCache::NodePathCache(size_t capacity)
+    : mCapacity(std::max<size_t>(capacity, 1))
+{
+}
+
+uint64_t NodePathCache::getGeneration() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mGeneration;
+}
+
+std::optional<std::string> NodePathCache::getPath(Handle folder)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mByHandle.find(folder);
+    if (it == mByHandle.end() || !it->second->mPath)
+    {
+        ++mMisses;
+        return std::nullopt;
+    }
+
+    ++mHits;
+    mEntries.splice(mEntries.begin(), mEntries, it->second);
+    return it->second->mPath;
+}
+
+void NodePathCache::putPath(Handle folder, const std::string &path, uint64_t generation)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (generation != mGeneration)
+    {
+        return;
+    }
+
+    touchLocked(folder)->mPath = path;
+    evictIfNeededLocked();
+}
+
+std::optional<NodePathCache::Handle> NodePathCache::getChild(Handle parent, const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mByChildKey.find(ChildKey{parent, name});
+    if (it == mByChildKey.end())
+    {
+        ++mMisses;
+        return std::nullopt;
+    }
+
+    ++mHits;
+    mEntries.splice(mEntries.begin(), mEntries, it->second);
+    return it->second->mHandle;
+}
+
+void NodePathCache::putChild(Handle parent, const std::string &name, Handle folder, uint64_t generation)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (generation != mGeneration)
+    {
+        return;
+    }
+
+    auto entry = touchLocked(folder);
+    if (entry->mParent && *entry->mParent == parent && entry->mName == name)
+    {
+        return;
+    }
+
+    unindexChildLocked(*entry);
+    auto existing = mByChildKey.find(ChildKey{parent, name});
+    if (existing != mByChildKey.end()) // a duplicate name: the latest resolution prevails
+    {
+        unindexChildLocked(*existing->second);
+    }
+
+    entry->mParent = parent;
+    entry->mName = name;
+    mByChildKey.emplace(ChildKey{parent, entry->mName}, entry);
+    evictIfNeededLocked();
+}
+
+void NodePathCache::forgetChild(Handle parent, const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    ++mGeneration;
+    auto it = mByChildKey.find(ChildKey{parent, name});
+    if (it != mByChildKey.end())
+    {
+        unindexChildLocked(*it->second);
+    }
+}
+
+void NodePathCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    ++mGeneration;
+    mByChildKey.clear();
+    mByHandle.clear();
+    mEntries.clear();
+}
+
+NodePathCache::Stats NodePathCache::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    Stats stats;
+    stats.mNumEntries = mEntries.size();
+    stats.mCapacity = mCapacity;
+    stats.mHits = mHits;
+    stats.mMisses = mMisses;
+    return stats;
+}
+
+std::string NodePathCache::join(const std::string &parentPath, const std::string &name)
+{
+    if (!parentPath.empty() && parentPath.back() == '/') // the root
+    {
+        return parentPath + name;
+    }
+    return parentPath + '/' + name;
+}
+
+NodePathCache::Entries::iterator NodePathCache::touchLocked(Handle folder)
+{
+    auto it = mByHandle.find(folder);
+    if (it != mByHandle.end())
+    {
+        mEntries.splice(mEntries.begin(), mEntries, it->second);
+        return it->second;
+    }
+
+    mEntries.push_front(Entry{folder, std::nullopt, std::nullopt, std::string()});
+    mByHandle.emplace(folder, mEntries.begin());
+    return mEntries.begin();
+}
+
+void NodePathCache::unindexChildLocked(Entry &entry)
+{
+    if (entry.mParent)
+    {
+        mByChildKey.erase(ChildKey{*entry.mParent, entry.mName});
+        entry.mParent.reset();
+        entry.mName.clear();
+    }
+}
+
+void NodePathCache::evictIfNeededLocked()
+{
+    while (mEntries.size() > mCapacity)
+    {
+        Entry &last = mEntries.back();
+        unindexChildLocked(last);
+        mByHandle.erase(last.mHandle);
+        mEntries.pop_back();
+    }
+}
+
+}
@@ -0,0 +1,118 @@
+/**
+ * @file src/megacmd_path_cache.h
+ * @brief MEGAcmd: Cache of the paths of folders
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace megacmd {
+
+/**
+ * @brief Least recently used folders, with their paths and/or the (parent, name) they were resolved by.
+ *
+ * The path of a node is the one of its parent joined with its name: only folders need to be kept,
+ * and all the files within a folder share its path.
+ *
+ * A renamed, moved or removed folder changes the paths of everything below it: the cache is expected to be cleared then.
+ * Values got before clearing are discarded when put afterwards: generations are to be taken before reading them.
+ * Thread safe.
+ */
+class NodePathCache final
+{
+public:
+    using Handle = uint64_t;
+
+    struct Stats
+    {
+        size_t mNumEntries = 0;
+        size_t mCapacity = 0;
+        uint64_t mHits = 0;
+        uint64_t mMisses = 0;
+    };
+
+    explicit NodePathCache(size_t capacity);
+
+    NodePathCache(const NodePathCache&) = delete;
+    NodePathCache& operator=(const NodePathCache&) = delete;
+
+    uint64_t getGeneration() const;
+
+    std::optional<std::string> getPath(Handle folder);
+    void putPath(Handle folder, const std::string &path, uint64_t generation);
+
+    std::optional<Handle> getChild(Handle parent, const std::string &name);
+    void putChild(Handle parent, const std::string &name, Handle folder, uint64_t generation);
+    // Another node with that name appeared: it may be the one to be resolved by it now
+    void forgetChild(Handle parent, const std::string &name);
+
+    void clear();
+
+    Stats getStats() const;
+
+    static std::string join(const std::string &parentPath, const std::string &name);
+
+private:
+    struct ChildKey
+    {
+        Handle mParent;
+        std::string_view mName; // owned by the entry
+
+        bool operator==(const ChildKey &other) const { return mParent == other.mParent && mName == other.mName; }
+    };
+
+    struct ChildKeyHash
+    {
+        size_t operator()(const ChildKey &key) const
+        {
+            return std::hash<Handle>()(key.mParent) ^ (std::hash<std::string_view>()(key.mName) * 31);
+        }
+    };
+
+    struct Entry
+    {
+        Handle mHandle;
+        std::optional<std::string> mPath;
+        std::optional<Handle> mParent; // along with mName, if resolved by name
+        std::string mName;
+    };
+
+    using Entries = std::list<Entry>;
+
+    // Finds or creates the entry, making it the most recently used one
+    Entries::iterator touchLocked(Handle folder);
+    void unindexChildLocked(Entry &entry);
+    void evictIfNeededLocked();
+
+    const size_t mCapacity;
+
+    mutable std::mutex mMutex;
+    uint64_t mGeneration = 0;
+    Entries mEntries; // most recently used first
+    std::unordered_map<Handle, Entries::iterator> mByHandle;
+    std::unordered_map<ChildKey, Entries::iterator, ChildKeyHash> mByChildKey;
+    uint64_t mHits = 0;
+    uint64_t mMisses = 0;
+};
+
+}
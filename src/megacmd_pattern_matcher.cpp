@@ -0,0 +1,402 @@
+/**
+ * @file src/megacmd_pattern_matcher.cpp
+ * @brief MEGAcmd: Compiled patterns to match node names against
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "megacmd_pattern_matcher.h"
+
+#include "megacmdlogger.h"
+#include "megacmdutils.h"
+
+#ifdef USE_PCRE
+#include <pcre.h>
+#elif __cplusplus >= 201103L && !defined(__MINGW32__)
+#include <regex>
+#endif
+
+namespace megacmd {
+
+struct PatternMatcher::CompiledRegex
+{
+#ifdef USE_PCRE
+    pcre *mCode = nullptr;
+    pcre_extra *mExtra = nullptr;
+
+    ~CompiledRegex()
+    {
+        if (mExtra)
+        {
+#ifdef PCRE_STUDY_JIT_COMPILE
+            pcre_free_study(mExtra);
+#else
+            pcre_free(mExtra);
+#endif
+        }
+        if (mCode)
+        {
+            pcre_free(mCode);
+        }
+    }
+#elif __cplusplus >= 201103L && !defined(__MINGW32__)
+    std::regex mRegex;
+#endif
+};
+
+namespace {
+
+bool hasRegexSpecialChars(const std::string &s)
+{
+    return s.find_first_of("\\^$.|?*+()[]{}") != std::string::npos;
+}
+
+bool startsWith(const char *what, size_t size, const std::string &prefix)
+{
+    return size >= prefix.size() && !memcmp(what, prefix.data(), prefix.size());
+}
+
+bool endsWith(const char *what, size_t size, const std::string &suffix)
+{
+    return size >= suffix.size() && !memcmp(what + size - suffix.size(), suffix.data(), suffix.size());
+}
+
+}
+
+GlobPattern::Run::Run(std::string text)
+    : mText(std::move(text))
+    , mAnchor(mText.find_first_not_of('?'))
+    , mHasAnyChar(mText.find('?') != std::string::npos)
+{
+}
+
+bool GlobPattern::Run::matchesAt(const char *what) const
+{
+    if (!mHasAnyChar)
+    {
+        return !memcmp(what, mText.data(), mText.size());
+    }
+
+    for (size_t i = 0; i < mText.size(); ++i)
+    {
+        if (mText[i] != '?' && mText[i] != what[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t GlobPattern::Run::find(const char *what, size_t from, size_t to) const
+{
+    if (to - from < mText.size())
+    {
+        return std::string::npos;
+    }
+
+    const size_t last = to - mText.size(); // last position where the run fits
+    if (mAnchor == std::string::npos)
+    {
+        return from; // only '?': fits anywhere
+    }
+
+    const char anchorChar = mText[mAnchor];
+    size_t pos = from;
+    while (pos <= last)
+    {
+        auto found = static_cast<const char*>(memchr(what + pos + mAnchor, anchorChar, last - pos + 1));
+        if (!found)
+        {
+            return std::string::npos;
+        }
+
+        pos = static_cast<size_t>(found - what) - mAnchor;
+        if (matchesAt(what + pos))
+        {
+            return pos;
+        }
+        ++pos;
+    }
+    return std::string::npos;
+}
+
+GlobPattern::GlobPattern(const std::string &pattern)
+{
+    // Consecutive stars are equivalent to a single one: the runs between them are empty and dropped,
+    // except for the first and last runs, that are anchored to the ends of the name
+    size_t start = 0;
+    for (;;)
+    {
+        size_t star = pattern.find('*', start);
+        std::string text = pattern.substr(start, star == std::string::npos ? std::string::npos : star - start);
+        if (!text.empty() || mRuns.empty() || star == std::string::npos)
+        {
+            mRuns.emplace_back(std::move(text));
+            mMinSize += mRuns.back().mText.size();
+        }
+        if (star == std::string::npos)
+        {
+            break;
+        }
+        mHasStars = true;
+        start = star + 1;
+    }
+}
+
+bool GlobPattern::matches(const char *what, size_t size) const
+{
+    if (!mHasStars)
+    {
+        return size == mMinSize && mRuns.front().matchesAt(what);
+    }
+
+    if (size < mMinSize)
+    {
+        return false;
+    }
+
+    const Run &head = mRuns.front();
+    const Run &tail = mRuns.back();
+    if (!head.matchesAt(what) || !tail.matchesAt(what + size - tail.mText.size()))
+    {
+        return false;
+    }
+
+    // Leftmost occurrences leave as much room as possible for the following runs
+    size_t pos = head.mText.size();
+    const size_t end = size - tail.mText.size();
+    for (size_t i = 1; i + 1 < mRuns.size(); ++i)
+    {
+        pos = mRuns[i].find(what, pos, end);
+        if (pos == std::string::npos)
+        {
+            return false;
+        }
+        pos += mRuns[i].mText.size();
+    }
+    return true;
+}
+
+PatternMatcher::PatternMatcher(const std::string &pattern, bool usepcre)
+    : mPattern(pattern)
+{
+    if (!usepcre)
+    {
+        compileGlob();
+        return;
+    }
+
+    std::string error;
+    if (compileRegex(pattern, error))
+    {
+        return;
+    }
+
+#ifdef USE_PCRE
+    //In case the user supplied non-pcre regexp with * or ? in it.
+    std::string newpattern(pattern);
+    replaceAll(newpattern, "*", ".*");
+    replaceAll(newpattern, "?", ".");
+    if (compileRegex(newpattern, error))
+    {
+        return;
+    }
+#endif
+
+    LOG_warn << error;
+    mBackend = Backend::INVALID;
+}
+
+void PatternMatcher::compileGlob()
+{
+    auto firstWildcard = mPattern.find_first_of("*?");
+    if (firstWildcard == std::string::npos)
+    {
+        mBackend = Backend::LITERAL;
+        mLiteral = mPattern;
+    }
+    else if (mPattern.find('?') != std::string::npos || mPattern.find('*', firstWildcard + 1) != std::string::npos)
+    {
+        mBackend = Backend::GLOB;
+        mGlob = std::make_shared<GlobPattern>(mPattern);
+    }
+    else if (firstWildcard == mPattern.size() - 1)
+    {
+        mBackend = Backend::PREFIX;
+        mLiteral = mPattern.substr(0, firstWildcard);
+    }
+    else if (firstWildcard == 0)
+    {
+        mBackend = Backend::SUFFIX;
+        mLiteral = mPattern.substr(1);
+    }
+    else
+    {
+        mBackend = Backend::GLOB;
+        mGlob = std::make_shared<GlobPattern>(mPattern);
+    }
+}
+
+bool PatternMatcher::compileRegex(const std::string &regex, std::string &error)
+{
+    if (!hasRegexSpecialChars(regex))
+    {
+        mBackend = Backend::LITERAL;
+        mLiteral = regex;
+        return true;
+    }
+
+#ifdef USE_PCRE
+    // ".*" matches anything but new lines (std::regex excludes more line terminators: no shortcut there)
+    if (regex.size() >= 2 && !hasRegexSpecialChars(regex.substr(0, regex.size() - 2)) && !regex.compare(regex.size() - 2, 2, ".*"))
+    {
+        mBackend = Backend::PREFIX;
+        mLiteral = regex.substr(0, regex.size() - 2);
+        mWildcardExcludesNewLines = true;
+        return true;
+    }
+    if (regex.size() >= 2 && !hasRegexSpecialChars(regex.substr(2)) && !regex.compare(0, 2, ".*"))
+    {
+        mBackend = Backend::SUFFIX;
+        mLiteral = regex.substr(2);
+        mWildcardExcludesNewLines = true;
+        return true;
+    }
+
+    // Anchored at both ends (as pcrecpp::RE::FullMatch does), so that JIT can be used
+    std::string anchored = "(?:" + regex + ")\\z";
+    const char *pcreError = nullptr;
+    int errorOffset = 0;
+    auto compiled = std::make_shared<CompiledRegex>();
+    compiled->mCode = pcre_compile(anchored.c_str(), PCRE_ANCHORED, &pcreError, &errorOffset, nullptr);
+    if (!compiled->mCode)
+    {
+        error = std::string("Invalid PCRE regex: ") + (pcreError ? pcreError : regex.c_str());
+        return false;
+    }
+
+    // Studying is an optimization: matching works without it should it fail
+#ifdef PCRE_STUDY_JIT_COMPILE
+    compiled->mExtra = pcre_study(compiled->mCode, PCRE_STUDY_JIT_COMPILE, &pcreError);
+#else
+    compiled->mExtra = pcre_study(compiled->mCode, 0, &pcreError);
+#endif
+    mBackend = Backend::REGEX;
+    mRegex = std::move(compiled);
+    return true;
+#elif __cplusplus >= 201103L && !defined(__MINGW32__)
+    try
+    {
+        auto compiled = std::make_shared<CompiledRegex>();
+        compiled->mRegex = std::regex(regex);
+        mBackend = Backend::REGEX;
+        mRegex = std::move(compiled);
+        return true;
+    }
+    catch (const std::regex_error&)
+    {
+        error = "Couldn't compile regex: " + regex;
+        return false;
+    }
+#else
+    error = " PCRE not supported";
+    return false;
+#endif
+}
+
+bool PatternMatcher::matches(const char *what, size_t size) const
+{
+    switch (mBackend)
+    {
+        case Backend::LITERAL:
+            return size == mLiteral.size() && !memcmp(what, mLiteral.data(), size);
+
+        case Backend::PREFIX:
+            return startsWith(what, size, mLiteral)
+                    && (!mWildcardExcludesNewLines || !memchr(what + mLiteral.size(), '\n', size - mLiteral.size()));
+
+        case Backend::SUFFIX:
+            return endsWith(what, size, mLiteral)
+                    && (!mWildcardExcludesNewLines || !memchr(what, '\n', size - mLiteral.size()));
+
+        case Backend::GLOB:
+            return mGlob->matches(what, size);
+
+        case Backend::REGEX:
+#ifdef USE_PCRE
+            return pcre_exec(mRegex->mCode, mRegex->mExtra, what, static_cast<int>(size), 0, 0, nullptr, 0) >= 0;
+#elif __cplusplus >= 201103L && !defined(__MINGW32__)
+            return std::regex_match(what, what + size, mRegex->mRegex);
+#else
+            return false;
+#endif
+
+        case Backend::INVALID:
+            return false;
+    }
+    return false;
+}
+
+std::vector<std::string> PatternMatcher::getRequiredSubstrings() const
+{
+    std::vector<std::string> substrings;
+    switch (mBackend)
+    {
+        case Backend::LITERAL:
+        case Backend::PREFIX:
+        case Backend::SUFFIX:
+            substrings.push_back(mLiteral);
+            break;
+
+        case Backend::GLOB:
+        {
+            size_t start = 0;
+            while (start < mPattern.size())
+            {
+                size_t wildcard = mPattern.find_first_of("*?", start);
+                if (wildcard == std::string::npos)
+                {
+                    wildcard = mPattern.size();
+                }
+                if (wildcard > start)
+                {
+                    substrings.push_back(mPattern.substr(start, wildcard - start));
+                }
+                start = wildcard + 1;
+            }
+            break;
+        }
+
+        case Backend::REGEX:
+        case Backend::INVALID:
+            break;
+    }
+    return substrings;
+}
+
+const char* PatternMatcher::getBackendName(Backend backend)
+{
+    switch (backend)
+    {
+        case Backend::LITERAL: return "literal";
+        case Backend::PREFIX:  return "prefix";
+        case Backend::SUFFIX:  return "suffix";
+        case Backend::GLOB:    return "glob";
+        case Backend::REGEX:   return "regex";
+        case Backend::INVALID: return "invalid";
+    }
+    return "unknown";
+}
+
+}
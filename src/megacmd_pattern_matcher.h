@@ -0,0 +1,162 @@
+/**
+ * @file src/megacmd_pattern_matcher.h
+ * @brief MEGAcmd: Compiled patterns to match node names against
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace megacmd {
+
+/**
+ * @brief A '*' and '?' wildcard pattern, compiled into a plan of literal runs separated by stars.
+ *
+ * The runs before the first star and after the last one are tested at both ends of the name,
+ * and those in between are searched for left to right (leftmost occurrence, with memchr on one of their chars).
+ * Matching takes at most one pass per run over the name: there is no backtracking.
+ * '?' matches any single char (byte).
+ */
+class GlobPattern final
+{
+public:
+    explicit GlobPattern(const std::string &pattern);
+
+    bool matches(const char *what) const
+    {
+        return what && matches(what, std::strlen(what));
+    }
+
+    bool matches(const std::string &what) const
+    {
+        return matches(what.c_str(), what.size());
+    }
+
+    bool matches(const char *what, size_t size) const;
+
+private:
+    struct Run
+    {
+        std::string mText;
+        // First char that is not '?' (npos if none), to look for the run with memchr
+        size_t mAnchor = std::string::npos;
+        bool mHasAnyChar = false;
+
+        explicit Run(std::string text);
+
+        bool matchesAt(const char *what) const;
+        // Position of the leftmost occurrence within [from, to), or npos
+        size_t find(const char *what, size_t from, size_t to) const;
+    };
+
+    std::vector<Run> mRuns;
+    bool mHasStars = false;
+    size_t mMinSize = 0;
+};
+
+/**
+ * @brief A wildcard ('*' and '?') or regular expression pattern, compiled once to be matched against many names.
+ *
+ * The cheapest backend able to evaluate the pattern is chosen on construction:
+ * patterns without special characters are compared literally, "abc*" and "*abc" (or "abc.*" and ".*abc"
+ * as regular expressions) are tested as a prefix or suffix, and the rest are matched as globs
+ * or through a GlobPattern or a regular expression compiled once (JIT-compiled PCRE when available).
+ *
+ * Matching the same names, it behaves like patternMatches. Matching is thread-safe.
+ */
+class PatternMatcher final
+{
+public:
+    enum class Backend
+    {
+        LITERAL,
+        PREFIX,
+        SUFFIX,
+        GLOB,
+        REGEX,
+        INVALID, ///< The regular expression could not be compiled: nothing matches
+    };
+
+    PatternMatcher(const std::string &pattern, bool usepcre);
+
+    bool matches(const char *what) const
+    {
+        return what && matches(what, std::strlen(what));
+    }
+
+    bool matches(const std::string &what) const
+    {
+        return matches(what.c_str(), what.size());
+    }
+
+    bool isValid() const { return mBackend != Backend::INVALID; }
+    Backend getBackend() const { return mBackend; }
+
+    // Whether any name matches (e.g: "*"), so that the pattern need not be checked
+    bool matchesAnyName() const { return mBackend == Backend::PREFIX && mLiteral.empty() && !mWildcardExcludesNewLines; }
+
+    // Substrings every matching name contains (none known for regular expressions other than literals and prefix/suffix)
+    std::vector<std::string> getRequiredSubstrings() const;
+    const std::string& getPattern() const { return mPattern; }
+
+    static const char* getBackendName(Backend backend);
+
+private:
+    struct CompiledRegex;
+
+    bool matches(const char *what, size_t size) const;
+
+    void compileGlob();
+    bool compileRegex(const std::string &regex, std::string &error);
+
+    std::string mPattern;
+    Backend mBackend = Backend::INVALID;
+
+    // LITERAL, PREFIX and SUFFIX: the literal part of the pattern
+    std::string mLiteral;
+    // PREFIX and SUFFIX from regular expressions: ".*" does not match new lines
+    bool mWildcardExcludesNewLines = false;
+
+    std::shared_ptr<const GlobPattern> mGlob;
+    std::shared_ptr<const CompiledRegex> mRegex;
+};
+
+/**
+ * @brief Compiles each distinct pattern once, to match the parts of path patterns
+ * while resolving them. Not thread-safe: meant to live along a single command.
+ */
+class PatternMatcherCache final
+{
+public:
+    explicit PatternMatcherCache(bool usepcre) : mUsePcre(usepcre) {}
+
+    const PatternMatcher& get(const std::string &pattern)
+    {
+        return mMatchers.try_emplace(pattern, pattern, mUsePcre).first->second;
+    }
+
+    bool usesPcre() const { return mUsePcre; }
+
+private:
+    bool mUsePcre;
+    std::map<std::string, PatternMatcher> mMatchers;
+};
+
+}
@@ -0,0 +1,228 @@
+/**
+ * @file src/megacmd_petition_scheduler.cpp
+ * @brief MEGAcmd: Scheduling of petitions by class
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "megacmd_petition_scheduler.h"
+
+#include <algorithm>
+
+namespace megacmd {
+
+namespace {
+
+constexpr std::string_view sTransferCommands[] = {
+    "get", "put", "cat", "import", "mediainfo", "preview", "thumbnail",
+};
+
+constexpr std::string_view sTraversalCommands[] = {
+    "find", "du", "tree", "cp", "mv", "rm", "deleteversions",
+};
+
+template <size_t N>
+bool contains(const std::string_view (&commands)[N], std::string_view command)
+{
+    return std::find(std::begin(commands), std::end(commands), command) != std::end(commands);
+}
+
+// Splits the next whitespace separated word (quoting is irrelevant for classification)
+std::string_view nextWord(std::string_view &line)
+{
+    auto begin = line.find_first_not_of(" \t");
+    if (begin == std::string_view::npos)
+    {
+        line = {};
+        return {};
+    }
+    auto end = line.find_first_of(" \t", begin);
+    auto word = line.substr(begin, end == std::string_view::npos ? std::string_view::npos : end - begin);
+    line = end == std::string_view::npos ? std::string_view() : line.substr(end);
+    return word;
+}
+
+bool isRecursiveLsFlag(std::string_view word)
+{
+    if (word == "--tree")
+    {
+        return true;
+    }
+    // short flags can be combined, e.g: -lR
+    return word.size() > 1 && word[0] == '-' && word[1] != '-'
+            && word.find_first_of("Rr") != std::string_view::npos;
+}
+
+}
+
+const char* getPetitionClassName(PetitionClass petitionClass)
+{
+    switch (petitionClass)
+    {
+        case PetitionClass::INTERACTIVE: return "interactive";
+        case PetitionClass::TRAVERSAL: return "traversal";
+        case PetitionClass::TRANSFER: return "transfer";
+        default: return "unknown";
+    }
+}
+
+PetitionScheduler::PetitionScheduler(const Limits &limits)
+    : mDeferred(std::make_shared<Deferred>())
+{
+    for (size_t i = 0; i < mPools.size(); ++i)
+    {
+        mPools[i] = std::make_unique<WorkerPool>(limits[i].mMaxWorkers, limits[i].mMaxQueueDepth);
+    }
+}
+
+PetitionScheduler::~PetitionScheduler()
+{
+    stop();
+}
+
+PetitionClass PetitionScheduler::classify(std::string_view line)
+{
+    auto command = nextWord(line);
+    if (contains(sTransferCommands, command))
+    {
+        return PetitionClass::TRANSFER;
+    }
+    if (contains(sTraversalCommands, command))
+    {
+        return PetitionClass::TRAVERSAL;
+    }
+    if (command == "ls")
+    {
+        for (auto word = nextWord(line); !word.empty(); word = nextWord(line))
+        {
+            if (isRecursiveLsFlag(word))
+            {
+                return PetitionClass::TRAVERSAL;
+            }
+        }
+    }
+    return PetitionClass::INTERACTIVE;
+}
+
+WorkerPool::Task PetitionScheduler::wrap(PetitionClass petitionClass, std::shared_ptr<Task> task)
+{
+    const auto classIndex = static_cast<size_t>(petitionClass);
+    return [deferred = mDeferred, pool = mPools[classIndex].get(), classIndex, task, enqueued = std::chrono::steady_clock::now()]()
+    {
+        deferred->admit(pool, classIndex);
+        (*task)(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - enqueued));
+    };
+}
+
+bool PetitionScheduler::trySubmit(PetitionClass petitionClass, Task &&task, CancellationToken token)
+{
+    auto sharedTask = std::make_shared<Task>(std::move(task));
+    if (mPools[static_cast<size_t>(petitionClass)]->trySubmit(wrap(petitionClass, sharedTask), std::move(token)))
+    {
+        return true;
+    }
+
+    task = std::move(*sharedTask); // not admitted: give it back to the caller
+    return false;
+}
+
+bool PetitionScheduler::submit(PetitionClass petitionClass, Task &&task, CancellationToken token)
+{
+    return mPools[static_cast<size_t>(petitionClass)]->submit(wrap(petitionClass, std::make_shared<Task>(std::move(task))), std::move(token));
+}
+
+bool PetitionScheduler::submitOrDefer(PetitionClass petitionClass, Task &&task, CancellationToken token)
+{
+    const auto classIndex = static_cast<size_t>(petitionClass);
+    auto wrapped = wrap(petitionClass, std::make_shared<Task>(std::move(task)));
+
+    std::lock_guard<std::mutex> g(mDeferred->mMutex);
+    if (mDeferred->mStopped)
+    {
+        return false;
+    }
+
+    // Not ahead of the ones deferred already. With any deferred, the queue is full: there are queued tasks to admit them
+    auto &deferredTasks = mDeferred->mTasks[classIndex];
+    if (deferredTasks.empty() && mPools[classIndex]->trySubmit(std::move(wrapped), token))
+    {
+        return true;
+    }
+    deferredTasks.emplace_back(std::move(wrapped), std::move(token));
+    return true;
+}
+
+void PetitionScheduler::Deferred::admit(WorkerPool *pool, size_t classIndex)
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    auto &tasks = mTasks[classIndex];
+    while (!mStopped && !tasks.empty() && pool->trySubmit(std::move(tasks.front().first), tasks.front().second))
+    {
+        tasks.pop_front();
+    }
+}
+
+size_t PetitionScheduler::stop(std::chrono::milliseconds maxWaitTime)
+{
+    decltype(mDeferred->mTasks) discarded;
+    {
+        std::lock_guard<std::mutex> g(mDeferred->mMutex);
+        mDeferred->mStopped = true;
+        discarded.swap(mDeferred->mTasks);
+    }
+    discarded = {}; // outside the lock: tasks may own resources with non trivial destruction
+
+    // Cancel the tasks of every class before waiting for any
+    for (auto &pool : mPools)
+    {
+        pool->requestStop();
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + maxWaitTime;
+    size_t numRunning = 0;
+    for (auto &pool : mPools)
+    {
+        auto timeLeft = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        numRunning += pool->stop(std::max(timeLeft, std::chrono::milliseconds(0)));
+    }
+    return numRunning;
+}
+
+size_t PetitionScheduler::getNumOngoingTasks() const
+{
+    size_t total = 0;
+    for (size_t i = 0; i < sNumClasses; ++i)
+    {
+        total += getNumOngoingTasks(static_cast<PetitionClass>(i));
+    }
+    return total;
+}
+
+size_t PetitionScheduler::getNumOngoingTasks(PetitionClass petitionClass) const
+{
+    return mPools[static_cast<size_t>(petitionClass)]->getNumOngoingTasks() + getNumDeferredTasks(petitionClass);
+}
+
+size_t PetitionScheduler::getNumDeferredTasks(PetitionClass petitionClass) const
+{
+    std::lock_guard<std::mutex> g(mDeferred->mMutex);
+    return mDeferred->mTasks[static_cast<size_t>(petitionClass)].size();
+}
+
+const WorkerPool& PetitionScheduler::getPool(PetitionClass petitionClass) const
+{
+    return *mPools[static_cast<size_t>(petitionClass)];
+}
+
+}
@@ -0,0 +1,130 @@
+/**
+ * @file src/megacmd_petition_scheduler.h
+ * @brief MEGAcmd: Scheduling of petitions by class
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <utility>
+
+#include "megacmd_worker_pool.h"
+
+namespace megacmd {
+
+enum class PetitionClass
+{
+    INTERACTIVE = 0,  ///< Metadata and quick commands (pwd, transfers, sync, whoami, ...)
+    TRAVERSAL,        ///< Commands that may walk whole trees (find, du, tree, ls -R, rm, cp, ...)
+    TRANSFER,         ///< Commands that initiate transfers or stream contents (get, put, cat, ...)
+    NUM_CLASSES
+};
+
+const char* getPetitionClassName(PetitionClass petitionClass);
+
+/**
+ * @brief Runs petitions in a separate worker pool per class.
+ *
+ * Each class has its own concurrency budget and queue, so that a burst of heavy
+ * petitions (e.g: many get or find) cannot delay quick ones (e.g: pwd or transfers).
+ * Petitions are admitted only if there is room in the queue of their class. Otherwise they can be deferred:
+ * kept aside (in order) and admitted as soon as workers of their class pick up the queued ones.
+ */
+class PetitionScheduler final
+{
+public:
+    // Receives the time the petition waited in the queue before being started
+    using Task = std::function<void(std::chrono::milliseconds queueWaitTime)>;
+
+    struct ClassLimits
+    {
+        size_t mMaxWorkers;
+        size_t mMaxQueueDepth;
+    };
+    using Limits = std::array<ClassLimits, static_cast<size_t>(PetitionClass::NUM_CLASSES)>;
+
+    explicit PetitionScheduler(const Limits &limits);
+    ~PetitionScheduler();
+
+    PetitionScheduler(const PetitionScheduler&) = delete;
+    PetitionScheduler& operator=(const PetitionScheduler&) = delete;
+
+    // Classifies a petition by its (uniform) command line
+    static PetitionClass classify(std::string_view line);
+
+    /**
+     * @brief Enqueues the task in the queue of its class, without blocking.
+     * The token is cancelled if the scheduler is stopped while the task runs
+     * @returns false if that queue is full or the scheduler has been stopped (the task is left untouched)
+     */
+    bool trySubmit(PetitionClass petitionClass, Task &&task, CancellationToken token = CancellationToken());
+
+    /**
+     * @brief Enqueues the task in the queue of its class, blocking while it is full
+     * @returns false if the scheduler has been stopped
+     */
+    bool submit(PetitionClass petitionClass, Task &&task, CancellationToken token = CancellationToken());
+
+    /**
+     * @brief Enqueues the task in the queue of its class or, if full (or others are deferred already), defers it,
+     * without blocking. The time it waited includes the one deferred
+     * @returns false if the scheduler has been stopped
+     */
+    bool submitOrDefer(PetitionClass petitionClass, Task &&task, CancellationToken token = CancellationToken());
+
+    /**
+     * @brief Stops every pool (see WorkerPool::stop), waiting up to maxWaitTime in total. Discards the deferred tasks too
+     * @returns the number of tasks still running then
+     */
+    size_t stop(std::chrono::milliseconds maxWaitTime = WorkerPool::sDefaultStopWaitTime);
+
+    // Including the deferred ones
+    size_t getNumOngoingTasks() const;
+    size_t getNumOngoingTasks(PetitionClass petitionClass) const;
+
+    size_t getNumDeferredTasks(PetitionClass petitionClass) const;
+
+    const WorkerPool& getPool(PetitionClass petitionClass) const;
+
+private:
+    static constexpr size_t sNumClasses = static_cast<size_t>(PetitionClass::NUM_CLASSES);
+
+    // Shared with the wrappers, so that workers detached by stop never outlive it
+    struct Deferred
+    {
+        std::mutex mMutex; // taken before the pools' own
+        std::array<std::deque<std::pair<WorkerPool::Task, CancellationToken>>, sNumClasses> mTasks;
+        bool mStopped = false; // the pools are not to be used then
+
+        // Moves deferred tasks into the queue of their class, while there is room
+        void admit(WorkerPool *pool, size_t classIndex);
+    };
+
+    // std::function requires copyable callables: tasks are shared with the wrapper that measures the wait.
+    // As it starts, the task makes room for the deferred ones
+    WorkerPool::Task wrap(PetitionClass petitionClass, std::shared_ptr<Task> task);
+
+    std::array<std::unique_ptr<WorkerPool>, sNumClasses> mPools;
+    std::shared_ptr<Deferred> mDeferred;
+};
+
+}
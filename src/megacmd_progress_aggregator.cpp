@@ -0,0 +1,129 @@
+/**
+ * @file src/megacmd_progress_aggregator.cpp
+ * @brief MEGAcmd: Rate limiting of the progress updates sent to clients
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "megacmd_progress_aggregator.h"
+
+namespace megacmd {
+
+ProgressAggregator::ProgressAggregator(std::chrono::milliseconds interval, Sender sender)
+    : mInterval(interval)
+    , mSender(std::move(sender))
+{
+    mFlusher = std::thread(&ProgressAggregator::flusherLoop, this);
+}
+
+ProgressAggregator::~ProgressAggregator()
+{
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        mStopping = true;
+    }
+    mCV.notify_all();
+    mFlusher.join();
+}
+
+std::string ProgressAggregator::formatMessage(long long transferred, long long total, const std::string &title)
+{
+    std::string s = "progress:";
+    s += std::to_string(transferred);
+    s += ":";
+    s += std::to_string(total);
+
+    if (title.size())
+    {
+        s += ":";
+        s += title;
+    }
+    return s;
+}
+
+void ProgressAggregator::update(long long transferred, long long total, int clientID, const std::string &title)
+{
+    auto message = formatMessage(transferred, total, title);
+    auto now = Clock::now();
+
+    // Messages are sent with the lock held: otherwise a stale update could be sent after a completion
+    std::lock_guard<std::mutex> g(mMutex);
+    if (transferred == sCompleteMark)
+    {
+        mClients.erase(clientID);
+        mSender(clientID, message);
+        return;
+    }
+
+    auto it = mClients.find(clientID);
+    if (it == mClients.end() || now - it->second.mLastSent >= mInterval)
+    {
+        auto &progress = mClients[clientID];
+        progress.mLastSent = now;
+        progress.mPending.reset();
+        mSender(clientID, message);
+        return;
+    }
+
+    bool wasPending = it->second.mPending.has_value();
+    it->second.mPending = std::move(message);
+    if (!wasPending)
+    {
+        mCV.notify_one();
+    }
+}
+
+void ProgressAggregator::flusherLoop()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (!mStopping)
+    {
+        auto now = Clock::now();
+        std::optional<Clock::time_point> nextDeadline;
+        for (auto it = mClients.begin(); it != mClients.end();)
+        {
+            auto &progress = it->second;
+            if (!progress.mPending)
+            {
+                // forget about clients no longer reporting (e.g: cancelled transfers never reach completion)
+                it = now - progress.mLastSent > 100 * mInterval ? mClients.erase(it) : std::next(it);
+                continue;
+            }
+
+            auto deadline = progress.mLastSent + mInterval;
+            if (deadline <= now)
+            {
+                progress.mLastSent = now;
+                mSender(it->first, *progress.mPending);
+                progress.mPending.reset();
+            }
+            else if (!nextDeadline || deadline < *nextDeadline)
+            {
+                nextDeadline = deadline;
+            }
+            ++it;
+        }
+
+        if (nextDeadline)
+        {
+            mCV.wait_until(lock, *nextDeadline);
+        }
+        else
+        {
+            mCV.wait(lock);
+        }
+    }
+}
+
+}
@@ -0,0 +1,77 @@
+/**
+ * @file src/megacmd_progress_aggregator.h
+ * @brief MEGAcmd: Rate limiting of the progress updates sent to clients
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+namespace megacmd {
+
+/**
+ * @brief Samples the progress updates of every client at a fixed rate.
+ *
+ * Updates arriving faster than the interval are merged: only the latest one is kept, and
+ * sent once the interval has elapsed (by a background thread, if no other update comes).
+ * Completion updates (sCompleteMark) are always sent right away, discarding the pending one.
+ */
+class ProgressAggregator
+{
+public:
+    static constexpr long long sCompleteMark = -2; // PROGRESS_COMPLETE
+
+    using Sender = std::function<void(int /*clientID*/, const std::string & /*message*/)>;
+
+    ProgressAggregator(std::chrono::milliseconds interval, Sender sender);
+    ~ProgressAggregator();
+
+    ProgressAggregator(const ProgressAggregator&) = delete;
+    ProgressAggregator& operator=(const ProgressAggregator&) = delete;
+
+    void update(long long transferred, long long total, int clientID, const std::string &title = "");
+
+    static std::string formatMessage(long long transferred, long long total, const std::string &title);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct ClientProgress
+    {
+        Clock::time_point mLastSent;
+        std::optional<std::string> mPending;
+    };
+
+    void flusherLoop();
+
+    const std::chrono::milliseconds mInterval;
+    const Sender mSender;
+
+    std::mutex mMutex;
+    std::condition_variable mCV;
+    std::map<int, ClientProgress> mClients;
+    bool mStopping = false;
+    std::thread mFlusher;
+};
+
+}
@@ -0,0 +1,125 @@
+/**
+ * @file src/megacmd_size_cache.cpp
+ * @brief MEGAcmd: Cache of aggregated sizes of folders
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "megacmd_size_cache.h"
+
+namespace megacmd {
+
+std::optional<FolderSizeCache::Aggregate> FolderSizeCache::get(Handle folder)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    auto it = mAggregates.find(folder);
+    if (it == mAggregates.end())
+    {
+        ++mMisses;
+        return std::nullopt;
+    }
+    ++mHits;
+    return it->second;
+}
+
+uint64_t FolderSizeCache::getGeneration() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mGeneration;
+}
+
+bool FolderSizeCache::store(Handle folder, Handle parent, const Aggregate &aggregate, const std::vector<Handle> &children, uint64_t generation)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (generation != mGeneration)
+    {
+        return false;
+    }
+
+    mAggregates[folder] = aggregate;
+    mParents[folder] = parent;
+    for (Handle child : children)
+    {
+        mParents[child] = folder;
+    }
+    return true;
+}
+
+void FolderSizeCache::onNodeUpdated(Handle node, Handle parent, bool removed)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    ++mGeneration;
+
+    auto it = mParents.find(node);
+    if (it != mParents.end())
+    {
+        invalidateUpwardsLocked(it->second);
+    }
+    invalidateUpwardsLocked(parent);
+
+    if (removed)
+    {
+        // Descendants are notified as removed too
+        mAggregates.erase(node);
+        mParents.erase(node);
+    }
+    else if (it != mParents.end() || mParents.count(parent))
+    {
+        mParents[node] = parent;
+    }
+}
+
+void FolderSizeCache::invalidateUpwardsLocked(Handle from)
+{
+    // Links are updated one notification at a time: when B is moved out of A and then A into B, A may be notified
+    // first, leaving them as each other's parent meanwhile. No walk needs more steps than there are links
+    Handle current = from;
+    for (size_t steps = 0; steps <= mParents.size(); ++steps)
+    {
+        // An aggregate includes the ones of all the folders below: above a folder without one, there are none either.
+        // from may be a file though (with its versions below)
+        if (!mAggregates.erase(current) && steps)
+        {
+            return;
+        }
+
+        auto it = mParents.find(current);
+        if (it == mParents.end())
+        {
+            return;
+        }
+        current = it->second;
+    }
+}
+
+void FolderSizeCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    ++mGeneration;
+    mAggregates = std::unordered_map<Handle, Aggregate>();
+    mParents = std::unordered_map<Handle, Handle>();
+}
+
+FolderSizeCache::Stats FolderSizeCache::getStats() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    Stats stats;
+    stats.mNumAggregates = mAggregates.size();
+    stats.mNumLinks = mParents.size();
+    stats.mHits = mHits;
+    stats.mMisses = mMisses;
+    return stats;
+}
+
+}
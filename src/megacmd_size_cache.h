@@ -0,0 +1,88 @@
+/**
+ * @file src/megacmd_size_cache.h
+ * @brief MEGAcmd: Cache of aggregated sizes of folders
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace megacmd {
+
+/**
+ * @brief Aggregated sizes (with versions) of the trees under folders, computed once and kept until something changes within them.
+ *
+ * Along with each aggregate, the parent links of the children it was computed from are kept.
+ * When a node is added, moved or removed, the aggregates of the folders above both its former and new locations
+ * are discarded (the ones of the folders above a folder without aggregate are already gone).
+ *
+ * Aggregates are computed outside of the cache: store discards those computed while anything was being invalidated.
+ * Thread safe.
+ */
+class FolderSizeCache final
+{
+public:
+    using Handle = uint64_t;
+
+    // Sizes of the files themselves are served by the SDK from its node counters: only versions are aggregated here
+    struct Aggregate
+    {
+        int64_t mVersionBytes = 0; // size of the files, including all their versions
+    };
+
+    struct Stats
+    {
+        size_t mNumAggregates = 0;
+        size_t mNumLinks = 0;
+        uint64_t mHits = 0;
+        uint64_t mMisses = 0;
+    };
+
+    std::optional<Aggregate> get(Handle folder);
+
+    // To be taken before computing an aggregate, and given to store
+    uint64_t getGeneration() const;
+
+    /**
+     * @brief Stores the aggregate of a folder, and the links to its children
+     * (files and folders: the aggregates of the latter are expected to be stored already).
+     * @returns false if discarded: something was invalidated since generation was taken
+     */
+    bool store(Handle folder, Handle parent, const Aggregate &aggregate, const std::vector<Handle> &children, uint64_t generation);
+
+    // To be called with each node that was added, moved or removed
+    void onNodeUpdated(Handle node, Handle parent, bool removed);
+
+    void clear();
+
+    Stats getStats() const;
+
+private:
+    void invalidateUpwardsLocked(Handle from);
+
+    mutable std::mutex mMutex;
+    uint64_t mGeneration = 0;
+    std::unordered_map<Handle, Handle> mParents;
+    std::unordered_map<Handle, Aggregate> mAggregates;
+    uint64_t mHits = 0;
+    uint64_t mMisses = 0;
+};
+
+}
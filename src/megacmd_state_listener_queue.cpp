@@ -0,0 +1,134 @@
+/**
+ * @file src/megacmd_state_listener_queue.cpp
+ * @brief MEGAcmd: Outbound queue of messages for a state listener
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "megacmd_state_listener_queue.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace megacmd {
+
+namespace {
+constexpr std::string_view sPromptPrefix = "prompt:";
+constexpr std::string_view sProgressPrefix = "progress:";
+constexpr std::string_view sProgressCompletePrefix = "progress:-2:"; // PROGRESS_COMPLETE
+
+bool startsWith(std::string_view s, std::string_view prefix)
+{
+    return s.substr(0, prefix.size()) == prefix;
+}
+}
+
+StateListenerQueue::StateListenerQueue(size_t maxMessages)
+    : mMaxMessages(std::max<size_t>(1, maxMessages))
+{
+}
+
+std::string *StateListenerQueue::replaceable(const std::optional<uint64_t> &seq)
+{
+    if (!seq)
+    {
+        return nullptr;
+    }
+
+    size_t index = static_cast<size_t>(*seq - mFirstSeq);
+    assert(index < mMessages.size());
+    if (index == 0 && mSentOffset)
+    {
+        return nullptr; // partially sent already
+    }
+    return &mMessages[index];
+}
+
+bool StateListenerQueue::push(std::string message)
+{
+    bool isPrompt = startsWith(message, sPromptPrefix);
+    bool isProgress = !isPrompt && startsWith(message, sProgressPrefix);
+
+    if (isPrompt)
+    {
+        if (auto pending = replaceable(mPromptSeq))
+        {
+            *pending = std::move(message);
+            return true;
+        }
+    }
+    else if (isProgress)
+    {
+        auto pending = replaceable(mProgressSeq);
+        if (pending && !startsWith(*pending, sProgressCompletePrefix))
+        {
+            *pending = std::move(message);
+            return true;
+        }
+    }
+
+    if (mMessages.size() >= mMaxMessages)
+    {
+        return false;
+    }
+
+    uint64_t seq = mFirstSeq + mMessages.size();
+    mMessages.emplace_back(std::move(message));
+    if (isPrompt)
+    {
+        mPromptSeq = seq;
+    }
+    else if (isProgress)
+    {
+        mProgressSeq = seq;
+    }
+    return true;
+}
+
+std::string_view StateListenerQueue::front() const
+{
+    if (mMessages.empty())
+    {
+        return {};
+    }
+    return std::string_view(mMessages.front()).substr(mSentOffset);
+}
+
+void StateListenerQueue::consume(size_t size)
+{
+    while (size && !mMessages.empty())
+    {
+        size_t pendingInFront = mMessages.front().size() - mSentOffset;
+        if (size < pendingInFront)
+        {
+            mSentOffset += size;
+            return;
+        }
+
+        size -= pendingInFront;
+        if (mPromptSeq == mFirstSeq)
+        {
+            mPromptSeq.reset();
+        }
+        if (mProgressSeq == mFirstSeq)
+        {
+            mProgressSeq.reset();
+        }
+        mMessages.pop_front();
+        mSentOffset = 0;
+        ++mFirstSeq;
+    }
+}
+
+}
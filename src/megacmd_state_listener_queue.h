@@ -0,0 +1,75 @@
+/**
+ * @file src/megacmd_state_listener_queue.h
+ * @brief MEGAcmd: Outbound queue of messages for a state listener
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace megacmd {
+
+/**
+ * @brief Bounded queue of the messages pending to be sent to a state listener.
+ *
+ * Messages that only describe the current state are coalesced while waiting to be sent:
+ * a new "prompt:" replaces the one pending, and so does a new "progress:" (unless the pending one
+ * notifies a completion, which is never dropped).
+ * Messages may be sent in several steps (see front and consume).
+ *
+ * Not thread safe: the owner is expected to guard it.
+ */
+class StateListenerQueue
+{
+public:
+    static constexpr size_t sDefaultMaxMessages = 1000;
+
+    explicit StateListenerQueue(size_t maxMessages = sDefaultMaxMessages);
+
+    /**
+     * @brief Queues a message (which should include its separator)
+     * @returns false if the queue is full: the listener is not consuming messages
+     */
+    bool push(std::string message);
+
+    bool empty() const { return mMessages.empty(); }
+    size_t size() const { return mMessages.size(); }
+
+    // The part of the first message that is yet to be sent
+    std::string_view front() const;
+
+    // Marks the first `size` bytes of front() as sent
+    void consume(size_t size);
+
+private:
+    // Returns the pending message with that sequence number, if it can be replaced
+    std::string *replaceable(const std::optional<uint64_t> &seq);
+
+    size_t mMaxMessages;
+    std::deque<std::string> mMessages;
+    size_t mSentOffset = 0;
+
+    // sequence number of the first message in the queue
+    uint64_t mFirstSeq = 0;
+    std::optional<uint64_t> mPromptSeq;
+    std::optional<uint64_t> mProgressSeq;
+};
+
+}
@@ -0,0 +1,441 @@
+/**
+ * @file src/megacmd_tree_traversal.h
+ * @brief MEGAcmd: Traversal of trees of nodes, expanding folders ahead of the visitor
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "megacmd_cancellation.h"
+
+namespace megacmd {
+
+enum class TraversalOrder
+{
+    UNORDERED,   ///< The visitor is called concurrently from the traversal threads, as soon as nodes are found
+    PRE_ORDER,   ///< The visitor is called from the calling thread, parents before their children
+    POST_ORDER,  ///< The visitor is called from the calling thread, children before their parents
+};
+
+struct TraversalOptions
+{
+    TraversalOrder mOrder = TraversalOrder::PRE_ORDER;
+
+    // Threads expanding folders, besides the calling one. 0: traverse in the calling thread only.
+    // The SDK serializes getChildren behind its global lock: more than one expanding thread
+    // only contends for it, so by default a single one lists folders while the caller visits
+    unsigned mNumThreads = 1;
+
+    // Max depth of the nodes visited (the root has depth 0). -1: unlimited
+    int mMaxDepth = -1;
+
+    // Ordered traversals: max nodes found but not visited yet. Traversal threads wait for the visitor beyond that
+    size_t mMaxBufferedNodes = 64 * 1024;
+
+    CancellationToken mCancellationToken;
+};
+
+struct VisitInfo
+{
+    int mDepth = 0;
+    bool mIsLastChild = true;
+};
+
+/**
+ * @brief Traverses a tree with a pool of work-stealing threads.
+ *
+ * Folders are expanded (i.e: their children are got) by the traversal threads: each thread owns a queue of folders
+ * to expand, pushing there the subfolders it finds, and idle threads steal from the front of the others'.
+ * Threads are only spawned once there are folders waiting to be expanded.
+ * Expanding is only faster with more threads if getting children does not serialize them (see TraversalOptions).
+ *
+ * In ordered traversals the visitor is called from the calling thread in a deterministic order,
+ * while the threads keep expanding ahead of it. Should the visitor need a folder not expanded yet,
+ * the calling thread expands it itself.
+ *
+ * Node is expected to be cheap to copy.
+ */
+template <class Node>
+class TreeTraversal
+{
+public:
+    using ChildrenGetter = std::function<std::vector<Node>(const Node &folder)>;
+    using FolderChecker = std::function<bool(const Node &node)>;
+    using Visitor = std::function<void(const Node &node, const VisitInfo &info)>;
+
+    // Called once a folder has been expanded (before its children are visited, in ordered traversals)
+    using FolderVisitor = std::function<void(const Node &folder, const std::vector<Node> &children, int depth)>;
+
+    // Subfolders found for which shouldExpand (if any) returns false are visited, but not expanded: nothing below them
+    // is got. It is called from the thread expanding their parent
+    TreeTraversal(ChildrenGetter getChildren, FolderChecker isFolder, const TraversalOptions &options, FolderChecker shouldExpand = {})
+        : mGetChildren(std::move(getChildren))
+        , mIsFolder(std::move(isFolder))
+        , mShouldExpand(std::move(shouldExpand))
+        , mOptions(options)
+        , mQueues(options.mNumThreads + 1) // the last one is the calling thread's
+    {
+        for (auto &queue : mQueues)
+        {
+            queue = std::make_unique<WorkerQueue>();
+        }
+    }
+
+    ~TreeTraversal()
+    {
+        stopThreads();
+    }
+
+    TreeTraversal(const TreeTraversal&) = delete;
+    TreeTraversal& operator=(const TreeTraversal&) = delete;
+
+    /**
+     * @brief Visits the root and its descendants
+     * @returns false if the traversal was cancelled
+     */
+    bool run(const Node &root, const Visitor &visitor, const FolderVisitor &folderVisitor = {})
+    {
+        mVisitor = visitor;
+        mFolderVisitor = folderVisitor;
+
+        const VisitInfo rootInfo;
+        const bool expandRoot = mIsFolder(root) && mOptions.mMaxDepth != 0;
+        const bool ordered = mOptions.mOrder != TraversalOrder::UNORDERED;
+
+        if (mVisitor && mOptions.mOrder != TraversalOrder::POST_ORDER)
+        {
+            mVisitor(root, rootInfo);
+        }
+
+        if (expandRoot)
+        {
+            auto rootSlot = std::make_shared<Slot>(root, 0);
+            if (ordered)
+            {
+                emit(*rootSlot);
+            }
+            else
+            {
+                ++mPendingSlots;
+                push(callerQueueIndex(), {rootSlot});
+                workLoop(callerQueueIndex());
+            }
+        }
+
+        if (mVisitor && mOptions.mOrder == TraversalOrder::POST_ORDER && !isCancelled())
+        {
+            mVisitor(root, rootInfo);
+        }
+
+        stopThreads();
+        return !isCancelled();
+    }
+
+private:
+    enum SlotState { PENDING, CLAIMED, READY };
+
+    // A folder to be expanded
+    struct Slot
+    {
+        Slot(const Node &node, int depth) : mNode(node), mDepth(depth) {}
+
+        Node mNode;
+        const int mDepth;
+        std::atomic<int> mState{PENDING};
+        std::vector<Node> mChildren;
+        std::vector<std::shared_ptr<Slot>> mSubfolders; // aligned with mChildren, null for files (and beyond max depth)
+    };
+
+    struct WorkerQueue
+    {
+        std::mutex mMutex;
+        std::deque<std::shared_ptr<Slot>> mSlots;
+    };
+
+    bool isCancelled() const
+    {
+        return mOptions.mCancellationToken.isCancelled();
+    }
+
+    size_t callerQueueIndex() const
+    {
+        return mOptions.mNumThreads;
+    }
+
+    void push(size_t queueIndex, std::vector<std::shared_ptr<Slot>> &&slots)
+    {
+        if (slots.empty())
+        {
+            return;
+        }
+
+        {
+            WorkerQueue &queue = *mQueues[queueIndex];
+            std::lock_guard<std::mutex> g(queue.mMutex);
+            std::move(slots.begin(), slots.end(), std::back_inserter(queue.mSlots));
+        }
+
+        std::lock_guard<std::mutex> g(mMutex);
+        mQueued += slots.size();
+        if (mThreads.size() < mOptions.mNumThreads && !mStopping)
+        {
+            // Spawn a thread per queued folder (up to the max): small traversals stay single threaded
+            size_t toSpawn = std::min(mOptions.mNumThreads - mThreads.size(), slots.size());
+            for (size_t i = 0; i < toSpawn; ++i)
+            {
+                mThreads.emplace_back(&TreeTraversal::workLoop, this, mThreads.size());
+            }
+        }
+        mWorkAvailableCV.notify_all();
+    }
+
+    // Own queue first (LIFO: depth first, for locality), then steal from the front of the others
+    std::shared_ptr<Slot> pop(size_t queueIndex)
+    {
+        {
+            WorkerQueue &own = *mQueues[queueIndex];
+            std::lock_guard<std::mutex> g(own.mMutex);
+            if (!own.mSlots.empty())
+            {
+                auto slot = std::move(own.mSlots.back());
+                own.mSlots.pop_back();
+                --mQueued;
+                return slot;
+            }
+        }
+
+        for (size_t i = 1; i < mQueues.size(); ++i)
+        {
+            WorkerQueue &victim = *mQueues[(queueIndex + i) % mQueues.size()];
+            std::lock_guard<std::mutex> g(victim.mMutex);
+            if (!victim.mSlots.empty())
+            {
+                auto slot = std::move(victim.mSlots.front());
+                victim.mSlots.pop_front();
+                --mQueued;
+                return slot;
+            }
+        }
+        return nullptr;
+    }
+
+    bool claim(Slot &slot)
+    {
+        int expected = PENDING;
+        return slot.mState.compare_exchange_strong(expected, CLAIMED);
+    }
+
+    void expand(Slot &slot, size_t queueIndex)
+    {
+        const bool ordered = mOptions.mOrder != TraversalOrder::UNORDERED;
+        const int childrenDepth = slot.mDepth + 1;
+        const bool expandSubfolders = mOptions.mMaxDepth < 0 || childrenDepth < mOptions.mMaxDepth;
+
+        std::vector<std::shared_ptr<Slot>> subfolders;
+        if (!isCancelled())
+        {
+            slot.mChildren = mGetChildren(slot.mNode);
+            if (ordered)
+            {
+                slot.mSubfolders.resize(slot.mChildren.size());
+            }
+
+            for (size_t i = 0; i < slot.mChildren.size(); ++i)
+            {
+                if (expandSubfolders && mIsFolder(slot.mChildren[i]) && (!mShouldExpand || mShouldExpand(slot.mChildren[i])))
+                {
+                    auto subfolder = std::make_shared<Slot>(slot.mChildren[i], childrenDepth);
+                    if (ordered)
+                    {
+                        slot.mSubfolders[i] = subfolder;
+                    }
+                    subfolders.emplace_back(std::move(subfolder));
+                }
+            }
+        }
+
+        if (!ordered)
+        {
+            mPendingSlots += subfolders.size();
+            if (mFolderVisitor && !isCancelled())
+            {
+                mFolderVisitor(slot.mNode, slot.mChildren, slot.mDepth);
+            }
+            for (size_t i = 0; mVisitor && i < slot.mChildren.size() && !isCancelled(); ++i)
+            {
+                mVisitor(slot.mChildren[i], VisitInfo{childrenDepth, i + 1 == slot.mChildren.size()});
+            }
+            slot.mChildren.clear();
+        }
+        else
+        {
+            mBuffered += slot.mChildren.size();
+        }
+
+        if (ordered && !mOptions.mNumThreads)
+        {
+            subfolders.clear(); // expanded on demand by the calling thread
+        }
+        else if (ordered)
+        {
+            // Pushed in reverse, so that the owner (LIFO) expands them in the order they will be visited
+            std::reverse(subfolders.begin(), subfolders.end());
+        }
+        push(queueIndex, std::move(subfolders));
+
+        bool complete = false;
+        {
+            std::lock_guard<std::mutex> g(mMutex);
+            slot.mState = READY;
+            complete = !ordered && !--mPendingSlots;
+        }
+
+        if (ordered)
+        {
+            mReadyCV.notify_all();
+        }
+        else if (complete)
+        {
+            mWorkAvailableCV.notify_all(); // wake up the calling thread
+        }
+    }
+
+    // Expands folders until the traversal is complete (or stopped)
+    void workLoop(size_t queueIndex)
+    {
+        const bool ordered = mOptions.mOrder != TraversalOrder::UNORDERED;
+        const bool isCaller = queueIndex == callerQueueIndex();
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mWorkAvailableCV.wait(lock, [this, ordered, isCaller]() {
+                    if (mStopping || (isCaller && !mPendingSlots))
+                    {
+                        return true;
+                    }
+                    return mQueued > 0 && (!ordered || mBuffered < mOptions.mMaxBufferedNodes);
+                });
+                if (mStopping || (isCaller && !mPendingSlots))
+                {
+                    return;
+                }
+            }
+
+            auto slot = pop(queueIndex);
+            if (slot && claim(*slot))
+            {
+                expand(*slot, queueIndex);
+            }
+        }
+    }
+
+    // Waits for the folder to be expanded, expanding it if no thread has claimed it yet
+    void waitReady(Slot &slot)
+    {
+        if (claim(slot))
+        {
+            expand(slot, callerQueueIndex());
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(mMutex);
+        mReadyCV.wait(lock, [&slot]() { return slot.mState == READY; });
+    }
+
+    // Ordered traversals: visits the descendants of the folder, from the calling thread
+    void emit(Slot &slot)
+    {
+        waitReady(slot);
+
+        if (mFolderVisitor && !isCancelled())
+        {
+            mFolderVisitor(slot.mNode, slot.mChildren, slot.mDepth);
+        }
+
+        const bool preOrder = mOptions.mOrder == TraversalOrder::PRE_ORDER;
+        const size_t numChildren = slot.mChildren.size();
+        for (size_t i = 0; i < numChildren && !isCancelled(); ++i)
+        {
+            const VisitInfo info{slot.mDepth + 1, i + 1 == numChildren};
+            if (mVisitor && preOrder)
+            {
+                mVisitor(slot.mChildren[i], info);
+            }
+            if (slot.mSubfolders[i])
+            {
+                emit(*slot.mSubfolders[i]);
+                slot.mSubfolders[i].reset(); // release the subtree as soon as possible
+            }
+            if (mVisitor && !preOrder && !isCancelled())
+            {
+                mVisitor(slot.mChildren[i], info);
+            }
+        }
+
+        slot.mChildren.clear();
+        slot.mSubfolders.clear();
+        if (mBuffered.fetch_sub(numChildren) >= mOptions.mMaxBufferedNodes)
+        {
+            std::lock_guard<std::mutex> g(mMutex);
+            mWorkAvailableCV.notify_all(); // there is room for the threads to expand again
+        }
+    }
+
+    void stopThreads()
+    {
+        {
+            std::lock_guard<std::mutex> g(mMutex);
+            mStopping = true;
+        }
+        mWorkAvailableCV.notify_all();
+
+        for (auto &thread : mThreads)
+        {
+            thread.join();
+        }
+        mThreads.clear();
+    }
+
+    ChildrenGetter mGetChildren;
+    FolderChecker mIsFolder;
+    FolderChecker mShouldExpand;
+    const TraversalOptions mOptions;
+    Visitor mVisitor;
+    FolderVisitor mFolderVisitor;
+
+    std::vector<std::unique_ptr<WorkerQueue>> mQueues;
+    std::vector<std::thread> mThreads;
+
+    std::mutex mMutex;
+    std::condition_variable mWorkAvailableCV;
+    std::condition_variable mReadyCV;
+    bool mStopping = false;
+    std::atomic<size_t> mQueued{0};
+    std::atomic<size_t> mBuffered{0};      // ordered traversals: nodes got but not visited yet
+    std::atomic<size_t> mPendingSlots{0};  // unordered traversals: folders not expanded yet
+};
+
+}
@@ -0,0 +1,264 @@
+/**
+ * @file src/megacmd_worker_pool.cpp
+ * @brief MEGAcmd: Pool of persistent worker threads
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "megacmd_worker_pool.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace megacmd {
+
+WorkerPool::State::State(size_t maxWorkers)
+    : mBusy(maxWorkers, false)
+    , mRunningTokens(maxWorkers)
+{
+    mQueues.reserve(maxWorkers);
+    for (size_t i = 0; i < maxWorkers; ++i)
+    {
+        mQueues.emplace_back(std::make_unique<WorkerQueue>());
+    }
+}
+
+bool WorkerPool::State::popTask(size_t workerIndex, QueuedTask &task)
+{
+    // Own queue first (FIFO), then steal from the back of the others
+    {
+        WorkerQueue &own = *mQueues[workerIndex];
+        std::lock_guard<std::mutex> g(own.mMutex);
+        if (!own.mTasks.empty())
+        {
+            task = std::move(own.mTasks.front());
+            own.mTasks.pop_front();
+            return true;
+        }
+    }
+
+    for (size_t i = 1; i < mQueues.size(); ++i)
+    {
+        WorkerQueue &victim = *mQueues[(workerIndex + i) % mQueues.size()];
+        std::lock_guard<std::mutex> g(victim.mMutex);
+        if (!victim.mTasks.empty())
+        {
+            task = std::move(victim.mTasks.back());
+            victim.mTasks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkerPool::State::onTaskDone(size_t workerIndex)
+{
+    --mNumRunning;
+    mBusy[workerIndex] = false;
+    mRunningTokens[workerIndex] = CancellationToken();
+    mTaskDoneCV.notify_all();
+}
+
+WorkerPool::WorkerPool(size_t maxWorkers, size_t maxQueueDepth)
+    : mMaxWorkers(std::max<size_t>(1, maxWorkers))
+    , mMaxQueueDepth(std::max<size_t>(1, maxQueueDepth))
+    , mState(std::make_shared<State>(mMaxWorkers))
+{
+    mThreads.reserve(mMaxWorkers);
+}
+
+WorkerPool::~WorkerPool()
+{
+    stop();
+}
+
+bool WorkerPool::submit(Task &&task, CancellationToken token)
+{
+    State &state = *mState;
+    std::unique_lock<std::mutex> lock(state.mMutex);
+    state.mSpaceAvailableCV.wait(lock, [this, &state]() {
+        return state.mStopping || state.mNumQueued < mMaxQueueDepth;
+    });
+
+    if (state.mStopping)
+    {
+        return false;
+    }
+
+    enqueueLocked({std::move(task), std::move(token)});
+    return true;
+}
+
+bool WorkerPool::trySubmit(Task &&task, CancellationToken token)
+{
+    std::lock_guard<std::mutex> g(mState->mMutex);
+    if (mState->mStopping || mState->mNumQueued >= mMaxQueueDepth)
+    {
+        return false;
+    }
+
+    enqueueLocked({std::move(task), std::move(token)});
+    return true;
+}
+
+void WorkerPool::enqueueLocked(QueuedTask &&task)
+{
+    State &state = *mState;
+    if (state.mNumIdle <= state.mNumQueued && state.mNumWorkers < mMaxWorkers)
+    {
+        // No worker will be free to pick this task up: spawn a new one (it will be kept alive)
+        mThreads.emplace_back(workerLoop, mState, state.mNumWorkers);
+        ++state.mNumWorkers;
+    }
+
+    size_t queueIndex = state.mNextQueue++ % state.mNumWorkers;
+    {
+        WorkerQueue &queue = *state.mQueues[queueIndex];
+        std::lock_guard<std::mutex> g(queue.mMutex);
+        queue.mTasks.emplace_back(std::move(task));
+    }
+    ++state.mNumQueued;
+    state.mWorkAvailableCV.notify_one();
+}
+
+void WorkerPool::workerLoop(std::shared_ptr<State> statePtr, size_t workerIndex)
+{
+    State &state = *statePtr;
+    // Held except while picking and running tasks, so that a worker done with its task is accounted as idle right away
+    std::unique_lock<std::mutex> lock(state.mMutex);
+    for (;;)
+    {
+        ++state.mNumIdle;
+        state.mWorkAvailableCV.wait(lock, [&state]() {
+            return state.mStopping || state.mNumQueued > 0;
+        });
+        --state.mNumIdle;
+
+        if (state.mStopping)
+        {
+            return;
+        }
+
+        // Reserve one of the queued tasks: it is guaranteed to be in some queue
+        --state.mNumQueued;
+        ++state.mNumRunning;
+        state.mBusy[workerIndex] = true;
+        lock.unlock();
+        state.mSpaceAvailableCV.notify_one();
+
+        QueuedTask task;
+        while (!state.popTask(workerIndex, task))
+        {
+            std::lock_guard<std::mutex> g(state.mMutex);
+            if (state.mStopping)
+            {
+                break; // the reserved task was discarded by stop()
+            }
+        }
+
+        lock.lock();
+        if (state.mStopping)
+        {
+            // discarded too if popped as stop() emptied the queues (and destroyed outside the lock)
+            state.onTaskDone(workerIndex);
+            lock.unlock();
+            return;
+        }
+        state.mRunningTokens[workerIndex] = task.mToken; // to be cancelled by stop()
+        lock.unlock();
+
+        task.mTask();
+        task = QueuedTask(); // release captured resources before being accounted as idle
+
+        lock.lock();
+        state.onTaskDone(workerIndex);
+    }
+}
+
+void WorkerPool::requestStop()
+{
+    std::deque<QueuedTask> discarded;
+    {
+        std::lock_guard<std::mutex> g(mState->mMutex);
+        if (mState->mStopping)
+        {
+            return;
+        }
+        mState->mStopping = true;
+
+        for (auto &queue : mState->mQueues)
+        {
+            std::lock_guard<std::mutex> qg(queue->mMutex);
+            std::move(queue->mTasks.begin(), queue->mTasks.end(), std::back_inserter(discarded));
+            queue->mTasks.clear();
+        }
+        mState->mNumQueued = 0;
+
+        for (auto &token : mState->mRunningTokens)
+        {
+            token.cancel();
+        }
+    }
+    mState->mWorkAvailableCV.notify_all();
+    mState->mSpaceAvailableCV.notify_all();
+
+    discarded.clear(); // outside the lock: tasks may own resources with non trivial destruction
+}
+
+size_t WorkerPool::stop(std::chrono::milliseconds maxWaitTime)
+{
+    requestStop();
+    if (mThreads.empty())
+    {
+        return 0; // stopped already
+    }
+
+    // Cancelled tasks are expected to bail out soon. Those that do not are left behind, not to hang the caller
+    std::vector<bool> busy;
+    {
+        std::unique_lock<std::mutex> lock(mState->mMutex);
+        mState->mTaskDoneCV.wait_for(lock, maxWaitTime, [this]() { return !mState->mNumRunning; });
+        busy = mState->mBusy;
+    }
+
+    size_t numDetached = 0;
+    for (size_t i = 0; i < mThreads.size(); ++i)
+    {
+        if (busy[i])
+        {
+            mThreads[i].detach();
+            ++numDetached;
+        }
+        else
+        {
+            mThreads[i].join(); // exiting, if not gone already
+        }
+    }
+    mThreads.clear();
+    return numDetached;
+}
+
+size_t WorkerPool::getNumOngoingTasks() const
+{
+    std::lock_guard<std::mutex> g(mState->mMutex);
+    return mState->mNumQueued + mState->mNumRunning;
+}
+
+size_t WorkerPool::getNumWorkers() const
+{
+    std::lock_guard<std::mutex> g(mState->mMutex);
+    return mState->mNumWorkers;
+}
+
+}
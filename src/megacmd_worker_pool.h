@@ -0,0 +1,140 @@
+/**
+ * @file src/megacmd_worker_pool.h
+ * @brief MEGAcmd: Pool of persistent worker threads
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "megacmd_cancellation.h"
+
+namespace megacmd {
+
+/**
+ * @brief Bounded pool of persistent worker threads.
+ *
+ * Workers are spawned on demand (up to maxWorkers) and kept alive afterwards,
+ * so cheap tasks do not pay for thread creation and teardown.
+ * Each worker owns a queue: tasks are distributed round-robin and idle workers
+ * steal from the back of other workers' queues.
+ * Once maxQueueDepth tasks are waiting to be started, submit blocks until there is room.
+ * Tasks come with the token that cancels them once the pool is stopped.
+ */
+class WorkerPool final
+{
+public:
+    using Task = std::function<void()>;
+
+    WorkerPool(size_t maxWorkers, size_t maxQueueDepth);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Waited for by the destructor, unless stopped already
+    static constexpr std::chrono::seconds sDefaultStopWaitTime{10};
+
+    /**
+     * @brief Enqueues a task, blocking while the queue is full
+     * @returns false if the pool has been stopped (the task is discarded)
+     */
+    bool submit(Task &&task, CancellationToken token = CancellationToken());
+
+    /**
+     * @brief Enqueues a task if there is room in the queue, without blocking
+     * @returns false if the queue is full or the pool has been stopped (task is left untouched)
+     */
+    bool trySubmit(Task &&task, CancellationToken token = CancellationToken());
+
+    /**
+     * @brief Stops accepting tasks: queued ones that have not started are discarded and running ones are cancelled.
+     * Does not wait for them.
+     */
+    void requestStop();
+
+    /**
+     * @brief Stops the pool (see requestStop) and joins the workers once their task is done, waiting up to maxWaitTime for them.
+     * @returns the number of tasks still running then: their workers are detached (they exit once done)
+     */
+    size_t stop(std::chrono::milliseconds maxWaitTime = sDefaultStopWaitTime);
+
+    // Number of tasks either waiting in the queues or being executed
+    size_t getNumOngoingTasks() const;
+
+    size_t getNumWorkers() const;
+
+    size_t getMaxWorkers() const { return mMaxWorkers; }
+    size_t getMaxQueueDepth() const { return mMaxQueueDepth; }
+
+private:
+    struct QueuedTask
+    {
+        Task mTask;
+        CancellationToken mToken;
+    };
+
+    struct WorkerQueue
+    {
+        std::mutex mMutex;
+        std::deque<QueuedTask> mTasks;
+    };
+
+    // State is shared with the workers, so that detached ones never outlive it
+    struct State
+    {
+        explicit State(size_t maxWorkers);
+
+        bool popTask(size_t workerIndex, QueuedTask &task);
+
+        // To be called with the mutex held, once the task reserved by the worker is done (or discarded)
+        void onTaskDone(size_t workerIndex);
+
+        std::vector<std::unique_ptr<WorkerQueue>> mQueues;
+        std::vector<bool> mBusy;
+        std::vector<CancellationToken> mRunningTokens; // by worker
+
+        mutable std::mutex mMutex;
+        std::condition_variable mWorkAvailableCV;
+        std::condition_variable mSpaceAvailableCV;
+        std::condition_variable mTaskDoneCV;
+        size_t mNumWorkers = 0;
+        size_t mNumIdle = 0;
+        size_t mNumQueued = 0;
+        size_t mNumRunning = 0;
+        size_t mNextQueue = 0;
+        bool mStopping = false;
+    };
+
+    static void workerLoop(std::shared_ptr<State> state, size_t workerIndex);
+
+    // To be called with the state mutex held, and room in the queue
+    void enqueueLocked(QueuedTask &&task);
+
+    const size_t mMaxWorkers;
+    const size_t mMaxQueueDepth;
+    std::shared_ptr<State> mState;
+    std::vector<std::thread> mThreads;
+};
+
+}
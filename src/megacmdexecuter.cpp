@@ -208,10 +208,235 @@ MegaCmdExecuter::MegaCmdExecuter(MegaApi *api, MegaCmdLogger *loggerCMD, MegaCmd
 
 MegaCmdExecuter::~MegaCmdExecuter()
 {
+    stopNameIndexBuilder();
     delete fsAccessCMD;
     delete globalTransferListener;
 }
 
+void MegaCmdExecuter::enableNameIndex()
+{
+    if (mNameIndex)
+    {
+        return;
+    }
+    mNameIndex = std::make_unique<NodeNameIndex>();
+    mNameIndexBuilder = std::thread([this]() { nameIndexBuilderLoop(); });
+
+    if (api->isFilesystemAvailable())
+    {
+        requestNameIndexRebuild();
+    }
+}
+
+void MegaCmdExecuter::requestNameIndexRebuild()
+{
+    if (!mNameIndex)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> g(mNameIndexBuilderMutex);
+        mNameIndexBuildToken.cancel(); // an ongoing build would be outdated
+        mNameIndexRebuildRequested = true;
+    }
+    mNameIndexBuilderCV.notify_one();
+}
+
+void MegaCmdExecuter::clearNameIndex()
+{
+    if (!mNameIndex)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> g(mNameIndexBuilderMutex);
+        mNameIndexBuildToken.cancel();
+        mNameIndexRebuildRequested = false;
+    }
+    mNameIndex->clear();
+}
+
+void MegaCmdExecuter::stopNameIndexBuilder()
+{
+    {
+        std::lock_guard<std::mutex> g(mNameIndexBuilderMutex);
+        mNameIndexBuildToken.cancel();
+        mNameIndexBuilderStopping = true;
+    }
+    mNameIndexBuilderCV.notify_one();
+
+    if (mNameIndexBuilder.joinable())
+    {
+        mNameIndexBuilder.join();
+    }
+}
+
+void MegaCmdExecuter::nameIndexBuilderLoop()
+{
+    for (;;)
+    {
+        CancellationToken token;
+        {
+            std::unique_lock<std::mutex> lock(mNameIndexBuilderMutex);
+            mNameIndexBuilderCV.wait(lock, [this]() { return mNameIndexBuilderStopping || mNameIndexRebuildRequested; });
+            if (mNameIndexBuilderStopping)
+            {
+                return;
+            }
+            mNameIndexRebuildRequested = false;
+            mNameIndexBuildToken = token;
+        }
+
+        buildNameIndex(token);
+    }
+}
+
+void MegaCmdExecuter::buildNameIndex(const CancellationToken &token)
+{
+    auto start = std::chrono::steady_clock::now();
+    mNameIndex->beginBuild();
+
+    std::vector<std::unique_ptr<MegaNode>> roots;
+    roots.emplace_back(api->getRootNode());
+    roots.emplace_back(api->getVaultNode());
+    roots.emplace_back(api->getRubbishNode());
+    std::unique_ptr<MegaNodeList> inShares(api->getInShares());
+    for (int i = 0; inShares && i < inShares->size(); i++)
+    {
+        roots.emplace_back(inShares->get(i)->copy());
+    }
+
+    TraversalOptions options;
+    options.mOrder = TraversalOrder::UNORDERED;
+    options.mCancellationToken = token;
+    for (const auto &root : roots)
+    {
+        if (root && !traverseTree(root.get(), options, [this](MegaNode *n, const VisitInfo&)
+            {
+                mNameIndex->add(n->getHandle(), n->getParentHandle(), n->getName() ? n->getName() : "", n->getType() == MegaNode::TYPE_FILE);
+            }))
+        {
+            LOG_debug << "Name index build interrupted";
+            mNameIndex->clear(); // a new build is due, or the index was to be cleared anyway
+            return;
+        }
+    }
+
+    mNameIndex->endBuild(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start));
+
+    auto stats = mNameIndex->getStats();
+    LOG_debug << "Name index built in " << stats.mBuildTime.count() << " ms: " << stats.mNumNodes << " nodes, "
+              << stats.mNumTrigrams << " trigrams, ~" << stats.mMemoryBytes / 1024 << " KB";
+}
+
+void MegaCmdExecuter::enableSizeCache()
+{
+    if (!mSizeCache)
+    {
+        mSizeCache = std::make_unique<FolderSizeCache>();
+    }
+}
+
+void MegaCmdExecuter::enablePathCache(size_t capacity)
+{
+    if (!mPathCache)
+    {
+        mPathCache = std::make_unique<NodePathCache>(capacity);
+    }
+}
+
+void MegaCmdExecuter::enableCompletionCache(size_t capacity)
+{
+    if (!mCompletionCache)
+    {
+        mCompletionCache = std::make_unique<CompletionCache>(capacity);
+    }
+}
+
+void MegaCmdExecuter::onNodesUpdate(MegaNodeList *nodes)
+{
+    if (!nodes) // too many changes to be notified one by one
+    {
+        if (mPathCache)
+        {
+            mPathCache->clear();
+        }
+        if (mCompletionCache)
+        {
+            mCompletionCache->clear();
+        }
+        if (mSizeCache)
+        {
+            mSizeCache->clear();
+        }
+        requestNameIndexRebuild();
+        return;
+    }
+
+    if (mPathCache)
+    {
+        for (int i = 0; i < nodes->size(); i++)
+        {
+            MegaNode *n = nodes->get(i);
+            if (n->getType() != MegaNode::TYPE_FILE && !n->hasChanged(MegaNode::CHANGE_TYPE_NEW)
+                    && (n->isRemoved() || n->hasChanged(MegaNode::CHANGE_TYPE_NAME | MegaNode::CHANGE_TYPE_PARENT | MegaNode::CHANGE_TYPE_INSHARE)))
+            {
+                // The paths of everything below change
+                mPathCache->clear();
+                break;
+            }
+
+            // A node now named like a folder resolved by name may be the one to resolve from now on
+            if (n->getName() && n->hasChanged(MegaNode::CHANGE_TYPE_NEW | MegaNode::CHANGE_TYPE_NAME | MegaNode::CHANGE_TYPE_PARENT))
+            {
+                mPathCache->forgetChild(n->getParentHandle(), n->getName());
+            }
+        }
+    }
+
+    if (mSizeCache)
+    {
+        for (int i = 0; i < nodes->size(); i++)
+        {
+            // Sizes only change with nodes added, moved or removed (a new version is a new node, with the former one moved under it)
+            MegaNode *n = nodes->get(i);
+            if (n->isRemoved() || n->hasChanged(MegaNode::CHANGE_TYPE_NEW | MegaNode::CHANGE_TYPE_PARENT | MegaNode::CHANGE_TYPE_REMOVED))
+            {
+                mSizeCache->onNodeUpdated(n->getHandle(), n->getParentHandle(), n->isRemoved());
+            }
+        }
+    }
+
+    if (mCompletionCache)
+    {
+        for (int i = 0; i < nodes->size(); i++)
+        {
+            MegaNode *n = nodes->get(i);
+            if (n->isRemoved() || n->hasChanged(MegaNode::CHANGE_TYPE_NEW | MegaNode::CHANGE_TYPE_NAME | MegaNode::CHANGE_TYPE_PARENT | MegaNode::CHANGE_TYPE_REMOVED))
+            {
+                mCompletionCache->onNodeUpdated(n->getHandle(), n->getParentHandle(), n->isRemoved());
+            }
+        }
+    }
+
+    if (!mNameIndex)
+    {
+        return;
+    }
+
+    std::vector<NodeNameIndex::Update> updates;
+    updates.reserve(static_cast<size_t>(nodes->size()));
+    for (int i = 0; i < nodes->size(); i++)
+    {
+        MegaNode *n = nodes->get(i);
+        updates.push_back({n->getHandle(), n->getParentHandle(), n->getName() ? n->getName() : "",
+                           n->getType() == MegaNode::TYPE_FILE, n->isRemoved()});
+    }
+    mNameIndex->applyUpdates(updates);
+}
+
 // list available top-level nodes and contacts/incoming shares
 void MegaCmdExecuter::listtrees()
 {
@@ -296,30 +521,14 @@ bool MegaCmdExecuter::includeIfIsSharedOrPendingOutShare(MegaApi *api, MegaNode
 
 struct patternNodeVector
 {
-    string pattern;
-    bool usepcre;
-    vector<MegaNode*> *nodesMatching;
-};
-
-struct criteriaNodeVector
-{
-    string pattern;
-    bool usepcre;
-    m_time_t minTime;
-    m_time_t maxTime;
-
-    int64_t maxSize;
-    int64_t minSize;
-
-    int mType = MegaNode::TYPE_UNKNOWN;
-
+    const PatternMatcher *matcher;
     vector<MegaNode*> *nodesMatching;
 };
 
 bool MegaCmdExecuter::includeIfMatchesPattern(MegaApi *api, MegaNode * n, void *arg)
 {
     struct patternNodeVector *pnv = (struct patternNodeVector*)arg;
-    if (patternMatches(n->getName(), pnv->pattern.c_str(), pnv->usepcre))
+    if (pnv->matcher->matches(n->getName()))
     {
         pnv->nodesMatching->push_back(n->copy());
         return true;
@@ -328,64 +537,182 @@ bool MegaCmdExecuter::includeIfMatchesPattern(MegaApi *api, MegaNode * n, void *
 }
 
 
-bool MegaCmdExecuter::includeIfMatchesCriteria(MegaApi *api, MegaNode * n, void *arg)
+bool MegaCmdExecuter::processTree(MegaNode *n, bool processor(MegaApi *, MegaNode *, void *), void *( arg ))
+{
+    if (!n || isCurrentThreadCancelled())
+    {
+        return false;
+    }
+
+    // children before their parents, as processors have always been called
+    bool toret = true;
+    bool completed = traverseTree(n, getTraversalOptions(TraversalOrder::POST_ORDER), [this, processor, arg, &toret](MegaNode *node, const VisitInfo&)
+    {
+        bool currentret = processor(api, node, arg);
+        toret = toret && currentret;
+    });
+    return completed && toret;
+}
+
+namespace {
+// A node within the list of children it was got with
+struct MegaNodeRef
 {
-    struct criteriaNodeVector *pnv = (struct criteriaNodeVector*)arg;
+    std::shared_ptr<MegaNodeList> mOwner; // keeps mNode alive (null for the root: owned by the caller)
+    MegaNode *mNode = nullptr;
+};
+}
 
-    if (pnv->mType != MegaNode::TYPE_UNKNOWN && n->getType() != pnv->mType )
+namespace {
+// --sort, --reverse and --limit (of ls and find). Errors are logged
+bool getListingOrder(std::map<std::string, int> *clflags, std::map<std::string, std::string> *cloptions, ListingOrder &order)
+{
+    string sortKey = getOption(cloptions, "sort", "");
+    if (sortKey.size())
     {
-        return false;
+        auto key = parseListingSortKey(sortKey);
+        if (!key)
+        {
+            setCurrentThreadOutCode(MCMD_EARGS);
+            LOG_err << "Invalid sort key: " << sortKey << ". Valid ones are: name, size and mtime";
+            return false;
+        }
+        order.mKey = *key;
     }
 
-    if ( pnv->maxTime != -1 && (n->getModificationTime() >= pnv->maxTime) )
+    order.mReverse = getFlag(clflags, "reverse");
+
+    if (cloptions->count("limit"))
     {
-        return false;
+        auto limit = getIntOptional(*cloptions, "limit");
+        if (!limit || *limit <= 0)
+        {
+            setCurrentThreadOutCode(MCMD_EARGS);
+            LOG_err << "Invalid limit: " << getOption(cloptions, "limit", "");
+            return false;
+        }
+        order.mLimit = static_cast<size_t>(*limit);
     }
-    if ( pnv->minTime != -1 && (n->getModificationTime() <= pnv->minTime) )
+
+    if (cloptions->count("offset"))
     {
-        return false;
+        auto offset = getIntOptional(*cloptions, "offset");
+        if (!offset || *offset < 0)
+        {
+            setCurrentThreadOutCode(MCMD_EARGS);
+            LOG_err << "Invalid offset: " << getOption(cloptions, "offset", "");
+            return false;
+        }
+        order.mOffset = static_cast<size_t>(*offset);
     }
+    return true;
+}
 
-    if ( pnv->maxSize != -1 && (n->getType() != MegaNode::TYPE_FILE || (n->getSize() > pnv->maxSize) ) )
+// --format (of ls and find). Errors are logged
+bool getNodeExportFormat(std::map<std::string, std::string> *cloptions, std::optional<NodeExportFormat> &format)
+{
+    if (cloptions->count("format"))
     {
-        return false;
+        format = parseNodeExportFormat(getOption(cloptions, "format", ""));
+        if (!format)
+        {
+            setCurrentThreadOutCode(MCMD_EARGS);
+            LOG_err << "Invalid format: " << getOption(cloptions, "format", "") << ". Valid formats: ndjson, binary";
+            return false;
+        }
     }
+    return true;
+}
 
-    if ( pnv->minSize != -1 && (n->getType() != MegaNode::TYPE_FILE || (n->getSize() < pnv->minSize) ) )
+// Exported nodes are written to the output of the command
+NodeExporter::Sink getOutStreamSink(NodeExportFormat format)
+{
+    if (format == NodeExportFormat::BINARY)
     {
-        return false;
+        return [](const char *data, size_t size)
+        {
+            OUTSTREAM << BinaryStringView(const_cast<char*>(data), size);
+        };
     }
+    return [](const char *data, size_t size)
+    {
+        OUTSTREAM << std::string_view(data, size);
+    };
+}
 
-    if (!patternMatches(n->getName(), pnv->pattern.c_str(), pnv->usepcre))
+// Sizes and times as shown: folders have no size, and show their creation time
+ListingEntry toListingEntry(MegaNode *n, ListingSortKey key, bool showCreationTime)
+{
+    ListingEntry entry;
+    entry.mHandle = n->getHandle();
+    if (key == ListingSortKey::NAME && n->getName())
     {
-        return false;
+        entry.mName = n->getName();
     }
+    entry.mIsFolder = !n->isFile();
+    entry.mSize = n->isFile() ? n->getSize() : 0;
+    entry.mTime = n->isFile() && !showCreationTime ? n->getModificationTime() : n->getCreationTime();
+    return entry;
+}
+}
 
-    pnv->nodesMatching->push_back(n->copy());
-    return true;
+TraversalOptions MegaCmdExecuter::getTraversalOptions(TraversalOrder order) const
+{
+    TraversalOptions options;
+    options.mOrder = order;
+    options.mCancellationToken = getCurrentThreadData().mCancellationToken;
+    return options;
 }
 
-bool MegaCmdExecuter::processTree(MegaNode *n, bool processor(MegaApi *, MegaNode *, void *), void *( arg ))
+bool MegaCmdExecuter::traverseTree(MegaNode *root, const TraversalOptions &options, NodeVisitor visitor, FolderVisitor folderVisitor, FolderFilter shouldExpand)
 {
-    if (!n)
+    if (!root)
     {
         return false;
     }
-    bool toret = true;
-    MegaNodeList *children = api->getChildren(n);
-    if (children)
-    {
-        for (int i = 0; i < children->size(); i++)
+
+    TreeTraversal<MegaNodeRef> traversal(
+        [this](const MegaNodeRef &folder)
         {
-            bool childret = processTree(children->get(i), processor, arg);
-            toret = toret && childret;
-        }
+            std::vector<MegaNodeRef> refs;
+            std::shared_ptr<MegaNodeList> children(api->getChildren(folder.mNode));
+            if (children)
+            {
+                refs.reserve(static_cast<size_t>(children->size()));
+                for (int i = 0; i < children->size(); i++)
+                {
+                    refs.push_back({children, children->get(i)});
+                }
+            }
+            return refs;
+        },
+        [](const MegaNodeRef &node) { return node.mNode->getType() != MegaNode::TYPE_FILE; },
+        options,
+        shouldExpand ? [&shouldExpand](const MegaNodeRef &folder) { return shouldExpand(folder.mNode); }
+                     : TreeTraversal<MegaNodeRef>::FolderChecker());
 
-        delete children;
+    TreeTraversal<MegaNodeRef>::Visitor onNode;
+    if (visitor)
+    {
+        onNode = [&visitor](const MegaNodeRef &node, const VisitInfo &info) { visitor(node.mNode, info); };
+    }
+
+    TreeTraversal<MegaNodeRef>::FolderVisitor onFolder;
+    if (folderVisitor)
+    {
+        onFolder = [&folderVisitor](const MegaNodeRef &folder, const std::vector<MegaNodeRef> &children, int depth)
+        {
+            std::vector<MegaNode*> nodes;
+            nodes.reserve(children.size());
+            for (const auto &child : children)
+            {
+                nodes.push_back(child.mNode);
+            }
+            folderVisitor(folder.mNode, nodes, depth);
+        };
     }
 
-    bool currentret = processor(api, n, arg);
-    return toret && currentret;
+    return traversal.run(MegaNodeRef{nullptr, root}, onNode, onFolder);
 }
 
 
@@ -471,7 +798,7 @@ std::unique_ptr<MegaNode> MegaCmdExecuter::nodebypath(const char* ptr, string* u
                 }
                 else
                 {
-                    nextNode.reset(api->getChildNode(baseNode.get(), curName.c_str()));
+                    nextNode = getChildNode(baseNode.get(), curName);
                 }
             }
 
@@ -504,10 +831,10 @@ std::unique_ptr<MegaNode> MegaCmdExecuter::nodebypath(const char* ptr, string* u
  * @param parentNode node for reference for relative paths
  * @param pathParts path pattern (separated in strings)
  * @param pathsMatching for the returned paths
- * @param usepcre use PCRE expressions if available
+ * @param matchers compiled patterns of the path parts
  * @param pathPrefix prefix to append to paths
  */
-void MegaCmdExecuter::getPathsMatching(MegaNode *parentNode, deque<string> pathParts, vector<string> *pathsMatching, bool usepcre, string pathPrefix)
+void MegaCmdExecuter::getPathsMatching(MegaNode *parentNode, deque<string> pathParts, vector<string> *pathsMatching, PatternMatcherCache &matchers, string pathPrefix)
 {
     if (!pathParts.size())
     {
@@ -525,7 +852,7 @@ void MegaCmdExecuter::getPathsMatching(MegaNode *parentNode, deque<string> pathP
          }
 
         //ignore this part
-        return getPathsMatching(parentNode, pathParts, pathsMatching, usepcre, pathPrefix+"./");
+        return getPathsMatching(parentNode, pathParts, pathsMatching, matchers, pathPrefix+"./");
     }
     if (currentPart == "..")
     {
@@ -537,7 +864,7 @@ void MegaCmdExecuter::getPathsMatching(MegaNode *parentNode, deque<string> pathP
             }
 
             unique_ptr<MegaNode> p(api->getNodeByHandle(parentNode->getParentHandle()));
-            return getPathsMatching(p.get(), pathParts, pathsMatching, usepcre, pathPrefix+"../");
+            return getPathsMatching(p.get(), pathParts, pathsMatching, matchers, pathPrefix+"../");
         }
         else
         {
@@ -549,8 +876,9 @@ void MegaCmdExecuter::getPathsMatching(MegaNode *parentNode, deque<string> pathP
     if (children)
     {
         bool isversion = nodeNameIsVersion(currentPart);
+        const PatternMatcher &partMatcher = matchers.get(isversion ? currentPart.substr(0, currentPart.size() - 11) : currentPart);
 
-        for (int i = 0; i < children->size(); i++)
+        for (int i = 0; i < children->size() && !isCurrentThreadCancelled(); i++)
         {
             MegaNode *childNode = children->get(i);
             // get childname from its path: alternative: childNode->getName()
@@ -568,7 +896,7 @@ void MegaCmdExecuter::getPathsMatching(MegaNode *parentNode, deque<string> pathP
             if (isversion)
             {
 
-                if (childNode && patternMatches(childname.c_str(), currentPart.substr(0,currentPart.size()-11).c_str(), usepcre))
+                if (childNode && partMatcher.matches(childname))
                 {
                     MegaNodeList *versionNodes = api->getVersions(childNode);
                     if (versionNodes)
@@ -584,7 +912,7 @@ void MegaCmdExecuter::getPathsMatching(MegaNode *parentNode, deque<string> pathP
                                 }
                                 else
                                 {
-                                    getPathsMatching(versionNode, pathParts, pathsMatching, usepcre,pathPrefix+childname+"#"+SSTR(versionNode->getModificationTime())+"/");
+                                    getPathsMatching(versionNode, pathParts, pathsMatching, matchers, pathPrefix+childname+"#"+SSTR(versionNode->getModificationTime())+"/");
                                 }
 
                                 break;
@@ -596,7 +924,7 @@ void MegaCmdExecuter::getPathsMatching(MegaNode *parentNode, deque<string> pathP
             }
             else
             {
-                if (patternMatches(childname.c_str(), currentPart.c_str(), usepcre))
+                if (partMatcher.matches(childname))
                 {
                     if (pathParts.size() == 0) //last leave
                     {
@@ -604,7 +932,7 @@ void MegaCmdExecuter::getPathsMatching(MegaNode *parentNode, deque<string> pathP
                     }
                     else
                     {
-                        getPathsMatching(childNode, pathParts, pathsMatching, usepcre,pathPrefix+childname+"/");
+                        getPathsMatching(childNode, pathParts, pathsMatching, matchers, pathPrefix+childname+"/");
                     }
                 }
 
@@ -685,7 +1013,8 @@ vector <string> * MegaCmdExecuter::nodesPathsbypath(const char* ptr, bool usepcr
         }
         else
         {
-            getPathsMatching((MegaNode *)baseNode, c, (vector<string> *)pathsMatching, usepcre, pathPrefix);
+            PatternMatcherCache matchers(usepcre);
+            getPathsMatching((MegaNode *)baseNode, c, (vector<string> *)pathsMatching, matchers, pathPrefix);
         }
         delete baseNode;
     }
@@ -694,6 +1023,7 @@ vector <string> * MegaCmdExecuter::nodesPathsbypath(const char* ptr, bool usepcr
 
         string matching = ptr;
         unescapeifRequired(matching);
+        PatternMatcher matcher(matching, false);
         unique_ptr<MegaShareList> inShares(api->getInSharesList());
         if (inShares)
         {
@@ -702,7 +1032,7 @@ vector <string> * MegaCmdExecuter::nodesPathsbypath(const char* ptr, bool usepcr
                 unique_ptr<MegaNode> n(api->getNodeByHandle(inShares->get(i)->getNodeHandle()));
                 string tomatch = string("//from/")+inShares->get(i)->getUser() + ":"+n->getName();
 
-                if (patternMatches(tomatch.c_str(), matching.c_str(), false))
+                if (matcher.matches(tomatch))
                 {
                     pathsMatching->push_back(tomatch);
                 }
@@ -720,7 +1050,7 @@ vector <string> * MegaCmdExecuter::nodesPathsbypath(const char* ptr, bool usepcr
  * @param c
  * @param nodesMatching
  */
-void MegaCmdExecuter::getNodesMatching(MegaNode *parentNode, deque<string> pathParts, vector<std::unique_ptr<MegaNode>>& nodesMatching, bool usepcre)
+void MegaCmdExecuter::getNodesMatching(MegaNode *parentNode, deque<string> pathParts, vector<std::unique_ptr<MegaNode>>& nodesMatching, PatternMatcherCache &matchers)
 {
     if (!pathParts.size())
     {
@@ -743,7 +1073,7 @@ void MegaCmdExecuter::getNodesMatching(MegaNode *parentNode, deque<string> pathP
         else
         {
             //ignore this part
-            return getNodesMatching(parentNode, pathParts, nodesMatching, usepcre);
+            return getNodesMatching(parentNode, pathParts, nodesMatching, matchers);
         }
     }
     if (currentPart == "..")
@@ -761,7 +1091,7 @@ void MegaCmdExecuter::getNodesMatching(MegaNode *parentNode, deque<string> pathP
             }
             else
             {
-                getNodesMatching(newparentNode, pathParts, nodesMatching, usepcre);
+                getNodesMatching(newparentNode, pathParts, nodesMatching, matchers);
                 delete newparentNode;
                 return;
             }
@@ -778,14 +1108,15 @@ void MegaCmdExecuter::getNodesMatching(MegaNode *parentNode, deque<string> pathP
     if (children)
     {
         bool isversion = nodeNameIsVersion(currentPart);
+        const PatternMatcher &partMatcher = matchers.get(isversion ? currentPart.substr(0, currentPart.size() - 11) : currentPart);
 
-        for (int i = 0; i < children->size(); i++)
+        for (int i = 0; i < children->size() && !isCurrentThreadCancelled(); i++)
         {
             MegaNode *childNode = children->get(i);
             if (isversion)
             {
 
-                if (childNode && patternMatches(childNode->getName(), currentPart.substr(0,currentPart.size()-11).c_str(), usepcre))
+                if (childNode && partMatcher.matches(childNode->getName()))
                 {
                     MegaNodeList *versionNodes = api->getVersions(childNode);
                     if (versionNodes)
@@ -801,7 +1132,7 @@ void MegaCmdExecuter::getNodesMatching(MegaNode *parentNode, deque<string> pathP
                                 }
                                 else
                                 {
-                                    getNodesMatching(versionNode, pathParts, nodesMatching, usepcre);
+                                    getNodesMatching(versionNode, pathParts, nodesMatching, matchers);
                                 }
 
                                 break;
@@ -814,7 +1145,7 @@ void MegaCmdExecuter::getNodesMatching(MegaNode *parentNode, deque<string> pathP
             else
             {
 
-                if (patternMatches(childNode->getName(), currentPart.c_str(), usepcre))
+                if (partMatcher.matches(childNode->getName()))
                 {
                     if (pathParts.size() == 0) //last leave
                     {
@@ -822,7 +1153,7 @@ void MegaCmdExecuter::getNodesMatching(MegaNode *parentNode, deque<string> pathP
                     }
                     else
                     {
-                        getNodesMatching(childNode, pathParts, nodesMatching, usepcre);
+                        getNodesMatching(childNode, pathParts, nodesMatching, matchers);
                     }
 
                 }
@@ -1201,7 +1532,8 @@ vector<std::unique_ptr<MegaNode>> MegaCmdExecuter::nodesbypath(const char* ptr,
         }
         else
         {
-            getNodesMatching(baseNode.get(), c, nodesMatching, usepcre);
+            PatternMatcherCache matchers(usepcre);
+            getNodesMatching(baseNode.get(), c, nodesMatching, matchers);
         }
     }
     else if (!strncmp(ptr, "//from/", max(3, min(static_cast<int>(strlen(ptr)-1), 7)))) //pattern trying to match inshares
@@ -1211,6 +1543,7 @@ vector<std::unique_ptr<MegaNode>> MegaCmdExecuter::nodesbypath(const char* ptr,
         {
             string matching = ptr;
             unescapeifRequired(matching);
+            PatternMatcher matcher(matching, false);
 
             for (int i = 0; i < inShares->size(); i++)
             {
@@ -1218,7 +1551,7 @@ vector<std::unique_ptr<MegaNode>> MegaCmdExecuter::nodesbypath(const char* ptr,
                 if (!n) continue;
 
                 string tomatch = string("//from/") + inShares->get(i)->getUser() + ":" + n->getName();
-                if (patternMatches(tomatch.c_str(), matching.c_str(), false))
+                if (matcher.matches(tomatch))
                 {
                     nodesMatching.emplace_back(std::move(n));
                 }
@@ -1735,7 +2068,7 @@ void MegaCmdExecuter::dumptree(MegaNode* n, bool treelike, vector<bool> &lastlea
             }
             else
             {
-                char * nodepath = api->getNodePath(n);
+                char * nodepath = getNodePath(n);
 
                 char *pathToShow = NULL;
                 if (pathRelativeTo != "")
@@ -1772,59 +2105,80 @@ void MegaCmdExecuter::dumptree(MegaNode* n, bool treelike, vector<bool> &lastlea
         }
     }
 
-    if (n->getType() != MegaNode::TYPE_FILE)
+    if (n->getType() == MegaNode::TYPE_FILE)
     {
-        MegaNodeList* children = api->getChildren(n);
-        if (children)
-        {
-            for (int i = 0; i < children->size(); i++)
-            {
-                vector<bool> lfs = lastleaf;
-                lfs.push_back(i==(children->size()-1));
-                dumptree(children->get(i), treelike, lfs, timeFormat, clflags, cloptions, recurse, extended_info, showversions, depth + 1);
-            }
+        return;
+    }
 
-            delete children;
-        }
+    TraversalOptions options = getTraversalOptions(TraversalOrder::PRE_ORDER);
+    if (!recurse)
+    {
+        options.mMaxDepth = 1;
     }
+
+    vector<bool> lfs = lastleaf; // whether each ancestor of the node being dumped is the last of its siblings
+    traverseTree(n, options, [&](MegaNode *child, const VisitInfo &info)
+    {
+        if (!info.mDepth)
+        {
+            return; // n itself, already dumped
+        }
+
+        lfs.resize(lastleaf.size() + info.mDepth - 1);
+        lfs.push_back(info.mIsLastChild);
+        if (treelike) printTreeSuffix(depth + info.mDepth, lfs);
+
+        dumpNode(child, timeFormat, clflags, cloptions, extended_info, showversions, treelike ? 0 : depth + info.mDepth);
+    });
 }
 
 void MegaCmdExecuter::dumpTreeSummary(MegaNode *n, const char *timeFormat, std::map<std::string, int> *clflags, std::map<std::string, std::string> *cloptions, int recurse, bool show_versions, int depth, bool humanreadable, string pathRelativeTo)
 {
-    char * nodepath = api->getNodePath(n);
-
-    string scryptoerror = "CRYPTO_ERROR";
-
-    char *pathToShow = NULL;
-    if (pathRelativeTo != "")
+    auto getPathToShow = [this](MegaNode *node, const string &pathRelativeTo) -> string
     {
-        pathToShow = strstr(nodepath, pathRelativeTo.c_str());
-    }
+        std::unique_ptr<char[]> nodepath(getNodePath(node));
 
-    if (pathToShow == nodepath) //found at beginning
-    {
-        pathToShow += pathRelativeTo.size();
-        if (( *pathToShow == '/' ) && ( pathRelativeTo != "/" ))
+        const char *pathToShow = NULL;
+        if (nodepath && pathRelativeTo != "")
         {
-            pathToShow++;
+            pathToShow = strstr(nodepath.get(), pathRelativeTo.c_str());
         }
-    }
-    else
-    {
-        pathToShow = nodepath;
-    }
 
-    if (!pathToShow && !( pathToShow = (char *)n->getName()))
-    {
-        pathToShow = (char *)scryptoerror.c_str();
-    }
+        if (nodepath && pathToShow == nodepath.get()) //found at beginning
+        {
+            pathToShow += pathRelativeTo.size();
+            if (( *pathToShow == '/' ) && ( pathRelativeTo != "/" ))
+            {
+                pathToShow++;
+            }
+        }
+        else
+        {
+            pathToShow = nodepath.get();
+        }
+
+        if (!pathToShow && !( pathToShow = node->getName()))
+        {
+            pathToShow = "CRYPTO_ERROR";
+        }
+        return pathToShow;
+    };
 
     if (n->getType() != MegaNode::TYPE_FILE)
     {
-        MegaNodeList* children = api->getChildren(n);
-        if (children)
+        TraversalOptions options = getTraversalOptions(TraversalOrder::PRE_ORDER);
+        if (!recurse)
         {
-            if (depth)
+            options.mMaxDepth = 1;
+        }
+
+        // Folders are dumped in pre-order, each one along with all its children
+        traverseTree(n, options, nullptr, [&](MegaNode *folder, const std::vector<MegaNode*> &children, int folderDepth)
+        {
+            // descendants are shown with their full paths
+            string pathToShow = getPathToShow(folder, folderDepth ? "NULL" : pathRelativeTo);
+
+            if (depth + folderDepth)
             {
                 OUTSTREAM << endl;
             }
@@ -1834,17 +2188,15 @@ void MegaCmdExecuter::dumpTreeSummary(MegaNode *n, const char *timeFormat, std::
                 OUTSTREAM << pathToShow << ":" << endl;
             }
 
-            for (int i = 0; i < children->size(); i++)
+            for (MegaNode *child : children)
             {
-                dumpNodeSummary(children->get(i), timeFormat, clflags, cloptions, humanreadable);
+                dumpNodeSummary(child, timeFormat, clflags, cloptions, humanreadable);
             }
 
             if (show_versions)
             {
-                for (int i = 0; i < children->size(); i++)
+                for (MegaNode *c : children)
                 {
-                    MegaNode *c = children->get(i);
-
                     MegaNodeList *vers = api->getVersions(c);
                     if (vers &&  vers->size() > 1)
                     {
@@ -1858,22 +2210,13 @@ void MegaCmdExecuter::dumpTreeSummary(MegaNode *n, const char *timeFormat, std::
                     delete vers;
                 }
             }
-
-            if (recurse)
-            {
-                for (int i = 0; i < children->size(); i++)
-                {
-                    MegaNode *c = children->get(i);
-                    dumpTreeSummary(c, timeFormat, clflags, cloptions, recurse, show_versions, depth + 1, humanreadable);
-                }
-            }
-            delete children;
-        }
+        });
     }
     else // file
     {
         if (!depth)
         {
+            string pathToShow = getPathToShow(n, pathRelativeTo);
 
             dumpNodeSummary(n, timeFormat, clflags, cloptions, humanreadable);
 
@@ -1895,7 +2238,6 @@ void MegaCmdExecuter::dumpTreeSummary(MegaNode *n, const char *timeFormat, std::
         }
 
     }
-    delete []nodepath;
 }
 
 
@@ -1944,6 +2286,208 @@ bool MegaCmdExecuter::TestCanWriteOnContainingFolder(string *path)
     return true;
 }
 
+std::optional<std::vector<ListingEntry>> MegaCmdExecuter::getDefaultOrderPage(MegaNode *folder, const ListingOrder &order, const ListingEntry *after, bool showCreationTime)
+{
+    // Resuming, the last entry is got along with the page, to check it is still at its position
+    const size_t first = after ? static_cast<size_t>(after->mSequence) : order.mOffset;
+    std::unique_ptr<MegaSearchFilter> filter(MegaSearchFilter::createInstance());
+    filter->byLocationHandle(folder->getHandle());
+    std::unique_ptr<MegaSearchPage> page(MegaSearchPage::createInstance(first, after ? order.mLimit + 1 : order.mLimit));
+    std::unique_ptr<MegaNodeList> children(api->getChildren(filter.get(), MegaApi::ORDER_DEFAULT_ASC, nullptr, page.get()));
+    if (after && (!children || !children->size() || children->get(0)->getHandle() != after->mHandle))
+    {
+        return std::nullopt;
+    }
+
+    std::vector<ListingEntry> selected;
+    for (int i = after ? 1 : 0; children && i < children->size(); i++)
+    {
+        ListingEntry entry = toListingEntry(children->get(i), order.mKey, showCreationTime);
+        entry.mSequence = first + static_cast<size_t>(i);
+        selected.push_back(std::move(entry));
+    }
+    return selected;
+}
+
+void MegaCmdExecuter::dumpSelectedListing(MegaNode *n, const ListingOrder &order, const std::optional<ListingCursor> &cursor, const char *timeFormat, std::map<std::string, int> *clflags, std::map<std::string, std::string> *cloptions, bool summary, int recurse, int extended_info, bool showversions, bool humanreadable)
+{
+    if (cursor && (cursor->mFolder != n->getHandle() || cursor->mKey != order.mKey
+                   || cursor->mReverse != order.mReverse || cursor->mRecursive != (recurse != 0)))
+    {
+        setCurrentThreadOutCode(MCMD_EARGS);
+        LOG_err << "The cursor given belongs to a different listing";
+        return;
+    }
+
+    ListingSelector selector(order);
+    if (cursor)
+    {
+        selector.startAfter(cursor->mLast);
+    }
+
+    std::vector<ListingEntry> selected;
+    bool startLost = false; // unsorted, the last entry of the previous page is not at its position anymore
+    const bool showCreationTime = getFlag(clflags, "show-creation-time");
+    if (n->getType() == MegaNode::TYPE_FILE)
+    {
+        selector.add(toListingEntry(n, order.mKey, showCreationTime));
+        selected = selector.take();
+    }
+    else if (!recurse && order.mKey == ListingSortKey::NONE && !order.mReverse && order.mLimit)
+    {
+        // Just the page, rather than every child, in the order children are got in
+        auto page = getDefaultOrderPage(n, order, cursor ? &cursor->mLast : nullptr, showCreationTime);
+        startLost = !page;
+        if (page)
+        {
+            selected = std::move(*page);
+        }
+    }
+    else
+    {
+        // Stopped as soon as no other node could be selected
+        CancellationToken stop;
+        TraversalOptions options = getTraversalOptions(TraversalOrder::PRE_ORDER);
+        options.mCancellationToken = stop;
+        if (!recurse)
+        {
+            options.mMaxDepth = 1;
+        }
+
+        traverseTree(n, options, [&](MegaNode *node, const VisitInfo &info)
+        {
+            if (selector.isComplete() || isCurrentThreadCancelled())
+            {
+                stop.cancel();
+            }
+            else if (info.mDepth)
+            {
+                selector.add(toListingEntry(node, order.mKey, showCreationTime));
+            }
+        });
+        selected = selector.take();
+        startLost = selector.isStartLost() && !isCurrentThreadCancelled();
+    }
+
+    if (startLost)
+    {
+        setCurrentThreadOutCode(MCMD_INVALIDSTATE);
+        LOG_err << "The listing changed since the cursor was given: list it again from its first page";
+        return;
+    }
+
+    // Only the nodes selected are got again and printed. Descendants are shown with their paths relative to n
+    std::unique_ptr<char[]> basePath(recurse ? getNodePath(n) : nullptr);
+    for (const auto &entry : selected)
+    {
+        if (isCurrentThreadCancelled())
+        {
+            break;
+        }
+
+        std::unique_ptr<MegaNode> node(api->getNodeByHandle(entry.mHandle));
+        if (!node)
+        {
+            continue; // removed meanwhile
+        }
+
+        string title = node->getName() ? node->getName() : "CRYPTO_ERROR";
+        if (basePath && node->getHandle() != n->getHandle())
+        {
+            std::unique_ptr<char[]> nodePath(getNodePath(node.get()));
+            const size_t baseSize = strlen(basePath.get());
+            if (nodePath && !strncmp(nodePath.get(), basePath.get(), baseSize))
+            {
+                title = nodePath.get() + baseSize;
+                if (title.size() && title[0] == '/')
+                {
+                    title.erase(0, 1);
+                }
+            }
+        }
+
+        if (summary)
+        {
+            dumpNodeSummary(node.get(), timeFormat, clflags, cloptions, humanreadable, title.c_str());
+        }
+        else
+        {
+            dumpNode(node.get(), timeFormat, clflags, cloptions, extended_info, showversions, 0, title.c_str());
+        }
+    }
+
+    // A full page: there may be more
+    if (order.mLimit && selected.size() == order.mLimit && !isCurrentThreadCancelled())
+    {
+        ListingCursor next;
+        next.mFolder = n->getHandle();
+        next.mKey = order.mKey;
+        next.mReverse = order.mReverse;
+        next.mRecursive = recurse != 0;
+        next.mLast = selected.back();
+        OUTSTREAM << "Next page: --cursor=" << next.encode() << endl;
+    }
+}
+
+void MegaCmdExecuter::exportNode(MegaNode *n, NodeExporter &exporter)
+{
+    ExportedNode exported;
+    exported.mHandle = n->getHandle();
+    if (n->getParentHandle() != UNDEF)
+    {
+        exported.mParentHandle = n->getParentHandle();
+    }
+    exported.mName = n->getName();
+    exported.mFingerprint = n->getFingerprint();
+
+    switch (n->getType())
+    {
+        case MegaNode::TYPE_FILE:       exported.mType = ExportedNodeType::FILE; break;
+        case MegaNode::TYPE_FOLDER:     exported.mType = ExportedNodeType::FOLDER; break;
+        case MegaNode::TYPE_ROOT:       exported.mType = ExportedNodeType::ROOT; break;
+        case MegaNode::TYPE_VAULT:      exported.mType = ExportedNodeType::VAULT; break;
+        case MegaNode::TYPE_RUBBISH:    exported.mType = ExportedNodeType::RUBBISH; break;
+        default:                        exported.mType = ExportedNodeType::UNKNOWN; break;
+    }
+
+    // As ls shows them: folders have no size, and show their creation time
+    if (n->getType() == MegaNode::TYPE_FILE)
+    {
+        exported.mSize = n->getSize();
+        exported.mTime = n->getModificationTime();
+        exported.mNumVersions = api->getNumVersions(n);
+    }
+    else
+    {
+        exported.mTime = n->getCreationTime();
+    }
+
+    exporter.write(exported);
+}
+
+void MegaCmdExecuter::exportListing(MegaNode *n, NodeExporter &exporter, bool recurse)
+{
+    if (n->getType() == MegaNode::TYPE_FILE)
+    {
+        exportNode(n, exporter);
+        return;
+    }
+
+    // Written as they are found, parents before their children
+    TraversalOptions options = getTraversalOptions(TraversalOrder::PRE_ORDER);
+    if (!recurse)
+    {
+        options.mMaxDepth = 1;
+    }
+    traverseTree(n, options, [this, &exporter](MegaNode *node, const VisitInfo &info)
+    {
+        if (info.mDepth)
+        {
+            exportNode(node, exporter);
+        }
+    });
+}
+
 std::unique_ptr<MegaContactRequest> MegaCmdExecuter::getPcrByContact(string contactEmail)
 {
     unique_ptr<MegaContactRequestList> icrl(api->getIncomingContactRequests());
@@ -1962,7 +2506,7 @@ std::unique_ptr<MegaContactRequest> MegaCmdExecuter::getPcrByContact(string cont
 
 string MegaCmdExecuter::getDisplayPath(string givenPath, MegaNode* n_param)
 {
-    char * pathToNode = api->getNodePath(n_param);
+    char * pathToNode = getNodePath(n_param);
     if (!pathToNode)
     {
         LOG_err << " GetNodePath failed for: " << givenPath;
@@ -1992,7 +2536,7 @@ string MegaCmdExecuter::getDisplayPath(string givenPath, MegaNode* n_param)
                 toret+="./";
                 if (n)
                 {
-                    char *npath = api->getNodePath(n);
+                    char *npath = getNodePath(n);
                     pathRelativeTo = string(npath);
                     delete []npath;
                 }
@@ -2011,7 +2555,7 @@ string MegaCmdExecuter::getDisplayPath(string givenPath, MegaNode* n_param)
                 delete aux;
                 if (n)
                 {
-                    char *npath = api->getNodePath(n);
+                    char *npath = getNodePath(n);
                     pathRelativeTo = string(npath);
                     delete []npath;
                 }
@@ -2556,6 +3100,19 @@ bool MegaCmdExecuter::actUponFetchNodes(MegaApi *api, SynchronousRequestListener
             mDeferredSharedFoldersVerifier.triggerDeferredSingleShot([this, api] { verifySharedFolders(api); });
         }
 
+        if (mPathCache)
+        {
+            mPathCache->clear();
+        }
+        if (mCompletionCache)
+        {
+            mCompletionCache->clear();
+        }
+        if (mSizeCache)
+        {
+            mSizeCache->clear();
+        }
+        requestNameIndexRebuild();
         return true;
     }
     else
@@ -2958,6 +3515,19 @@ void MegaCmdExecuter::actUponLogout(MegaApi& api, MegaError* e, bool keptSession
         LOG_verbose << "actUponLogout logout ok";
         cwd = UNDEF;
         session.reset();
+        clearNameIndex();
+        if (mPathCache)
+        {
+            mPathCache->clear();
+        }
+        if (mCompletionCache)
+        {
+            mCompletionCache->clear();
+        }
+        if (mSizeCache)
+        {
+            mSizeCache->clear();
+        }
         mtxSyncMap.lock();
         ConfigurationManager::unloadConfiguration();
         if (!keptSession)
@@ -3019,13 +3589,78 @@ int MegaCmdExecuter::actUponCreateFolder(SynchronousRequestListener *srl, int ti
     return 2;
 }
 
+namespace {
+// The outcome of the requests an item of a bulk operation made (one after the other), to report it once finished
+struct BulkItemOutcome
+{
+    std::vector<std::unique_ptr<MegaError>> mErrors; // one per request
+    MegaHandle mNodeHandle = INVALID_HANDLE; // of the last request (e.g: the node a copy created)
+
+    MegaError* getError(size_t request) const { return request < mErrors.size() ? mErrors[request].get() : nullptr; }
+    bool succeeded(size_t request) const { return getError(request) && getError(request)->getErrorCode() == MegaError::API_OK; }
+};
+
+using BulkItemRequest = std::function<void(MegaRequestListener *listener)>;
+// The request to follow the ones made so far, if any. Called from the SDK thread
+using BulkItemNext = std::function<BulkItemRequest(const BulkItemOutcome &outcome)>;
+
+void requestBulkItem(const std::shared_ptr<BulkItemOutcome> &outcome, const BulkItemRequest &request, const BulkItemNext &next,
+                     const BulkRequests::Completion &completion)
+{
+    request(new MegaCmdListenerFuncExecuter([outcome, next, completion](MegaApi*, MegaRequest *request, MegaError *e)
+    {
+        outcome->mErrors.emplace_back(e->copy());
+        outcome->mNodeHandle = request->getNodeHandle();
+
+        BulkItemRequest following = next ? next(*outcome) : nullptr;
+        if (following)
+        {
+            requestBulkItem(outcome, following, next, completion);
+            return;
+        }
+
+        int errorCode = MegaError::API_OK;
+        for (const auto &error : outcome->mErrors)
+        {
+            if (error->getErrorCode() != MegaError::API_OK)
+            {
+                errorCode = error->getErrorCode();
+                break;
+            }
+        }
+        completion(errorCode);
+    }, true));
+}
+
+// Submits an item made of a request (and the ones following it): its outcome is reported from the thread
+// submitting it, in order, as if it had been waited for
+void submitBulkItem(BulkRequests &bulk, BulkItemRequest request, BulkItemNext next, std::function<void(const BulkItemOutcome&)> report)
+{
+    auto outcome = std::make_shared<BulkItemOutcome>();
+    bulk.submit([outcome, request = std::move(request), next = std::move(next)](BulkRequests::Completion completion)
+    {
+        requestBulkItem(outcome, request, next, completion);
+    },
+    [outcome, report = std::move(report)](int)
+    {
+        report(*outcome);
+    });
+}
+}
+
+void MegaCmdExecuter::setMaxBulkRequestsInFlight(size_t maxInFlight)
+{
+    mMaxBulkRequestsInFlight = std::max<size_t>(maxInFlight, 1);
+}
+
 void MegaCmdExecuter::confirmDelete()
 {
     if (mNodesToConfirmDelete.size())
     {
         std::unique_ptr<MegaNode> nodeToConfirmDelete = std::move(mNodesToConfirmDelete.front());
         mNodesToConfirmDelete.erase(mNodesToConfirmDelete.begin());
-        doDeleteNode(nodeToConfirmDelete, api);
+        BulkRequests bulk(1);
+        doDeleteNode(nodeToConfirmDelete, api, bulk);
     }
 
 
@@ -3065,12 +3700,14 @@ void MegaCmdExecuter::discardDelete()
 
 void MegaCmdExecuter::confirmDeleteAll()
 {
+    BulkRequests bulk(mMaxBulkRequestsInFlight);
     while (mNodesToConfirmDelete.size())
     {
         std::unique_ptr<MegaNode> nodeToConfirmDelete = std::move(mNodesToConfirmDelete.front());
         mNodesToConfirmDelete.erase(mNodesToConfirmDelete.begin());
-        doDeleteNode(nodeToConfirmDelete, api);
+        doDeleteNode(nodeToConfirmDelete, api, bulk);
     }
+    bulk.waitAll();
 
     setprompt(COMMAND);
 }
@@ -3082,50 +3719,53 @@ void MegaCmdExecuter::discardDeleteAll()
 }
 
 
-void MegaCmdExecuter::doDeleteNode(const std::unique_ptr<MegaNode>& nodeToDelete, MegaApi* api)
+void MegaCmdExecuter::doDeleteNode(const std::unique_ptr<MegaNode>& nodeToDelete, MegaApi* api, BulkRequests &bulk)
 {
-    char* nodePath = api->getNodePath(nodeToDelete.get());
+    std::unique_ptr<char[]> nodePath(api->getNodePath(nodeToDelete.get()));
+    std::optional<string> path;
     if (nodePath)
     {
-        LOG_verbose << "Deleting: "<< nodePath;
-    }
-    else
-    {
-        LOG_warn << "Deleting node whose path could not be found " << nodeToDelete->getName();
+        path = nodePath.get();
     }
 
-    MegaCmdListener* megaCmdListener = new MegaCmdListener(api, nullptr);
     std::unique_ptr<MegaNode> parent(api->getParentNode(nodeToDelete.get()));
-    if (parent && parent->getType() == MegaNode::TYPE_FILE)
+    const bool isVersion = parent && parent->getType() == MegaNode::TYPE_FILE;
+    std::shared_ptr<MegaNode> node(nodeToDelete->copy());
+    submitBulkItem(bulk, [api, node, isVersion](MegaRequestListener *listener)
     {
-        api->removeVersion(nodeToDelete.get(), megaCmdListener);
-    }
-    else
+        if (isVersion)
+        {
+            api->removeVersion(node.get(), listener);
+        }
+        else
+        {
+            api->remove(node.get(), listener);
+        }
+    }, nullptr, [this, node, path](const BulkItemOutcome &outcome)
     {
-        api->remove(nodeToDelete.get(), megaCmdListener);
-    }
-    megaCmdListener->wait();
+        // Logged along with the result, for the output to read as when waiting for each node
+        if (path)
+        {
+            LOG_verbose << "Deleting: "<< *path;
+        }
+        else
+        {
+            LOG_warn << "Deleting node whose path could not be found " << node->getName();
+        }
 
-    string msj = "delete node ";
-    if (nodePath)
-    {
-        msj += nodePath;
-    }
-    else
-    {
-        msj += nodeToDelete->getName();
-    }
-    checkNoErrors(megaCmdListener->getError(), msj);
-    delete megaCmdListener;
-    delete []nodePath;
+        string msj = "delete node ";
+        msj += path ? *path : node->getName();
+        checkNoErrors(outcome.getError(0), msj);
+    });
 }
 
-int MegaCmdExecuter::deleteNodeVersions(const std::unique_ptr<MegaNode>& nodeToDelete, MegaApi* api, int force)
+int MegaCmdExecuter::deleteNodeVersions(const std::unique_ptr<MegaNode>& nodeToDelete, MegaApi* api, int force, BulkRequests &bulk)
 {
     if (nodeToDelete->getType() == MegaNode::TYPE_FILE && api->getNumVersions(nodeToDelete.get()) < 2)
     {
         if (!force)
         {
+            bulk.waitAll(); // after the results of the previous ones
             LOG_err << "No versions found for " << nodeToDelete->getName();
         }
         return MCMDCONFIRM_YES; //nothing to do, no sense asking
@@ -3139,19 +3779,27 @@ int MegaCmdExecuter::deleteNodeVersions(const std::unique_ptr<MegaNode>& nodeToD
         confirmationQuery += nodeToDelete->getName();
         confirmationQuery += "? (Yes/No): ";
 
+        if (!force)
+        {
+            bulk.waitAll();
+        }
         confirmationResponse = force?MCMDCONFIRM_ALL:askforConfirmation(confirmationQuery);
 
         if (confirmationResponse == MCMDCONFIRM_YES || confirmationResponse == MCMDCONFIRM_ALL)
         {
-            auto children = std::unique_ptr<MegaNodeList>(api->getChildren(nodeToDelete.get()));
-            if (children)
+            // Gather the versioned files first: removals are then requested one by one
+            std::vector<std::unique_ptr<MegaNode>> versionedFiles;
+            traverseTree(nodeToDelete.get(), getTraversalOptions(TraversalOrder::PRE_ORDER), [&versionedFiles, api](MegaNode *node, const VisitInfo&)
             {
-                for (int i = 0; i < children->size(); i++)
+                if (node->getType() == MegaNode::TYPE_FILE && api->getNumVersions(node) >= 2)
                 {
-                    auto child = std::unique_ptr<MegaNode>(children->get(i)); // wrap the pointer into the expected type by deleteNodeVersion
-                    deleteNodeVersions(child, api, true);
-                    child.release(); // the MegaNodeList owns the child, we don't want to double free it
+                    versionedFiles.emplace_back(node->copy());
                 }
+            });
+
+            for (size_t i = 0; i < versionedFiles.size() && !isCurrentThreadCancelled(); i++)
+            {
+                deleteNodeVersions(versionedFiles[i], api, true, bulk);
             }
         }
     }
@@ -3161,6 +3809,10 @@ int MegaCmdExecuter::deleteNodeVersions(const std::unique_ptr<MegaNode>& nodeToD
         string confirmationQuery("Are you sure todelete the version histories of ");
         confirmationQuery += nodeToDelete->getName();
         confirmationQuery += "? (Yes/No): ";
+        if (!force)
+        {
+            bulk.waitAll();
+        }
         confirmationResponse = force?MCMDCONFIRM_ALL:askforConfirmation(confirmationQuery);
 
         if (confirmationResponse == MCMDCONFIRM_YES || confirmationResponse == MCMDCONFIRM_ALL)
@@ -3175,17 +3827,20 @@ int MegaCmdExecuter::deleteNodeVersions(const std::unique_ptr<MegaNode>& nodeToD
 
                     if (versionNode->getHandle() != nodeToDelete->getHandle())
                     {
-                        MegaCmdListener *megaCmdListener = new MegaCmdListener(NULL);
-                        api->removeVersion(versionNode,megaCmdListener);
-                        megaCmdListener->wait();
-                        string fullname(versionNode->getName()?versionNode->getName():"NO_NAME");
-                        fullname += "#";
-                        fullname += SSTR(versionNode->getModificationTime());
-                        if (checkNoErrors(megaCmdListener->getError(), "remove version: "+fullname))
+                        std::shared_ptr<MegaNode> version(versionNode->copy());
+                        submitBulkItem(bulk, [api, version](MegaRequestListener *listener)
                         {
-                            LOG_verbose << " Removed " << fullname << " (" << getReadableTime(versionNode->getModificationTime()) << ")";
-                        }
-                        delete megaCmdListener;
+                            api->removeVersion(version.get(), listener);
+                        }, nullptr, [this, version](const BulkItemOutcome &outcome)
+                        {
+                            string fullname(version->getName()?version->getName():"NO_NAME");
+                            fullname += "#";
+                            fullname += SSTR(version->getModificationTime());
+                            if (checkNoErrors(outcome.getError(0), "remove version: "+fullname))
+                            {
+                                LOG_verbose << " Removed " << fullname << " (" << getReadableTime(version->getModificationTime()) << ")";
+                            }
+                        });
                     }
                 }
                 delete versionsToDelete;
@@ -3201,12 +3856,14 @@ int MegaCmdExecuter::deleteNodeVersions(const std::unique_ptr<MegaNode>& nodeToD
  * @param api
  * @param recursive
  * @param force
+ * @param bulk the removal is submitted to (its result is reported once finished)
  * @return confirmation code
  */
-int MegaCmdExecuter::deleteNode(const std::unique_ptr<MegaNode>& nodeToDelete, MegaApi* api, int recursive, int force)
+int MegaCmdExecuter::deleteNode(const std::unique_ptr<MegaNode>& nodeToDelete, MegaApi* api, int recursive, int force, BulkRequests &bulk)
 {
     if (nodeToDelete->getType() != MegaNode::TYPE_FILE && !recursive)
     {
+        bulk.waitAll(); // after the results of the previous ones
         char* nodePath = api->getNodePath(nodeToDelete.get());
         setCurrentThreadOutCode(MCMD_INVALIDTYPE);
         LOG_err << "Unable to delete folder: " << nodePath << ". Use -r to delete a folder recursively";
@@ -3244,12 +3901,13 @@ int MegaCmdExecuter::deleteNode(const std::unique_ptr<MegaNode>& nodeToDelete, M
             confirmationQuery += nodeToDelete->getName();
             confirmationQuery += " ? (Yes/No/All/None): ";
 
+            bulk.waitAll();
             int confirmationResponse = askforConfirmation(confirmationQuery);
 
             if (confirmationResponse == MCMDCONFIRM_YES || confirmationResponse == MCMDCONFIRM_ALL)
             {
                 LOG_debug << "confirmation received";
-                doDeleteNode(nodeToDelete, api);
+                doDeleteNode(nodeToDelete, api, bulk);
             }
             else
             {
@@ -3259,7 +3917,7 @@ int MegaCmdExecuter::deleteNode(const std::unique_ptr<MegaNode>& nodeToDelete, M
         }
         else //force
         {
-            doDeleteNode(nodeToDelete, api);
+            doDeleteNode(nodeToDelete, api, bulk);
             return MCMDCONFIRM_ALL;
         }
     }
@@ -3858,11 +4516,19 @@ int MegaCmdExecuter::makedir(string remotepath, bool recursive, MegaNode *parent
 
 string MegaCmdExecuter::getCurrentPath()
 {
+    if (mPathCache)
+    {
+        if (auto path = mPathCache->getPath(cwd))
+        {
+            return *path;
+        }
+    }
+
     string toret;
     MegaNode *ncwd = api->getNodeByHandle(cwd);
     if (ncwd)
     {
-        char *currentPath = api->getNodePath(ncwd);
+        char *currentPath = getNodePath(ncwd);
         toret = string(currentPath);
         delete []currentPath;
         delete ncwd;
@@ -3870,81 +4536,238 @@ string MegaCmdExecuter::getCurrentPath()
     return toret;
 }
 
-long long MegaCmdExecuter::getVersionsSize(MegaNode *n)
+long long MegaCmdExecuter::getOwnVersionsSize(MegaNode *n)
 {
-    long long toret = 0;
+    long long size = 0;
+    std::unique_ptr<MegaNodeList> versionNodes(api->getVersions(n));
+    for (int i = 0; versionNodes && i < versionNodes->size(); i++)
+    {
+        size += api->getSize(versionNodes->get(i));
+    }
+    return size;
+}
 
-    MegaNodeList *versionNodes = api->getVersions(n);
-    if (versionNodes)
+long long MegaCmdExecuter::getVersionsSize(MegaNode *n)
+{
+    if (!mSizeCache || n->getType() == MegaNode::TYPE_FILE)
     {
-        for (int i = 0; i < versionNodes->size(); i++)
+        std::atomic<long long> toret(0);
+        traverseTree(n, getTraversalOptions(TraversalOrder::UNORDERED), [this, &toret](MegaNode *node, const VisitInfo&)
         {
-            MegaNode *versionNode = versionNodes->get(i);
-            toret += api->getSize(versionNode);
-        }
-        delete versionNodes;
+            if (node->getType() == MegaNode::TYPE_FILE)
+            {
+                toret += getOwnVersionsSize(node);
+            }
+        });
+        return toret;
     }
 
-    MegaNodeList *children = api->getChildren(n);
-    if (children)
+    if (auto cached = mSizeCache->get(n->getHandle()))
     {
-        for (int i = 0; i < children->size(); i++)
-        {
-            MegaNode *child = children->get(i);
-            toret += getVersionsSize(child);
-        }
-        delete children;
+        return cached->mVersionBytes;
     }
-    return toret;
-}
 
-vector<string> MegaCmdExecuter::listpaths(bool usepcre, string askedPath, bool discardFiles)
-{
-    vector<string> paths;
-    if ((int)askedPath.size())
+    // The versions of the files are got as folders are expanded, then the folders are summed up from the deepest ones.
+    // Subfolders already cached are not expanded: nothing is got below them
+    struct Folder
     {
-        vector<string> *pathsToList = nodesPathsbypath(askedPath.c_str(), usepcre);
-        if (pathsToList)
+        MegaHandle mParent = INVALID_HANDLE;
+        int mDepth = 0;
+        long long mVersionBytes = 0;
+        std::vector<FolderSizeCache::Handle> mChildren;
+    };
+    std::mutex foldersMutex;
+    std::unordered_map<MegaHandle, Folder> folders;
+    std::vector<std::pair<MegaHandle, long long>> cachedSubfolders; // their parents, and their sizes of versions
+
+    const uint64_t generation = mSizeCache->getGeneration(); // before reading anything
+    const bool completed = traverseTree(n, getTraversalOptions(TraversalOrder::UNORDERED), nullptr,
+        [this, &foldersMutex, &folders](MegaNode *folderNode, const std::vector<MegaNode*> &children, int depth)
         {
-            for (std::vector< string >::iterator it = pathsToList->begin(); it != pathsToList->end(); ++it)
+            Folder folder;
+            folder.mParent = folderNode->getParentHandle();
+            folder.mDepth = depth;
+            for (MegaNode *child : children)
             {
-                string nodepath= *it;
-                MegaNode *ncwd = api->getNodeByHandle(cwd);
-                if (ncwd)
-                {
-                    std::unique_ptr<MegaNode> n = nodebypath(nodepath.c_str());
-                    if (n)
-                    {
-                        if (n->getType() != MegaNode::TYPE_FILE)
-                        {
-                            nodepath += "/";
-                        }
-                        if (!(discardFiles && (n->getType() == MegaNode::TYPE_FILE)))
-                        {
-                            paths.push_back(nodepath);
-                        }
-                    }
-                    else
-                    {
-                        LOG_debug << "Unexpected: matching path has no associated node: " << nodepath << ". Could have been deleted in the process";
-                    }
-                    delete ncwd;
-                }
-                else
+                folder.mChildren.push_back(child->getHandle());
+                if (child->getType() == MegaNode::TYPE_FILE)
                 {
-                    setCurrentThreadOutCode(MCMD_INVALIDSTATE);
-                    LOG_err << "Couldn't find woking folder (it might been deleted)";
+                    folder.mVersionBytes += getOwnVersionsSize(child);
                 }
             }
-            pathsToList->clear();
-            delete pathsToList;
+
+            std::lock_guard<std::mutex> guard(foldersMutex);
+            folders.emplace(folderNode->getHandle(), std::move(folder));
+        },
+        [this, &foldersMutex, &cachedSubfolders](MegaNode *subfolder)
+        {
+            auto cached = mSizeCache->get(subfolder->getHandle());
+            if (!cached)
+            {
+                return true;
+            }
+
+            std::lock_guard<std::mutex> guard(foldersMutex);
+            cachedSubfolders.emplace_back(subfolder->getParentHandle(), cached->mVersionBytes);
+            return false;
+        });
+
+    if (!completed)
+    {
+        return 0;
+    }
+
+    for (const auto &[parent, versionBytes] : cachedSubfolders)
+    {
+        folders.at(parent).mVersionBytes += versionBytes;
+    }
+
+    std::vector<std::pair<MegaHandle, Folder*>> deepestFirst;
+    deepestFirst.reserve(folders.size());
+    for (auto &folder : folders)
+    {
+        deepestFirst.emplace_back(folder.first, &folder.second);
+    }
+    std::sort(deepestFirst.begin(), deepestFirst.end(), [](const auto &a, const auto &b) { return a.second->mDepth > b.second->mDepth; });
+
+    for (auto &[handle, folder] : deepestFirst)
+    {
+        mSizeCache->store(handle, folder->mParent, FolderSizeCache::Aggregate{folder->mVersionBytes}, folder->mChildren, generation);
+        if (folder->mDepth > 0)
+        {
+            folders.at(folder->mParent).mVersionBytes += folder->mVersionBytes;
         }
     }
 
-    return paths;
+    auto root = folders.find(n->getHandle());
+    return root != folders.end() ? root->second.mVersionBytes : 0;
 }
 
-#ifdef _WIN32
+std::optional<vector<string>> MegaCmdExecuter::listCachedPaths(const string &askedPath, bool discardFiles)
+{
+    // Patterns, escaped characters, versions, shares and such are left to nodesPathsbypath
+    if (askedPath.empty() || askedPath.back() != '*')
+    {
+        return std::nullopt;
+    }
+    const string typed = askedPath.substr(0, askedPath.size() - 1);
+    if (typed.find_first_of("*?\\:#") != string::npos || typed.find("//") != string::npos)
+    {
+        return std::nullopt;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    // The folder part is kept as typed, as nodesPathsbypath does
+    const size_t lastSeparator = typed.rfind('/');
+    const string folderPath = lastSeparator == string::npos ? string() : typed.substr(0, lastSeparator + 1);
+    const string prefix = typed.substr(folderPath.size());
+
+    std::unique_ptr<MegaNode> folder;
+    if (folderPath.empty())
+    {
+        folder.reset(api->getNodeByHandle(cwd));
+    }
+    else
+    {
+        folder = nodebypath(folderPath.size() > 1 ? folderPath.substr(0, folderPath.size() - 1).c_str() : folderPath.c_str());
+    }
+    if (!folder || folder->getType() == MegaNode::TYPE_FILE)
+    {
+        return std::nullopt;
+    }
+
+    auto children = mCompletionCache->find(folder->getHandle(), prefix);
+    const bool cached = children.has_value();
+    if (!cached)
+    {
+        const uint64_t generation = mCompletionCache->getGeneration(); // before listing
+        std::unique_ptr<MegaNodeList> list(api->getChildren(folder.get()));
+        std::vector<CompletionCache::Child> listed;
+        listed.reserve(list ? static_cast<size_t>(list->size()) : 0);
+        for (int i = 0; list && i < list->size(); i++)
+        {
+            MegaNode *child = list->get(i);
+            listed.push_back({child->getName() ? child->getName() : "", child->getHandle(), child->getType() == MegaNode::TYPE_FILE});
+        }
+        mCompletionCache->put(folder->getHandle(), std::move(listed), generation);
+
+        children = mCompletionCache->find(folder->getHandle(), prefix);
+        if (!children) // changed meanwhile, or too large to be kept
+        {
+            return std::nullopt;
+        }
+    }
+
+    vector<string> paths;
+    for (const auto &child : *children)
+    {
+        if (!(discardFiles && child.mIsFile))
+        {
+            paths.push_back(folderPath + child.mName + (child.mIsFile ? "" : "/"));
+        }
+    }
+
+    LOG_verbose << "Completion of " << askedPath << ": " << paths.size() << " paths " << (cached ? "from the cache" : "listed")
+                << " in " << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms";
+    return paths;
+}
+
+vector<string> MegaCmdExecuter::listpaths(bool usepcre, string askedPath, bool discardFiles)
+{
+    if (mCompletionCache && !usepcre)
+    {
+        if (auto paths = listCachedPaths(askedPath, discardFiles))
+        {
+            return *paths;
+        }
+    }
+
+    vector<string> paths;
+    if ((int)askedPath.size())
+    {
+        vector<string> *pathsToList = nodesPathsbypath(askedPath.c_str(), usepcre);
+        if (pathsToList)
+        {
+            for (std::vector< string >::iterator it = pathsToList->begin(); it != pathsToList->end(); ++it)
+            {
+                string nodepath= *it;
+                MegaNode *ncwd = api->getNodeByHandle(cwd);
+                if (ncwd)
+                {
+                    std::unique_ptr<MegaNode> n = nodebypath(nodepath.c_str());
+                    if (n)
+                    {
+                        if (n->getType() != MegaNode::TYPE_FILE)
+                        {
+                            nodepath += "/";
+                        }
+                        if (!(discardFiles && (n->getType() == MegaNode::TYPE_FILE)))
+                        {
+                            paths.push_back(nodepath);
+                        }
+                    }
+                    else
+                    {
+                        LOG_debug << "Unexpected: matching path has no associated node: " << nodepath << ". Could have been deleted in the process";
+                    }
+                    delete ncwd;
+                }
+                else
+                {
+                    setCurrentThreadOutCode(MCMD_INVALIDSTATE);
+                    LOG_err << "Couldn't find woking folder (it might been deleted)";
+                }
+            }
+            pathsToList->clear();
+            delete pathsToList;
+        }
+    }
+
+    return paths;
+}
+
+#ifdef _WIN32
 //TODO: try to use these functions from somewhere else
 static std::wstring toUtf16String(const std::string& s, UINT codepage = CP_UTF8)
 {
@@ -4691,69 +5514,234 @@ void MegaCmdExecuter::printBackup(backup_struct *backupstruct, const char *timeF
     }
 }
 
-void MegaCmdExecuter::doFind(MegaNode* nodeBase, const char *timeFormat, std::map<std::string, int> *clflags, std::map<std::string, std::string> *cloptions, string word, int printfileinfo, string pattern, bool usepcre, m_time_t minTime, m_time_t maxTime, int64_t minSize, int64_t maxSize)
+namespace {
+// Beyond this many names matched in the name index, the folders to sort them by would take too much memory:
+// find traverses the tree instead, printing matches as they are found
+constexpr size_t sMaxSortedFindResults = 1 << 20;
+
+bool matchesFindQuery(const FindQuery &query, MegaNode *n, int depth)
+{
+    FindCandidate candidate;
+    candidate.mIsFile = n->getType() == MegaNode::TYPE_FILE;
+    candidate.mIsFolder = n->getType() == MegaNode::TYPE_FOLDER;
+    candidate.mName = n->getName();
+    candidate.mTime = n->getModificationTime();
+    candidate.mSize = n->getSize();
+    candidate.mDepth = depth;
+    return query.matches(candidate);
+}
+}
+
+void MegaCmdExecuter::doFind(MegaNode* nodeBase, const char *timeFormat, std::map<std::string, int> *clflags, std::map<std::string, std::string> *cloptions, string word, int printfileinfo, const PatternMatcher &matcher, const FindQuery &query, const ListingOrder &order, NodeExporter *exporter)
 {
-    struct criteriaNodeVector pnv;
-    pnv.pattern = pattern;
+    auto start = std::chrono::steady_clock::now();
+    auto elapsedMs = [&start]() { return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count(); };
+
+    const bool showFullPath = word.size() > 0 && ( (word.find("/") == 0) || (word.find("..") != string::npos));
+    size_t numMatches = 0;
+    auto printMatch = [&](MegaNode *n)
+    {
+        if (!numMatches++)
+        {
+            LOG_verbose << "find: first result after " << elapsedMs() << " ms";
+        }
+
+        if (exporter)
+        {
+            exportNode(n, *exporter);
+            return;
+        }
+
+        string pathToShow;
+        if (showFullPath)
+        {
+            std::unique_ptr<char[]> nodepath(getNodePath(n));
+            pathToShow = nodepath ? nodepath.get() : "";
+        }
+        else
+        {
+            pathToShow = getDisplayPath("", n);
+        }
 
-    vector<MegaNode *> listOfMatches;
-    pnv.nodesMatching = &listOfMatches;
-    pnv.usepcre = usepcre;
+        if (getFlag(clflags, "print-only-handles"))
+        {
+            OUTSTREAM << "H:" << handleToBase64(n->getHandle()) << "" << endl;
+        }
+        else if (printfileinfo)
+        {
+            dumpNode(n, timeFormat, clflags, cloptions, 3, false, 1, pathToShow.c_str());
+        }
+        else
+        {
+            OUTSTREAM << pathToShow;
 
-    pnv.minTime = minTime;
-    pnv.maxTime = maxTime;
-    pnv.minSize = minSize;
-    pnv.maxSize = maxSize;
-    auto opt = getOption(cloptions, "type", "");
-    pnv.mType = opt == "f" ? MegaNode::TYPE_FILE : (opt == "d" ? MegaNode::TYPE_FOLDER : MegaNode::TYPE_UNKNOWN);
+            if (getFlag(clflags, "show-handles"))
+            {
+                OUTSTREAM << " <H:" << handleToBase64(n->getHandle()) << ">";
+            }
 
+            OUTSTREAM << endl;
+        }
+        //notice: some nodes may be dumped twice
+    };
 
-    processTree(nodeBase, includeIfMatchesCriteria, (void*)&pnv);
+    if (!query.isSatisfiable())
+    {
+        LOG_verbose << "find: no node can match the criteria given";
+        return;
+    }
+    LOG_debug << "find: checking " << query.describe();
 
+    // Every criterion is checked on the actual nodes, cheapest first
+    size_t numVisited = 0;
+    size_t numMatched = 0;
+    std::function<void(MegaNode*)> onMatch;
+    auto visit = [&query, &numVisited, &numMatched, &onMatch](MegaNode *n, int depth)
+    {
+        ++numVisited;
+        if (matchesFindQuery(query, n, depth))
+        {
+            ++numMatched;
+            onMatch(n);
+        }
+    };
 
-    for (std::vector< MegaNode * >::iterator it = listOfMatches.begin(); it != listOfMatches.end(); ++it)
+    // Depths are unknown to the name index
+    std::optional<std::vector<NodeNameIndex::Handle>> indexed;
+    if (mNameIndex && !query.usesDepth())
     {
-        MegaNode * n = *it;
-        if (n)
+        indexed = mNameIndex->find(nodeBase->getHandle(), matcher);
+        if (indexed)
+        {
+            LOG_verbose << "find: " << indexed->size() << " names matched in the name index in " << elapsedMs() << " ms";
+        }
+        if (indexed && indexed->size() > sMaxSortedFindResults)
         {
-            string pathToShow;
+            LOG_debug << "find: too many names matched to sort them. Traversing the tree instead";
+            indexed.reset();
+        }
+    }
 
-            if ( word.size() > 0 && ( (word.find("/") == 0) || (word.find("..") != string::npos)) )
+    // Sorted or limited results: only the ones selected are kept, and their nodes got again to be printed
+    std::optional<ListingSelector> selector;
+    if (!order.isDefault())
+    {
+        selector.emplace(order);
+    }
+    auto select = [&selector, &order](MegaNode *n)
+    {
+        selector->add(toListingEntry(n, order.mKey, false));
+    };
+
+    auto matchIndexed = [this, &indexed, &visit]()
+    {
+        for (size_t i = 0; i < indexed->size() && !isCurrentThreadCancelled(); i++)
+        {
+            std::unique_ptr<MegaNode> n(api->getNodeByHandle((*indexed)[i]));
+            if (n)
             {
-                char * nodepath = api->getNodePath(n);
-                pathToShow = string(nodepath);
-                delete [] nodepath;
+                visit(n.get(), 0);
             }
-            else
+        }
+        indexed.reset();
+    };
+
+    // Children before their parents, as find has always listed them. Nothing deeper than the max depth is expanded
+    auto matchTraversed = [this, nodeBase, &query, &visit]()
+    {
+        if (!nodeBase || isCurrentThreadCancelled())
+        {
+            return;
+        }
+
+        TraversalOptions options = getTraversalOptions(TraversalOrder::POST_ORDER);
+        options.mMaxDepth = query.getMaxDepth();
+        traverseTree(nodeBase, options, [&visit](MegaNode *n, const VisitInfo &info)
+        {
+            visit(n, info.mDepth);
+        });
+    };
+
+    if (indexed && selector && order.mKey != ListingSortKey::NONE)
+    {
+        onMatch = select;
+        matchIndexed();
+    }
+    else if (indexed)
+    {
+        // Results are sorted close to the order the traversal finds them in: only their keys and the ones of the folders
+        // they are in (as indexed, rather than got from the SDK) are kept
+        vector<ListingEntry> sorted;
+        onMatch = [this, nodeBase, &sorted](MegaNode *n)
+        {
+            ListingEntry entry = toListingEntry(n, ListingSortKey::NAME, false);
+            if (auto lineage = mNameIndex->getLineage(n->getHandle(), nodeBase->getHandle()))
             {
-                pathToShow = getDisplayPath("", n);
+                for (size_t i = 0; i + 1 < lineage->size(); i++)
+                {
+                    entry.mAncestors.push_back(ListingKey{true, (*lineage)[i].mName, (*lineage)[i].mHandle});
+                }
             }
-            if (getFlag(clflags, "print-only-handles"))
+            sorted.push_back(std::move(entry));
+        };
+        matchIndexed();
+
+        std::sort(sorted.begin(), sorted.end(), [](const ListingEntry &a, const ListingEntry &b)
+        {
+            return compareFindOrder(a, b) < 0;
+        });
+        for (size_t i = 0; i < sorted.size() && !isCurrentThreadCancelled(); i++)
+        {
+            if (selector)
             {
-                OUTSTREAM << "H:" << handleToBase64(n->getHandle()) << "" << endl;
+                ListingEntry entry;
+                entry.mHandle = sorted[i].mHandle;
+                selector->add(std::move(entry));
+                continue;
             }
-            else if (printfileinfo)
+
+            std::unique_ptr<MegaNode> n(api->getNodeByHandle(sorted[i].mHandle));
+            if (n)
             {
-                dumpNode(n, timeFormat, clflags, cloptions, 3, false, 1, pathToShow.c_str());
+                printMatch(n.get());
             }
-            else
-            {
-                OUTSTREAM << pathToShow;
-
-                if (getFlag(clflags, "show-handles"))
-                {
-                    OUTSTREAM << " <H:" << handleToBase64(n->getHandle()) << ">";
-                }
+        }
+    }
+    else if (selector)
+    {
+        onMatch = select;
+        matchTraversed();
+    }
+    else
+    {
+        // Matches are printed as the traversal finds them, without keeping any
+        onMatch = printMatch;
+        matchTraversed();
+    }
 
-                OUTSTREAM << endl;
+    if (selector)
+    {
+        for (const auto &entry : selector->take())
+        {
+            if (isCurrentThreadCancelled())
+            {
+                break;
             }
-            //notice: some nodes may be dumped twice
 
-            delete n;
+            std::unique_ptr<MegaNode> n(api->getNodeByHandle(entry.mHandle));
+            if (n)
+            {
+                printMatch(n.get());
+            }
         }
     }
 
-    listOfMatches.clear();
+    LOG_verbose << "find: " << numVisited << " nodes visited, " << numMatched << " matched, " << numMatches << " results in " << elapsedMs() << " ms";
+    if (mPathCache)
+    {
+        auto stats = mPathCache->getStats();
+        LOG_debug << "Path cache: " << stats.mNumEntries << "/" << stats.mCapacity << " folders, " << stats.mHits << " hits, " << stats.mMisses << " misses";
+    }
 }
 
 string MegaCmdExecuter::getLPWD()
@@ -4771,7 +5759,7 @@ string MegaCmdExecuter::getLPWD()
 }
 
 
-void MegaCmdExecuter::moveToDestination(const std::unique_ptr<MegaNode>& n, string destiny)
+void MegaCmdExecuter::moveToDestination(const std::unique_ptr<MegaNode>& n, string destiny, BulkRequests &bulk)
 {
     assert(n);
 
@@ -4782,6 +5770,9 @@ void MegaCmdExecuter::moveToDestination(const std::unique_ptr<MegaNode>& n, stri
     string newname;
     std::unique_ptr<MegaNode> tn = nodebypath(destiny.c_str(), nullptr, &newname); // target node
 
+    MegaApi *api = this->api;
+    std::shared_ptr<MegaNode> source(n->copy());
+
     // we have four situations:
     // 1. target path does not exist - fail
     // 2. target node exists and is folder - move
@@ -4789,8 +5780,10 @@ void MegaCmdExecuter::moveToDestination(const std::unique_ptr<MegaNode>& n, stri
     // 4. target path exists, but filename does not - rename
     if (tn)
     {
+        std::shared_ptr<MegaNode> target(tn->copy());
         if (tn->getHandle() == n->getHandle())
         {
+            bulk.waitAll(); // after the results of the previous ones
             LOG_err << "Source and destiny are the same";
         }
         else
@@ -4799,30 +5792,37 @@ void MegaCmdExecuter::moveToDestination(const std::unique_ptr<MegaNode>& n, stri
             {
                 if (tn->getType() == MegaNode::TYPE_FILE)
                 {
+                    bulk.waitAll();
                     setCurrentThreadOutCode(MCMD_INVALIDTYPE);
                     LOG_err << destiny << ": Not a directory";
                     return;
                 }
                 else //move and rename!
                 {
-                    MegaCmdListener *megaCmdListener = new MegaCmdListener(nullptr);
-                    api->moveNode(n.get(), tn.get(), megaCmdListener);
-                    megaCmdListener->wait();
-
-                    if (checkNoErrors(megaCmdListener->getError(), "move"))
+                    submitBulkItem(bulk, [api, source, target](MegaRequestListener *listener)
                     {
-                        MegaCmdListener *megaCmdListener = new MegaCmdListener(nullptr);
-                        api->renameNode(n.get(), newname.c_str(), megaCmdListener);
-                        megaCmdListener->wait();
-
-                        checkNoErrors(megaCmdListener->getError(), "rename");
-                        delete megaCmdListener;
-                    }
-                    else
+                        api->moveNode(source.get(), target.get(), listener);
+                    }, [api, source, newname](const BulkItemOutcome &outcome) -> BulkItemRequest
                     {
-                        LOG_debug << "Won't rename, since move failed " << n->getName() << " to " << tn->getName() << " : " << megaCmdListener->getError()->getErrorCode();
-                    }
-                    delete megaCmdListener;
+                        if (outcome.mErrors.size() > 1 || !outcome.succeeded(0))
+                        {
+                            return nullptr;
+                        }
+                        return [api, source, newname](MegaRequestListener *listener)
+                        {
+                            api->renameNode(source.get(), newname.c_str(), listener);
+                        };
+                    }, [this, source, target](const BulkItemOutcome &outcome)
+                    {
+                        if (checkNoErrors(outcome.getError(0), "move"))
+                        {
+                            checkNoErrors(outcome.getError(1), "rename");
+                        }
+                        else
+                        {
+                            LOG_debug << "Won't rename, since move failed " << source->getName() << " to " << target->getName() << " : " << outcome.getError(0)->getErrorCode();
+                        }
+                    });
                 }
             }
             else //target found
@@ -4830,69 +5830,72 @@ void MegaCmdExecuter::moveToDestination(const std::unique_ptr<MegaNode>& n, stri
                 if (tn->getType() == MegaNode::TYPE_FILE) //move & remove old & rename new
                 {
                     // (there should never be any orphaned filenodes)
-                    std::unique_ptr<MegaNode> tnParentNode(api->getNodeByHandle(tn->getParentHandle()));
+                    std::shared_ptr<MegaNode> tnParentNode(api->getNodeByHandle(tn->getParentHandle()));
                     if (tnParentNode)
                     {
-                        //move into the parent of target node
-                        MegaCmdListener *megaCmdListener = new MegaCmdListener(nullptr);
-                        std::unique_ptr<MegaNode> parentNode(api->getNodeByHandle(tn->getParentHandle()));
-                        api->moveNode(n.get(), parentNode.get(), megaCmdListener);
-                        megaCmdListener->wait();
+                        const string name_to_replace = tn->getName();
+                        const bool renaming = name_to_replace != n->getName();
 
-                        if (checkNoErrors(megaCmdListener->getError(), "move node"))
+                        //move into the parent of target node, then remove (replaced) target node and rename moved node with the new name
+                        submitBulkItem(bulk, [api, source, tnParentNode](MegaRequestListener *listener)
                         {
-                            const char* name_to_replace = tn->getName();
-
-                            //remove (replaced) target node
-                            if (n.get() != tn.get()) //just in case moving to same location
+                            api->moveNode(source.get(), tnParentNode.get(), listener);
+                        }, [api, source, target, name_to_replace, renaming](const BulkItemOutcome &outcome) -> BulkItemRequest
+                        {
+                            if (outcome.mErrors.size() == 1 && outcome.succeeded(0))
                             {
-                                MegaCmdListener *megaCmdListener = new MegaCmdListener(NULL);
-                                api->remove(tn.get(), megaCmdListener); //remove target node
-                                megaCmdListener->wait();
-
-                                if (!checkNoErrors(megaCmdListener->getError(), "remove target node"))
+                                return [api, target](MegaRequestListener *listener)
                                 {
-                                    LOG_err << "Couldnt move " << n->getName() << " to " << tn->getName() << " : " << megaCmdListener->getError()->getErrorCode();
-                                }
-                                delete megaCmdListener;
+                                    api->remove(target.get(), listener); //remove target node
+                                };
                             }
-
-                            // rename moved node with the new name
-                            if (strcmp(name_to_replace, n->getName()))
+                            if (outcome.mErrors.size() == 2 && renaming)
                             {
-                                MegaCmdListener *megaCmdListener = new MegaCmdListener(NULL);
-                                api->renameNode(n.get(), name_to_replace, megaCmdListener);
-                                megaCmdListener->wait();
+                                return [api, source, name_to_replace](MegaRequestListener *listener)
+                                {
+                                    api->renameNode(source.get(), name_to_replace.c_str(), listener);
+                                };
+                            }
+                            return nullptr;
+                        }, [this, source, target, renaming](const BulkItemOutcome &outcome)
+                        {
+                            if (checkNoErrors(outcome.getError(0), "move node"))
+                            {
+                                if (!checkNoErrors(outcome.getError(1), "remove target node"))
+                                {
+                                    LOG_err << "Couldnt move " << source->getName() << " to " << target->getName() << " : " << outcome.getError(1)->getErrorCode();
+                                }
 
-                                if (!checkNoErrors(megaCmdListener->getError(), "rename moved node"))
+                                if (renaming && !checkNoErrors(outcome.getError(2), "rename moved node"))
                                 {
-                                    LOG_err << "Failed to rename moved node: " << megaCmdListener->getError()->getErrorString();
+                                    LOG_err << "Failed to rename moved node: " << outcome.getError(2)->getErrorString();
                                 }
-                                delete megaCmdListener;
                             }
-                        }
-                        delete megaCmdListener;
+                        });
                     }
                     else
                     {
+                        bulk.waitAll();
                         setCurrentThreadOutCode(MCMD_INVALIDSTATE);
                         LOG_fatal << "Destiny node is orphan!!!";
                     }
                 }
                 else // target is a folder
                 {
-                    MegaCmdListener *megaCmdListener = new MegaCmdListener(nullptr);
-                    api->moveNode(n.get(), tn.get(), megaCmdListener);
-                    megaCmdListener->wait();
-
-                    checkNoErrors(megaCmdListener->getError(), "move node");
-                    delete megaCmdListener;
+                    submitBulkItem(bulk, [api, source, target](MegaRequestListener *listener)
+                    {
+                        api->moveNode(source.get(), target.get(), listener);
+                    }, nullptr, [this](const BulkItemOutcome &outcome)
+                    {
+                        checkNoErrors(outcome.getError(0), "move node");
+                    });
                 }
             }
         }
     }
     else //target not found (not even its folder), cant move
     {
+        bulk.waitAll();
         setCurrentThreadOutCode(MCMD_NOTFOUND);
         LOG_err << destiny << ": No such directory";
     }
@@ -4917,20 +5920,111 @@ bool MegaCmdExecuter::isValidFolder(string destiny)
     return isdestinyavalidfolder;
 }
 
+std::optional<std::string> MegaCmdExecuter::getCachedNodePath(MegaNode *n)
+{
+    const bool isFolder = n->getType() != MegaNode::TYPE_FILE;
+    if (isFolder)
+    {
+        if (auto path = mPathCache->getPath(n->getHandle()))
+        {
+            return path;
+        }
+    }
+
+    const uint64_t generation = mPathCache->getGeneration(); // before reading anything
+    std::optional<std::string> path;
+
+    // Inshares (even within other inshares) and root nodes are shown their own way: their paths are left to the SDK
+    if (n->getParentHandle() != UNDEF && !n->isInShare() && n->getName())
+    {
+        std::optional<std::string> parentPath = mPathCache->getPath(n->getParentHandle());
+        if (!parentPath)
+        {
+            std::unique_ptr<MegaNode> parent(api->getNodeByHandle(n->getParentHandle()));
+            if (parent)
+            {
+                parentPath = getCachedNodePath(parent.get());
+            }
+        }
+        if (parentPath)
+        {
+            path = NodePathCache::join(*parentPath, n->getName());
+        }
+    }
+
+    if (!path)
+    {
+        std::unique_ptr<char[]> sdkPath(api->getNodePath(n));
+        if (!sdkPath)
+        {
+            return std::nullopt;
+        }
+        path = sdkPath.get();
+    }
+
+    if (isFolder)
+    {
+        mPathCache->putPath(n->getHandle(), *path, generation);
+    }
+    return path;
+}
+
+char *MegaCmdExecuter::getNodePath(MegaNode *n)
+{
+    if (mPathCache)
+    {
+        if (auto path = getCachedNodePath(n))
+        {
+            return MegaApi::strdup(path->c_str());
+        }
+    }
+    return api->getNodePath(n);
+}
+
+std::unique_ptr<MegaNode> MegaCmdExecuter::getChildNode(MegaNode *parent, const std::string &name)
+{
+    if (!mPathCache)
+    {
+        return std::unique_ptr<MegaNode>(api->getChildNode(parent, name.c_str()));
+    }
+
+    if (auto handle = mPathCache->getChild(parent->getHandle(), name))
+    {
+        std::unique_ptr<MegaNode> child(api->getNodeByHandle(*handle));
+        if (child)
+        {
+            return child;
+        }
+    }
+
+    const uint64_t generation = mPathCache->getGeneration();
+    std::unique_ptr<MegaNode> child(api->getChildNode(parent, name.c_str()));
+    if (child && child->getType() != MegaNode::TYPE_FILE)
+    {
+        mPathCache->putChild(parent->getHandle(), name, child->getHandle(), generation);
+    }
+    return child;
+}
+
 std::string MegaCmdExecuter::getNodePathString(MegaNode *n)
 {
-    const char *path = api->getNodePath(n);
+    const char *path = getNodePath(n);
     string toret(path);
     delete[] path;
     return toret;
 }
 
-void MegaCmdExecuter::copyNode(MegaNode *n, string destiny, MegaNode * tn, string &targetuser, string &newname)
+void MegaCmdExecuter::copyNode(MegaNode *n, string destiny, MegaNode * tn, string &targetuser, string &newname, BulkRequests &bulk)
 {
+    MegaApi *api = this->api;
+    std::shared_ptr<MegaNode> source(n->copy());
+
     if (tn)
     {
+        std::shared_ptr<MegaNode> target(tn->copy());
         if (tn->getHandle() == n->getHandle())
         {
+            bulk.waitAll(); // after the results of the previous ones
             LOG_err << "Source and destiny are the same";
         }
         else
@@ -4941,37 +6035,51 @@ void MegaCmdExecuter::copyNode(MegaNode *n, string destiny, MegaNode * tn, strin
                 {
                     LOG_debug << "copy with new name: \"" << getNodePathString(n) << "\" to \"" << destiny << "\" newname=" << newname;
                     //copy with new name
-                    MegaCmdListener *megaCmdListener = new MegaCmdListener(NULL);
-                    api->copyNode(n, tn, newname.c_str(), megaCmdListener); //only works for files
-                    megaCmdListener->wait();
-                    checkNoErrors(megaCmdListener->getError(), "copy node");
-                    delete megaCmdListener;
+                    submitBulkItem(bulk, [api, source, target, newname](MegaRequestListener *listener)
+                    {
+                        api->copyNode(source.get(), target.get(), newname.c_str(), listener); //only works for files
+                    }, nullptr, [this](const BulkItemOutcome &outcome)
+                    {
+                        checkNoErrors(outcome.getError(0), "copy node");
+                    });
                 }
                 else //copy & rename
                 {
                     LOG_debug << "copy & rename: \"" << getNodePathString(n) << "\" to \"" << destiny << "\"";
-                    //copy with new name
-                    MegaCmdListener *megaCmdListener = new MegaCmdListener(NULL);
-                    api->copyNode(n, tn, megaCmdListener);
-                    megaCmdListener->wait();
-                    if (checkNoErrors(megaCmdListener->getError(), "copy node"))
+                    //copy, then rename the new node
+                    submitBulkItem(bulk, [api, source, target](MegaRequestListener *listener)
+                    {
+                        api->copyNode(source.get(), target.get(), listener);
+                    }, [api, newname](const BulkItemOutcome &outcome) -> BulkItemRequest
                     {
-                        MegaNode * newNode = api->getNodeByHandle(megaCmdListener->getRequest()->getNodeHandle());
-                        if (newNode)
+                        if (outcome.mErrors.size() > 1 || !outcome.succeeded(0))
                         {
-                            MegaCmdListener *megaCmdListener = new MegaCmdListener(NULL);
-                            api->renameNode(newNode, newname.c_str(), megaCmdListener);
-                            megaCmdListener->wait();
-                            checkNoErrors(megaCmdListener->getError(), "rename new node");
-                            delete megaCmdListener;
-                            delete newNode;
+                            return nullptr;
                         }
-                        else
+
+                        std::shared_ptr<MegaNode> newNode(api->getNodeByHandle(outcome.mNodeHandle));
+                        if (!newNode)
                         {
-                            LOG_err << " Couldn't find new node created upon cp";
+                            return nullptr;
                         }
-                    }
-                    delete megaCmdListener;
+                        return [api, newNode, newname](MegaRequestListener *listener)
+                        {
+                            api->renameNode(newNode.get(), newname.c_str(), listener);
+                        };
+                    }, [this](const BulkItemOutcome &outcome)
+                    {
+                        if (checkNoErrors(outcome.getError(0), "copy node"))
+                        {
+                            if (outcome.getError(1))
+                            {
+                                checkNoErrors(outcome.getError(1), "rename new node");
+                            }
+                            else
+                            {
+                                LOG_err << " Couldn't find new node created upon cp";
+                            }
+                        }
+                    });
                 }
             }
             else
@@ -4983,39 +6091,42 @@ void MegaCmdExecuter::copyNode(MegaNode *n, string destiny, MegaNode * tn, strin
                         LOG_debug << "overwriding target: \"" << getNodePathString(n) << "\" to \"" << destiny << "\"";
 
                         // overwrite target if source and target are files
-                        MegaNode *tnParentNode = api->getNodeByHandle(tn->getParentHandle());
+                        std::shared_ptr<MegaNode> tnParentNode(api->getNodeByHandle(tn->getParentHandle()));
                         if (tnParentNode) // (there should never be any orphaned filenodes)
                         {
-                            const char* name_to_replace = tn->getName();
-                            //copy with new name
-                            MegaCmdListener *megaCmdListener = new MegaCmdListener(NULL);
-                            api->copyNode(n, tnParentNode, name_to_replace, megaCmdListener);
-                            megaCmdListener->wait();
-                            if (checkNoErrors(megaCmdListener->getError(), "copy with new name") )
+                            const string name_to_replace = tn->getName();
+                            //copy with new name, then remove target node
+                            submitBulkItem(bulk, [api, source, tnParentNode, name_to_replace](MegaRequestListener *listener)
                             {
-                                MegaHandle newNodeHandle = megaCmdListener->getRequest()->getNodeHandle();
-                                delete megaCmdListener;
-                                delete tnParentNode;
-
-                                //remove target node
-                                if (tn->getHandle() != newNodeHandle )//&& newNodeHandle != n->getHandle())
+                                api->copyNode(source.get(), tnParentNode.get(), name_to_replace.c_str(), listener);
+                            }, [api, target](const BulkItemOutcome &outcome) -> BulkItemRequest
+                            {
+                                if (outcome.mErrors.size() > 1 || !outcome.succeeded(0) || outcome.mNodeHandle == target->getHandle())
                                 {
-                                    megaCmdListener = new MegaCmdListener(NULL);
-                                    api->remove(tn, megaCmdListener);
-                                    megaCmdListener->wait();
-                                    checkNoErrors(megaCmdListener->getError(), "delete target node");
-                                    delete megaCmdListener;
+                                    return nullptr;
                                 }
-                            }
+                                return [api, target](MegaRequestListener *listener)
+                                {
+                                    api->remove(target.get(), listener);
+                                };
+                            }, [this](const BulkItemOutcome &outcome)
+                            {
+                                if (checkNoErrors(outcome.getError(0), "copy with new name") && outcome.getError(1))
+                                {
+                                    checkNoErrors(outcome.getError(1), "delete target node");
+                                }
+                            });
                         }
                         else
                         {
+                            bulk.waitAll();
                             setCurrentThreadOutCode(MCMD_INVALIDSTATE);
                             LOG_fatal << "Destiny node is orphan!!!";
                         }
                     }
                     else
                     {
+                        bulk.waitAll();
                         setCurrentThreadOutCode(MCMD_INVALIDTYPE);
                         LOG_err << "Cannot overwrite file with folder";
                         return;
@@ -5025,11 +6136,13 @@ void MegaCmdExecuter::copyNode(MegaNode *n, string destiny, MegaNode * tn, strin
                 {
                     LOG_debug << "Copying into folder: \"" << getNodePathString(n) << "\" to \"" << destiny << "\"";
 
-                    MegaCmdListener *megaCmdListener = new MegaCmdListener(NULL);
-                    api->copyNode(n, tn, megaCmdListener);
-                    megaCmdListener->wait();
-                    checkNoErrors(megaCmdListener->getError(), "copy node");
-                    delete megaCmdListener;
+                    submitBulkItem(bulk, [api, source, target](MegaRequestListener *listener)
+                    {
+                        api->copyNode(source.get(), target.get(), listener);
+                    }, nullptr, [this](const BulkItemOutcome &outcome)
+                    {
+                        checkNoErrors(outcome.getError(0), "copy node");
+                    });
                 }
             }
         }
@@ -5038,14 +6151,17 @@ void MegaCmdExecuter::copyNode(MegaNode *n, string destiny, MegaNode * tn, strin
     {
         LOG_debug << "Sending to user: \"" << getNodePathString(n) << "\" to \"" << targetuser << "\"";
 
-        MegaCmdListener *megaCmdListener = new MegaCmdListener(NULL);
-        api->sendFileToUser(n,targetuser.c_str(),megaCmdListener);
-        megaCmdListener->wait();
-        checkNoErrors(megaCmdListener->getError(), "send file to user");
-        delete megaCmdListener;
+        submitBulkItem(bulk, [api, source, targetuser](MegaRequestListener *listener)
+        {
+            api->sendFileToUser(source.get(), targetuser.c_str(), listener);
+        }, nullptr, [this](const BulkItemOutcome &outcome)
+        {
+            checkNoErrors(outcome.getError(0), "send file to user");
+        });
     }
     else
     {
+        bulk.waitAll();
         setCurrentThreadOutCode(MCMD_NOTFOUND);
         LOG_err << destiny << " Couldn't find destination";
     }
@@ -5593,6 +6709,94 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
         bool treelike = getFlag(clflags,"tree");
         recursive += treelike?1:0;
 
+        ListingOrder order;
+        if (!getListingOrder(clflags, cloptions, order))
+        {
+            return;
+        }
+
+        std::optional<ListingCursor> cursor;
+        if (cloptions->count("cursor"))
+        {
+            cursor = ListingCursor::decode(getOption(cloptions, "cursor", ""));
+            if (!cursor)
+            {
+                setCurrentThreadOutCode(MCMD_EARGS);
+                LOG_err << "Invalid cursor: " << getOption(cloptions, "cursor", "");
+                return;
+            }
+            if (order.mOffset)
+            {
+                setCurrentThreadOutCode(MCMD_EARGS);
+                LOG_err << "--cursor and --offset cannot be combined";
+                return;
+            }
+        }
+        const bool selecting = !order.isDefault() || cursor;
+
+        std::optional<NodeExportFormat> exportFormat;
+        if (!getNodeExportFormat(cloptions, exportFormat))
+        {
+            return;
+        }
+        if (exportFormat)
+        {
+            if (selecting)
+            {
+                setCurrentThreadOutCode(MCMD_EARGS);
+                LOG_err << "--format cannot be combined with --sort, --reverse, --limit, --offset or --cursor";
+                return;
+            }
+
+            vector<std::unique_ptr<MegaNode>> nodes;
+            if ((int)words.size() > 1)
+            {
+                unescapeifRequired(words[1]);
+                if (isRegExp(words[1]))
+                {
+                    nodes = nodesbypath(words[1].c_str(), getFlag(clflags,"use-pcre"));
+                }
+                else if (auto n = nodebypath(words[1].c_str()))
+                {
+                    nodes.push_back(std::move(n));
+                }
+            }
+            else if (std::unique_ptr<MegaNode> n{api->getNodeByHandle(cwd)})
+            {
+                nodes.push_back(std::move(n));
+            }
+
+            if (nodes.empty())
+            {
+                setCurrentThreadOutCode(MCMD_NOTFOUND);
+                LOG_err << "Couldn't find " << ((int)words.size() > 1 ? words[1] : string("the current folder"));
+                return;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            NodeExporter exporter(*exportFormat, getOutStreamSink(*exportFormat));
+            for (const auto &n : nodes)
+            {
+                exportListing(n.get(), exporter, recursive);
+            }
+            exporter.flush();
+            LOG_verbose << "ls: " << exporter.getNumNodes() << " nodes exported in "
+                        << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count() << " ms";
+            return;
+        }
+
+        // Sorted or limited listings are flat, formatting only the nodes selected
+        auto dumpSelected = [&](MegaNode *n)
+        {
+            const char *timeFormat = getTimeFormatFromSTR(getOption(cloptions, "time-format", summary ? "SHORT" : "RFC2822"));
+            if (summary && firstprint)
+            {
+                dumpNodeSummaryHeader(timeFormat, clflags, cloptions);
+                firstprint = false;
+            }
+            dumpSelectedListing(n, order, cursor, timeFormat, clflags, cloptions, summary, recursive, extended_info, show_versions, humanreadable);
+        };
+
         if ((int)words.size() > 1)
         {
             unescapeifRequired(words[1]);
@@ -5629,7 +6833,11 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                                 {
                                     OUTSTREAM << nodepath << ": " << endl;
                                 }
-                                if (summary)
+                                if (selecting)
+                                {
+                                    dumpSelected(n.get());
+                                }
+                                else if (summary)
                                 {
                                     if (firstprint)
                                     {
@@ -5674,7 +6882,11 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                 std::unique_ptr<MegaNode> n = nodebypath(words[1].c_str());
                 if (n)
                 {
-                    if (summary)
+                    if (selecting)
+                    {
+                        dumpSelected(n.get());
+                    }
+                    else if (summary)
                     {
                         if (firstprint)
                         {
@@ -5708,7 +6920,11 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
             std::unique_ptr<MegaNode> n(api->getNodeByHandle(cwd));
             if (n)
             {
-                if (summary)
+                if (selecting)
+                {
+                    dumpSelected(n.get());
+                }
+                else if (summary)
                 {
                     if (firstprint)
                     {
@@ -5762,11 +6978,70 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
             return;
         }
 
+        // Compiled once for the whole command
+        PatternMatcher matcher(pattern, getFlag(clflags,"use-pcre"));
+        if (!matcher.isValid())
+        {
+            setCurrentThreadOutCode(MCMD_EARGS);
+            LOG_err << "Invalid pattern: " << pattern;
+            return;
+        }
+
+        ListingOrder order;
+        if (!getListingOrder(clflags, cloptions, order))
+        {
+            return;
+        }
+
+        FindCriteria criteria;
+        criteria.mMatcher = &matcher;
+        string type = getOption(cloptions, "type", "");
+        criteria.mType = type == "f" ? FindNodeType::FILES : (type == "d" ? FindNodeType::FOLDERS : FindNodeType::ANY);
+        criteria.mMinTime = minTime;
+        criteria.mMaxTime = maxTime;
+        criteria.mMinSize = minSize;
+        criteria.mMaxSize = maxSize;
+        for (const char *depthOption : {"mindepth", "maxdepth"})
+        {
+            if (!cloptions->count(depthOption))
+            {
+                continue;
+            }
+
+            auto depth = getIntOptional(*cloptions, depthOption);
+            if (!depth || *depth < 0)
+            {
+                setCurrentThreadOutCode(MCMD_EARGS);
+                LOG_err << "Invalid " << depthOption << ": " << getOption(cloptions, depthOption, "");
+                return;
+            }
+            if (!strcmp(depthOption, "mindepth"))
+            {
+                criteria.mMinDepth = *depth;
+            }
+            else
+            {
+                criteria.mMaxDepth = *depth;
+            }
+        }
+        FindQuery query(criteria);
+
+        std::optional<NodeExportFormat> exportFormat;
+        if (!getNodeExportFormat(cloptions, exportFormat))
+        {
+            return;
+        }
+        std::optional<NodeExporter> exporter;
+        if (exportFormat)
+        {
+            exporter.emplace(*exportFormat, getOutStreamSink(*exportFormat));
+        }
+        NodeExporter *exporterPtr = exporter ? &*exporter : nullptr;
 
         if (words.size() <= 1)
         {
             std::unique_ptr<MegaNode> n(api->getNodeByHandle(cwd));
-            doFind(n.get(), getTimeFormatFromSTR(getOption(cloptions, "time-format","RFC2822")), clflags, cloptions, "", printfileinfo, pattern, getFlag(clflags,"use-pcre"), minTime, maxTime, minSize, maxSize);
+            doFind(n.get(), getTimeFormatFromSTR(getOption(cloptions, "time-format","RFC2822")), clflags, cloptions, "", printfileinfo, matcher, query, order, exporterPtr);
         }
         for (int i = 1; i < (int)words.size(); i++)
         {
@@ -5778,7 +7053,7 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                     for (const auto& node : nodesToFind)
                     {
                         assert(node);
-                        doFind(node.get(), getTimeFormatFromSTR(getOption(cloptions, "time-format","RFC2822")), clflags, cloptions, words[i], printfileinfo, pattern, getFlag(clflags,"use-pcre"), minTime, maxTime, minSize, maxSize);
+                        doFind(node.get(), getTimeFormatFromSTR(getOption(cloptions, "time-format","RFC2822")), clflags, cloptions, words[i], printfileinfo, matcher, query, order, exporterPtr);
                     }
                 }
                 else
@@ -5797,7 +7072,7 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                 }
                 else
                 {
-                    doFind(n.get(), getTimeFormatFromSTR(getOption(cloptions, "time-format","RFC2822")), clflags, cloptions, words[i], printfileinfo, pattern, getFlag(clflags,"use-pcre"), minTime, maxTime, minSize, maxSize);
+                    doFind(n.get(), getTimeFormatFromSTR(getOption(cloptions, "time-format","RFC2822")), clflags, cloptions, words[i], printfileinfo, matcher, query, order, exporterPtr);
                 }
             }
         }
@@ -5898,8 +7173,11 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
             bool force = getFlag(clflags, "f");
             bool none = false;
 
+            // The nodes matched by each path are removed with many requests in flight
+            BulkRequests bulk(mMaxBulkRequestsInFlight);
             for (unsigned int i = 1; i < words.size(); i++)
             {
+                bulk.waitAll(); // paths are resolved once the previous ones are removed
                 unescapeifRequired(words[i]);
                 if (isRegExp(words[i]))
                 {
@@ -5914,7 +7192,7 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                     {
                         assert(node);
 
-                        int confirmationCode = deleteNode(node, api, getFlag(clflags, "r"), force);
+                        int confirmationCode = deleteNode(node, api, getFlag(clflags, "r"), force, bulk);
                         if (confirmationCode == MCMDCONFIRM_ALL)
                         {
                             force = true;
@@ -5935,7 +7213,7 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                     }
                     else
                     {
-                        int confirmationCode = deleteNode(nodeToDelete, api, getFlag(clflags, "r"), force);
+                        int confirmationCode = deleteNode(nodeToDelete, api, getFlag(clflags, "r"), force, bulk);
                         if (confirmationCode == MCMDCONFIRM_ALL)
                         {
                             force = true;
@@ -5976,8 +7254,11 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                 return;
             }
 
+            // The nodes matched by each path are moved with many requests in flight
+            BulkRequests bulk(mMaxBulkRequestsInFlight);
             for (unsigned int i=1;i<(words.size()-1);i++)
             {
+                bulk.waitAll(); // paths are resolved once the previous ones are moved
                 string source = words[i];
                 unescapeifRequired(source);
 
@@ -6003,7 +7284,7 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                         for (const auto& node : nodesToList)
                         {
                             assert(node);
-                            moveToDestination(node, destiny);
+                            moveToDestination(node, destiny, bulk);
                         }
                     }
                 }
@@ -6012,7 +7293,7 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                     std::unique_ptr<MegaNode> n = nodebypath(source.c_str());
                     if (n)
                     {
-                        moveToDestination(n, destiny);
+                        moveToDestination(n, destiny, bulk);
                     }
                     else
                     {
@@ -6053,6 +7334,8 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                 return;
             }
 
+            // Copying leaves the sources as they were: every node is copied with many requests in flight
+            BulkRequests bulk(mMaxBulkRequestsInFlight);
             for (unsigned int i=1;i<(words.size()-1);i++)
             {
                 string source = words[i];
@@ -6062,6 +7345,7 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                     vector<std::unique_ptr<MegaNode>> nodesToCopy = nodesbypath(words[i].c_str(), getFlag(clflags,"use-pcre"));
                     if (nodesToCopy.empty())
                     {
+                        bulk.waitAll(); // after the results of the previous ones
                         setCurrentThreadOutCode(MCMD_NOTFOUND);
                         LOG_err << source << ": No such file or directory";
                     }
@@ -6069,6 +7353,7 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                     bool destinyisok = true;
                     if (nodesToCopy.size() > 1 && !isValidFolder(destiny) && !targetuser.size())
                     {
+                        bulk.waitAll();
                         destinyisok = false;
                         setCurrentThreadOutCode(MCMD_INVALIDTYPE);
                         LOG_err << destiny << " must be a valid folder";
@@ -6079,7 +7364,7 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                         for (const auto& n : nodesToCopy)
                         {
                             assert(n);
-                            copyNode(n.get(), destiny, tn.get(), targetuser, newname);
+                            copyNode(n.get(), destiny, tn.get(), targetuser, newname, bulk);
                         }
                     }
                 }
@@ -6088,10 +7373,11 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                     std::unique_ptr<MegaNode> n = nodebypath(source.c_str());
                     if (n)
                     {
-                        copyNode(n.get(), destiny, tn.get(), targetuser, newname);
+                        copyNode(n.get(), destiny, tn.get(), targetuser, newname, bulk);
                     }
                     else
                     {
+                        bulk.waitAll();
                         setCurrentThreadOutCode(MCMD_NOTFOUND);
                         LOG_err << source << ": No such file or directory";
                     }
@@ -6227,6 +7513,13 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
             }
             OUTSTREAM << endl;
         }
+
+        if (mSizeCache)
+        {
+            auto stats = mSizeCache->getStats();
+            LOG_debug << "Size cache: " << stats.mNumAggregates << " folders, " << stats.mNumLinks << " links, "
+                      << stats.mHits << " hits, " << stats.mMisses << " misses";
+        }
         return;
     }
     else if (words[0] == "cat")
@@ -7404,6 +8697,8 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
         }
         else
         {
+            // Versions are removed with many requests in flight
+            BulkRequests bulk(mMaxBulkRequestsInFlight);
             for (unsigned int i = 1; i < words.size(); i++)
             {
                 if (isRegExp(words[i]))
@@ -7415,12 +8710,13 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                         {
                             assert(node);
 
-                            int ret = deleteNodeVersions(node, api, forcedelete);
+                            int ret = deleteNodeVersions(node, api, forcedelete, bulk);
                             forcedelete = forcedelete || (ret == MCMDCONFIRM_ALL);
                         }
                     }
                     else
                     {
+                        bulk.waitAll(); // after the results of the previous ones
                         setCurrentThreadOutCode(MCMD_NOTFOUND);
                         LOG_err << "No node found: " << words[i];
                     }
@@ -7430,11 +8726,12 @@ void MegaCmdExecuter::executecommand(vector<string> words, map<string, int> *clf
                     std::unique_ptr<MegaNode> n = nodebypath(words[i].c_str());
                     if (n)
                     {
-                        int ret = deleteNodeVersions(n, api, forcedelete);
+                        int ret = deleteNodeVersions(n, api, forcedelete, bulk);
                         forcedelete = forcedelete || (ret == MCMDCONFIRM_ALL);
                     }
                     else
                     {
+                        bulk.waitAll();
                         setCurrentThreadOutCode(MCMD_NOTFOUND);
                         LOG_err << "Node not found: " << words[i];
                     }
@@ -24,6 +24,16 @@
 #include "listeners.h"
 #include "deferred_single_trigger.h"
 #include "sync_issues.h"
+#include "megacmd_tree_traversal.h"
+#include "megacmd_pattern_matcher.h"
+#include "megacmd_name_index.h"
+#include "megacmd_size_cache.h"
+#include "megacmd_path_cache.h"
+#include "megacmd_listing_selector.h"
+#include "megacmd_find_query.h"
+#include "megacmd_completion_cache.h"
+#include "megacmd_node_export.h"
+#include "megacmd_bulk_requests.h"
 
 namespace megacmd {
 class MegaCmdGlobalTransferListener;
@@ -58,6 +68,45 @@ private:
     // delete confirmation
     std::vector<std::unique_ptr<mega::MegaNode>> mNodesToConfirmDelete;
 
+    // Requests kept in flight by bulk operations (rm, mv, cp and deleteversions), see BulkRequests
+    size_t mMaxBulkRequestsInFlight = 1;
+
+    // Index of node names (only if enabled), built in the background by mNameIndexBuilder
+    std::unique_ptr<NodeNameIndex> mNameIndex;
+    std::thread mNameIndexBuilder;
+    std::mutex mNameIndexBuilderMutex;
+    std::condition_variable mNameIndexBuilderCV;
+    bool mNameIndexRebuildRequested = false;
+    bool mNameIndexBuilderStopping = false;
+    CancellationToken mNameIndexBuildToken;
+
+    void nameIndexBuilderLoop();
+    void buildNameIndex(const CancellationToken &token);
+    void stopNameIndexBuilder();
+
+    // Sizes with versions of the folders du --versions was asked for (only if enabled), kept until something changes under them
+    std::unique_ptr<FolderSizeCache> mSizeCache;
+
+    // Sizes of all the versions of a file
+    long long getOwnVersionsSize(mega::MegaNode *n);
+
+    // Paths of folders (only if enabled), and the folders resolved by name in paths
+    std::unique_ptr<NodePathCache> mPathCache;
+
+    // The path of a node from the one of its parent (cached), recursively. Nothing if the SDK has none either
+    std::optional<std::string> getCachedNodePath(mega::MegaNode *n);
+    // Same as MegaApi::getNodePath (to be deleted[]), through the path cache when enabled
+    char *getNodePath(mega::MegaNode *n);
+
+    // Sorted children of the folders completed lately (only if enabled)
+    std::unique_ptr<CompletionCache> mCompletionCache;
+
+    // Paths completing a plain path ending in "*" (no other wildcards), from the cached children of its folder.
+    // Nothing if the path is not that simple or its folder cannot be listed: it is to be resolved as a pattern then
+    std::optional<std::vector<std::string>> listCachedPaths(const std::string &askedPath, bool discardFiles);
+    // Same as MegaApi::getChildNode, through the path cache when enabled
+    std::unique_ptr<mega::MegaNode> getChildNode(mega::MegaNode *parent, const std::string &name);
+
     std::string getNodePathString(mega::MegaNode *n);
 
     void cancelOngoingVerification(mega::MegaApi* api, bool start_new_verification);
@@ -73,22 +122,19 @@ private:
     template <typename Cb>
     void forEachFileInNode(mega::MegaNode &n, bool recurse, Cb &&callback)
     {
-        auto children = std::unique_ptr<mega::MegaNodeList>(api->getChildren(&n));
-        if (children != nullptr)
+        TraversalOptions options = getTraversalOptions(TraversalOrder::PRE_ORDER);
+        if (!recurse)
         {
-            for (int i = 0; i < children->size(); i++)
+            options.mMaxDepth = 1;
+        }
+
+        traverseTree(&n, options, [&callback](mega::MegaNode *node, const VisitInfo &info)
+        {
+            if (info.mDepth && node->getType() == mega::MegaNode::TYPE_FILE)
             {
-                auto child = children->get(i);
-                if (child->getType() == mega::MegaNode::TYPE_FILE)
-                {
-                    callback(children->get(i));
-                }
-                else if (recurse)
-                {
-                    forEachFileInNode(*child, true, std::forward<Cb>(callback));
-                }
+                callback(node);
             }
-        }
+        });
     }
 
 public:
@@ -103,6 +149,22 @@ public:
 
     void updateprompt(mega::MegaApi *api = nullptr);
 
+    // Keeps an index of node names to serve find without traversing the tree (see NodeNameIndex)
+    void enableNameIndex();
+    // Discards the index and builds it again in the background
+    void requestNameIndexRebuild();
+    void clearNameIndex();
+    // Keeps the aggregated sizes of folders computed by du, to answer again without traversing them (see FolderSizeCache)
+    void enableSizeCache();
+    // Keeps the paths of up to capacity folders, for the paths of nodes to be shown and resolved faster (see NodePathCache)
+    void enablePathCache(size_t capacity);
+    // Keeps the sorted children of up to capacity names, for remote paths to be completed faster (see CompletionCache)
+    void enableCompletionCache(size_t capacity);
+    // Keeps up to that many requests in flight when removing, moving or copying many nodes (1 waits for each one)
+    void setMaxBulkRequestsInFlight(size_t maxInFlight);
+    // To be called with the nodes updated (null if too many changed)
+    void onNodesUpdate(mega::MegaNodeList *nodes);
+
     // nodes browsing
     void listtrees();
     static bool includeIfIsExported(mega::MegaApi* api, mega::MegaNode * n, void *arg);
@@ -110,16 +172,30 @@ public:
     static bool includeIfIsPendingOutShare(mega::MegaApi* api, mega::MegaNode * n, void *arg);
     static bool includeIfIsSharedOrPendingOutShare(mega::MegaApi* api, mega::MegaNode * n, void *arg);
     static bool includeIfMatchesPattern(mega::MegaApi* api, mega::MegaNode * n, void *arg);
-    static bool includeIfMatchesCriteria(mega::MegaApi* api, mega::MegaNode * n, void *arg);
 
     bool processTree(mega::MegaNode * n, bool(mega::MegaApi *, mega::MegaNode *, void *), void *( arg ));
 
+    using NodeVisitor = std::function<void(mega::MegaNode *node, const VisitInfo &info)>;
+    using FolderVisitor = std::function<void(mega::MegaNode *folder, const std::vector<mega::MegaNode*> &children, int depth)>;
+    // Whether a subfolder found is to be expanded: nothing below those it returns false for is got
+    using FolderFilter = std::function<bool(mega::MegaNode *folder)>;
+
+    // Options for traversals within the current petition: they are cancelled along with it
+    TraversalOptions getTraversalOptions(TraversalOrder order) const;
+
+    /**
+     * @brief Traverses the tree under root (see TreeTraversal). Nodes given to the visitors
+     * are only valid during the call.
+     * @returns false if the traversal was cancelled
+     */
+    bool traverseTree(mega::MegaNode *root, const TraversalOptions &options, NodeVisitor visitor, FolderVisitor folderVisitor = {}, FolderFilter shouldExpand = {});
+
     std::unique_ptr<mega::MegaNode> nodebypath(const char* ptr, std::string* user = nullptr, std::string* namepart = nullptr);
     std::vector<std::unique_ptr<mega::MegaNode>> nodesbypath(const char* ptr, bool usepcre, std::string* user = nullptr);
-    void getNodesMatching(mega::MegaNode* parentNode, std::deque<std::string> pathParts, std::vector<std::unique_ptr<mega::MegaNode>>& nodesMatching, bool usepcre);
+    void getNodesMatching(mega::MegaNode* parentNode, std::deque<std::string> pathParts, std::vector<std::unique_ptr<mega::MegaNode>>& nodesMatching, PatternMatcherCache &matchers);
 
     std::vector <std::string> * nodesPathsbypath(const char* ptr, bool usepcre, std::string* user = NULL, std::string* namepart = NULL);
-    void getPathsMatching(mega::MegaNode *parentNode, std::deque<std::string> pathParts, std::vector<std::string> *pathsMatching, bool usepcre, std::string pathPrefix = "");
+    void getPathsMatching(mega::MegaNode *parentNode, std::deque<std::string> pathParts, std::vector<std::string> *pathsMatching, PatternMatcherCache &matchers, std::string pathPrefix = "");
 
     void printTreeSuffix(int depth, std::vector<bool> &lastleaf);
     void dumpNode(mega::MegaNode* n, const char *timeFormat, std::map<std::string, int> *clflags, std::map<std::string, std::string> *cloptions, int extended_info, bool showversions = false, int depth = 0, const char* title = NULL);
@@ -127,6 +203,15 @@ public:
     void dumpNodeSummaryHeader(const char *timeFormat, std::map<std::string, int> *clflags, std::map<std::string, std::string> *cloptions);
     void dumpNodeSummary(mega::MegaNode* n, const char *timeFormat, std::map<std::string, int> *clflags, std::map<std::string, std::string> *cloptions, bool humanreadable = false, const char* title = NULL);
     void dumpTreeSummary(mega::MegaNode* n, const char *timeFormat, std::map<std::string, int> *clflags, std::map<std::string, std::string> *cloptions, int recurse, bool show_versions, int depth = 0, bool humanreadable = false, std::string pathRelativeTo = "NULL");
+    // The page of the children of folder in the default order (after the entry given, if any), got without the rest of them.
+    // Empty if that entry is not at its position anymore
+    std::optional<std::vector<ListingEntry>> getDefaultOrderPage(mega::MegaNode *folder, const ListingOrder &order, const ListingEntry *after, bool showCreationTime);
+    // Dumps the children of n (all its descendants if recurse) in the given order, up to its limit (after the cursor, if any)
+    // Full pages end with the cursor of the next one
+    void dumpSelectedListing(mega::MegaNode *n, const ListingOrder &order, const std::optional<ListingCursor> &cursor, const char *timeFormat, std::map<std::string, int> *clflags, std::map<std::string, std::string> *cloptions, bool summary, int recurse, int extended_info, bool showversions, bool humanreadable);
+    void exportNode(mega::MegaNode *n, NodeExporter &exporter);
+    // Exports the children of n (all its descendants if recurse), or n if it is a file
+    void exportListing(mega::MegaNode *n, NodeExporter &exporter, bool recurse);
     std::unique_ptr<mega::MegaContactRequest> getPcrByContact(std::string contactEmail);
     bool TestCanWriteOnContainingFolder(std::string *path);
     std::string getDisplayPath(std::string givenPath, mega::MegaNode* n);
@@ -136,6 +221,7 @@ public:
     void dumpListOfAllShared(mega::MegaNode* n, std::string givenPath);
     void dumpListOfPendingShares(mega::MegaNode* n, std::string givenPath);
     std::string getCurrentPath();
+    // Size of the files under n, including all their versions (reusing and storing cached ones). 0 if cancelled
     long long getVersionsSize(mega::MegaNode* n);
 
     //acting
@@ -148,8 +234,8 @@ public:
     void actUponLogout(mega::MegaApi& api, mega::MegaError* e, bool keptSession);
     void actUponLogout(mega::SynchronousRequestListener *srl, bool keptSession, int timeout = 0);
     int actUponCreateFolder(mega::SynchronousRequestListener *srl, int timeout = 0);
-    int deleteNode(const std::unique_ptr<mega::MegaNode>& nodeToDelete, mega::MegaApi* api, int recursive, int force = 0);
-    int deleteNodeVersions(const std::unique_ptr<mega::MegaNode>& nodeToDelete, mega::MegaApi* api, int force = 0);
+    int deleteNode(const std::unique_ptr<mega::MegaNode>& nodeToDelete, mega::MegaApi* api, int recursive, int force, BulkRequests &bulk);
+    int deleteNodeVersions(const std::unique_ptr<mega::MegaNode>& nodeToDelete, mega::MegaApi* api, int force, BulkRequests &bulk);
     void downloadNode(std::string source, std::string localPath, mega::MegaApi* api, mega::MegaNode *node, bool background, bool ignorequotawar, int clientID, std::shared_ptr<MegaCmdMultiTransferListener> listener);
     void uploadNode(std::string localPath, mega::MegaApi* api, mega::MegaNode *node, std::string newname, bool background, bool ignorequotawarn, int clientID, MegaCmdMultiTransferListener *multiTransferListener = NULL);
     void exportNode(mega::MegaNode *n, int64_t expireTime, const std::optional<std::string>& password = {},
@@ -182,7 +268,7 @@ public:
     int makedir(std::string remotepath, bool recursive, mega::MegaNode *parentnode = NULL);
     bool IsFolder(std::string path);
     bool pathExists(const std::string &path);
-    void doDeleteNode(const std::unique_ptr<mega::MegaNode>& nodeToDelete, mega::MegaApi* api);
+    void doDeleteNode(const std::unique_ptr<mega::MegaNode>& nodeToDelete, mega::MegaApi* api, BulkRequests &bulk);
 
     void confirmDelete();
     void discardDelete();
@@ -200,10 +286,11 @@ public:
     void printBackup(int tag, mega::MegaScheduledCopy *backup, const char *timeFormat, const unsigned int PATHSIZE, bool extendedinfo = false, bool showhistory = false, mega::MegaNode *parentnode = NULL);
     void printBackup(backup_struct *backupstruct, const char *timeFormat, const unsigned int PATHSIZE, bool extendedinfo = false, bool showhistory = false);
 
-    void doFind(mega::MegaNode* nodeBase, const char *timeFormat, std::map<std::string, int> *clflags, std::map<std::string, std::string> *cloptions, std::string word, int printfileinfo, std::string pattern, bool usepcre, mega::m_time_t minTime, mega::m_time_t maxTime, int64_t minSize, int64_t maxSize);
+    void doFind(mega::MegaNode* nodeBase, const char *timeFormat, std::map<std::string, int> *clflags, std::map<std::string, std::string> *cloptions, std::string word, int printfileinfo, const PatternMatcher &matcher, const FindQuery &query, const ListingOrder &order, NodeExporter *exporter = nullptr);
 
-    void moveToDestination(const std::unique_ptr<mega::MegaNode>& n, std::string destiny);
-    void copyNode(mega::MegaNode *n, std::string destiny, mega::MegaNode *tn, std::string &targetuser, std::string &newname);
+    // Errors found right away are logged once the items already in bulk are finished: the output stays in order
+    void moveToDestination(const std::unique_ptr<mega::MegaNode>& n, std::string destiny, BulkRequests &bulk);
+    void copyNode(mega::MegaNode *n, std::string destiny, mega::MegaNode *tn, std::string &targetuser, std::string &newname, BulkRequests &bulk);
     std::string getLPWD();
     bool isValidFolder(std::string destiny);
     bool establishBackup(std::string local, mega::MegaNode *n, int64_t period, std::string periodstring, int numBackups);
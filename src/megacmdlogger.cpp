@@ -20,7 +20,11 @@
 #include "megacmdcommonutils.h"
 #include "megacmd_src_file_list.h"
 
+#include <condition_variable>
 #include <map>
+#include <set>
+#include <thread>
+#include <vector>
 
 #include <sys/types.h>
 
@@ -89,6 +93,18 @@ void setCurrentThreadIsCmdShell(bool isCmdShell)
     getCurrentThreadData().mIsCmdShell = isCmdShell;
 }
 
+void setCurrentThreadCancellationToken(const CancellationToken &cancellationToken)
+{
+    isThreadDataSet = true;
+    getCurrentThreadData().mCancellationToken = cancellationToken;
+}
+
+void resetCurrentThreadData()
+{
+    isThreadDataSet = false;
+    getCurrentThreadData() = ThreadData();
+}
+
 std::string formatErrorAndMaySetErrorCode(const MegaError &error)
 {
     auto code = error.getErrorCode();
@@ -405,6 +421,220 @@ void MegaCmdSimpleLogger::log(const char * /*time*/, int logLevel, const char *s
     }
 }
 
+namespace {
+
+// Flushes the partial outputs buffers that have been pending for longer than their deadline
+class PartialOutputsFlusher
+{
+    std::mutex mMutex;
+    std::condition_variable mCV;
+    std::set<PartialOutputsBuffer*> mBuffers;
+    // The one being flushed out of the lock: it is not to be destroyed until done
+    PartialOutputsBuffer *mFlushing = nullptr;
+    std::condition_variable mFlushedCV;
+    bool mFinished = false;
+    std::thread mThread;
+
+    void loop()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (!mFinished)
+        {
+            mCV.wait_for(lock, PartialOutputsBuffer::sFlushDeadline);
+
+            // Sending blocks while a client is not reading (e.g: output piped to a paused pager):
+            // that must not keep the other petitions from adding or removing their buffers
+            std::vector<PartialOutputsBuffer*> buffers(mBuffers.begin(), mBuffers.end());
+            for (auto buffer : buffers)
+            {
+                if (mFinished)
+                {
+                    break;
+                }
+                if (!mBuffers.count(buffer)) // removed meanwhile
+                {
+                    continue;
+                }
+
+                mFlushing = buffer;
+                lock.unlock();
+                buffer->flushIfDeadlineExpired();
+                lock.lock();
+                mFlushing = nullptr;
+                mFlushedCV.notify_all();
+            }
+        }
+    }
+
+public:
+    PartialOutputsFlusher() : mThread([this]() { loop(); }) {}
+
+    ~PartialOutputsFlusher()
+    {
+        {
+            std::lock_guard<std::mutex> g(mMutex);
+            mFinished = true;
+        }
+        mCV.notify_one();
+        mThread.join();
+    }
+
+    void add(PartialOutputsBuffer *buffer)
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        mBuffers.insert(buffer);
+    }
+
+    // Once removed, the buffer is no longer used by the flusher
+    void remove(PartialOutputsBuffer *buffer)
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mBuffers.erase(buffer);
+        mFlushedCV.wait(lock, [this, buffer]() { return mFlushing != buffer; });
+    }
+
+    static PartialOutputsFlusher &get()
+    {
+        static PartialOutputsFlusher flusher;
+        return flusher;
+    }
+};
+
+// Size of the longest prefix of data not ending in the middle of an utf-8 sequence
+size_t completeUtf8PrefixSize(const std::string &data)
+{
+    size_t size = data.size();
+    for (size_t back = 1; back <= 4 && back <= size; ++back)
+    {
+        unsigned char c = static_cast<unsigned char>(data[size - back]);
+        if ((c & 0xC0) == 0x80)
+        {
+            continue; // continuation byte
+        }
+
+        size_t expected = (c & 0x80) == 0 ? 1 : (c & 0xE0) == 0xC0 ? 2 : (c & 0xF0) == 0xE0 ? 3 : 4;
+        return expected > back ? size - back : size;
+    }
+    return size;
+}
+}
+
+PartialOutputsBuffer::PartialOutputsBuffer(ComunicationsManager *cm, CmdPetition *inf)
+    : mCm(cm), mInf(inf)
+{
+    PartialOutputsFlusher::get().add(this);
+}
+
+PartialOutputsBuffer::~PartialOutputsBuffer()
+{
+    PartialOutputsFlusher::get().remove(this);
+    flush();
+}
+
+void PartialOutputsBuffer::append(std::string_view data, bool isError, bool binary)
+{
+    if (data.empty())
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> g(mMutex);
+    if (!mPending.empty() && (mPendingIsError != isError || mPendingIsBinary != binary))
+    {
+        flushLocked(false);
+    }
+
+    if (binary && data.size() >= sFlushThreshold)
+    {
+        // Large binary chunks (e.g: cat streaming) are sent straight from the caller's buffer.
+        // Sending blocks while the client is not consuming: that throttles the producer.
+        flushLocked(false);
+        auto buffer = const_cast<char *>(data.data());
+        if (isError)
+        {
+            mCm->sendPartialError(mInf, buffer, data.size(), true);
+        }
+        else
+        {
+            mCm->sendPartialOutput(mInf, buffer, data.size(), true);
+        }
+        return;
+    }
+
+    if (mPending.empty())
+    {
+        mPendingIsError = isError;
+        mPendingIsBinary = binary;
+        mPendingSince = std::chrono::steady_clock::now();
+    }
+    mPending.append(data);
+
+    if (mPending.size() >= sFlushThreshold)
+    {
+        flushLocked(!binary);
+    }
+}
+
+void PartialOutputsBuffer::appendOutString(const OUTSTRING &s, bool isError)
+{
+#ifdef _WIN32
+    append(utf16ToUtf8(s), isError);
+#else
+    append(s, isError);
+#endif
+}
+
+void PartialOutputsBuffer::lineCompleted()
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    if (!mPending.empty() && std::chrono::steady_clock::now() - mPendingSince >= sFlushDeadline)
+    {
+        flushLocked(false);
+    }
+}
+
+void PartialOutputsBuffer::flush()
+{
+    std::lock_guard<std::mutex> g(mMutex);
+    flushLocked(false);
+}
+
+void PartialOutputsBuffer::flushIfDeadlineExpired()
+{
+    // If busy, the owner is writing and will take care of flushing
+    std::unique_lock<std::mutex> lock(mMutex, std::try_to_lock);
+    if (lock.owns_lock() && !mPending.empty() && std::chrono::steady_clock::now() - mPendingSince >= sFlushDeadline)
+    {
+        flushLocked(!mPendingIsBinary);
+    }
+}
+
+void PartialOutputsBuffer::flushLocked(bool completeCodePointsOnly)
+{
+    if (mPending.empty())
+    {
+        return;
+    }
+
+    size_t size = completeCodePointsOnly ? completeUtf8PrefixSize(mPending) : mPending.size();
+    if (!size)
+    {
+        return;
+    }
+
+    if (mPendingIsError)
+    {
+        mCm->sendPartialError(mInf, mPending.data(), size, mPendingIsBinary);
+    }
+    else
+    {
+        mCm->sendPartialOutput(mInf, mPending.data(), size, mPendingIsBinary);
+    }
+
+    mPending.erase(0, size);
+    mPendingSince = std::chrono::steady_clock::now();
+}
+
 LoggedStreamDefaultFile::LoggedStreamDefaultFile() :
     LoggedStreamOutStream(nullptr),
     mFstream(MegaCmdLogger::getDefaultFilePath())
@@ -24,6 +24,9 @@
 #include "megacmd.h"
 #include "comunicationsmanager.h"
 
+#include <chrono>
+#include <mutex>
+
 #define OUTSTREAM getCurrentThreadOutStream()
 
 namespace megacmd {
@@ -194,83 +197,108 @@ public:
     virtual ~LoggedStreamDefaultFile() = default;
 };
 
-class LoggedStreamPartialOutputs : public LoggedStream
+/**
+ * @brief Per-petition buffer of partial outputs/errors
+ *
+ * Accumulates what is written to the petition's out/err streams so that it reaches
+ * the client in a few large writes, instead of one socket send per token.
+ * Pending data is flushed:
+ *  - when it exceeds a size threshold
+ *  - on endl, if it has been pending for longer than the flush deadline
+ *  - when the deadline expires (a background flusher takes care of that)
+ *  - on explicit flush() (e.g: before asking the user for confirmation)
+ *  - at the end of the petition (destruction)
+ * Outputs and errors share the buffer, so that their relative order is kept.
+ */
+class PartialOutputsBuffer
 {
 public:
-    LoggedStreamPartialOutputs(ComunicationsManager *_cm, CmdPetition *_inf) : cm(_cm), inf(_inf) {}
-    virtual bool isClientConnected() override { return inf && !inf->clientDisconnected; }
+    static constexpr size_t sFlushThreshold = 64 * 1024;
+    static constexpr std::chrono::milliseconds sFlushDeadline{100};
 
-    virtual const LoggedStream& operator<<(const char& v) const override { OUTSTRINGSTREAM os; os << v; OUTSTRING s = os.str(); cm->sendPartialOutput(inf, &s); return *this; }
-    virtual const LoggedStream& operator<<(const char* v) const override { OUTSTRINGSTREAM os; os << v; OUTSTRING s = os.str(); cm->sendPartialOutput(inf, &s); return *this; }
+    PartialOutputsBuffer(ComunicationsManager *cm, CmdPetition *inf);
+    ~PartialOutputsBuffer();
 
-#ifdef _WIN32
-    virtual const LoggedStream& operator<<(std::wstring v) const override { cm->sendPartialOutput(inf, &v); return *this; }
-    virtual const LoggedStream& operator<<(std::string v) const override { cm->sendPartialOutput(inf, (char *)v.data(), v.size()); return *this; }
-#else
-    virtual const LoggedStream& operator<<(std::string v) const override { cm->sendPartialOutput(inf, &v); return *this; }
-#endif
-    virtual const LoggedStream& operator<<(BinaryStringView v) const override { cm->sendPartialOutput(inf, (char*) v.get().data(), v.get().size(), true); return *this; }
-    virtual const LoggedStream& operator<<(std::string_view v) const override { cm->sendPartialOutput(inf, (char*) v.data(), v.size()); return *this; }
-
-    virtual const LoggedStream& operator<<(int v) const override { OUTSTRINGSTREAM os; os << v; OUTSTRING s = os.str(); cm->sendPartialOutput(inf, &s); return *this; }
-    virtual const LoggedStream& operator<<(unsigned int v) const override { OUTSTRINGSTREAM os; os << v; OUTSTRING s = os.str(); cm->sendPartialOutput(inf, &s); return *this; }
-    virtual const LoggedStream& operator<<(long unsigned int v) const override { OUTSTRINGSTREAM os; os << v; OUTSTRING s = os.str(); cm->sendPartialOutput(inf, &s); return *this; }
-    virtual const LoggedStream& operator<<(long long int v) const override { OUTSTRINGSTREAM os; os << v; OUTSTRING s = os.str(); cm->sendPartialOutput(inf, &s); return *this; }
-    virtual const LoggedStream& operator<<(long long unsigned int v) const override { OUTSTRINGSTREAM os; os << v; OUTSTRING s = os.str(); cm->sendPartialOutput(inf, &s); return *this; }
-    virtual const LoggedStream& operator<<(std::ios_base v) const override { *out << &v;return *this; }
-    virtual const LoggedStream& operator<<(std::ios_base *v) const override { OUTSTRINGSTREAM os; os << v; OUTSTRING s = os.str(); cm->sendPartialOutput(inf, &s); return *this; }
+    void append(std::string_view data, bool isError, bool binary = false);
+    void appendOutString(const OUTSTRING &s, bool isError);
 
-    LoggedStream const& operator<<(OUTSTREAMTYPE& (*F)(OUTSTREAMTYPE&)) const override
-    {
-        OUTSTRINGSTREAM os; os << F; OUTSTRING s = os.str(); cm->sendPartialOutput(inf, &s);
-        return *this;
-    }
+    // A line has been completed: flush if data has been pending for too long
+    void lineCompleted();
 
-    virtual ~LoggedStreamPartialOutputs() = default;
+    void flush();
 
-protected:
-    ComunicationsManager *cm;
-    CmdPetition *inf;
-};
+    // To be called by the background flusher
+    void flushIfDeadlineExpired();
+
+    bool isClientConnected() const { return mInf && !mInf->clientDisconnected; }
+
+private:
+    void flushLocked(bool completeCodePointsOnly);
 
+    ComunicationsManager *mCm;
+    CmdPetition *mInf;
 
-class LoggedStreamPartialErrors : public LoggedStream
+    std::mutex mMutex;
+    std::string mPending;
+    bool mPendingIsError = false;
+    bool mPendingIsBinary = false;
+    std::chrono::steady_clock::time_point mPendingSince;
+};
+
+class LoggedStreamPartialBuffered : public LoggedStream
 {
 public:
-    LoggedStreamPartialErrors(ComunicationsManager *_cm, CmdPetition *_inf) : cm(_cm), inf(_inf) {}
-    virtual bool isClientConnected() override { return inf && !inf->clientDisconnected; }
+    LoggedStreamPartialBuffered(PartialOutputsBuffer &buffer, bool isError) : mBuffer(buffer), mIsError(isError) {}
+    virtual bool isClientConnected() override { return mBuffer.isClientConnected(); }
 
-    virtual const LoggedStream& operator<<(const char& v) const override { OUTSTRINGSTREAM os; os << v; OUTSTRING s = os.str(); cm->sendPartialError(inf, &s); return *this; }
-    virtual const LoggedStream& operator<<(const char* v) const override { OUTSTRINGSTREAM os; os << v; OUTSTRING s = os.str(); cm->sendPartialError(inf, &s); return *this; }
+    virtual const LoggedStream& operator<<(const char& v) const override { mBuffer.append(std::string_view(&v, 1), mIsError); return *this; }
+    virtual const LoggedStream& operator<<(const char* v) const override { mBuffer.append(v, mIsError); return *this; }
 
 #ifdef _WIN32
-    virtual const LoggedStream& operator<<(std::wstring v) const override { cm->sendPartialError(inf, &v); return *this; }
-    virtual const LoggedStream& operator<<(std::string v) const override { cm->sendPartialError(inf, (char *)v.data(), v.size()); return *this; }
-#else
-    virtual const LoggedStream& operator<<(std::string v) const override { cm->sendPartialError(inf, &v); return *this; }
+    virtual const LoggedStream& operator<<(std::wstring v) const override { mBuffer.appendOutString(v, mIsError); return *this; }
 #endif
-    virtual const LoggedStream& operator<<(BinaryStringView v) const override { cm->sendPartialError(inf, (char*) v.get().data(), v.get().size(), true); return *this; }
-    virtual const LoggedStream& operator<<(std::string_view v) const override { cm->sendPartialError(inf, (char*) v.data(), v.size()); return *this; }
-
-    virtual const LoggedStream& operator<<(int v) const override { OUTSTRINGSTREAM os; os << v; OUTSTRING s = os.str(); cm->sendPartialError(inf, &s); return *this; }
-    virtual const LoggedStream& operator<<(unsigned int v) const override { OUTSTRINGSTREAM os; os << v; OUTSTRING s = os.str(); cm->sendPartialError(inf, &s); return *this; }
-    virtual const LoggedStream& operator<<(long unsigned int v) const override { OUTSTRINGSTREAM os; os << v; OUTSTRING s = os.str(); cm->sendPartialError(inf, &s); return *this; }
-    virtual const LoggedStream& operator<<(long long int v) const override { OUTSTRINGSTREAM os; os << v; OUTSTRING s = os.str(); cm->sendPartialError(inf, &s); return *this; }
-    virtual const LoggedStream& operator<<(long long unsigned int v) const override { OUTSTRINGSTREAM os; os << v; OUTSTRING s = os.str(); cm->sendPartialError(inf, &s); return *this; }
-    virtual const LoggedStream& operator<<(std::ios_base v) const override { *out << &v;return *this; }
-    virtual const LoggedStream& operator<<(std::ios_base *v) const override { OUTSTRINGSTREAM os; os << v; OUTSTRING s = os.str(); cm->sendPartialError(inf, &s); return *this; }
+    virtual const LoggedStream& operator<<(std::string v) const override { mBuffer.append(v, mIsError); return *this; }
+    virtual const LoggedStream& operator<<(BinaryStringView v) const override { mBuffer.append(v.get(), mIsError, true); return *this; }
+    virtual const LoggedStream& operator<<(std::string_view v) const override { mBuffer.append(v, mIsError); return *this; }
+
+    virtual const LoggedStream& operator<<(int v) const override { mBuffer.append(std::to_string(v), mIsError); return *this; }
+    virtual const LoggedStream& operator<<(unsigned int v) const override { mBuffer.append(std::to_string(v), mIsError); return *this; }
+    virtual const LoggedStream& operator<<(long unsigned int v) const override { mBuffer.append(std::to_string(v), mIsError); return *this; }
+    virtual const LoggedStream& operator<<(long long int v) const override { mBuffer.append(std::to_string(v), mIsError); return *this; }
+    virtual const LoggedStream& operator<<(long long unsigned int v) const override { mBuffer.append(std::to_string(v), mIsError); return *this; }
+    virtual const LoggedStream& operator<<(std::ios_base v) const override { return *this << &v; }
+    virtual const LoggedStream& operator<<(std::ios_base *v) const override { OUTSTRINGSTREAM os; os << v; mBuffer.appendOutString(os.str(), mIsError); return *this; }
 
     LoggedStream const& operator<<(OUTSTREAMTYPE& (*F)(OUTSTREAMTYPE&)) const override
     {
-        OUTSTRINGSTREAM os; os << F; OUTSTRING s = os.str(); cm->sendPartialError(inf, &s);
+        OUTSTRINGSTREAM os; os << F; OUTSTRING s = os.str();
+        mBuffer.appendOutString(s, mIsError);
+        if (!s.empty() && s.back() == '\n')
+        {
+            mBuffer.lineCompleted();
+        }
         return *this;
     }
 
-    virtual ~LoggedStreamPartialErrors() = default;
+    virtual void flush() override { mBuffer.flush(); }
 
 protected:
-    ComunicationsManager *cm;
-    CmdPetition *inf;
+    PartialOutputsBuffer &mBuffer;
+    bool mIsError;
+};
+
+class LoggedStreamPartialOutputs : public LoggedStreamPartialBuffered
+{
+public:
+    LoggedStreamPartialOutputs(PartialOutputsBuffer &buffer) : LoggedStreamPartialBuffered(buffer, false) {}
+    virtual ~LoggedStreamPartialOutputs() = default;
+};
+
+class LoggedStreamPartialErrors : public LoggedStreamPartialBuffered
+{
+public:
+    LoggedStreamPartialErrors(PartialOutputsBuffer &buffer) : LoggedStreamPartialBuffered(buffer, true) {}
+    virtual ~LoggedStreamPartialErrors() = default;
 };
 
 struct ThreadData
@@ -281,6 +309,7 @@ struct ThreadData
     int mOutCode = 0;
     CmdPetition *mCmdPetition = nullptr;
     bool mIsCmdShell = false;
+    CancellationToken mCancellationToken;
 };
 
 ThreadData &getCurrentThreadData();
@@ -293,12 +322,17 @@ inline int getCurrentThreadLogLevel()             { return getCurrentThreadData(
 inline int getCurrentThreadOutCode()              { return getCurrentThreadData().mOutCode; }
 inline CmdPetition *getCurrentThreadCmdPetition() { return getCurrentThreadData().mCmdPetition; }
 inline bool isCurrentThreadCmdShell()             { return getCurrentThreadData().mIsCmdShell; }
+inline bool isCurrentThreadCancelled()            { return getCurrentThreadData().mCancellationToken.isCancelled(); }
 
 void setCurrentThreadOutStreams(LoggedStream &outStream, LoggedStream &errStream);
 void setCurrentThreadOutCode(int outCode);
 void setCurrentThreadLogLevel(int logLevel);
 void setCurrentThreadCmdPetition(CmdPetition *cmdPetition);
 void setCurrentThreadIsCmdShell(bool isCmdShell);
+void setCurrentThreadCancellationToken(const CancellationToken &cancellationToken);
+
+// Restores the defaults, so that reused threads do not keep references to a finished petition
+void resetCurrentThreadData();
 
 constexpr size_t LogTimestampSize = std::char_traits<char>::length("2024-12-27_16-33-12.654787");
 std::optional<std::chrono::time_point<std::chrono::system_clock>> stringToTimestamp(std::string_view str);
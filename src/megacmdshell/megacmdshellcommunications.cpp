@@ -21,10 +21,16 @@
 
 #include "megacmdshellcommunications.h"
 #include "../megacmdcommonutils.h"
+#include "../megacmd_framing.h"
+#include "megacmdshelloutputforwarder.h"
 
+#include <algorithm>
 #include <iostream>
+#include <map>
+#include <optional>
 #include <sstream>
 #include <string.h>
+#include <thread>
 
 #include <assert.h>
 
@@ -89,6 +95,7 @@ bool is_pid_running(pid_t pid) {
 
     return 0;
 }
+
 #endif
 
 #ifndef _WIN32
@@ -370,6 +377,12 @@ int MegaCmdShellCommunications::executeCommandW(wstring wcommand, std::string (*
     return executeCommand("", readresponse, output, errorOutput, interactiveshell, wcommand);
 }
 
+int MegaCmdShellCommunications::executeBatch(std::istream &/*commands*/, PrepareCommandCb_t /*prepareCommand*/, int /*maxInFlight*/, OUTSTREAMTYPE &/*output*/, OUTSTREAMTYPE &errorOutput)
+{
+    errorOutput << "Batch mode is not supported in this platform" << endl;
+    return MCMD_NOTPERMITTED;
+}
+
 #ifndef _WIN32
 int MegaCmdShellCommunicationsPosix::executeCommand(string command, std::string (*readresponse)(const char *), OUTSTREAMTYPE &output, OUTSTREAMTYPE &errorOutput, bool interactiveshell, wstring /*wcommand*/)
 {
@@ -389,8 +402,9 @@ int MegaCmdShellCommunicationsPosix::executeCommand(string command, std::string
         command="X"+command;
     }
 
-    auto n = send(thesock,command.data(),command.size(), MSG_NOSIGNAL);
-    if (n == SOCKET_ERROR)
+    FrameHeader commandHeader;
+    commandHeader.mType = FrameType::COMMAND;
+    if (!framing::sendFrame(thesock, commandHeader, command))
     {
         if ( (!command.compare(0,5,"Xexit") || !command.compare(0,5,"Xquit") ) && (ERRNO == ENOTCONN) )
         {
@@ -403,118 +417,284 @@ int MegaCmdShellCommunicationsPosix::executeCommand(string command, std::string
         return -1;
     }
 
-    int outcode = -1;
-
-    n = recv(thesock, (char *)&outcode, sizeof(outcode), MSG_NOSIGNAL);
-    if (n == SOCKET_ERROR)
+    // Outputs are written straight into stdout/stderr when those are not terminals (or for binary contents)
+    int outFd = &output == &COUT ? STDOUT_FILENO : -1;
+    int errFd = &errorOutput == &CERR ? STDERR_FILENO : -1;
+    OutputForwarder textOutput(output, outFd != -1 && !isatty(outFd) ? outFd : -1);
+    OutputForwarder binaryOutput(output, outFd);
+    OutputForwarder errorsOutput(errorOutput, errFd != -1 && !isatty(errFd) ? errFd : -1);
+    bool streaming = false;
+
+    // The stdout lock is held while outputs keep coming, and released when waiting for more
+    std::optional<StdoutMutexGuard> burstGuard;
+    auto endBurst = [&]()
     {
-        cerr << "ERROR reading output code: " << ERRNO << endl;
-        return -1;
-    }
+        if (burstGuard)
+        {
+            textOutput.flush();
+            binaryOutput.flush();
+            errorsOutput.flush();
+            burstGuard.reset();
+        }
+    };
 
-    while (outcode == MCMD_REQCONFIRM || outcode == MCMD_REQSTRING || outcode == MCMD_PARTIALOUT || outcode == MCMD_PARTIALERR)
+    for (;;)
     {
-        if (outcode == MCMD_PARTIALOUT || outcode == MCMD_PARTIALERR)
+        if (burstGuard && !framing::bytesAvailable(thesock))
         {
-            bool useErrorStream = outcode == MCMD_PARTIALERR;
-            auto &partialOutputStream = useErrorStream ? errorOutput : output;
+            endBurst();
+        }
 
-            size_t partialoutsize;
+        auto header = framing::recvFrameHeader(thesock);
+        if (!header)
+        {
+            endBurst();
+            if (command.compare(0,5,"Xexit") && command.compare(0,5,"Xquit") && command.compare(0,4,"exit") && command.compare(0,4,"quit"))
+            {
+                cerr << "ERROR reading response: " << ERRNO << endl;
+            }
+            return -1;
+        }
 
-            n = recv(thesock, (char *)&partialoutsize, sizeof(partialoutsize), MSG_NOSIGNAL);
-            if (n && partialoutsize > 0)
+        if (header->mType == FrameType::PARTIAL_OUT || header->mType == FrameType::PARTIAL_ERR)
+        {
+            bool binary = header->mType == FrameType::PARTIAL_OUT && (header->mFlags & FRAME_FLAG_BINARY);
+            if (binary && !streaming)
             {
-                StdoutMutexGuard stdOutLockGuard;
-                do{
-                    char *buffer = new char[partialoutsize+1];
-                    n = recv(thesock, (char *)buffer, partialoutsize, MSG_NOSIGNAL);
+                framing::enlargeSocketBuffer(thesock, SO_RCVBUF);
+                streaming = true;
+            }
 
-                    if (n)
-                    {
-                        partialOutputStream << string(buffer,partialoutsize) << flush;
-                        partialoutsize-=n;
-                    }
-                    delete[] buffer;
-                } while(n != 0 && partialoutsize && n !=SOCKET_ERROR);
+            if (!burstGuard)
+            {
+                burstGuard.emplace();
             }
-            else
+
+            auto &forwarder = header->mType == FrameType::PARTIAL_ERR ? errorsOutput : (binary ? binaryOutput : textOutput);
+            if (!forwarder.forward(thesock, header->mLength))
             {
-                std::cerr << "Error reading size of partial output: " << ERRNO << std::endl;
+                endBurst();
+                std::cerr << "Error reading partial output: " << ERRNO << std::endl;
                 return -1;
             }
         }
-        else { //REQCONFIRM|REQSTRING
-            size_t BUFFERSIZE = 1024;
-            string confirmQuestion;
-            char buffer[1025];
-            do{
-                n = recv(thesock, buffer, BUFFERSIZE, MSG_NOSIGNAL);
-                if (n)
-                {
-                    buffer[n]='\0';
-                    confirmQuestion.append(buffer);
-                }
-            } while(n == BUFFERSIZE && n != SOCKET_ERROR);
+        else if (header->mType == FrameType::REQ_CONFIRM || header->mType == FrameType::REQ_STRING)
+        {
+            endBurst();
 
-            if (outcode == MCMD_REQCONFIRM)
+            string question(header->mLength, '\0');
+            if (!framing::recvAll(thesock, question.data(), question.size()))
             {
-                int response = MCMDCONFIRM_NO;
+                cerr << "ERROR reading question: " << ERRNO << endl;
+                return -1;
+            }
 
+            string response;
+            if (header->mType == FrameType::REQ_CONFIRM)
+            {
+                int32_t confirmation = MCMDCONFIRM_NO;
                 if (readresponse != NULL)
                 {
-                    response = readconfirmationloop(confirmQuestion.c_str(), readresponse);
+                    confirmation = readconfirmationloop(question.c_str(), readresponse);
                 }
+                response.assign(reinterpret_cast<const char *>(&confirmation), sizeof(confirmation));
+            }
+            else
+            {
+                response = readresponse != NULL ? readresponse(question.c_str()) : "FAILED";
+            }
 
-                n = send(thesock, (const char *) &response, sizeof(response), MSG_NOSIGNAL);
+            FrameHeader responseHeader;
+            responseHeader.mType = FrameType::USER_RESPONSE;
+            if (!framing::sendFrame(thesock, responseHeader, response))
+            {
+                cerr << "ERROR writing confirm response to socket: " << ERRNO << endl;
+                return -1;
             }
-            else // MCMD_REQSTRING
+        }
+        else if (header->mType == FrameType::FINAL)
+        {
+            int32_t outcode = -1;
+            if (header->mLength < sizeof(outcode) || !framing::recvAll(thesock, reinterpret_cast<char *>(&outcode), sizeof(outcode)))
             {
-                string response = "FAILED";
+                cerr << "ERROR reading output code: " << ERRNO << endl;
+                return -1;
+            }
 
-                if (readresponse != NULL)
+            size_t remaining = header->mLength - sizeof(outcode);
+            if (remaining == 1) //To avoid outputing 0 char in binary outputs
+            {
+                char c = '\0';
+                if (framing::recvAll(thesock, &c, 1) && c != '\0')
                 {
-                    response = readresponse(confirmQuestion.c_str());
+                    StdoutMutexGuard stdOutLockGuard;
+                    textOutput.write(&c, 1);
                 }
+                remaining = 0;
+            }
 
-                n = send(thesock, (const char *) response.data(), sizeof(response), MSG_NOSIGNAL);
+            bool ok = true;
+            if (remaining)
+            {
+                if (!burstGuard)
+                {
+                    burstGuard.emplace();
+                }
+                ok = textOutput.forward(thesock, remaining);
             }
-            if (n == SOCKET_ERROR)
+            endBurst();
+            textOutput.flush();
+
+            if (!ok)
             {
-                cerr << "ERROR writing confirm response to socket: " << ERRNO << endl;
+                cerr << "ERROR reading output: " << ERRNO << endl;
                 return -1;
             }
-
+            return outcode;
         }
-
-        n = recv(thesock, (char *)&outcode, sizeof(outcode), MSG_NOSIGNAL);
-        if (n == SOCKET_ERROR)
+        else
         {
-            cerr << "ERROR reading output code: " << ERRNO << endl;
+            endBurst();
+            cerr << "Unexpected response frame received: " << static_cast<int>(header->mType) << endl;
             return -1;
         }
     }
+}
+
+int MegaCmdShellCommunicationsPosix::executeBatch(std::istream &commands, PrepareCommandCb_t prepareCommand, int maxInFlight, OUTSTREAMTYPE &output, OUTSTREAMTYPE &errorOutput)
+{
+    SOCKET thesock = createSocket(0, true);
+    if (!isSocketValid(thesock))
+    {
+        return -1;
+    }
+
+    ScopeGuard g([&thesock]()
+    {
+        close(thesock);
+    });
+
+    FrameHeader startHeader;
+    startHeader.mType = FrameType::COMMAND;
+    if (!framing::sendFrame(thesock, startHeader, "batchsession --parallel=" + std::to_string(maxInFlight)))
+    {
+        cerr << "ERROR writing command to socket: " << ERRNO << endl;
+        return -1;
+    }
 
-    int BUFFERSIZE = 1024;
-    char buffer[1025];
-    do{
-        n = recv(thesock, buffer, BUFFERSIZE, MSG_NOSIGNAL);
-        if (n)
+    auto ready = framing::recvFrameHeader(thesock);
+    if (!ready || ready->mType != FrameType::SESSION_READY)
+    {
+        cerr << "MEGAcmd server does not support batch sessions" << endl;
+        return -1;
+    }
+
+    // Commands are sent from a different thread: otherwise, both ends could get blocked writing
+    std::thread writer([&commands, &prepareCommand, thesock]()
+    {
+        uint32_t petitionId = 0;
+        string line;
+        while (getline(commands, line))
         {
-            if (n != 1 || buffer[0] != 0) //To avoid outputing 0 char in binary outputs
+            auto firstNonSpace = line.find_first_not_of(" \t\r");
+            if (firstNonSpace == string::npos || line[firstNonSpace] == '#')
+            {
+                continue; // skip blank lines and comments
+            }
+
+            FrameHeader header;
+            header.mType = FrameType::COMMAND;
+            header.mPetitionId = ++petitionId;
+            if (!framing::sendFrame(thesock, header, prepareCommand(line.substr(firstNonSpace))))
             {
-                StdoutMutexGuard stdOutLockGuard;
-                output << string(buffer,n) << flush;
+                cerr << "ERROR writing command " << petitionId << " to socket: " << ERRNO << endl;
+                break;
             }
         }
-    } while(n != 0 && n !=SOCKET_ERROR);
+        ::shutdown(thesock, SHUT_WR); // no more commands
+    });
 
-    if (n == SOCKET_ERROR)
+    struct Response
     {
-        cerr << "ERROR reading output: " << ERRNO << endl;
-        return -1;
+        std::vector<std::pair<bool /*isError*/, string>> mChunks;
+        bool mFinished = false;
+    };
+    std::map<uint32_t, Response> responses; // only buffered when commands run in parallel
+    uint32_t nextToPrint = 1;
+    int firstFailure = 0;
+
+    auto print = [&output, &errorOutput](bool isError, const string &contents)
+    {
+        if (contents.empty())
+        {
+            return;
+        }
+        StdoutMutexGuard stdOutLockGuard;
+        (isError ? errorOutput : output) << contents << flush;
+    };
+
+    auto printFinishedInOrder = [&]()
+    {
+        for (auto it = responses.find(nextToPrint); it != responses.end() && it->second.mFinished; it = responses.find(nextToPrint))
+        {
+            for (auto &chunk : it->second.mChunks)
+            {
+                print(chunk.first, chunk.second);
+            }
+            responses.erase(it);
+            ++nextToPrint;
+        }
+    };
+
+    string payload;
+    while (auto header = framing::recvFrameHeader(thesock))
+    {
+        payload.resize(header->mLength);
+        if (!framing::recvAll(thesock, payload.data(), payload.size()))
+        {
+            cerr << "ERROR reading response of command " << header->mPetitionId << ": " << ERRNO << endl;
+            break;
+        }
+
+        bool isFinal = header->mType == FrameType::FINAL;
+        if (isFinal)
+        {
+            int32_t outcode = -1;
+            if (payload.size() >= sizeof(outcode))
+            {
+                memcpy(&outcode, payload.data(), sizeof(outcode));
+                payload.erase(0, sizeof(outcode));
+            }
+            if (outcode != MCMD_OK && !firstFailure)
+            {
+                firstFailure = outcode;
+            }
+        }
+        bool isError = header->mType == FrameType::PARTIAL_ERR;
+
+        if (maxInFlight <= 1)
+        {
+            print(isError, payload);
+            continue;
+        }
+
+        auto &response = responses[header->mPetitionId];
+        response.mChunks.emplace_back(isError, payload);
+        response.mFinished = isFinal;
+        printFinishedInOrder();
     }
 
-    return outcode;
+    // print whatever we got from unfinished commands (e.g: the server went down)
+    for (auto &response : responses)
+    {
+        for (auto &chunk : response.second.mChunks)
+        {
+            print(chunk.first, chunk.second);
+        }
+    }
+
+    writer.join();
+    return firstFailure;
 }
 
 int MegaCmdShellCommunicationsPosix::listenToStateChanges(int receiveSocket, StateChangedCb_t statechangehandle)
@@ -722,9 +902,10 @@ std::optional<int> MegaCmdShellCommunicationsPosix::registerForStateChangesImpl(
 
     string command=interactive?"Xregisterstatelistener":"registerstatelistener";
 
-    auto n = send(thesock,command.data(),command.size(), MSG_NOSIGNAL);
-
-    if (n == SOCKET_ERROR)
+    // Once registered, the socket will carry (unframed) state changes
+    FrameHeader header;
+    header.mType = FrameType::COMMAND;
+    if (!framing::sendFrame(thesock, header, command))
     {
         cerr << "ERROR writing output Code to socket: " << ERRNO << endl;
         return {};
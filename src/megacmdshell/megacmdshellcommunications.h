@@ -32,6 +32,7 @@
 #include <iostream>
 #include <mutex>
 #include <future>
+#include <functional>
 
 #ifdef _WIN32
 #include <WinSock2.h>
@@ -87,6 +88,18 @@ public:
     virtual int executeCommand(std::string command, std::string (*readresponse)(const char *) = NULL, OUTSTREAMTYPE &output = COUT, OUTSTREAMTYPE &errorOutput = CERR, bool interactiveshell = true, std::wstring = L"") = 0;
     virtual int executeCommandW(std::wstring command, std::string (*readresponse)(const char *) = NULL, OUTSTREAMTYPE &output = COUT, OUTSTREAMTYPE &errorOutput = CERR, bool interactiveshell = true);
 
+    using PrepareCommandCb_t = std::function<std::string(const std::string & /*line*/)>;
+
+    /**
+     * @brief Executes the commands read from `commands` (one per line) through a single connection.
+     * Commands are pipelined: they are sent without waiting for the responses of the previous ones.
+     * Outputs are written in the order of the commands.
+     * @param prepareCommand Transforms each line into the command to send (e.g: to absolutize local paths)
+     * @param maxInFlight Max number of commands the server will process at the same time
+     * @returns the out code of the first command failing, or 0 if all succeeded
+     */
+    virtual int executeBatch(std::istream &commands, PrepareCommandCb_t prepareCommand, int maxInFlight, OUTSTREAMTYPE &output = COUT, OUTSTREAMTYPE &errorOutput = CERR);
+
     virtual bool registerForStateChanges(bool interactive, StateChangedCb_t statechangehandle, bool initiateServer = true);
 
     virtual void setResponseConfirmation(bool confirmation);
@@ -144,6 +157,7 @@ class MegaCmdShellCommunicationsPosix : public MegaCmdShellCommunications
 {
 public:
     int executeCommand(std::string command, std::string (*readresponse)(const char *) = NULL, OUTSTREAMTYPE &output = COUT, OUTSTREAMTYPE &errorOutput = CERR, bool interactiveshell = true, std::wstring = L"") override;
+    int executeBatch(std::istream &commands, PrepareCommandCb_t prepareCommand, int maxInFlight, OUTSTREAMTYPE &output = COUT, OUTSTREAMTYPE &errorOutput = CERR) override;
 private:
 
     bool isSocketValid(SOCKET socket);
@@ -0,0 +1,147 @@
+/**
+ * @file src/megacmdshell/megacmdshelloutputforwarder.h
+ * @brief MEGAcmd: forwarding of outputs received from the server
+ *
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#pragma once
+
+#ifndef _WIN32
+
+#include <algorithm>
+#include <cerrno>
+#include <ostream>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace megacmd {
+
+/**
+ * @brief Writes the outputs received from a socket into a stream or straight into a file descriptor.
+ *
+ * Data is received into a large buffer, reused for the whole petition, and written as is:
+ * no strings are built, and the stream is not flushed after every chunk (see flush).
+ * When a file descriptor is given, the stream is skipped altogether.
+ * When that fd is a pipe (Linux only), data is moved from the socket with splice, never reaching user space.
+ */
+class OutputForwarder
+{
+public:
+    static constexpr size_t sBufferSize = 256 * 1024;
+
+    // fd: descriptor to write into directly (the one behind stream), or -1 to write into the stream
+    OutputForwarder(std::ostream &stream, int fd)
+        : mStream(stream), mFd(fd)
+    {
+#ifdef __linux__
+        struct stat st = {};
+        mFdIsPipe = mFd != -1 && fstat(mFd, &st) == 0 && S_ISFIFO(st.st_mode);
+#endif
+    }
+
+    // Receives `size` bytes from the socket and writes them
+    bool forward(int socket, size_t size)
+    {
+        if (mFd != -1)
+        {
+            mStream.flush(); // whatever was written through the stream goes first
+        }
+
+#ifdef __linux__
+        while (size && mFdIsPipe)
+        {
+            auto n = splice(socket, nullptr, mFd, nullptr, size, SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n < 0 && errno == EINVAL)
+            {
+                mFdIsPipe = false; // not supported: fallback to receive & write
+                break;
+            }
+            if (n <= 0)
+            {
+                return false;
+            }
+            size -= static_cast<size_t>(n);
+        }
+#endif
+
+        if (size && mBuffer.empty())
+        {
+            mBuffer.resize(sBufferSize);
+        }
+
+        while (size)
+        {
+            auto n = recv(socket, mBuffer.data(), std::min(size, mBuffer.size()), 0);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0 || !write(mBuffer.data(), static_cast<size_t>(n)))
+            {
+                return false;
+            }
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool write(const char *data, size_t size)
+    {
+        if (mFd == -1)
+        {
+            mStream.write(data, static_cast<std::streamsize>(size));
+            return mStream.good();
+        }
+
+        while (size)
+        {
+            auto n = ::write(mFd, data, size);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                return false;
+            }
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    // To be called at the end of every burst of outputs
+    void flush()
+    {
+        mStream.flush();
+    }
+
+private:
+    std::ostream &mStream;
+    int mFd = -1;
+    bool mFdIsPipe = false;
+    std::vector<char> mBuffer;
+};
+
+}
+#endif
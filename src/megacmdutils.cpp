@@ -17,12 +17,11 @@
  */
 
 #include "megacmdutils.h"
+#include "megacmd_pattern_matcher.h"
 #include "mega/types.h"
 
 #ifdef USE_PCRE
 #include <pcrecpp.h>
-#elif __cplusplus >= 201103L && !defined(__MINGW32__)
-#include <regex>
 #endif
 
 #ifdef _WIN32
@@ -1015,93 +1014,15 @@ string unquote(string what)
 }
 
 bool megacmdWildcardMatch(const char *pszString, const char *pszMatch)
-//  cf. http://www.planet-source-code.com/vb/scripts/ShowCode.asp?txtCodeId=1680&lngWId=3
 {
-    const char *cp = nullptr;
-    const char *mp = nullptr;
-
-    while ((*pszString) && (*pszMatch != '*'))
-    {
-        if ((*pszMatch != *pszString) && (*pszMatch != '?'))
-        {
-            return false;
-        }
-        pszMatch++;
-        pszString++;
-    }
-
-    while (*pszString)
-    {
-        if (*pszMatch == '*')
-        {
-            if (!*++pszMatch)
-            {
-                return true;
-            }
-            mp = pszMatch;
-            cp = pszString + 1;
-        }
-        else if ((*pszMatch == *pszString) || (*pszMatch == '?'))
-        {
-            pszMatch++;
-            pszString++;
-        }
-        else
-        {
-            pszMatch = mp;
-            pszString = cp++;
-        }
-    }
-    while (*pszMatch == '*')
-    {
-        pszMatch++;
-    }
-    return !*pszMatch;
+    // Compiled for a single use: to match many names, build a GlobPattern (or a PatternMatcher) once
+    return GlobPattern(pszMatch).matches(pszString);
 }
 
 bool patternMatches(const char *what, const char *pattern, bool usepcre)
 {
-    if (usepcre)
-    {
-#ifdef USE_PCRE
-        pcrecpp::RE re(pattern);
-        if (re.error().length())
-        {
-            //In case the user supplied non-pcre regexp with * or ? in it.
-            string newpattern(pattern);
-            replaceAll(newpattern,"*",".*");
-            replaceAll(newpattern,"?",".");
-            re=pcrecpp::RE(newpattern);
-        }
-
-        if (!re.error().length())
-        {
-            bool toret = re.FullMatch(what);
-
-            return toret;
-        }
-        else
-        {
-            LOG_warn << "Invalid PCRE regex: " << re.error();
-            return false;
-        }
-#elif __cplusplus >= 201103L && !defined(__MINGW32__)
-        try
-        {
-            return std::regex_match(what, std::regex(pattern));
-        }
-        catch (std::regex_error e)
-        {
-            LOG_warn << "Couldn't compile regex: " << pattern;
-            return false;
-        }
-#else
-        LOG_warn << " PCRE not supported";
-        return false;
-#endif
-    }
-
-    return megacmdWildcardMatch(what,pattern);
+    // Compiled for a single use: to match many names, build a PatternMatcher once
+    return PatternMatcher(pattern, usepcre).matches(what);
 }
 
 bool nodeNameIsVersion(string &nodeName)
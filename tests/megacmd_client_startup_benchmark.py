@@ -0,0 +1,64 @@
+#!/usr/bin/python3
+# -*- coding: utf-8 -*-
+
+# Compares the latency of client commands invoked through the bash wrapper scripts
+# (mega-ls -> bash -> mega-exec ls) with the multi-call path (mega-ls -> mega-exec, via symlink).
+# Requires a running MEGAcmd server. The command used should be cheap server-side (e.g: pwd),
+# so that the difference is dominated by the startup of the client.
+#
+# Usage: megacmd_client_startup_benchmark.py [--mega-exec PATH] [--command pwd] [--runs 200]
+
+import argparse, os, shutil, statistics, subprocess, sys, tempfile, time
+
+def measure(argv, runs, binDir):
+    env = dict(os.environ, PATH=binDir + os.pathsep + os.environ.get('PATH', ''))
+    latencies = []
+    for _ in range(runs):
+        start = time.perf_counter()
+        subprocess.run(argv, env=env, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL, check=False)
+        latencies.append((time.perf_counter() - start) * 1000)
+    latencies.sort()
+    return {
+        'median': statistics.median(latencies),
+        'p95': latencies[int(len(latencies) * 0.95) - 1],
+        'min': latencies[0],
+    }
+
+def main():
+    parser = argparse.ArgumentParser(description='MEGAcmd client startup latency benchmark')
+    parser.add_argument('--mega-exec', default=shutil.which('mega-exec'), help='path to the mega-exec binary')
+    parser.add_argument('--command', default='pwd', help='command to execute (without the mega- prefix)')
+    parser.add_argument('--runs', type=int, default=200)
+    args = parser.parse_args()
+
+    if not args.mega_exec or not os.path.isfile(args.mega_exec):
+        sys.exit('mega-exec not found: use --mega-exec')
+
+    with tempfile.TemporaryDirectory() as tmp:
+        megaExec = os.path.join(tmp, 'mega-exec')
+        os.symlink(os.path.abspath(args.mega_exec), megaExec)
+
+        wrapperDir = os.path.join(tmp, 'wrapper')
+        os.mkdir(wrapperDir)
+        wrapper = os.path.join(wrapperDir, 'mega-' + args.command)
+        with open(wrapper, 'w') as f:
+            f.write('#!/bin/bash\nmega-exec ' + args.command + ' "$@"\n') # as the installed ones
+        os.chmod(wrapper, 0o755)
+
+        multiCall = os.path.join(tmp, 'mega-' + args.command)
+        os.symlink('mega-exec', multiCall)
+
+        measure([multiCall], min(args.runs, 10), tmp) # warm up (server connection, page cache)
+
+        results = [
+            ('mega-exec ' + args.command, measure([megaExec, args.command], args.runs, tmp)),
+            ('wrapper script', measure([wrapper], args.runs, tmp)),
+            ('multi-call symlink', measure([multiCall], args.runs, tmp)),
+        ]
+
+    print('%-24s %10s %10s %10s' % ('invocation (%d runs)' % args.runs, 'min ms', 'median ms', 'p95 ms'))
+    for name, r in results:
+        print('%-24s %10.2f %10.2f %10.2f' % (name, r['min'], r['median'], r['p95']))
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,223 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <queue>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_bulk_requests.h"
+
+using namespace megacmd;
+
+namespace {
+
+// Stands in for the API: completes each request from a thread of its own, once its latency elapsed
+class FakeApi final
+{
+public:
+    FakeApi() : mWorker([this]() { loop(); }) {}
+
+    ~FakeApi()
+    {
+        {
+            std::lock_guard<std::mutex> guard(mMutex);
+            mStopping = true;
+        }
+        mCV.notify_all();
+        mWorker.join();
+    }
+
+    void request(std::chrono::microseconds latency, int errorCode, BulkRequests::Completion completion)
+    {
+        const int inFlight = ++mInFlight;
+        int maxInFlight = mMaxInFlight;
+        while (inFlight > maxInFlight && !mMaxInFlight.compare_exchange_weak(maxInFlight, inFlight))
+        {
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(mMutex);
+            mRequests.push(Request{std::chrono::steady_clock::now() + latency, mNumRequests++, errorCode, std::move(completion)});
+        }
+        mCV.notify_all();
+    }
+
+    int getMaxInFlight() const { return mMaxInFlight; }
+
+private:
+    struct Request
+    {
+        std::chrono::steady_clock::time_point mDue;
+        size_t mOrder;
+        int mErrorCode;
+        BulkRequests::Completion mCompletion;
+
+        bool operator<(const Request &other) const // the earliest on top
+        {
+            return mDue != other.mDue ? mDue > other.mDue : mOrder > other.mOrder;
+        }
+    };
+
+    void loop()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        while (!mStopping || !mRequests.empty())
+        {
+            if (mRequests.empty())
+            {
+                mCV.wait(lock);
+                continue;
+            }
+            const auto due = mRequests.top().mDue;
+            if (std::chrono::steady_clock::now() < due)
+            {
+                mCV.wait_until(lock, due);
+                continue; // a request was added, maybe due earlier
+            }
+
+            Request request = mRequests.top();
+            mRequests.pop();
+            lock.unlock();
+            --mInFlight;
+            request.mCompletion(request.mErrorCode);
+            lock.lock();
+        }
+    }
+
+    std::mutex mMutex;
+    std::condition_variable mCV;
+    std::priority_queue<Request> mRequests;
+    size_t mNumRequests = 0;
+    bool mStopping = false;
+    std::atomic<int> mInFlight{0};
+    std::atomic<int> mMaxInFlight{0};
+    std::thread mWorker;
+};
+
+}
+
+TEST(BulkRequestsTest, finishesInOrder)
+{
+    std::vector<BulkRequests::Completion> completions;
+    std::vector<int> finished;
+    {
+        BulkRequests bulk(3);
+        for (int i = 0; i < 3; ++i)
+        {
+            bulk.submit([&completions](BulkRequests::Completion completion) { completions.push_back(std::move(completion)); },
+                        [&finished, i](int) { finished.push_back(i); });
+        }
+        EXPECT_EQ(completions.size(), 3u);
+
+        completions[2](0);
+        completions[1](0);
+        EXPECT_TRUE(finished.empty());
+        EXPECT_EQ(bulk.getNumFinished(), 0u);
+
+        completions[0](0);
+        bulk.waitAll();
+        EXPECT_EQ(bulk.getNumFinished(), 3u);
+    }
+    EXPECT_EQ(finished, std::vector<int>({0, 1, 2}));
+}
+
+TEST(BulkRequestsTest, itemsCompletingRightAway)
+{
+    std::vector<int> finished;
+    BulkRequests bulk(1);
+    for (int i = 0; i < 5; ++i)
+    {
+        bulk.submit([](BulkRequests::Completion completion) { completion(0); }, [&finished, i](int) { finished.push_back(i); });
+        EXPECT_EQ(finished.size(), static_cast<size_t>(i + 1)); // as if waited for
+    }
+    EXPECT_EQ(bulk.getNumSubmitted(), 5u);
+}
+
+TEST(BulkRequestsTest, errorsPerItem)
+{
+    FakeApi api;
+    std::vector<int> codes;
+    BulkRequests bulk(4);
+    for (int i = 0; i < 20; ++i)
+    {
+        const int errorCode = i % 7 ? 0 : -9;
+        // Later items complete earlier
+        bulk.submit([&api, i, errorCode](BulkRequests::Completion completion) { api.request(std::chrono::microseconds(2000 - i * 100), errorCode, std::move(completion)); },
+                    [&codes](int errorCode) { codes.push_back(errorCode); });
+    }
+    bulk.waitAll();
+
+    ASSERT_EQ(codes.size(), 20u);
+    for (int i = 0; i < 20; ++i)
+    {
+        EXPECT_EQ(codes[i], i % 7 ? 0 : -9);
+    }
+
+    const auto &errors = bulk.getErrors();
+    ASSERT_EQ(errors.size(), 3u);
+    EXPECT_EQ(errors[0].mItem, 0u);
+    EXPECT_EQ(errors[1].mItem, 7u);
+    EXPECT_EQ(errors[2].mItem, 14u);
+    EXPECT_EQ(errors[2].mErrorCode, -9);
+}
+
+TEST(BulkRequestsTest, limitsTheRequestsInFlight)
+{
+    for (size_t limit : {1, 3, 16})
+    {
+        G_SUBTEST << "limit " << limit;
+        FakeApi api;
+        std::atomic<size_t> numFinished{0};
+        {
+            BulkRequests bulk(limit);
+            for (int i = 0; i < 100; ++i)
+            {
+                bulk.submit([&api](BulkRequests::Completion completion) { api.request(std::chrono::microseconds(200), 0, std::move(completion)); },
+                            [&numFinished](int) { ++numFinished; });
+            }
+        }
+        EXPECT_EQ(numFinished, 100u);
+        EXPECT_LE(api.getMaxInFlight(), static_cast<int>(limit));
+        if (limit == 1)
+        {
+            EXPECT_EQ(api.getMaxInFlight(), 1);
+        }
+    }
+}
+
+// Wait per item vs items in flight, against requests taking 1 ms (run with --gtest_also_run_disabled_tests)
+TEST(BulkRequestsTest, DISABLED_benchmarkThroughput)
+{
+    constexpr int numItems = 2000;
+    for (size_t limit : {1, 8, 64, 256})
+    {
+        FakeApi api;
+        auto start = std::chrono::steady_clock::now();
+        {
+            BulkRequests bulk(limit);
+            for (int i = 0; i < numItems; ++i)
+            {
+                bulk.submit([&api](BulkRequests::Completion completion) { api.request(std::chrono::milliseconds(1), 0, std::move(completion)); }, nullptr);
+            }
+        }
+        auto time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << numItems << " items, " << limit << " in flight: " << time * 1000 << " ms, " << numItems / time << " items/s" << std::endl;
+    }
+}
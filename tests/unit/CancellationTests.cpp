@@ -0,0 +1,49 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmdlogger.h"
+
+TEST(CancellationTest, copiesShareTheFlag)
+{
+    megacmd::CancellationToken token;
+    megacmd::CancellationToken copy = token;
+    EXPECT_FALSE(copy.isCancelled());
+
+    std::thread canceller([token]() mutable { token.cancel(); });
+    canceller.join();
+
+    EXPECT_TRUE(token.isCancelled());
+    EXPECT_TRUE(copy.isCancelled());
+    EXPECT_FALSE(megacmd::CancellationToken().isCancelled());
+}
+
+TEST(CancellationTest, threadDataCarriesThePetitionToken)
+{
+    megacmd::CmdPetition petition;
+    megacmd::setCurrentThreadCancellationToken(petition.mCancellationToken);
+    EXPECT_FALSE(megacmd::isCurrentThreadCancelled());
+
+    petition.mCancellationToken.cancel();
+    EXPECT_TRUE(megacmd::isCurrentThreadCancelled());
+
+    // reused threads shall not see the token of a previous petition
+    megacmd::resetCurrentThreadData();
+    EXPECT_FALSE(megacmd::isCurrentThreadCancelled());
+}
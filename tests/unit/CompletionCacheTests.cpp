@@ -0,0 +1,154 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <chrono>
+#include <iostream>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_completion_cache.h"
+
+using megacmd::CompletionCache;
+
+namespace {
+
+std::vector<std::string> getNames(const std::optional<std::vector<CompletionCache::Child>> &children)
+{
+    std::vector<std::string> names;
+    for (const auto &child : children.value_or(std::vector<CompletionCache::Child>()))
+    {
+        names.push_back(child.mName);
+    }
+    return names;
+}
+
+// docs (1) contains: b.txt (10), a.txt (11), a (12, a folder), ab.txt (13)
+void putDocs(CompletionCache &cache)
+{
+    cache.put(1, {{"b.txt", 10, true}, {"a.txt", 11, true}, {"a", 12, false}, {"ab.txt", 13, true}}, cache.getGeneration());
+}
+
+}
+
+TEST(CompletionCacheTest, prefixSearch)
+{
+    CompletionCache cache(100);
+    EXPECT_FALSE(cache.find(1, ""));
+    putDocs(cache);
+
+    using Names = std::vector<std::string>;
+    EXPECT_EQ(getNames(cache.find(1, "")), Names({"a", "a.txt", "ab.txt", "b.txt"}));
+    EXPECT_EQ(getNames(cache.find(1, "a")), Names({"a", "a.txt", "ab.txt"}));
+    EXPECT_EQ(getNames(cache.find(1, "a.")), Names({"a.txt"}));
+    EXPECT_EQ(getNames(cache.find(1, "b.txt")), Names({"b.txt"}));
+    EXPECT_TRUE(getNames(cache.find(1, "c")).empty());
+    EXPECT_TRUE(getNames(cache.find(1, "A")).empty()); // case sensitive
+
+    auto folder = cache.find(1, "a");
+    ASSERT_TRUE(folder);
+    EXPECT_FALSE(folder->front().mIsFile);
+    EXPECT_EQ(folder->front().mHandle, 12u);
+
+    auto stats = cache.getStats();
+    EXPECT_EQ(stats.mNumFolders, 1u);
+    EXPECT_EQ(stats.mNumNames, 4u);
+    EXPECT_EQ(stats.mMisses, 1u);
+}
+
+TEST(CompletionCacheTest, invalidation)
+{
+    CompletionCache cache(100);
+    {
+        G_SUBTEST << "Added to the folder";
+        putDocs(cache);
+        cache.onNodeUpdated(20, 1, false);
+        EXPECT_FALSE(cache.find(1, ""));
+    }
+    {
+        G_SUBTEST << "Moved away from the folder";
+        putDocs(cache);
+        cache.onNodeUpdated(10, 2, false);
+        EXPECT_FALSE(cache.find(1, ""));
+    }
+    {
+        G_SUBTEST << "Changes elsewhere";
+        putDocs(cache);
+        cache.onNodeUpdated(30, 3, false);
+        EXPECT_TRUE(cache.find(1, ""));
+    }
+    {
+        G_SUBTEST << "The folder removed";
+        cache.onNodeUpdated(1, 0, true);
+        EXPECT_FALSE(cache.find(1, ""));
+        EXPECT_EQ(cache.getStats().mNumNames, 0u);
+    }
+    {
+        G_SUBTEST << "Listings got before a change are discarded";
+        auto generation = cache.getGeneration();
+        cache.onNodeUpdated(30, 3, false);
+        cache.put(1, {{"a", 12, false}}, generation);
+        EXPECT_FALSE(cache.find(1, ""));
+    }
+    {
+        G_SUBTEST << "Clearing";
+        putDocs(cache);
+        cache.clear();
+        EXPECT_FALSE(cache.find(1, ""));
+    }
+}
+
+TEST(CompletionCacheTest, capacity)
+{
+    CompletionCache cache(5);
+    putDocs(cache);
+    cache.put(2, {{"x", 21, true}}, cache.getGeneration());
+    EXPECT_EQ(cache.getStats().mNumNames, 5u);
+
+    EXPECT_TRUE(cache.find(1, ""));
+    cache.put(3, {{"y", 31, true}}, cache.getGeneration()); // evicts 2: 1 was used after it
+    EXPECT_FALSE(cache.find(2, ""));
+    EXPECT_TRUE(cache.find(1, ""));
+    EXPECT_TRUE(cache.find(3, ""));
+
+    cache.put(4, {{"1", 1, true}, {"2", 2, true}, {"3", 3, true}, {"4", 4, true}, {"5", 5, true}, {"6", 6, true}}, cache.getGeneration());
+    EXPECT_FALSE(cache.find(4, "")); // too large to be kept
+    EXPECT_TRUE(cache.find(1, ""));
+}
+
+// Completing within a folder with 50k children (run with --gtest_also_run_disabled_tests)
+TEST(CompletionCacheTest, DISABLED_benchmarkLargeFolder)
+{
+    constexpr size_t numChildren = 50000;
+    std::vector<CompletionCache::Child> children;
+    for (size_t i = 0; i < numChildren; ++i)
+    {
+        children.push_back({"file" + std::to_string(i * 7919 % numChildren) + ".dat", i, true});
+    }
+
+    CompletionCache cache(1000000);
+    auto start = std::chrono::steady_clock::now();
+    cache.put(1, children, cache.getGeneration());
+    auto putTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << numChildren << " children sorted in " << putTime << " ms" << std::endl;
+
+    for (const char *prefix : {"file4242", "file4", ""})
+    {
+        start = std::chrono::steady_clock::now();
+        auto found = cache.find(1, prefix);
+        auto time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "\"" << prefix << "\": " << found->size() << " found in " << time << " ms" << std::endl;
+    }
+}
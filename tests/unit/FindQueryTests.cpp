@@ -0,0 +1,157 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_find_query.h"
+
+using namespace megacmd;
+
+namespace {
+
+FindCandidate file(const char *name, int64_t size, int64_t time, int depth = 1)
+{
+    FindCandidate candidate;
+    candidate.mIsFile = true;
+    candidate.mName = name;
+    candidate.mSize = size;
+    candidate.mTime = time;
+    candidate.mDepth = depth;
+    return candidate;
+}
+
+FindCandidate folder(const char *name, int64_t time, int depth = 1)
+{
+    FindCandidate candidate;
+    candidate.mIsFolder = true;
+    candidate.mName = name;
+    candidate.mTime = time;
+    candidate.mDepth = depth;
+    return candidate;
+}
+
+}
+
+TEST(FindQueryTest, matching)
+{
+    PatternMatcher matcher("*.txt", false);
+    FindCriteria criteria;
+    criteria.mMatcher = &matcher;
+    {
+        G_SUBTEST << "Name only";
+        FindQuery query(criteria);
+        EXPECT_TRUE(query.matches(file("a.txt", 10, 100)));
+        EXPECT_TRUE(query.matches(folder("dir.txt", 100)));
+        EXPECT_FALSE(query.matches(file("a.jpg", 10, 100)));
+        EXPECT_FALSE(query.matches(file(nullptr, 10, 100)));
+    }
+    {
+        G_SUBTEST << "Type";
+        criteria.mType = FindNodeType::FOLDERS;
+        FindQuery query(criteria);
+        EXPECT_FALSE(query.matches(file("a.txt", 10, 100)));
+        EXPECT_TRUE(query.matches(folder("dir.txt", 100)));
+        criteria.mType = FindNodeType::ANY;
+    }
+    {
+        G_SUBTEST << "Sizes (inclusive): files only";
+        criteria.mMinSize = 10;
+        criteria.mMaxSize = 20;
+        FindQuery query(criteria);
+        EXPECT_TRUE(query.matches(file("a.txt", 10, 100)));
+        EXPECT_TRUE(query.matches(file("a.txt", 20, 100)));
+        EXPECT_FALSE(query.matches(file("a.txt", 21, 100)));
+        EXPECT_FALSE(query.matches(folder("dir.txt", 100)));
+        criteria.mMinSize = criteria.mMaxSize = -1;
+    }
+    {
+        G_SUBTEST << "Times (exclusive)";
+        criteria.mMinTime = 100;
+        criteria.mMaxTime = 200;
+        FindQuery query(criteria);
+        EXPECT_FALSE(query.matches(file("a.txt", 10, 100)));
+        EXPECT_TRUE(query.matches(file("a.txt", 10, 101)));
+        EXPECT_TRUE(query.matches(folder("dir.txt", 199)));
+        EXPECT_FALSE(query.matches(file("a.txt", 10, 200)));
+        criteria.mMinTime = criteria.mMaxTime = -1;
+    }
+    {
+        G_SUBTEST << "Depths (inclusive)";
+        criteria.mMinDepth = 1;
+        criteria.mMaxDepth = 2;
+        FindQuery query(criteria);
+        EXPECT_TRUE(query.usesDepth());
+        EXPECT_EQ(query.getMaxDepth(), 2);
+        EXPECT_FALSE(query.matches(folder("dir.txt", 100, 0)));
+        EXPECT_TRUE(query.matches(file("a.txt", 10, 100, 1)));
+        EXPECT_TRUE(query.matches(file("a.txt", 10, 100, 2)));
+        EXPECT_FALSE(query.matches(file("a.txt", 10, 100, 3)));
+    }
+}
+
+TEST(FindQueryTest, planning)
+{
+    PatternMatcher glob("a*b*c", false);
+    PatternMatcher any("*", false);
+    FindCriteria criteria;
+    EXPECT_EQ(FindQuery(criteria).describe(), "everything matches");
+
+    criteria.mMatcher = &any;
+    EXPECT_EQ(FindQuery(criteria).describe(), "any name");
+
+    criteria.mMatcher = &glob;
+    criteria.mType = FindNodeType::FILES;
+    criteria.mMaxTime = 100;
+    criteria.mMaxDepth = 3;
+    EXPECT_EQ(FindQuery(criteria).describe(), "depth, type, mtime, name (glob)");
+
+    // Sizes are only met by files
+    criteria.mMinSize = 1;
+    EXPECT_EQ(FindQuery(criteria).describe(), "depth, size, mtime, name (glob)");
+}
+
+TEST(FindQueryTest, unsatisfiable)
+{
+    auto check = [](const FindCriteria &criteria)
+    {
+        FindQuery query(criteria);
+        EXPECT_FALSE(query.isSatisfiable());
+        EXPECT_FALSE(query.matches(file("a", 10, 100)));
+        EXPECT_FALSE(query.matches(folder("a", 100)));
+    };
+
+    FindCriteria sizedFolders;
+    sizedFolders.mType = FindNodeType::FOLDERS;
+    sizedFolders.mMaxSize = 1000;
+    check(sizedFolders);
+
+    FindCriteria sizes;
+    sizes.mMinSize = 20;
+    sizes.mMaxSize = 10;
+    check(sizes);
+
+    FindCriteria times;
+    times.mMinTime = 100;
+    times.mMaxTime = 101;
+    check(times);
+
+    FindCriteria depths;
+    depths.mMinDepth = 3;
+    depths.mMaxDepth = 2;
+    check(depths);
+
+    EXPECT_TRUE(FindQuery(FindCriteria()).isSatisfiable());
+}
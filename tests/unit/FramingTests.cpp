@@ -0,0 +1,235 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_framing.h"
+
+using namespace megacmd;
+
+TEST(FramingTest, headerRoundTrip)
+{
+    FrameHeader header;
+    header.mType = FrameType::PARTIAL_ERR;
+    header.mFlags = 0xABCD;
+    header.mPetitionId = 123456;
+    header.mLength = (1ull << 40) + 7;
+
+    auto bytes = header.encode();
+    auto decoded = FrameHeader::decode(bytes.data());
+    ASSERT_TRUE(decoded);
+    EXPECT_EQ(decoded->mVersion, FRAME_PROTOCOL_VERSION);
+    EXPECT_EQ(decoded->mType, FrameType::PARTIAL_ERR);
+    EXPECT_EQ(decoded->mFlags, 0xABCD);
+    EXPECT_EQ(decoded->mPetitionId, 123456u);
+    EXPECT_EQ(decoded->mLength, (1ull << 40) + 7);
+}
+
+TEST(FramingTest, rejectsInvalidHeaders)
+{
+    {
+        G_SUBTEST << "Legacy petition (raw command line)";
+        const char legacy[FRAME_HEADER_SIZE + 1] = "ls -l /some/folder/x";
+        EXPECT_FALSE(FrameHeader::decode(legacy));
+    }
+    {
+        G_SUBTEST << "Newer protocol version";
+        FrameHeader header;
+        header.mVersion = FRAME_PROTOCOL_VERSION + 1;
+        EXPECT_FALSE(FrameHeader::decode(header.encode().data()));
+    }
+}
+
+TEST(FramingTest, petitionsAreAssembledAsBytesArrive)
+{
+    using Status = PetitionAssembler::Status;
+    const auto t0 = PetitionAssembler::Clock::now();
+
+    FrameHeader header;
+    header.mType = FrameType::COMMAND;
+    header.mPetitionId = 42;
+    const std::string command = "find / --pattern=*.jpg";
+    header.mLength = command.size();
+    auto headerBytes = header.encode();
+    const std::string frame = std::string(headerBytes.data(), headerBytes.size()) + command;
+
+    {
+        G_SUBTEST << "Framed, byte by byte";
+        PetitionAssembler assembler;
+        for (size_t i = 0; i + 1 < frame.size(); ++i)
+        {
+            ASSERT_EQ(assembler.append(&frame[i], 1), Status::INCOMPLETE) << "byte " << i;
+            ASSERT_EQ(assembler.onIdle(), Status::INCOMPLETE) << "byte " << i;
+        }
+        EXPECT_EQ(assembler.append(&frame.back(), 1), Status::COMPLETE);
+        EXPECT_TRUE(assembler.isFramed());
+        EXPECT_EQ(assembler.getHeader().mPetitionId, 42u);
+        EXPECT_EQ(assembler.takeLine(), command);
+    }
+    {
+        G_SUBTEST << "Legacy, told apart by its first byte";
+        PetitionAssembler assembler(t0);
+        EXPECT_EQ(assembler.append("l", 1, t0), Status::INCOMPLETE);
+        EXPECT_EQ(assembler.append("s -l", 4, t0), Status::INCOMPLETE);
+        EXPECT_EQ(assembler.onIdle(t0 + LEGACY_PETITION_QUIET_TIME), Status::COMPLETE);
+        EXPECT_FALSE(assembler.isFramed());
+        EXPECT_EQ(assembler.takeLine(), "ls -l");
+    }
+    {
+        G_SUBTEST << "Undecided until the whole magic number is received";
+        PetitionAssembler assembler;
+        EXPECT_EQ(assembler.append(frame.data(), 3), Status::INCOMPLETE);
+        EXPECT_EQ(assembler.onIdle(), Status::INCOMPLETE);
+        EXPECT_EQ(assembler.append(frame.data() + 3, frame.size() - 3), Status::COMPLETE);
+        EXPECT_TRUE(assembler.isFramed());
+    }
+    {
+        G_SUBTEST << "Legacy, a prefix of the magic number";
+        PetitionAssembler assembler;
+        EXPECT_EQ(assembler.append(frame.data(), 2), Status::INCOMPLETE);
+        EXPECT_EQ(assembler.onIdle(), Status::INCOMPLETE);
+        EXPECT_EQ(assembler.onClosed(), Status::COMPLETE);
+        EXPECT_EQ(assembler.takeLine(), frame.substr(0, 2));
+    }
+    {
+        G_SUBTEST << "Framed, closed before complete";
+        PetitionAssembler assembler;
+        EXPECT_EQ(assembler.append(frame.data(), frame.size() - 1), Status::INCOMPLETE);
+        EXPECT_EQ(assembler.onClosed(), Status::INVALID);
+        EXPECT_FALSE(assembler.hasTimedOut());
+    }
+    {
+        G_SUBTEST << "Framed, idle for too long";
+        PetitionAssembler assembler(t0);
+        EXPECT_EQ(assembler.append(frame.data(), frame.size() - 1, t0), Status::INCOMPLETE);
+        EXPECT_EQ(assembler.onIdle(t0 + INCOMING_PETITION_TIMEOUT - std::chrono::milliseconds(1)), Status::INCOMPLETE);
+        EXPECT_EQ(assembler.onIdle(t0 + INCOMING_PETITION_TIMEOUT), Status::INVALID);
+        EXPECT_TRUE(assembler.hasTimedOut());
+        EXPECT_EQ(assembler.append(&frame.back(), 1, t0 + INCOMING_PETITION_TIMEOUT), Status::INVALID);
+    }
+    {
+        G_SUBTEST << "Not a command";
+        FrameHeader response = header;
+        response.mType = FrameType::USER_RESPONSE;
+        PetitionAssembler assembler;
+        EXPECT_EQ(assembler.append(response.encode().data(), FRAME_HEADER_SIZE), Status::INVALID);
+    }
+    {
+        G_SUBTEST << "Nothing received";
+        PetitionAssembler assembler(t0);
+        EXPECT_EQ(assembler.onIdle(t0 + LEGACY_PETITION_QUIET_TIME), Status::INCOMPLETE);
+        EXPECT_EQ(assembler.onClosed(), Status::INVALID);
+    }
+    {
+        G_SUBTEST << "Nothing received for too long";
+        PetitionAssembler assembler(t0);
+        EXPECT_EQ(assembler.onIdle(t0 + INCOMING_PETITION_TIMEOUT), Status::INVALID);
+        EXPECT_TRUE(assembler.hasTimedOut());
+    }
+}
+
+TEST(FramingTest, legacyPetitionsSplitAcrossWritesAreWaitedFor)
+{
+    using Status = PetitionAssembler::Status;
+    const auto t0 = PetitionAssembler::Clock::now();
+    const auto quiet = LEGACY_PETITION_QUIET_TIME;
+
+    {
+        G_SUBTEST << "Second write before the quiet time";
+        PetitionAssembler assembler(t0);
+        EXPECT_EQ(assembler.append("ls -l", 5, t0), Status::INCOMPLETE);
+        // every byte sent so far was received: the rest is still on its way
+        EXPECT_EQ(assembler.onIdle(t0 + quiet / 2), Status::INCOMPLETE);
+        EXPECT_EQ(assembler.append(" /folder", 8, t0 + quiet / 2), Status::INCOMPLETE);
+        // the quiet time counts from the last bytes received
+        EXPECT_EQ(assembler.onIdle(t0 + quiet), Status::INCOMPLETE);
+        EXPECT_EQ(assembler.getDeadline(), t0 + quiet / 2 + quiet);
+        EXPECT_EQ(assembler.onIdle(t0 + quiet / 2 + quiet), Status::COMPLETE);
+        EXPECT_FALSE(assembler.isFramed());
+        EXPECT_EQ(assembler.takeLine(), "ls -l /folder");
+    }
+    {
+        G_SUBTEST << "Second write, then closed";
+        PetitionAssembler assembler(t0);
+        EXPECT_EQ(assembler.append("ls -l", 5, t0), Status::INCOMPLETE);
+        EXPECT_EQ(assembler.onIdle(t0), Status::INCOMPLETE);
+        EXPECT_EQ(assembler.append(" /folder", 8, t0 + quiet * 10), Status::INCOMPLETE);
+        EXPECT_EQ(assembler.onClosed(), Status::COMPLETE);
+        EXPECT_EQ(assembler.takeLine(), "ls -l /folder");
+    }
+}
+
+#ifndef _WIN32
+TEST(FramingTest, framesAreSentAndReceivedThroughSockets)
+{
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+    FrameHeader header;
+    header.mType = FrameType::COMMAND;
+    header.mPetitionId = 7;
+    std::string command = "rm " + std::string(10000, 'a');
+    ASSERT_TRUE(framing::sendFrame(fds[0], header, command, " -f"));
+
+    auto frame = framing::recvFrame(fds[1], FRAME_MAX_COMMAND_SIZE);
+    ASSERT_TRUE(frame);
+    EXPECT_EQ(frame->first.mType, FrameType::COMMAND);
+    EXPECT_EQ(frame->first.mPetitionId, 7u);
+    EXPECT_EQ(frame->second, command + " -f");
+
+    {
+        G_SUBTEST << "Payload over the limit";
+        ASSERT_TRUE(framing::sendFrame(fds[0], header, command));
+        EXPECT_FALSE(framing::recvFrame(fds[1], command.size() - 1));
+    }
+
+    close(fds[0]);
+    EXPECT_FALSE(framing::recvFrameHeader(fds[1]));
+    close(fds[1]);
+}
+
+TEST(FramingTest, legacyPetitionsSplitAcrossSocketWritesAreWaitedFor)
+{
+    using Status = PetitionAssembler::Status;
+
+    int fds[2];
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    ASSERT_EQ(write(fds[0], "ls -l", 5), 5);
+
+    char buffer[64];
+    PetitionAssembler assembler;
+    auto n = read(fds[1], buffer, sizeof(buffer));
+    ASSERT_EQ(n, 5);
+    EXPECT_EQ(assembler.append(buffer, static_cast<size_t>(n)), Status::INCOMPLETE);
+    EXPECT_EQ(framing::bytesAvailable(fds[1]), 0u);
+
+    // the second write arrives within the quiet time, after the first one was drained
+    ASSERT_EQ(write(fds[0], " /folder", 8), 8);
+    ASSERT_TRUE(framing::waitForBytes(fds[1], std::chrono::ceil<std::chrono::milliseconds>(assembler.getDeadline() - PetitionAssembler::Clock::now())));
+    n = read(fds[1], buffer, sizeof(buffer));
+    ASSERT_EQ(n, 8);
+    EXPECT_EQ(assembler.append(buffer, static_cast<size_t>(n)), Status::INCOMPLETE);
+
+    // nothing else comes
+    EXPECT_FALSE(framing::waitForBytes(fds[1], std::chrono::ceil<std::chrono::milliseconds>(assembler.getDeadline() - PetitionAssembler::Clock::now())));
+    EXPECT_EQ(assembler.onIdle(), Status::COMPLETE);
+    EXPECT_EQ(assembler.takeLine(), "ls -l /folder");
+
+    close(fds[0]);
+    EXPECT_TRUE(framing::waitForBytes(fds[1], std::chrono::milliseconds(0))); // closed
+    close(fds[1]);
+}
+#endif
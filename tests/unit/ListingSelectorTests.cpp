@@ -0,0 +1,382 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_listing_selector.h"
+
+using namespace megacmd;
+
+namespace {
+
+std::vector<ListingEntry> getRandomEntries(size_t count, unsigned seed)
+{
+    std::mt19937 random(seed);
+    std::vector<ListingEntry> entries;
+    for (size_t i = 0; i < count; ++i)
+    {
+        ListingEntry entry;
+        entry.mHandle = i;
+        entry.mName = "file" + std::to_string(random() % 50);
+        entry.mSize = random() % 20; // plenty of ties
+        entry.mTime = 1700000000 + random() % 100;
+        entry.mIsFolder = random() % 4 == 0;
+        entries.push_back(entry);
+    }
+    return entries;
+}
+
+std::vector<uint64_t> select(const std::vector<ListingEntry> &entries, const ListingOrder &order, const ListingEntry *startAfter = nullptr)
+{
+    ListingSelector selector(order);
+    if (startAfter)
+    {
+        selector.startAfter(*startAfter);
+    }
+    for (const auto &entry : entries)
+    {
+        selector.add(entry);
+    }
+
+    std::vector<uint64_t> handles;
+    for (const auto &entry : selector.take())
+    {
+        handles.push_back(entry.mHandle);
+    }
+    return handles;
+}
+
+// Stable sort of everything, then the first ones after the offset
+std::vector<uint64_t> selectByFullSort(std::vector<ListingEntry> entries, const ListingOrder &order)
+{
+    std::stable_sort(entries.begin(), entries.end(), [&order](const ListingEntry &a, const ListingEntry &b)
+    {
+        switch (order.mKey)
+        {
+            case ListingSortKey::NAME: return a.mName < b.mName;
+            case ListingSortKey::SIZE: return a.mSize > b.mSize;
+            case ListingSortKey::TIME: return a.mTime > b.mTime;
+            case ListingSortKey::NONE: return false;
+        }
+        return false;
+    });
+    if (order.mReverse)
+    {
+        std::reverse(entries.begin(), entries.end());
+    }
+
+    std::vector<uint64_t> handles;
+    for (size_t i = order.mOffset; i < entries.size() && (!order.mLimit || i < order.mOffset + order.mLimit); ++i)
+    {
+        handles.push_back(entries[i].mHandle);
+    }
+    return handles;
+}
+
+// As find sorts the results of the name index
+std::vector<uint64_t> sortForFind(std::vector<ListingEntry> entries)
+{
+    std::sort(entries.begin(), entries.end(), [](const ListingEntry &a, const ListingEntry &b)
+    {
+        return compareFindOrder(a, b) < 0;
+    });
+
+    std::vector<uint64_t> handles;
+    for (const auto &entry : entries)
+    {
+        handles.push_back(entry.mHandle);
+    }
+    return handles;
+}
+
+ListingEntry makeEntry(uint64_t handle, const std::string &name, bool isFolder = false, std::vector<ListingKey> ancestors = {})
+{
+    ListingEntry entry;
+    entry.mHandle = handle;
+    entry.mName = name;
+    entry.mIsFolder = isFolder;
+    entry.mAncestors = std::move(ancestors);
+    return entry;
+}
+
+}
+
+TEST(ListingSelectorTest, parsing)
+{
+    EXPECT_EQ(parseListingSortKey("name"), ListingSortKey::NAME);
+    EXPECT_EQ(parseListingSortKey("size"), ListingSortKey::SIZE);
+    EXPECT_EQ(parseListingSortKey("mtime"), ListingSortKey::TIME);
+    EXPECT_FALSE(parseListingSortKey("date"));
+    EXPECT_TRUE(ListingOrder().isDefault());
+}
+
+TEST(ListingSelectorTest, selectsLikeAFullSort)
+{
+    const auto entries = getRandomEntries(1000, 20240620);
+    for (ListingSortKey key : {ListingSortKey::NONE, ListingSortKey::NAME, ListingSortKey::SIZE, ListingSortKey::TIME})
+    {
+        for (bool reverse : {false, true})
+        {
+            for (size_t limit : {0, 1, 10, 999, 1000, 5000})
+            {
+                G_SUBTEST << "key " << static_cast<int>(key) << ", reverse " << reverse << ", limit " << limit;
+                ListingOrder order{key, reverse, limit};
+                EXPECT_EQ(select(entries, order), selectByFullSort(entries, order));
+            }
+        }
+    }
+}
+
+TEST(ListingSelectorTest, offsets)
+{
+    const auto entries = getRandomEntries(500, 42);
+    for (ListingSortKey key : {ListingSortKey::NONE, ListingSortKey::SIZE})
+    {
+        for (size_t offset : {1, 10, 499, 500, 600})
+        {
+            for (size_t limit : {0, 1, 10})
+            {
+                G_SUBTEST << "key " << static_cast<int>(key) << ", offset " << offset << ", limit " << limit;
+                ListingOrder order{key, false, limit, offset};
+                EXPECT_EQ(select(entries, order), selectByFullSort(entries, order));
+            }
+        }
+    }
+}
+
+TEST(ListingSelectorTest, pagesFollowEachOther)
+{
+    const auto entries = getRandomEntries(1000, 7);
+    for (ListingSortKey key : {ListingSortKey::NONE, ListingSortKey::NAME, ListingSortKey::SIZE, ListingSortKey::TIME})
+    {
+        for (bool reverse : {false, true})
+        {
+            G_SUBTEST << "key " << static_cast<int>(key) << ", reverse " << reverse;
+            const ListingOrder order{key, reverse, 64};
+
+            std::vector<uint64_t> paged;
+            std::optional<ListingEntry> last;
+            for (int page = 0; page < 100; ++page)
+            {
+                ListingSelector selector(order);
+                if (last)
+                {
+                    selector.startAfter(*last);
+                }
+                for (const auto &entry : entries)
+                {
+                    selector.add(entry);
+                }
+
+                auto selected = selector.take();
+                if (selected.empty())
+                {
+                    break;
+                }
+                for (const auto &entry : selected)
+                {
+                    paged.push_back(entry.mHandle);
+                }
+
+                // Through the cursor, as the client would give it back
+                ListingCursor cursor;
+                cursor.mLast = selected.back();
+                auto decoded = ListingCursor::decode(cursor.encode());
+                ASSERT_TRUE(decoded);
+                last = decoded->mLast;
+            }
+
+            EXPECT_EQ(paged, selectByFullSort(entries, ListingOrder{key, reverse}));
+        }
+    }
+}
+
+TEST(ListingSelectorTest, findOrder)
+{
+    // Siblings: folders first, then names case-insensitively, digits by their value
+    const std::vector<ListingEntry> sorted{makeEntry(9, "zeta", true), makeEntry(1, "a"), makeEntry(2, "B"),
+                                           makeEntry(3, "file2"), makeEntry(4, "File010"), makeEntry(8, "file10"),
+                                           makeEntry(5, "file10b")};
+    for (size_t i = 0; i < sorted.size(); ++i)
+    {
+        G_SUBTEST << "entry " << i;
+        EXPECT_EQ(compareFindOrder(sorted[i], sorted[i]), 0);
+        for (size_t j = i + 1; j < sorted.size(); ++j)
+        {
+            EXPECT_LT(compareFindOrder(sorted[i], sorted[j]), 0) << sorted[i].mName << " vs " << sorted[j].mName;
+            EXPECT_GT(compareFindOrder(sorted[j], sorted[i]), 0);
+        }
+    }
+
+    // Each folder after its descendants, which come before the folders after it
+    const ListingKey a{true, "a", 10};
+    const ListingKey b{true, "b", 11};
+    const std::vector<ListingEntry> entries{makeEntry(16, "file"), makeEntry(15, "a", false, {b}), makeEntry(11, "b", true),
+                                            makeEntry(14, "b", false, {a}), makeEntry(10, "a", true),
+                                            makeEntry(13, "z", false, {a, ListingKey{true, "c", 12}}),
+                                            makeEntry(12, "c", true, {a})};
+    EXPECT_EQ(sortForFind(entries), std::vector<uint64_t>({13, 12, 14, 10, 15, 11, 16}));
+}
+
+TEST(ListingSelectorTest, findOrderDiffersFromTheTraversalForSomeNames)
+{
+    // The SDK compares the case of any letter: it would list "écrit" first. Non-ASCII bytes are compared as they are
+    EXPECT_EQ(sortForFind({makeEntry(1, "écrit"), makeEntry(2, "Été")}), std::vector<uint64_t>({2, 1}));
+
+    // Names equal but for leading zeros or case are told apart by handle, wherever the SDK lists them
+    EXPECT_EQ(sortForFind({makeEntry(2, "01"), makeEntry(1, "1")}), std::vector<uint64_t>({1, 2}));
+    EXPECT_EQ(sortForFind({makeEntry(2, "name"), makeEntry(1, "NAME")}), std::vector<uint64_t>({1, 2}));
+}
+
+TEST(ListingSelectorTest, unsortedPagesCheckTheirStart)
+{
+    // As the SDK got them: names are not compared, whatever their case, digits or encoding
+    const std::vector<std::string> names{"001", "01", "1", "Ábaco", "ábaco", "Zürich", "zurich", "ß", "SS", "日本",
+                                         "file", "File", "FILE", "file2", "file10", "file02"};
+    std::vector<ListingEntry> entries;
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        entries.push_back(makeEntry(100 + i, names[i]));
+    }
+
+    const ListingOrder order{ListingSortKey::NONE, false, 4};
+    std::vector<uint64_t> paged;
+    std::optional<ListingEntry> last;
+    for (size_t page = 0; page < names.size(); ++page)
+    {
+        ListingSelector selector(order);
+        if (last)
+        {
+            selector.startAfter(*last);
+        }
+        for (const auto &entry : entries)
+        {
+            selector.add(entry);
+        }
+        auto selected = selector.take();
+        EXPECT_FALSE(selector.isStartLost());
+        if (selected.empty())
+        {
+            break;
+        }
+        for (const auto &entry : selected)
+        {
+            paged.push_back(entry.mHandle);
+        }
+        auto decoded = ListingCursor::decode(ListingCursor{0, order.mKey, false, false, selected.back()}.encode());
+        ASSERT_TRUE(decoded);
+        last = decoded->mLast;
+    }
+    EXPECT_EQ(paged, select(entries, ListingOrder{}));
+
+    // The last entry listed moved: a page from its former position would skip or repeat entries
+    ListingSelector firstPage(order);
+    for (const auto &entry : entries)
+    {
+        firstPage.add(entry);
+    }
+    const ListingEntry lastListed = firstPage.take().back();
+    for (int change = 0; change < 3; ++change)
+    {
+        G_SUBTEST << "change " << change;
+        auto changed = entries;
+        switch (change)
+        {
+            case 0: changed.insert(changed.begin(), makeEntry(1, "0")); break;
+            case 1: changed.erase(changed.begin() + 1); break;
+            case 2: changed.resize(3); break;
+        }
+
+        ListingSelector selector(order);
+        selector.startAfter(lastListed);
+        for (const auto &entry : changed)
+        {
+            selector.add(entry);
+        }
+        selector.take();
+        EXPECT_TRUE(selector.isStartLost());
+    }
+
+    // Sorted by any key, pages start after the last entry wherever it is
+    ListingSelector sorted(ListingOrder{ListingSortKey::NAME, false, 4});
+    sorted.startAfter(lastListed);
+    EXPECT_FALSE(sorted.isStartLost());
+}
+
+TEST(ListingSelectorTest, cursors)
+{
+    ListingCursor cursor;
+    cursor.mFolder = 0x123456789abcULL;
+    cursor.mKey = ListingSortKey::TIME;
+    cursor.mReverse = true;
+    cursor.mRecursive = true;
+    cursor.mLast = makeEntry(77, "some name\n");
+    cursor.mLast.mSize = -1;
+    cursor.mLast.mTime = 1700000000;
+    cursor.mLast.mSequence = 12;
+
+    auto decoded = ListingCursor::decode(cursor.encode());
+    ASSERT_TRUE(decoded);
+    EXPECT_EQ(decoded->mFolder, cursor.mFolder);
+    EXPECT_EQ(decoded->mKey, cursor.mKey);
+    EXPECT_TRUE(decoded->mReverse);
+    EXPECT_TRUE(decoded->mRecursive);
+    EXPECT_EQ(decoded->mLast.mHandle, 77u);
+    EXPECT_EQ(decoded->mLast.mName, "some name\n");
+    EXPECT_EQ(decoded->mLast.mSize, -1);
+    EXPECT_EQ(decoded->mLast.mTime, 1700000000);
+    EXPECT_EQ(decoded->mLast.mSequence, 12u);
+
+    EXPECT_FALSE(ListingCursor::decode(""));
+    EXPECT_FALSE(ListingCursor::decode("not a cursor!"));
+    auto token = cursor.encode();
+    EXPECT_FALSE(ListingCursor::decode(token.substr(0, token.size() - 2)));
+}
+
+TEST(ListingSelectorTest, completion)
+{
+    ListingSelector selector(ListingOrder{ListingSortKey::NONE, false, 2});
+    selector.add(makeEntry(1, ""));
+    EXPECT_FALSE(selector.isComplete());
+    selector.add(makeEntry(2, ""));
+    EXPECT_TRUE(selector.isComplete());
+
+    // Any later entry could still be selected
+    ListingSelector sorted(ListingOrder{ListingSortKey::SIZE, false, 1});
+    sorted.add(makeEntry(1, ""));
+    EXPECT_FALSE(sorted.isComplete());
+    ListingSelector reversed(ListingOrder{ListingSortKey::NONE, true, 1});
+    reversed.add(makeEntry(1, ""));
+    EXPECT_FALSE(reversed.isComplete());
+}
+
+// Top 100 of a large listing, bounded heap vs full sort (run with --gtest_also_run_disabled_tests)
+TEST(ListingSelectorTest, DISABLED_benchmarkTopK)
+{
+    const auto entries = getRandomEntries(2000000, 7);
+    for (size_t limit : {100, 0})
+    {
+        auto start = std::chrono::steady_clock::now();
+        auto selected = select(entries, ListingOrder{ListingSortKey::SIZE, false, limit});
+        auto time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << entries.size() << " entries, limit " << limit << ": " << selected.size() << " selected in " << time << " ms" << std::endl;
+    }
+}
@@ -0,0 +1,206 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_name_index.h"
+
+using megacmd::NodeNameIndex;
+using megacmd::PatternMatcher;
+using Handle = NodeNameIndex::Handle;
+
+namespace {
+
+constexpr Handle UNDEF_HANDLE = ~Handle(0);
+
+// root(1): docs(2): {report.pdf(3), notes.txt(4) [version: notes.txt(5)]}, photos(6): {report.jpg(7)}
+void buildSampleTree(NodeNameIndex &index)
+{
+    index.beginBuild();
+    index.add(1, UNDEF_HANDLE, "root", false);
+    index.add(2, 1, "docs", false);
+    index.add(3, 2, "report.pdf", true);
+    index.add(4, 2, "notes.txt", true);
+    index.add(5, 4, "notes.txt", true);
+    index.add(6, 1, "photos", false);
+    index.add(7, 6, "report.jpg", true);
+    index.endBuild(std::chrono::milliseconds(0));
+}
+
+std::vector<Handle> find(const NodeNameIndex &index, Handle root, const std::string &pattern, bool usepcre = false)
+{
+    auto found = index.find(root, PatternMatcher(pattern, usepcre));
+    EXPECT_TRUE(found.has_value());
+    if (!found)
+    {
+        return {};
+    }
+    std::sort(found->begin(), found->end());
+    return *found;
+}
+
+}
+
+TEST(NameIndexTest, queries)
+{
+    NodeNameIndex index;
+    EXPECT_FALSE(index.find(1, PatternMatcher("*", false)).has_value()); // not built yet
+
+    buildSampleTree(index);
+    {
+        G_SUBTEST << "Name";
+        EXPECT_EQ(find(index, 1, "notes.txt"), std::vector<Handle>({4})); // the version is not part of the tree
+        EXPECT_EQ(find(index, 1, "missing"), std::vector<Handle>());
+    }
+    {
+        G_SUBTEST << "Extension";
+        EXPECT_EQ(find(index, 1, "*.pdf"), std::vector<Handle>({3}));
+        EXPECT_EQ(find(index, 1, "*.jpg"), std::vector<Handle>({7}));
+    }
+    {
+        G_SUBTEST << "Substring";
+        EXPECT_EQ(find(index, 1, "*port*"), std::vector<Handle>({3, 7}));
+        EXPECT_EQ(find(index, 1, "*o*"), std::vector<Handle>({1, 2, 3, 4, 6, 7})); // no trigrams: every name is matched
+    }
+    {
+        G_SUBTEST << "Subtree";
+        EXPECT_EQ(find(index, 2, "*port*"), std::vector<Handle>({3}));
+        EXPECT_EQ(find(index, 6, "*"), std::vector<Handle>({6, 7}));
+        EXPECT_FALSE(index.find(42, PatternMatcher("*", false)).has_value()); // unknown root
+    }
+    {
+        G_SUBTEST << "Regular expressions";
+        EXPECT_EQ(find(index, 1, "report\\.(pdf|jpg)", true), std::vector<Handle>({3, 7}));
+    }
+}
+
+TEST(NameIndexTest, lineage)
+{
+    NodeNameIndex index;
+    buildSampleTree(index);
+
+    auto lineage = index.getLineage(7, 1);
+    ASSERT_TRUE(lineage);
+    ASSERT_EQ(lineage->size(), 3u);
+    EXPECT_EQ((*lineage)[0].mName, "root");
+    EXPECT_EQ((*lineage)[1].mHandle, 6u);
+    EXPECT_FALSE((*lineage)[1].mIsFile);
+    EXPECT_EQ((*lineage)[2].mName, "report.jpg");
+    EXPECT_TRUE((*lineage)[2].mIsFile);
+
+    EXPECT_EQ(index.getLineage(2, 2)->size(), 1u);
+    EXPECT_FALSE(index.getLineage(7, 2)); // in another subtree
+    EXPECT_FALSE(index.getLineage(5, 1)); // a version
+    EXPECT_FALSE(index.getLineage(42, 1));
+}
+
+TEST(NameIndexTest, updates)
+{
+    NodeNameIndex index;
+    buildSampleTree(index);
+
+    index.applyUpdates({{3, 2, "summary.pdf", true, false},   // rename
+                        {7, 2, "report.jpg", true, false},    // move
+                        {8, 6, "report.png", true, false},    // new
+                        {4, 2, "notes.txt", true, true}});    // removal
+    EXPECT_EQ(find(index, 1, "*report*"), std::vector<Handle>({7, 8}));
+    EXPECT_EQ(find(index, 2, "*.*"), std::vector<Handle>({3, 7}));
+    EXPECT_EQ(find(index, 1, "summary.pdf"), std::vector<Handle>({3}));
+    EXPECT_EQ(find(index, 1, "notes.txt"), std::vector<Handle>());
+
+    // Removing a folder leaves nothing reachable under it
+    index.applyUpdates({{6, 1, "photos", false, true}});
+    EXPECT_EQ(find(index, 1, "*.png"), std::vector<Handle>());
+}
+
+TEST(NameIndexTest, updatesDuringBuildAreNotLost)
+{
+    NodeNameIndex index;
+    index.beginBuild();
+    index.add(1, UNDEF_HANDLE, "root", false);
+    index.applyUpdates({{2, 1, "new.txt", true, false}, {1, UNDEF_HANDLE, "root", false, false}});
+    index.add(3, 1, "old.txt", true);
+    index.applyUpdates({{3, 1, "old.txt", true, true}});
+    EXPECT_FALSE(index.isReady());
+    index.endBuild(std::chrono::milliseconds(0));
+
+    EXPECT_TRUE(index.isReady());
+    EXPECT_EQ(find(index, 1, "*.txt"), std::vector<Handle>({2}));
+
+    index.clear();
+    EXPECT_FALSE(index.isReady());
+}
+
+TEST(NameIndexTest, renamesAreCompacted)
+{
+    NodeNameIndex index;
+    index.beginBuild();
+    index.add(1, UNDEF_HANDLE, "root", false);
+    index.add(2, 1, "file", true);
+    index.endBuild(std::chrono::milliseconds(0));
+
+    auto initialMemory = index.getStats().mMemoryBytes;
+    for (int i = 0; i < 100000; ++i)
+    {
+        index.applyUpdates({{2, 1, "file " + std::to_string(i), true, false}});
+    }
+    EXPECT_EQ(find(index, 1, "file 99999"), std::vector<Handle>({2}));
+    EXPECT_EQ(find(index, 1, "file 1*"), std::vector<Handle>());
+    EXPECT_EQ(index.getStats().mNumNodes, 2u);
+    EXPECT_LT(index.getStats().mMemoryBytes, initialMemory + 8 * 1024 * 1024);
+}
+
+// Build time, footprint and query times on a large synthetic account (run with --gtest_also_run_disabled_tests)
+TEST(NameIndexTest, DISABLED_benchmarkLargeAccount)
+{
+    constexpr Handle numFolders = 20000;
+    constexpr Handle filesPerFolder = 50;
+
+    NodeNameIndex index;
+    auto start = std::chrono::steady_clock::now();
+    index.beginBuild();
+    index.add(1, UNDEF_HANDLE, "root", false);
+    Handle next = 2;
+    for (Handle f = 0; f < numFolders; ++f)
+    {
+        Handle folder = next++;
+        index.add(folder, f < 100 ? 1 : 2 + (f % 100) * (filesPerFolder + 1), "folder " + std::to_string(f), false);
+        for (Handle i = 0; i < filesPerFolder; ++i)
+        {
+            static const char *extensions[] = {".jpg", ".pdf", ".txt", ".mp4", ".docx"};
+            index.add(next++, folder, "IMG_" + std::to_string(f * filesPerFolder + i) + extensions[i % 5], true);
+        }
+    }
+    auto buildTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    index.endBuild(buildTime);
+
+    auto stats = index.getStats();
+    std::cout << "nodes: " << stats.mNumNodes << ", trigrams: " << stats.mNumTrigrams << ", memory: " << stats.mMemoryBytes / (1024 * 1024)
+              << " MB, build: " << stats.mBuildTime.count() << " ms" << std::endl;
+
+    for (const char *pattern : {"IMG_123456.pdf", "*.docx", "*_99999*", "folder 1*", "*4?2*"})
+    {
+        auto queryStart = std::chrono::steady_clock::now();
+        auto found = index.find(1, PatternMatcher(pattern, false));
+        auto queryTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - queryStart).count();
+        ASSERT_TRUE(found.has_value());
+        std::cout << pattern << ": " << found->size() << " results in " << queryTime << " ms" << std::endl;
+    }
+}
@@ -0,0 +1,245 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_node_export.h"
+
+using namespace megacmd;
+
+namespace {
+
+std::string exportNodes(NodeExportFormat format, const std::vector<ExportedNode> &nodes, size_t bufferSize = 1024)
+{
+    std::string out;
+    NodeExporter exporter(format, [&out](const char *data, size_t size) { out.append(data, size); }, bufferSize);
+    for (const auto &node : nodes)
+    {
+        exporter.write(node);
+    }
+    exporter.flush();
+    return out;
+}
+
+ExportedNode getFile()
+{
+    ExportedNode node;
+    node.mHandle = 0x0000050403020100;
+    node.mParentHandle = 0;
+    node.mName = "a \"b\"\\c\n.txt";
+    node.mType = ExportedNodeType::FILE;
+    node.mSize = 300;
+    node.mTime = 1700000000;
+    node.mFingerprint = "fp";
+    node.mNumVersions = 2;
+    return node;
+}
+
+// Reads what BINARY records hold
+class BinaryReader
+{
+public:
+    explicit BinaryReader(const std::string &data) : mData(data) {}
+
+    bool atEnd() const { return mPos >= mData.size(); }
+
+    uint8_t byte() { return static_cast<uint8_t>(mData.at(mPos++)); }
+
+    uint64_t handle()
+    {
+        uint64_t value = 0;
+        for (int i = 0; i < 6; ++i)
+        {
+            value |= static_cast<uint64_t>(byte()) << (8 * i);
+        }
+        return value;
+    }
+
+    uint64_t varint()
+    {
+        uint64_t value = 0;
+        for (int shift = 0; ; shift += 7)
+        {
+            uint8_t b = byte();
+            value |= static_cast<uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80))
+            {
+                return value;
+            }
+        }
+    }
+
+    std::string bytes()
+    {
+        size_t size = static_cast<size_t>(varint());
+        std::string value = mData.substr(mPos, size);
+        mPos += size;
+        return value;
+    }
+
+private:
+    std::string mData;
+    size_t mPos = 0;
+};
+
+}
+
+TEST(NodeExportTest, handles)
+{
+    std::string out;
+    NodeExporter::appendHandle(out, 0);
+    EXPECT_EQ(out, "AAAAAAAA");
+
+    out.clear();
+    NodeExporter::appendHandle(out, ~uint64_t(0));
+    EXPECT_EQ(out, "________");
+
+    // 00 01 02 | 03 04 05
+    out.clear();
+    NodeExporter::appendHandle(out, 0x0000050403020100);
+    EXPECT_EQ(out, "AAECAwQF");
+}
+
+TEST(NodeExportTest, ndjson)
+{
+    ExportedNode folder;
+    folder.mHandle = 0;
+    folder.mName = "root";
+    folder.mType = ExportedNodeType::ROOT;
+
+    EXPECT_EQ(exportNodes(NodeExportFormat::NDJSON, {folder, getFile()}),
+              "{\"handle\":\"AAAAAAAA\",\"parent\":null,\"name\":\"root\",\"type\":\"root\",\"size\":0,\"mtime\":0,\"fingerprint\":null,\"versions\":0}\n"
+              "{\"handle\":\"AAECAwQF\",\"parent\":\"AAAAAAAA\",\"name\":\"a \\\"b\\\"\\\\c\\n.txt\",\"type\":\"file\",\"size\":300,\"mtime\":1700000000,\"fingerprint\":\"fp\",\"versions\":2}\n");
+
+    ExportedNode control = getFile();
+    control.mName = "\x01";
+    control.mTime = -5;
+    auto out = exportNodes(NodeExportFormat::NDJSON, {control});
+    EXPECT_NE(out.find("\"name\":\"\\u0001\""), std::string::npos);
+    EXPECT_NE(out.find("\"mtime\":-5"), std::string::npos);
+}
+
+TEST(NodeExportTest, binary)
+{
+    ExportedNode orphan = getFile();
+    orphan.mParentHandle.reset();
+    orphan.mFingerprint = nullptr;
+    orphan.mTime = -1;
+
+    const std::string out = exportNodes(NodeExportFormat::BINARY, {getFile(), orphan});
+    ASSERT_EQ(out.substr(0, 5), std::string("MCNX\x01", 5));
+
+    BinaryReader reader(out.substr(5));
+    for (const ExportedNode &expected : {getFile(), orphan})
+    {
+        G_SUBTEST << "Record of " << expected.mNumVersions;
+        EXPECT_EQ(reader.byte(), static_cast<uint8_t>(ExportedNodeType::FILE));
+        EXPECT_EQ(reader.handle(), expected.mHandle);
+        EXPECT_EQ(reader.handle(), expected.mParentHandle ? *expected.mParentHandle : 0xFFFFFFFFFFFFull);
+        EXPECT_EQ(reader.varint(), static_cast<uint64_t>(expected.mSize));
+        uint64_t zigzag = reader.varint();
+        EXPECT_EQ(static_cast<int64_t>((zigzag >> 1) ^ (~(zigzag & 1) + 1)), expected.mTime);
+        EXPECT_EQ(reader.varint(), static_cast<uint64_t>(expected.mNumVersions));
+        EXPECT_EQ(reader.bytes(), expected.mName);
+        EXPECT_EQ(reader.bytes(), expected.mFingerprint ? expected.mFingerprint : "");
+    }
+    EXPECT_TRUE(reader.atEnd());
+}
+
+TEST(NodeExportTest, streaming)
+{
+    size_t numWrites = 0;
+    std::string out;
+    {
+        NodeExporter exporter(NodeExportFormat::NDJSON, [&](const char *data, size_t size)
+        {
+            ++numWrites;
+            out.append(data, size);
+        }, 256);
+
+        for (int i = 0; i < 10; ++i)
+        {
+            exporter.write(getFile());
+        }
+        EXPECT_GT(numWrites, 1u); // written as the buffer fills up
+        EXPECT_EQ(exporter.getNumNodes(), 10u);
+    }
+    EXPECT_EQ(out, exportNodes(NodeExportFormat::NDJSON, std::vector<ExportedNode>(10, getFile()), 1 << 20));
+
+    EXPECT_EQ(parseNodeExportFormat("ndjson"), NodeExportFormat::NDJSON);
+    EXPECT_EQ(parseNodeExportFormat("binary"), NodeExportFormat::BINARY);
+    EXPECT_FALSE(parseNodeExportFormat("json"));
+}
+
+// Nodes per second exported vs formatted in columns the way ls -l does (run with --gtest_also_run_disabled_tests)
+TEST(NodeExportTest, DISABLED_benchmarkVsTable)
+{
+    constexpr int numNodes = 1000000;
+    std::vector<std::string> names;
+    for (int i = 0; i < numNodes; ++i)
+    {
+        names.push_back("file number " + std::to_string(i) + ".jpg");
+    }
+
+    auto run = [&](const char *what, const std::function<size_t()> &format)
+    {
+        auto start = std::chrono::steady_clock::now();
+        size_t bytes = format();
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << what << ": " << static_cast<long long>(numNodes / seconds) << " nodes/s, " << bytes / numNodes << " bytes/node" << std::endl;
+    };
+
+    for (NodeExportFormat format : {NodeExportFormat::NDJSON, NodeExportFormat::BINARY})
+    {
+        run(format == NodeExportFormat::NDJSON ? "ndjson" : "binary", [&]()
+        {
+            size_t bytes = 0;
+            NodeExporter exporter(format, [&bytes](const char*, size_t size) { bytes += size; });
+            ExportedNode node = getFile();
+            node.mFingerprint = "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAA";
+            for (int i = 0; i < numNodes; ++i)
+            {
+                node.mHandle = static_cast<uint64_t>(i);
+                node.mName = names[i].c_str();
+                exporter.write(node);
+            }
+            exporter.flush();
+            return bytes;
+        });
+    }
+
+    // Fixed length columns, and a time formatted with strftime for each node
+    run("table", [&]()
+    {
+        size_t bytes = 0;
+        for (int i = 0; i < numNodes; ++i)
+        {
+            std::ostringstream line;
+            char time[64];
+            std::time_t t = 1700000000 + i;
+            std::strftime(time, sizeof(time), "%d%b%Y %H:%M:%S", std::localtime(&t));
+            line << "-" << std::setw(4) << 2 << " " << std::setw(12) << 300 << " " << time << " " << names[i] << "\n";
+            bytes += line.str().size();
+        }
+        return bytes;
+    });
+}
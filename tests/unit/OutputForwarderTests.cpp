@@ -0,0 +1,207 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef _WIN32
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmdshell/megacmdshelloutputforwarder.h"
+
+namespace
+{
+struct SocketPair
+{
+    int mFds[2] = {-1, -1};
+
+    SocketPair() { socketpair(AF_UNIX, SOCK_STREAM, 0, mFds); }
+    ~SocketPair()
+    {
+        for (int fd : mFds)
+        {
+            if (fd != -1)
+            {
+                close(fd);
+            }
+        }
+    }
+
+    int sender() const { return mFds[0]; }
+    int receiver() const { return mFds[1]; }
+};
+
+std::string generateContents(size_t size)
+{
+    std::string contents(size, '\0');
+    for (size_t i = 0; i < size; ++i)
+    {
+        contents[i] = static_cast<char>('a' + i % 26);
+    }
+    return contents;
+}
+
+void sendAll(int socket, const std::string &contents)
+{
+    size_t sent = 0;
+    while (sent < contents.size())
+    {
+        auto n = send(socket, contents.data() + sent, contents.size() - sent, 0);
+        if (n <= 0)
+        {
+            return;
+        }
+        sent += static_cast<size_t>(n);
+    }
+}
+}
+
+TEST(OutputForwarderTest, forwardsIntoStream)
+{
+    SocketPair sockets;
+    const auto contents = generateContents(3 * megacmd::OutputForwarder::sBufferSize + 17);
+    std::thread sender([&]() { sendAll(sockets.sender(), contents); });
+
+    std::ostringstream stream;
+    megacmd::OutputForwarder forwarder(stream, -1);
+    EXPECT_TRUE(forwarder.forward(sockets.receiver(), contents.size()));
+    forwarder.flush();
+    sender.join();
+
+    EXPECT_EQ(stream.str(), contents);
+}
+
+TEST(OutputForwarderTest, forwardsIntoFd)
+{
+    const auto contents = generateContents(1024 * 1024 + 3);
+
+    for (bool usePipe : {true, false})
+    {
+        G_SUBTEST << (usePipe ? "Pipe" : "Socket");
+
+        SocketPair sockets;
+        int readFd = -1;
+        int writeFd = -1;
+        SocketPair outputSockets;
+        int pipeFds[2];
+        if (usePipe)
+        {
+            ASSERT_EQ(pipe(pipeFds), 0);
+            readFd = pipeFds[0];
+            writeFd = pipeFds[1];
+        }
+        else
+        {
+            readFd = outputSockets.receiver();
+            writeFd = outputSockets.sender();
+        }
+
+        std::thread sender([&]() { sendAll(sockets.sender(), contents); });
+        std::string received;
+        std::thread reader([&]()
+        {
+            char buffer[65536];
+            while (received.size() < contents.size())
+            {
+                auto n = read(readFd, buffer, sizeof(buffer));
+                if (n <= 0)
+                {
+                    break;
+                }
+                received.append(buffer, static_cast<size_t>(n));
+            }
+        });
+
+        std::ostringstream stream;
+        stream << "written before";
+        megacmd::OutputForwarder forwarder(stream, writeFd);
+        EXPECT_TRUE(forwarder.forward(sockets.receiver(), contents.size()));
+        sender.join();
+        reader.join();
+
+        EXPECT_EQ(received, contents);
+        EXPECT_EQ(stream.str(), "written before");
+
+        if (usePipe)
+        {
+            close(pipeFds[0]);
+            close(pipeFds[1]);
+        }
+    }
+}
+
+// Run with --gtest_also_run_disabled_tests to compare the legacy receive loop with the forwarder
+TEST(OutputForwarderTest, DISABLED_benchmarkReceivePath)
+{
+    const size_t totalSize = 512 * 1024 * 1024;
+    const auto chunk = generateContents(64 * 1024);
+    std::recursive_mutex stdoutMutex;
+
+    auto measure = [&](const char *name, const std::function<void(int /*socket*/, int /*devnull*/)> &receive)
+    {
+        SocketPair sockets;
+        int devNull = open("/dev/null", O_WRONLY);
+        ASSERT_NE(devNull, -1);
+
+        std::thread sender([&]()
+        {
+            for (size_t sent = 0; sent < totalSize; sent += chunk.size())
+            {
+                sendAll(sockets.sender(), chunk);
+            }
+            shutdown(sockets.sender(), SHUT_WR);
+        });
+
+        auto start = std::chrono::steady_clock::now();
+        receive(sockets.receiver(), devNull);
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        sender.join();
+        close(devNull);
+
+        std::cout << name << ": " << (totalSize / (1024.0 * 1024.0)) / elapsed << " MB/s" << std::endl;
+    };
+
+    measure("legacy (1 KiB recv, string, lock & flush per chunk)", [&](int socket, int)
+    {
+        std::ofstream devNull("/dev/null");
+        char buffer[1025];
+        ssize_t n;
+        do
+        {
+            n = recv(socket, buffer, 1024, 0);
+            if (n > 0)
+            {
+                std::lock_guard<std::recursive_mutex> g(stdoutMutex);
+                devNull << std::string(buffer, static_cast<size_t>(n)) << std::flush;
+            }
+        } while (n > 0);
+    });
+
+    measure("forwarder (256 KiB buffer into the fd, one lock)", [&](int socket, int devNull)
+    {
+        std::ostringstream unused;
+        megacmd::OutputForwarder forwarder(unused, devNull);
+        std::lock_guard<std::recursive_mutex> g(stdoutMutex);
+        EXPECT_TRUE(forwarder.forward(socket, totalSize));
+    });
+}
+
+#endif
@@ -0,0 +1,102 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_path_cache.h"
+
+using megacmd::NodePathCache;
+
+TEST(PathCacheTest, pathsAndChildren)
+{
+    NodePathCache cache(10);
+    EXPECT_FALSE(cache.getPath(1));
+
+    cache.putPath(1, "/", cache.getGeneration());
+    cache.putPath(2, "/docs", cache.getGeneration());
+    cache.putChild(1, "docs", 2, cache.getGeneration());
+    EXPECT_EQ(cache.getPath(1), std::optional<std::string>("/"));
+    EXPECT_EQ(cache.getPath(2), std::optional<std::string>("/docs"));
+    EXPECT_EQ(cache.getChild(1, "docs"), std::optional<NodePathCache::Handle>(2));
+    EXPECT_FALSE(cache.getChild(1, "photos"));
+
+    auto stats = cache.getStats();
+    EXPECT_EQ(stats.mNumEntries, 2u);
+    EXPECT_EQ(stats.mHits, 3u);
+    EXPECT_EQ(stats.mMisses, 2u);
+
+    {
+        G_SUBTEST << "Joining";
+        EXPECT_EQ(NodePathCache::join("/", "docs"), "/docs");
+        EXPECT_EQ(NodePathCache::join("/docs", "a.txt"), "/docs/a.txt");
+        EXPECT_EQ(NodePathCache::join("//bin", "old"), "//bin/old");
+        EXPECT_EQ(NodePathCache::join("user@example.com:shared", "sub"), "user@example.com:shared/sub");
+    }
+}
+
+TEST(PathCacheTest, leastRecentlyUsedAreEvicted)
+{
+    NodePathCache cache(3);
+    for (NodePathCache::Handle h = 1; h <= 3; ++h)
+    {
+        cache.putPath(h, "/" + std::to_string(h), cache.getGeneration());
+    }
+    EXPECT_TRUE(cache.getPath(1));
+    cache.putChild(1, "x", 4, cache.getGeneration()); // evicts 2: 1 was used after it
+    EXPECT_TRUE(cache.getPath(3));
+    EXPECT_FALSE(cache.getPath(2));
+    EXPECT_TRUE(cache.getPath(1));
+    EXPECT_TRUE(cache.getChild(1, "x"));
+
+    cache.putPath(5, "/5", cache.getGeneration()); // evicts 3
+    EXPECT_FALSE(cache.getPath(3));
+    EXPECT_EQ(cache.getStats().mNumEntries, 3u);
+}
+
+TEST(PathCacheTest, invalidation)
+{
+    NodePathCache cache(10);
+    {
+        G_SUBTEST << "Clearing";
+        cache.putPath(2, "/docs", cache.getGeneration());
+        cache.clear();
+        EXPECT_FALSE(cache.getPath(2));
+    }
+    {
+        G_SUBTEST << "Values got before clearing are discarded";
+        auto generation = cache.getGeneration();
+        cache.clear();
+        cache.putPath(2, "/docs", generation);
+        cache.putChild(1, "docs", 2, generation);
+        EXPECT_FALSE(cache.getPath(2));
+        EXPECT_FALSE(cache.getChild(1, "docs"));
+    }
+    {
+        G_SUBTEST << "Names";
+        cache.putPath(2, "/docs", cache.getGeneration());
+        cache.putChild(1, "docs", 2, cache.getGeneration());
+        cache.forgetChild(1, "docs");
+        EXPECT_FALSE(cache.getChild(1, "docs"));
+        EXPECT_TRUE(cache.getPath(2)); // still valid
+
+        cache.putChild(1, "docs", 2, cache.getGeneration());
+        cache.putChild(1, "docs", 3, cache.getGeneration()); // a duplicate name
+        EXPECT_EQ(cache.getChild(1, "docs"), std::optional<NodePathCache::Handle>(3));
+        cache.putChild(1, "renamed", 3, cache.getGeneration());
+        EXPECT_FALSE(cache.getChild(1, "docs"));
+        EXPECT_EQ(cache.getChild(1, "renamed"), std::optional<NodePathCache::Handle>(3));
+    }
+}
@@ -0,0 +1,280 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_pattern_matcher.h"
+
+using megacmd::PatternMatcher;
+using Backend = megacmd::PatternMatcher::Backend;
+
+namespace {
+
+// The backtracking matcher megacmdWildcardMatch used to be, kept as reference
+bool legacyWildcardMatch(const char *pszString, const char *pszMatch)
+{
+    const char *cp = nullptr;
+    const char *mp = nullptr;
+
+    while ((*pszString) && (*pszMatch != '*'))
+    {
+        if ((*pszMatch != *pszString) && (*pszMatch != '?'))
+        {
+            return false;
+        }
+        pszMatch++;
+        pszString++;
+    }
+
+    while (*pszString)
+    {
+        if (*pszMatch == '*')
+        {
+            if (!*++pszMatch)
+            {
+                return true;
+            }
+            mp = pszMatch;
+            cp = pszString + 1;
+        }
+        else if ((*pszMatch == *pszString) || (*pszMatch == '?'))
+        {
+            pszMatch++;
+            pszString++;
+        }
+        else
+        {
+            pszMatch = mp;
+            pszString = cp++;
+        }
+    }
+    while (*pszMatch == '*')
+    {
+        pszMatch++;
+    }
+    return !*pszMatch;
+}
+
+std::vector<std::string> getTestNames()
+{
+    return {"", "a", "abc", "abcd", "xabc", "abcabc", "file.txt", "file.txt.bak", ".txt", "a.c", "aXc",
+            "photo 001.JPG", "photo_002.jpg", "**", "?", "a*c", "line\nbreak.txt", "ab", "cd"};
+}
+
+}
+
+TEST(PatternMatcherTest, backendSelection)
+{
+    {
+        G_SUBTEST << "Wildcards";
+        EXPECT_EQ(PatternMatcher("abc", false).getBackend(), Backend::LITERAL);
+        EXPECT_EQ(PatternMatcher("abc*", false).getBackend(), Backend::PREFIX);
+        EXPECT_EQ(PatternMatcher("*", false).getBackend(), Backend::PREFIX);
+        EXPECT_EQ(PatternMatcher("*.txt", false).getBackend(), Backend::SUFFIX);
+        EXPECT_EQ(PatternMatcher("a*c", false).getBackend(), Backend::GLOB);
+        EXPECT_EQ(PatternMatcher("*a*", false).getBackend(), Backend::GLOB);
+        EXPECT_EQ(PatternMatcher("abc?", false).getBackend(), Backend::GLOB);
+    }
+    {
+        G_SUBTEST << "Regular expressions";
+        EXPECT_EQ(PatternMatcher("abc", true).getBackend(), Backend::LITERAL);
+        EXPECT_EQ(PatternMatcher("a[bc]d", true).getBackend(), Backend::REGEX);
+#ifdef USE_PCRE
+        EXPECT_EQ(PatternMatcher("abc.*", true).getBackend(), Backend::PREFIX);
+        EXPECT_EQ(PatternMatcher(".*abc", true).getBackend(), Backend::SUFFIX);
+#endif
+    }
+}
+
+TEST(PatternMatcherTest, wildcardsMatchLikeTheBacktrackingMatcher)
+{
+    for (const char *pattern : {"abc", "abc*", "*", "*.txt", "a*c", "*a*", "a?c", "?", "*abc*abc", "**", "", "*.jpg"})
+    {
+        G_SUBTEST << "Pattern " << pattern;
+        PatternMatcher matcher(pattern, false);
+        for (const auto &name : getTestNames())
+        {
+            EXPECT_EQ(matcher.matches(name), legacyWildcardMatch(name.c_str(), pattern)) << name;
+        }
+    }
+}
+
+// Differential fuzzing of the glob compiler against the backtracking matcher
+TEST(PatternMatcherTest, globFuzzing)
+{
+    std::mt19937 random(20240601);
+    auto randomString = [&random](const char *alphabet, size_t maxSize)
+    {
+        std::string s(std::uniform_int_distribution<size_t>(0, maxSize)(random), ' ');
+        const size_t alphabetSize = std::strlen(alphabet);
+        for (auto &c : s)
+        {
+            c = alphabet[std::uniform_int_distribution<size_t>(0, alphabetSize - 1)(random)];
+        }
+        return s;
+    };
+
+    int mismatches = 0;
+    for (int i = 0; i < 200000 && mismatches < 10; ++i)
+    {
+        const std::string pattern = randomString("ab*?", 8);
+        const std::string name = randomString(i % 2 ? "ab" : "ab*?", 12);
+
+        const bool expected = legacyWildcardMatch(name.c_str(), pattern.c_str());
+        const bool compiled = megacmd::GlobPattern(pattern).matches(name);
+        const bool matched = PatternMatcher(pattern, false).matches(name);
+        if (compiled != expected || matched != expected)
+        {
+            ++mismatches;
+            ADD_FAILURE() << "pattern \"" << pattern << "\", name \"" << name << "\": expected " << expected
+                          << ", glob " << compiled << ", matcher " << matched;
+        }
+    }
+}
+
+TEST(PatternMatcherTest, regularExpressionsMatchTheWholeName)
+{
+    {
+        G_SUBTEST << "Literal";
+        PatternMatcher matcher("abc", true);
+        EXPECT_TRUE(matcher.matches("abc"));
+        EXPECT_FALSE(matcher.matches("abcd"));
+        EXPECT_FALSE(matcher.matches("xabc"));
+    }
+    {
+        G_SUBTEST << "Alternatives";
+        PatternMatcher matcher("ab|cd", true);
+        EXPECT_TRUE(matcher.matches("ab"));
+        EXPECT_TRUE(matcher.matches("cd"));
+        EXPECT_FALSE(matcher.matches("abcd"));
+    }
+    {
+        G_SUBTEST << "Prefix and suffix";
+        PatternMatcher prefix("file.*", true);
+        EXPECT_TRUE(prefix.matches("file.txt"));
+        EXPECT_FALSE(prefix.matches("afile.txt"));
+        PatternMatcher suffix(".*\\.jpg", true);
+        EXPECT_TRUE(suffix.matches("photo_002.jpg"));
+        EXPECT_FALSE(suffix.matches("photo 001.JPG"));
+        EXPECT_FALSE(suffix.matches("line\nbreak.jpg"));
+    }
+    {
+        G_SUBTEST << "Null names";
+        EXPECT_FALSE(PatternMatcher("*", false).matches(static_cast<const char*>(nullptr)));
+    }
+}
+
+TEST(PatternMatcherTest, invalidRegularExpressionsMatchNothing)
+{
+    PatternMatcher matcher("(abc", true);
+    EXPECT_FALSE(matcher.isValid());
+    for (const auto &name : getTestNames())
+    {
+        EXPECT_FALSE(matcher.matches(name)) << name;
+    }
+}
+
+TEST(PatternMatcherTest, requiredSubstrings)
+{
+    using Substrings = std::vector<std::string>;
+    EXPECT_EQ(PatternMatcher("report.pdf", false).getRequiredSubstrings(), Substrings({"report.pdf"}));
+    EXPECT_EQ(PatternMatcher("*.pdf", false).getRequiredSubstrings(), Substrings({".pdf"}));
+    EXPECT_EQ(PatternMatcher("*re?ort*2024*", false).getRequiredSubstrings(), Substrings({"re", "ort", "2024"}));
+    EXPECT_EQ(PatternMatcher("*", false).getRequiredSubstrings(), Substrings({""}));
+    EXPECT_EQ(PatternMatcher("a[bc]d", true).getRequiredSubstrings(), Substrings());
+}
+
+TEST(PatternMatcherTest, cacheCompilesEachPatternOnce)
+{
+    megacmd::PatternMatcherCache cache(false);
+    const PatternMatcher &first = cache.get("a*c");
+    cache.get("*.txt");
+    EXPECT_EQ(&first, &cache.get("a*c"));
+    EXPECT_TRUE(first.matches("abc"));
+}
+
+// Matches per second of each backend, compiled once vs once per name (run with --gtest_also_run_disabled_tests)
+TEST(PatternMatcherTest, DISABLED_benchmarkMatchesPerSecond)
+{
+    std::vector<std::string> names;
+    for (int i = 0; i < 200000; ++i)
+    {
+        names.push_back("folder " + std::to_string(i % 97) + "/document_" + std::to_string(i) + (i % 3 ? ".txt" : ".pdf"));
+    }
+
+    struct Case { const char *mPattern; bool mUsePcre; };
+    for (const Case &c : {Case{"document_100.txt", false}, Case{"folder 1*", false}, Case{"*.pdf", false}, Case{"*doc*_1?.txt", false},
+                          Case{"document_100.txt", true}, Case{".*\\.pdf", true}, Case{"document_[0-9]+\\.(txt|pdf)", true}})
+    {
+        size_t compiledMatches = 0;
+        auto start = std::chrono::steady_clock::now();
+        PatternMatcher matcher(c.mPattern, c.mUsePcre);
+        for (const auto &name : names)
+        {
+            compiledMatches += matcher.matches(name);
+        }
+        auto compiledTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        size_t perNameMatches = 0;
+        start = std::chrono::steady_clock::now();
+        for (const auto &name : names)
+        {
+            perNameMatches += PatternMatcher(c.mPattern, c.mUsePcre).matches(name);
+        }
+        auto perNameTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        ASSERT_EQ(compiledMatches, perNameMatches);
+        std::cout << c.mPattern << (c.mUsePcre ? " (regex)" : "") << " [" << PatternMatcher::getBackendName(matcher.getBackend()) << "]: "
+                  << static_cast<long long>(names.size() / compiledTime) << " matches/s compiled once, "
+                  << static_cast<long long>(names.size() / perNameTime) << " matches/s compiled per name" << std::endl;
+    }
+}
+
+// Patterns that make the backtracking matcher rescan the name for every star (run with --gtest_also_run_disabled_tests)
+TEST(PatternMatcherTest, DISABLED_benchmarkAdversarialGlob)
+{
+    const std::string name(4096, 'a');
+    for (const char *pattern : {"*a*a*a*b", "*a*a*a*a*a*a*a*a*b", "*?a?*?a?*b"})
+    {
+        const int iterations = 200;
+        auto start = std::chrono::steady_clock::now();
+        bool legacy = false;
+        for (int i = 0; i < iterations; ++i)
+        {
+            legacy |= legacyWildcardMatch(name.c_str(), pattern);
+        }
+        auto legacyTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        megacmd::GlobPattern glob(pattern);
+        start = std::chrono::steady_clock::now();
+        bool compiled = false;
+        for (int i = 0; i < iterations; ++i)
+        {
+            compiled |= glob.matches(name);
+        }
+        auto compiledTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        ASSERT_EQ(legacy, compiled);
+        std::cout << pattern << " on " << name.size() << " chars: " << static_cast<long long>(iterations / legacyTime)
+                  << " matches/s backtracking, " << static_cast<long long>(iterations / compiledTime) << " matches/s compiled" << std::endl;
+    }
+}
@@ -0,0 +1,205 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <future>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_petition_scheduler.h"
+
+using namespace std::chrono_literals;
+using megacmd::CancellationToken;
+using megacmd::PetitionClass;
+using megacmd::PetitionScheduler;
+
+TEST(PetitionSchedulerTest, classify)
+{
+    struct Case
+    {
+        const char* mLine;
+        PetitionClass mExpected;
+    };
+    const Case cases[] = {
+        {"pwd", PetitionClass::INTERACTIVE},
+        {"transfers --summary", PetitionClass::INTERACTIVE},
+        {"  sync", PetitionClass::INTERACTIVE},
+        {"ls -l /some/folder", PetitionClass::INTERACTIVE},
+        {"ls --show-handles", PetitionClass::INTERACTIVE},
+        {"ls -R /", PetitionClass::TRAVERSAL},
+        {"ls -lr", PetitionClass::TRAVERSAL},
+        {"ls --tree", PetitionClass::TRAVERSAL},
+        {"find / --pattern=*.jpg", PetitionClass::TRAVERSAL},
+        {"du -h", PetitionClass::TRAVERSAL},
+        {"rm -rf folder", PetitionClass::TRAVERSAL},
+        {"get /remote ./local", PetitionClass::TRANSFER},
+        {"put -c local /remote", PetitionClass::TRANSFER},
+        {"cat file.txt", PetitionClass::TRANSFER},
+        {"getter", PetitionClass::INTERACTIVE},
+        {"", PetitionClass::INTERACTIVE},
+    };
+
+    for (const auto &c : cases)
+    {
+        G_SUBTEST << c.mLine;
+        EXPECT_EQ(PetitionScheduler::classify(c.mLine), c.mExpected);
+    }
+}
+
+TEST(PetitionSchedulerTest, busyClassDoesNotDelayOthers)
+{
+    PetitionScheduler::Limits limits;
+    limits.fill({1, 1});
+    PetitionScheduler scheduler(limits);
+
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::promise<void> blockerStarted;
+    ASSERT_TRUE(scheduler.trySubmit(PetitionClass::TRANSFER,
+                                    [&blockerStarted, released](std::chrono::milliseconds) { blockerStarted.set_value(); released.wait(); }));
+    blockerStarted.get_future().wait();
+
+    // The transfer class has room for one more queued petition only
+    ASSERT_TRUE(scheduler.trySubmit(PetitionClass::TRANSFER, [](std::chrono::milliseconds) {}));
+    PetitionScheduler::Task rejected = [](std::chrono::milliseconds) {};
+    EXPECT_FALSE(scheduler.trySubmit(PetitionClass::TRANSFER, std::move(rejected)));
+    EXPECT_TRUE(rejected); // given back to the caller
+
+    std::promise<void> interactiveDone;
+    auto interactiveFuture = interactiveDone.get_future();
+    ASSERT_TRUE(scheduler.trySubmit(PetitionClass::INTERACTIVE,
+                                    [&interactiveDone](std::chrono::milliseconds) { interactiveDone.set_value(); }));
+    EXPECT_EQ(interactiveFuture.wait_for(5s), std::future_status::ready);
+    EXPECT_EQ(scheduler.getNumOngoingTasks(PetitionClass::TRANSFER), 2u);
+
+    release.set_value();
+}
+
+TEST(PetitionSchedulerTest, reportsQueueWaitTime)
+{
+    PetitionScheduler::Limits limits;
+    limits.fill({1, 10});
+    PetitionScheduler scheduler(limits);
+
+    std::promise<void> blockerStarted;
+    ASSERT_TRUE(scheduler.submit(PetitionClass::TRAVERSAL, [&blockerStarted](std::chrono::milliseconds)
+    {
+        blockerStarted.set_value();
+        std::this_thread::sleep_for(50ms);
+    }));
+    blockerStarted.get_future().wait();
+
+    std::promise<std::chrono::milliseconds> waited;
+    auto waitedFuture = waited.get_future();
+    ASSERT_TRUE(scheduler.submit(PetitionClass::TRAVERSAL, [&waited](std::chrono::milliseconds wait) { waited.set_value(wait); }));
+
+    ASSERT_EQ(waitedFuture.wait_for(5s), std::future_status::ready);
+    EXPECT_GE(waitedFuture.get(), 30ms);
+}
+
+TEST(PetitionSchedulerTest, fullClassDefersPetitions)
+{
+    PetitionScheduler::Limits limits;
+    limits.fill({1, 1});
+    PetitionScheduler scheduler(limits);
+
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::promise<void> blockerStarted;
+    ASSERT_TRUE(scheduler.submitOrDefer(PetitionClass::TRAVERSAL,
+                                        [&blockerStarted, released](std::chrono::milliseconds) { blockerStarted.set_value(); released.wait(); }));
+    blockerStarted.get_future().wait();
+
+    // One queued, the rest deferred: none rejected, and all run in order once there is room
+    std::mutex mutex;
+    std::vector<int> order;
+    std::promise<void> allDone;
+    constexpr int numPetitions = 5;
+    for (int i = 0; i < numPetitions; ++i)
+    {
+        ASSERT_TRUE(scheduler.submitOrDefer(PetitionClass::TRAVERSAL, [&mutex, &order, &allDone, i](std::chrono::milliseconds)
+        {
+            bool last = false;
+            {
+                std::lock_guard<std::mutex> guard(mutex);
+                order.push_back(i);
+                last = order.size() == numPetitions;
+            }
+            if (last)
+            {
+                allDone.set_value();
+            }
+        }));
+    }
+    EXPECT_EQ(scheduler.getNumDeferredTasks(PetitionClass::TRAVERSAL), 4u);
+    EXPECT_EQ(scheduler.getNumOngoingTasks(PetitionClass::TRAVERSAL), 6u);
+
+    release.set_value();
+    ASSERT_EQ(allDone.get_future().wait_for(5s), std::future_status::ready);
+    EXPECT_EQ(order, std::vector<int>({0, 1, 2, 3, 4}));
+    EXPECT_EQ(scheduler.getNumDeferredTasks(PetitionClass::TRAVERSAL), 0u);
+
+    scheduler.stop();
+    EXPECT_FALSE(scheduler.submitOrDefer(PetitionClass::TRAVERSAL, [](std::chrono::milliseconds) {}));
+}
+
+TEST(PetitionSchedulerTest, stopCancelsRunningPetitions)
+{
+    PetitionScheduler::Limits limits;
+    limits.fill({1, 1});
+    PetitionScheduler scheduler(limits);
+
+    std::atomic<int> cancelled{0};
+    std::promise<void> allStarted;
+    std::atomic<int> started{0};
+    auto runUntilCancelled = [&cancelled, &started, &allStarted](CancellationToken token)
+    {
+        return [&cancelled, &started, &allStarted, token](std::chrono::milliseconds)
+        {
+            if (++started == 2)
+            {
+                allStarted.set_value();
+            }
+            while (!token.isCancelled())
+            {
+                std::this_thread::sleep_for(1ms);
+            }
+            ++cancelled;
+        };
+    };
+
+    CancellationToken transferToken;
+    CancellationToken traversalToken;
+    ASSERT_TRUE(scheduler.submitOrDefer(PetitionClass::TRANSFER, runUntilCancelled(transferToken), transferToken));
+    ASSERT_TRUE(scheduler.submitOrDefer(PetitionClass::TRAVERSAL, runUntilCancelled(traversalToken), traversalToken));
+    ASSERT_EQ(allStarted.get_future().wait_for(5s), std::future_status::ready);
+
+    // Deferred ones are discarded, never cancelled
+    CancellationToken queuedToken;
+    CancellationToken deferredToken;
+    ASSERT_TRUE(scheduler.submitOrDefer(PetitionClass::TRANSFER, [](std::chrono::milliseconds) {}, queuedToken));
+    ASSERT_TRUE(scheduler.submitOrDefer(PetitionClass::TRANSFER, [](std::chrono::milliseconds) {}, deferredToken));
+    EXPECT_EQ(scheduler.getNumDeferredTasks(PetitionClass::TRANSFER), 1u);
+
+    EXPECT_EQ(scheduler.stop(5s), 0u);
+    EXPECT_EQ(cancelled, 2);
+    EXPECT_TRUE(transferToken.isCancelled());
+    EXPECT_TRUE(traversalToken.isCancelled());
+    EXPECT_FALSE(queuedToken.isCancelled());
+    EXPECT_FALSE(deferredToken.isCancelled());
+    EXPECT_EQ(scheduler.getNumOngoingTasks(), 0u);
+}
@@ -0,0 +1,104 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_progress_aggregator.h"
+
+using namespace std::chrono_literals;
+using megacmd::ProgressAggregator;
+
+namespace
+{
+class SentMessages
+{
+public:
+    void add(int clientID, const std::string &message)
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        mMessages.emplace_back(clientID, message);
+    }
+
+    std::vector<std::pair<int, std::string>> get()
+    {
+        std::lock_guard<std::mutex> g(mMutex);
+        return mMessages;
+    }
+
+private:
+    std::mutex mMutex;
+    std::vector<std::pair<int, std::string>> mMessages;
+};
+}
+
+TEST(ProgressAggregatorTest, mergesUpdatesWithinTheInterval)
+{
+    SentMessages sent;
+    ProgressAggregator aggregator(1h, [&sent](int clientID, const std::string &m) { sent.add(clientID, m); });
+
+    for (int i = 1; i <= 1000; ++i)
+    {
+        aggregator.update(i, 1000, 7);
+    }
+    aggregator.update(ProgressAggregator::sCompleteMark, 1000, 7);
+
+    auto messages = sent.get();
+    ASSERT_EQ(messages.size(), 2u);
+    EXPECT_EQ(messages[0], std::make_pair(7, std::string("progress:1:1000")));
+    EXPECT_EQ(messages[1], std::make_pair(7, std::string("progress:-2:1000")));
+}
+
+TEST(ProgressAggregatorTest, sendsTheLatestUpdateOnceTheIntervalElapses)
+{
+    SentMessages sent;
+    ProgressAggregator aggregator(20ms, [&sent](int clientID, const std::string &m) { sent.add(clientID, m); });
+
+    aggregator.update(1, 10, 1, "Fetching nodes");
+    aggregator.update(2, 10, 1, "Fetching nodes");
+    aggregator.update(3, 10, 1, "Fetching nodes");
+    aggregator.update(5, 50, 2);
+
+    for (int i = 0; i < 100 && sent.get().size() < 3; ++i)
+    {
+        std::this_thread::sleep_for(10ms);
+    }
+
+    auto messages = sent.get();
+    ASSERT_EQ(messages.size(), 3u);
+    EXPECT_EQ(messages[0], std::make_pair(1, std::string("progress:1:10:Fetching nodes")));
+    EXPECT_EQ(messages[1], std::make_pair(2, std::string("progress:5:50")));
+    EXPECT_EQ(messages[2], std::make_pair(1, std::string("progress:3:10:Fetching nodes")));
+}
+
+TEST(ProgressAggregatorTest, completionDiscardsPendingUpdates)
+{
+    SentMessages sent;
+    {
+        ProgressAggregator aggregator(50ms, [&sent](int clientID, const std::string &m) { sent.add(clientID, m); });
+        aggregator.update(1, 10, 3);
+        aggregator.update(9, 10, 3);
+        aggregator.update(ProgressAggregator::sCompleteMark, 10, 3);
+        std::this_thread::sleep_for(100ms);
+    }
+
+    auto messages = sent.get();
+    ASSERT_EQ(messages.size(), 2u);
+    EXPECT_EQ(messages.back().second, "progress:-2:10");
+}
@@ -0,0 +1,269 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <map>
+#include <random>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_size_cache.h"
+
+using megacmd::FolderSizeCache;
+using Handle = FolderSizeCache::Handle;
+using Aggregate = FolderSizeCache::Aggregate;
+
+namespace {
+
+// A tree of folders and files (files' children being their previous versions)
+struct Tree
+{
+    struct Node
+    {
+        Handle mParent;
+        bool mIsFile;
+        int64_t mSize;
+    };
+    std::map<Handle, Node> mNodes;
+
+    std::vector<Handle> getChildren(Handle parent) const
+    {
+        std::vector<Handle> children;
+        for (const auto &node : mNodes)
+        {
+            if (node.second.mParent == parent)
+            {
+                children.push_back(node.first);
+            }
+        }
+        return children;
+    }
+
+    int64_t getVersionsSize(Handle file) const
+    {
+        int64_t size = mNodes.at(file).mSize;
+        for (Handle version : getChildren(file))
+        {
+            size += getVersionsSize(version);
+        }
+        return size;
+    }
+
+    // What the executer does: cached aggregates of subfolders are reused, and new ones stored
+    Aggregate compute(FolderSizeCache &cache, Handle folder, int *numComputed = nullptr) const
+    {
+        if (auto cached = cache.get(folder))
+        {
+            return *cached;
+        }
+        if (numComputed)
+        {
+            ++*numComputed;
+        }
+
+        const uint64_t generation = cache.getGeneration();
+        Aggregate aggregate;
+        auto children = getChildren(folder);
+        for (Handle child : children)
+        {
+            if (mNodes.at(child).mIsFile)
+            {
+                aggregate.mVersionBytes += getVersionsSize(child);
+            }
+            else
+            {
+                aggregate.mVersionBytes += compute(cache, child, numComputed).mVersionBytes;
+            }
+        }
+        cache.store(folder, mNodes.at(folder).mParent, aggregate, children, generation);
+        return aggregate;
+    }
+
+    void update(FolderSizeCache &cache, Handle handle, Handle parent, bool isFile, int64_t size)
+    {
+        mNodes[handle] = Node{parent, isFile, size};
+        cache.onNodeUpdated(handle, parent, false);
+    }
+
+    void remove(FolderSizeCache &cache, Handle handle)
+    {
+        for (Handle child : getChildren(handle))
+        {
+            remove(cache, child);
+        }
+        cache.onNodeUpdated(handle, mNodes.at(handle).mParent, true);
+        mNodes.erase(handle);
+    }
+};
+
+constexpr Handle UNDEF_HANDLE = ~Handle(0);
+
+// root(1): docs(2): {a(3) 10 bytes [version: 4 bytes], sub(5): {b(6) 100 bytes}}, photos(7): {c(8) 1000 bytes}
+Tree getSampleTree()
+{
+    Tree tree;
+    tree.mNodes = {{1, {UNDEF_HANDLE, false, 0}},
+                   {2, {1, false, 0}},
+                   {3, {2, true, 10}},
+                   {4, {3, true, 4}},
+                   {5, {2, false, 0}},
+                   {6, {5, true, 100}},
+                   {7, {1, false, 0}},
+                   {8, {7, true, 1000}}};
+    return tree;
+}
+
+void expectAggregate(const Aggregate &aggregate, int64_t versionBytes)
+{
+    EXPECT_EQ(aggregate.mVersionBytes, versionBytes);
+}
+
+}
+
+TEST(SizeCacheTest, aggregatesAreComputedOnce)
+{
+    Tree tree = getSampleTree();
+    FolderSizeCache cache;
+
+    int numComputed = 0;
+    expectAggregate(tree.compute(cache, 1, &numComputed), 1114);
+    EXPECT_EQ(numComputed, 4);
+
+    numComputed = 0;
+    expectAggregate(tree.compute(cache, 1, &numComputed), 1114);
+    expectAggregate(tree.compute(cache, 2, &numComputed), 114);
+    EXPECT_EQ(numComputed, 0);
+    EXPECT_EQ(cache.getStats().mNumAggregates, 4u);
+    EXPECT_GE(cache.getStats().mHits, 2u);
+}
+
+TEST(SizeCacheTest, updatesInvalidateTheAncestors)
+{
+    Tree tree = getSampleTree();
+    FolderSizeCache cache;
+    tree.compute(cache, 1);
+
+    {
+        G_SUBTEST << "New file";
+        tree.update(cache, 9, 5, true, 1);
+        EXPECT_FALSE(cache.get(5));
+        EXPECT_FALSE(cache.get(2));
+        EXPECT_FALSE(cache.get(1));
+        EXPECT_TRUE(cache.get(7)); // elsewhere
+
+        int numComputed = 0;
+        expectAggregate(tree.compute(cache, 1, &numComputed), 1115);
+        EXPECT_EQ(numComputed, 3);
+    }
+    {
+        G_SUBTEST << "New version";
+        tree.update(cache, 10, 2, true, 20);
+        tree.update(cache, 3, 10, true, 10); // the former file becomes a version of the new one
+        expectAggregate(tree.compute(cache, 2, nullptr), 135);
+    }
+    {
+        G_SUBTEST << "Move";
+        tree.update(cache, 8, 5, true, 1000);
+        EXPECT_FALSE(cache.get(7));
+        expectAggregate(tree.compute(cache, 7), 0);
+        expectAggregate(tree.compute(cache, 5), 1101);
+    }
+    {
+        G_SUBTEST << "Removal";
+        tree.remove(cache, 5);
+        expectAggregate(tree.compute(cache, 1), 34);
+        EXPECT_FALSE(cache.get(5));
+    }
+}
+
+TEST(SizeCacheTest, aggregatesComputedDuringUpdatesAreDiscarded)
+{
+    Tree tree = getSampleTree();
+    FolderSizeCache cache;
+
+    const uint64_t generation = cache.getGeneration();
+    Aggregate stale = tree.compute(cache, 7);
+    cache.clear();
+    tree.update(cache, 9, 7, true, 1);
+    EXPECT_FALSE(cache.store(7, 1, stale, tree.getChildren(7), generation));
+    EXPECT_FALSE(cache.get(7));
+    expectAggregate(tree.compute(cache, 7), 1001);
+}
+
+// Random updates, with the cached aggregates checked against fresh computations
+TEST(SizeCacheTest, randomUpdates)
+{
+    std::mt19937 random(20240615);
+    Tree tree = getSampleTree();
+    FolderSizeCache cache;
+    Handle next = 100;
+
+    for (int i = 0; i < 2000; ++i)
+    {
+        std::vector<Handle> folders;
+        for (const auto &node : tree.mNodes)
+        {
+            if (!node.second.mIsFile)
+            {
+                folders.push_back(node.first);
+            }
+        }
+        auto pick = [&random](const std::vector<Handle> &v) { return v[std::uniform_int_distribution<size_t>(0, v.size() - 1)(random)]; };
+
+        const Handle folder = pick(folders);
+        switch (std::uniform_int_distribution<int>(0, 3)(random))
+        {
+            case 0:
+                tree.update(cache, next++, folder, true, std::uniform_int_distribution<int64_t>(0, 1000)(random));
+                break;
+            case 1:
+                tree.update(cache, next++, folder, false, 0);
+                break;
+            case 2:
+            {
+                // moves a file (folders could create cycles)
+                std::vector<Handle> files;
+                for (const auto &node : tree.mNodes)
+                {
+                    if (node.second.mIsFile && !tree.mNodes.at(node.second.mParent).mIsFile)
+                    {
+                        files.push_back(node.first);
+                    }
+                }
+                if (!files.empty())
+                {
+                    Handle file = pick(files);
+                    tree.update(cache, file, folder, true, tree.mNodes.at(file).mSize);
+                }
+                break;
+            }
+            case 3:
+                if (folder != 1 && random() % 4 == 0)
+                {
+                    tree.remove(cache, folder);
+                }
+                break;
+        }
+
+        FolderSizeCache fresh;
+        const Handle queried = pick(folders);
+        if (tree.mNodes.count(queried))
+        {
+            Aggregate expected = tree.compute(fresh, queried);
+            Aggregate cached = tree.compute(cache, queried);
+            ASSERT_EQ(cached.mVersionBytes, expected.mVersionBytes) << "iteration " << i;
+        }
+    }
+}
@@ -0,0 +1,100 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_state_listener_queue.h"
+
+using megacmd::StateListenerQueue;
+
+namespace
+{
+std::string drain(StateListenerQueue &queue)
+{
+    std::string sent;
+    while (!queue.empty())
+    {
+        auto front = queue.front();
+        sent.append(front);
+        queue.consume(front.size());
+    }
+    return sent;
+}
+}
+
+TEST(StateListenerQueueTest, keepsOrder)
+{
+    StateListenerQueue queue;
+    EXPECT_TRUE(queue.push("message:one;"));
+    EXPECT_TRUE(queue.push("ack;"));
+    EXPECT_TRUE(queue.push("message:two;"));
+    EXPECT_EQ(drain(queue), "message:one;ack;message:two;");
+}
+
+TEST(StateListenerQueueTest, coalescesSupersededMessages)
+{
+    {
+        G_SUBTEST << "Prompts";
+        StateListenerQueue queue;
+        queue.push("prompt:a;");
+        queue.push("message:m;");
+        queue.push("prompt:b;");
+        EXPECT_EQ(queue.size(), 2u);
+        EXPECT_EQ(drain(queue), "prompt:b;message:m;");
+    }
+    {
+        G_SUBTEST << "Progress";
+        StateListenerQueue queue;
+        for (int i = 0; i < 100; ++i)
+        {
+            queue.push("progress:" + std::to_string(i) + ":100;");
+        }
+        EXPECT_EQ(drain(queue), "progress:99:100;");
+    }
+    {
+        G_SUBTEST << "Completion is never dropped";
+        StateListenerQueue queue;
+        queue.push("progress:50:100;");
+        queue.push("progress:-2:100;");
+        queue.push("progress:0:200:next;");
+        queue.push("progress:10:200:next;");
+        EXPECT_EQ(drain(queue), "progress:-2:100;progress:10:200:next;");
+    }
+}
+
+TEST(StateListenerQueueTest, partiallySentMessagesAreNotReplaced)
+{
+    StateListenerQueue queue;
+    queue.push("prompt:first;");
+    queue.consume(3);
+    queue.push("prompt:second;");
+    EXPECT_EQ(queue.front(), "mpt:first;");
+    EXPECT_EQ(drain(queue), "mpt:first;prompt:second;");
+
+    queue.push("prompt:third;");
+    EXPECT_EQ(drain(queue), "prompt:third;");
+}
+
+TEST(StateListenerQueueTest, isBounded)
+{
+    StateListenerQueue queue(3);
+    EXPECT_TRUE(queue.push("message:1;"));
+    EXPECT_TRUE(queue.push("message:2;"));
+    EXPECT_TRUE(queue.push("progress:1:2;"));
+    EXPECT_FALSE(queue.push("message:3;"));
+    EXPECT_TRUE(queue.push("progress:2:2;")); // coalesced: takes no room
+    EXPECT_EQ(queue.size(), 3u);
+}
@@ -0,0 +1,303 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <set>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_tree_traversal.h"
+
+using megacmd::TraversalOptions;
+using megacmd::TraversalOrder;
+using megacmd::VisitInfo;
+
+namespace {
+
+// Synthetic tree: node ids are assigned in pre-order; folders have `fanout` children, half of them folders
+struct TestTree
+{
+    struct Node
+    {
+        std::vector<int> mChildren;
+        bool mIsFolder = false;
+    };
+    std::vector<Node> mNodes;
+    std::chrono::microseconds mGetChildrenCost{0};
+    std::mutex *mGetChildrenLock = nullptr; // if set, held while getting children, as the SDK does with its global lock
+    std::atomic<int> mNumExpanded{0};
+
+    TestTree(int depth, int fanout)
+    {
+        build(depth, fanout);
+    }
+
+    int build(int depth, int fanout)
+    {
+        int id = static_cast<int>(mNodes.size());
+        mNodes.emplace_back();
+        mNodes[id].mIsFolder = depth > 0;
+        for (int i = 0; depth > 0 && i < fanout; ++i)
+        {
+            int child = i % 2 ? build(0, fanout) : build(depth - 1, fanout);
+            mNodes[id].mChildren.push_back(child);
+        }
+        return id;
+    }
+
+    megacmd::TreeTraversal<int> traversal(const TraversalOptions &options, megacmd::TreeTraversal<int>::FolderChecker shouldExpand = {})
+    {
+        return megacmd::TreeTraversal<int>(
+            [this](const int &folder)
+            {
+                ++mNumExpanded;
+                std::unique_lock<std::mutex> lock;
+                if (mGetChildrenLock)
+                {
+                    lock = std::unique_lock<std::mutex>(*mGetChildrenLock);
+                }
+                if (mGetChildrenCost.count())
+                {
+                    // emulates the cost of getting (and copying) the children of a folder
+                    auto until = std::chrono::steady_clock::now() + mGetChildrenCost;
+                    while (std::chrono::steady_clock::now() < until);
+                }
+                return mNodes[folder].mChildren;
+            },
+            [this](const int &node) { return mNodes[node].mIsFolder; },
+            options,
+            std::move(shouldExpand));
+    }
+
+    void sequential(int node, bool preOrder, int depth, int maxDepth, std::vector<std::pair<int, int>> &out) const
+    {
+        if (preOrder) out.emplace_back(node, depth);
+        if (mNodes[node].mIsFolder && (maxDepth < 0 || depth < maxDepth))
+        {
+            for (int child : mNodes[node].mChildren)
+            {
+                sequential(child, preOrder, depth + 1, maxDepth, out);
+            }
+        }
+        if (!preOrder) out.emplace_back(node, depth);
+    }
+};
+
+std::vector<std::pair<int, int>> traverse(TestTree &tree, TraversalOptions options)
+{
+    std::vector<std::pair<int, int>> visited;
+    std::mutex mutex;
+    auto traversal = tree.traversal(options);
+    EXPECT_TRUE(traversal.run(0, [&visited, &mutex](const int &node, const VisitInfo &info)
+    {
+        std::lock_guard<std::mutex> g(mutex);
+        visited.emplace_back(node, info.mDepth);
+    }));
+    return visited;
+}
+
+}
+
+TEST(TreeTraversalTest, orderedTraversalsAreDeterministic)
+{
+    TestTree tree(6, 6);
+
+    for (auto order : {TraversalOrder::PRE_ORDER, TraversalOrder::POST_ORDER})
+    {
+        std::vector<std::pair<int, int>> expected;
+        tree.sequential(0, order == TraversalOrder::PRE_ORDER, 0, -1, expected);
+
+        for (unsigned numThreads : {0u, 1u, 4u})
+        {
+            for (size_t maxBuffered : {size_t(1), size_t(64 * 1024)})
+            {
+                G_SUBTEST << "order " << static_cast<int>(order) << ", threads " << numThreads << ", max buffered " << maxBuffered;
+                TraversalOptions options;
+                options.mOrder = order;
+                options.mNumThreads = numThreads;
+                options.mMaxBufferedNodes = maxBuffered;
+                EXPECT_EQ(traverse(tree, options), expected);
+            }
+        }
+    }
+}
+
+TEST(TreeTraversalTest, unorderedVisitsEveryNodeOnce)
+{
+    TestTree tree(6, 6);
+    std::vector<std::pair<int, int>> expected;
+    tree.sequential(0, true, 0, -1, expected);
+    std::sort(expected.begin(), expected.end());
+
+    for (unsigned numThreads : {0u, 1u, 4u})
+    {
+        G_SUBTEST << "threads " << numThreads;
+        TraversalOptions options;
+        options.mOrder = TraversalOrder::UNORDERED;
+        options.mNumThreads = numThreads;
+        auto visited = traverse(tree, options);
+        std::sort(visited.begin(), visited.end());
+        EXPECT_EQ(visited, expected);
+    }
+}
+
+TEST(TreeTraversalTest, maxDepth)
+{
+    TestTree tree(5, 4);
+    for (int maxDepth : {0, 1, 3})
+    {
+        G_SUBTEST << "max depth " << maxDepth;
+        std::vector<std::pair<int, int>> expected;
+        tree.sequential(0, true, 0, maxDepth, expected);
+
+        TraversalOptions options;
+        options.mMaxDepth = maxDepth;
+        options.mNumThreads = 2;
+        EXPECT_EQ(traverse(tree, options), expected);
+    }
+}
+
+TEST(TreeTraversalTest, foldersNotToExpandArePruned)
+{
+    TestTree tree(5, 4);
+    const int pruned = tree.mNodes[0].mChildren[0]; // the first subfolder of the root, and everything below it
+    std::vector<std::pair<int, int>> below;
+    tree.sequential(pruned, true, 1, -1, below);
+
+    for (auto order : {TraversalOrder::PRE_ORDER, TraversalOrder::POST_ORDER, TraversalOrder::UNORDERED})
+    {
+        G_SUBTEST << "order " << static_cast<int>(order);
+        TraversalOptions options;
+        options.mOrder = order;
+        options.mNumThreads = 2;
+
+        tree.mNumExpanded = 0;
+        std::set<int> visited;
+        std::mutex mutex;
+        auto traversal = tree.traversal(options, [pruned](const int &folder) { return folder != pruned; });
+        EXPECT_TRUE(traversal.run(0, [&visited, &mutex](const int &node, const VisitInfo&)
+        {
+            std::lock_guard<std::mutex> g(mutex);
+            visited.insert(node);
+        }));
+
+        int numFolders = 0;
+        int numFoldersBelow = 0;
+        for (const auto &node : tree.mNodes)
+        {
+            numFolders += node.mIsFolder;
+        }
+        for (const auto &visit : below)
+        {
+            numFoldersBelow += tree.mNodes[visit.first].mIsFolder;
+        }
+        EXPECT_EQ(tree.mNumExpanded, numFolders - numFoldersBelow);
+        EXPECT_EQ(visited.size(), tree.mNodes.size() - below.size() + 1); // the pruned folder itself is visited
+        EXPECT_TRUE(visited.count(pruned));
+    }
+}
+
+TEST(TreeTraversalTest, folderVisitorAndLastChild)
+{
+    TestTree tree(3, 3);
+    TraversalOptions options;
+    options.mNumThreads = 2;
+
+    std::vector<int> folders;
+    int lastChildren = 0;
+    auto traversal = tree.traversal(options);
+    traversal.run(0,
+        [&lastChildren](const int&, const VisitInfo &info) { lastChildren += info.mIsLastChild; },
+        [&folders, &tree](const int &folder, const std::vector<int> &children, int)
+        {
+            EXPECT_EQ(children, tree.mNodes[folder].mChildren);
+            folders.push_back(folder);
+        });
+
+    std::vector<std::pair<int, int>> preOrder;
+    tree.sequential(0, true, 0, -1, preOrder);
+    std::vector<int> expectedFolders;
+    for (auto &visit : preOrder)
+    {
+        if (tree.mNodes[visit.first].mIsFolder)
+        {
+            expectedFolders.push_back(visit.first);
+        }
+    }
+    EXPECT_EQ(folders, expectedFolders);
+    EXPECT_EQ(lastChildren, static_cast<int>(expectedFolders.size()) + 1); // one per folder, plus the root
+}
+
+TEST(TreeTraversalTest, cancellationStopsTheTraversal)
+{
+    TestTree tree(8, 6);
+    for (auto order : {TraversalOrder::PRE_ORDER, TraversalOrder::UNORDERED})
+    {
+        G_SUBTEST << "order " << static_cast<int>(order);
+        TraversalOptions options;
+        options.mOrder = order;
+        options.mNumThreads = 4;
+
+        std::atomic<int> visited{0};
+        auto traversal = tree.traversal(options);
+        auto token = options.mCancellationToken;
+        EXPECT_FALSE(traversal.run(0, [&visited, &token](const int&, const VisitInfo&)
+        {
+            if (++visited == 100)
+            {
+                token.cancel();
+            }
+        }));
+        EXPECT_LT(visited.load(), static_cast<int>(tree.mNodes.size()) / 2);
+    }
+}
+
+// Scaling benchmark (run with --gtest_also_run_disabled_tests). With getChildren serialized by a lock,
+// as with the SDK, more than one expanding thread is not expected to help (hence the default of one)
+TEST(TreeTraversalTest, DISABLED_benchmarkScaling)
+{
+    TestTree tree(9, 6); // ~10K folders, ~60K nodes
+    tree.mGetChildrenCost = std::chrono::microseconds(20);
+    std::mutex getChildrenLock;
+
+    std::cout << "nodes: " << tree.mNodes.size() << std::endl;
+    for (bool contended : {false, true})
+    {
+        tree.mGetChildrenLock = contended ? &getChildrenLock : nullptr;
+        for (auto order : {TraversalOrder::UNORDERED, TraversalOrder::PRE_ORDER})
+        {
+            for (unsigned numThreads : {0u, 1u, 2u, 4u, 8u})
+            {
+                TraversalOptions options;
+                options.mOrder = order;
+                options.mNumThreads = numThreads;
+
+                std::atomic<size_t> visited{0};
+                auto start = std::chrono::steady_clock::now();
+                auto traversal = tree.traversal(options);
+                traversal.run(0, [&visited](const int&, const VisitInfo&) { ++visited; });
+                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+                ASSERT_EQ(visited, tree.mNodes.size());
+                std::cout << (contended ? "locked getChildren, " : "") << (order == TraversalOrder::UNORDERED ? "unordered" : "pre-order") << ", threads: " << numThreads
+                          << ": " << elapsed.count() << " ms" << std::endl;
+            }
+        }
+    }
+}
@@ -0,0 +1,173 @@
+/**
+ * (c) 2013 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of MEGAcmd.
+ *
+ * MEGAcmd is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <future>
+
+#include <gtest/gtest.h>
+
+#include "TestUtils.h"
+#include "megacmd_worker_pool.h"
+
+using namespace std::chrono_literals;
+
+TEST(WorkerPoolTest, runsAllTasks)
+{
+    megacmd::WorkerPool pool(4, 100);
+    std::atomic<int> executed{0};
+
+    constexpr int numTasks = 1000;
+    for (int i = 0; i < numTasks; ++i)
+    {
+        ASSERT_TRUE(pool.submit([&executed]() { ++executed; }));
+    }
+
+    for (int i = 0; i < 500 && executed < numTasks; ++i)
+    {
+        std::this_thread::sleep_for(10ms);
+    }
+    EXPECT_EQ(executed, numTasks);
+    EXPECT_LE(pool.getNumWorkers(), 4u);
+}
+
+TEST(WorkerPoolTest, reusesWorkersForSequentialTasks)
+{
+    megacmd::WorkerPool pool(8, 8);
+
+    for (int i = 0; i < 50; ++i)
+    {
+        std::promise<void> done;
+        auto future = done.get_future();
+        ASSERT_TRUE(pool.submit([&done]() { done.set_value(); }));
+        ASSERT_EQ(future.wait_for(5s), std::future_status::ready);
+
+        // give the worker the chance to become idle again
+        for (int j = 0; j < 100 && pool.getNumOngoingTasks(); ++j)
+        {
+            std::this_thread::sleep_for(1ms);
+        }
+    }
+
+    EXPECT_EQ(pool.getNumWorkers(), 1u);
+}
+
+TEST(WorkerPoolTest, idleWorkersStealQueuedTasks)
+{
+    megacmd::WorkerPool pool(2, 10);
+
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::promise<void> blockerStarted;
+    ASSERT_TRUE(pool.submit([&blockerStarted, released]() { blockerStarted.set_value(); released.wait(); }));
+    blockerStarted.get_future().wait();
+
+    // These would be queued round-robin on both workers, including the blocked one
+    std::atomic<int> executed{0};
+    for (int i = 0; i < 6; ++i)
+    {
+        ASSERT_TRUE(pool.submit([&executed]() { ++executed; }));
+    }
+
+    for (int i = 0; i < 500 && executed < 6; ++i)
+    {
+        std::this_thread::sleep_for(10ms);
+    }
+    EXPECT_EQ(executed, 6);
+
+    release.set_value();
+}
+
+TEST(WorkerPoolTest, stopDiscardsPendingTasks)
+{
+    std::atomic<int> executed{0};
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    {
+        megacmd::WorkerPool pool(1, 10);
+        std::promise<void> blockerStarted;
+        ASSERT_TRUE(pool.submit([&blockerStarted, released]() { blockerStarted.set_value(); released.wait(); }));
+        blockerStarted.get_future().wait();
+
+        ASSERT_TRUE(pool.submit([&executed]() { ++executed; }));
+        EXPECT_EQ(pool.getNumOngoingTasks(), 2u);
+
+        EXPECT_EQ(pool.stop(10ms), 1u); // the blocker ignores cancellation: left behind
+        EXPECT_FALSE(pool.submit([&executed]() { ++executed; }));
+    }
+    release.set_value();
+    std::this_thread::sleep_for(50ms);
+    EXPECT_EQ(executed, 0);
+}
+
+TEST(WorkerPoolTest, stopCancelsRunningTasksAndJoinsTheirWorkers)
+{
+    megacmd::WorkerPool pool(2, 10);
+
+    std::atomic<int> started{0};
+    std::atomic<int> cancelled{0};
+    std::vector<megacmd::CancellationToken> tokens(2);
+    for (auto &token : tokens)
+    {
+        ASSERT_TRUE(pool.submit([&started, &cancelled, token]()
+        {
+            ++started;
+            while (!token.isCancelled())
+            {
+                std::this_thread::sleep_for(1ms);
+            }
+            ++cancelled;
+        }, token));
+    }
+    for (int i = 0; i < 500 && started < 2; ++i)
+    {
+        std::this_thread::sleep_for(10ms);
+    }
+    ASSERT_EQ(started, 2);
+
+    megacmd::CancellationToken discardedToken;
+    ASSERT_TRUE(pool.submit([]() {}, discardedToken));
+
+    EXPECT_EQ(pool.stop(5s), 0u);
+    EXPECT_EQ(cancelled, 2); // joined: done by then
+    EXPECT_FALSE(discardedToken.isCancelled()); // never started
+    EXPECT_EQ(pool.getNumOngoingTasks(), 0u);
+    EXPECT_EQ(pool.stop(5s), 0u);
+}
+
+TEST(WorkerPoolTest, trySubmitRejectsWhenQueueIsFull)
+{
+    megacmd::WorkerPool pool(1, 1);
+
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    std::promise<void> blockerStarted;
+    ASSERT_TRUE(pool.trySubmit([&blockerStarted, released]() { blockerStarted.set_value(); released.wait(); }));
+    blockerStarted.get_future().wait();
+
+    std::atomic<int> executed{0};
+    ASSERT_TRUE(pool.trySubmit([&executed]() { ++executed; }));
+
+    megacmd::WorkerPool::Task rejected = [&executed]() { executed += 10; };
+    EXPECT_FALSE(pool.trySubmit(std::move(rejected)));
+    ASSERT_TRUE(rejected); // left untouched
+
+    release.set_value();
+    for (int i = 0; i < 500 && executed < 1; ++i)
+    {
+        std::this_thread::sleep_for(10ms);
+    }
+    EXPECT_EQ(executed, 1);
+}